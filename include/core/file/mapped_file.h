@@ -0,0 +1,53 @@
+//
+// Created by kyrosz7u on 2023/7/4.
+//
+
+#ifndef XEXAMPLE_MAPPED_FILE_H
+#define XEXAMPLE_MAPPED_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// 只读文件映射，数据按需由操作系统分页读入
+class MappedFile
+{
+public:
+    MappedFile()
+    {}
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+
+    void close();
+
+    [[nodiscard]] inline const uint8_t *data() const
+    {
+        return m_data;
+    }
+
+    [[nodiscard]] inline size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    const uint8_t *m_data{nullptr};
+    size_t        m_size{0};
+#ifdef _WIN32
+    void *m_file_handle{nullptr};
+    void *m_mapping_handle{nullptr};
+#else
+    int m_file_descriptor{-1};
+#endif
+};
+
+#endif //XEXAMPLE_MAPPED_FILE_H
@@ -13,12 +13,19 @@
 
 #include "GLFW/glfw3.h"
 #include "vulkan/vulkan.h"
+#include "vulkan_timeline.h"
+#include "vulkan_deletion_queue.h"
 #include <vector>
 #include <optional>
 #include <algorithm>
 #include <functional>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <assert.h>
 
+class Thread;
+
 namespace VulkanAPI
 {
     struct RenderCommandInfo
@@ -33,6 +40,9 @@ namespace VulkanAPI
     {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // 没有独立的计算/传输队列族时与graphicsFamily相同
+        std::optional<uint32_t> computeFamily;
+        std::optional<uint32_t> transferFamily;
 
         bool isComplete()
         {
@@ -47,6 +57,28 @@ namespace VulkanAPI
         std::vector<VkPresentModeKHR>   presentModes;
     };
 
+    // 帧节奏设置，在吞吐量和输入延迟之间取舍
+    struct FramePacingSettings
+    {
+        // 设备不支持时回退到FIFO
+        VkPresentModeKHR present_mode{VK_PRESENT_MODE_MAILBOX_KHR};
+        // CPU最多领先GPU的帧数，取值1~kMaxFramesInFlight，越小延迟越低、吞吐量越低
+        uint32_t         frames_in_flight{3};
+        // 帧率上限，0为不限制
+        float            max_frame_rate{0.0f};
+    };
+
+    // 从采样输入开始计时的延迟，单位毫秒，取滑动平均
+    // 支持present wait时，上屏时间在等待线程中vkWaitForPresentKHR返回时记录；
+    // 否则GPU完成时间在之后某帧的beginFrame中轮询到，最多偏大一个CPU帧
+    struct FrameLatencyStats
+    {
+        float input_to_submit_ms{0.0f};
+        float input_to_present_ms{0.0f};
+        // true时呈现时间来自VK_KHR_present_wait，否则为GPU执行完该帧的时间
+        bool  present_wait_timing{false};
+    };
+
     // api中所有与管线执行无关的接口封装
     class VulkanContext
     {
@@ -56,21 +88,55 @@ namespace VulkanAPI
         VkSurfaceKHR               _surface;
         VkPhysicalDevice           _physical_device;
         VkPhysicalDeviceProperties _physical_device_properties;
+        // createLogicalDevice中实际开启的特性
+        VkPhysicalDeviceFeatures   _enabled_device_features{};
+        // 是否开启了VK_EXT_memory_budget
+        bool                       _memory_budget_supported{false};
+        // 是否开启了VK_KHR_multiview，点光源阴影一次pass绘制cube的六个面
+        bool                       _multiview_supported{false};
+        // 是否开启了VK_KHR_present_id和VK_KHR_present_wait，用于测量真实的呈现延迟
+        bool                       _present_wait_supported{false};
+        // 是否开启了VK_KHR_timeline_semaphore，不支持时VulkanTimeline用fence模拟
+        bool                       _timeline_semaphore_supported{false};
+        // 是否开启了VK_KHR_dynamic_rendering和VK_KHR_synchronization2，主相机pass不再需要render pass和framebuffer
+        bool                       _dynamic_rendering_supported{false};
 
         QueueFamilyIndices _queue_indices;
         VkDevice           _device;
         VkQueue            _graphics_queue = VK_NULL_HANDLE;
         VkQueue            _present_queue  = VK_NULL_HANDLE;
+        VkQueue            _compute_queue  = VK_NULL_HANDLE;
+        VkQueue            _transfer_queue = VK_NULL_HANDLE;
         VkCommandPool      _command_pool   = VK_NULL_HANDLE;
+        // 上传命令使用的传输队列族cmdpool
+        VkCommandPool      _transfer_command_pool = VK_NULL_HANDLE;
         VkSwapchainKHR     _swapchain      = VK_NULL_HANDLE;
 
+        // 每个队列一条timeline，提交返回的值完成后该次提交引用的资源即可回收或复用
+        VulkanTimeline _graphics_timeline;
+        VulkanTimeline _compute_timeline;
+        VulkanTimeline _transfer_timeline;
+        // 帧内释放的资源在对应的图形提交完成后才销毁
+        VulkanDeletionQueue _deletion_queue;
+
         void initialize(GLFWwindow *window);
 
         void clear();
 
         VkCommandBuffer beginSingleTimeCommands();
 
-        void endSingleTimeCommands(VkCommandBuffer command_buffer);
+        void endSingleTimeCommands(VkCommandBuffer command_buffer,
+                                   const std::vector<TimelineWait> &timeline_waits = {});
+
+        // 上传命令录制在传输队列上，返回时上传已经完成
+        VkCommandBuffer beginTransferCommands();
+
+        // 提交到传输队列并在_transfer_timeline上发出信号；传输队列族与图形队列族不同时，
+        // barriers中的资源在传输队列上释放所有权，再由等待该值的图形队列提交获取所有权，
+        // 调用方只需填写资源、布局和子资源范围
+        void endTransferCommands(VkCommandBuffer command_buffer,
+                                 std::vector<VkBufferMemoryBarrier> buffer_barriers,
+                                 std::vector<VkImageMemoryBarrier> image_barriers);
 
         // debug functions
         PFN_vkCmdBeginDebugUtilsLabelEXT _vkCmdBeginDebugUtilsLabelEXT;
@@ -91,12 +157,18 @@ namespace VulkanAPI
         PFN_vkCmdBindVertexBuffers       _vkCmdBindVertexBuffers;
         PFN_vkCmdBindIndexBuffer         _vkCmdBindIndexBuffer;
         PFN_vkCmdBindDescriptorSets      _vkCmdBindDescriptorSets;
+        PFN_vkCmdPushConstants           _vkCmdPushConstants;
         PFN_vkCmdDraw                    _vkCmdDraw;
         PFN_vkCmdDrawIndexed             _vkCmdDrawIndexed;
+        PFN_vkCmdDrawIndexedIndirect     _vkCmdDrawIndexedIndirect;
         PFN_vkCmdClearAttachments        _vkCmdClearAttachments;
         PFN_vkAllocateDescriptorSets     _vkAllocateDescriptorSets;
         PFN_vkUpdateDescriptorSets       _vkUpdateDescriptorSets;
         PFN_vkFreeDescriptorSets         _vkFreeDescriptorSets;
+        PFN_vkWaitForPresentKHR          _vkWaitForPresentKHR{nullptr};
+        PFN_vkCmdBeginRenderingKHR       _vkCmdBeginRenderingKHR{nullptr};
+        PFN_vkCmdEndRenderingKHR         _vkCmdEndRenderingKHR{nullptr};
+        PFN_vkCmdPipelineBarrier2KHR     _vkCmdPipelineBarrier2KHR{nullptr};
 
         VkFormat                 _swapchain_image_format = VK_FORMAT_UNDEFINED;
         VkExtent2D               _swapchain_extent;
@@ -108,11 +180,18 @@ namespace VulkanAPI
         VkImageView    _depth_image_view   = VK_NULL_HANDLE;
         VkFormat       _depth_image_format = VK_FORMAT_UNDEFINED;
 
-        static uint32_t const m_max_frames_in_flight = 3;
-        uint32_t              m_current_frame_index  = 0;
-        VkSemaphore           m_image_available_for_render_semaphores[m_max_frames_in_flight];
-        VkSemaphore           m_image_finished_for_presentation_semaphores[m_max_frames_in_flight];
-        VkFence               m_is_frame_in_flight_fences[m_max_frames_in_flight];
+        // 同步对象按上限创建，实际只轮转前m_frames_in_flight个
+        static constexpr uint32_t kMaxFramesInFlight = 3;
+        uint32_t                  m_frames_in_flight    = kMaxFramesInFlight;
+        uint32_t                  m_current_frame_index = 0;
+        VkSemaphore               m_image_available_for_render_semaphores[kMaxFramesInFlight];
+        VkSemaphore               m_image_finished_for_presentation_semaphores[kMaxFramesInFlight];
+        // 每个帧槽位最后一次提交在_graphics_timeline上的值，替代逐帧的fence
+        uint64_t                  m_frame_timeline_values[kMaxFramesInFlight]{};
+        // 渲染器的command buffer按swapchain image索引，记录每个索引最后一次提交的值；
+        // 重建swapchain不等待队列，新image索引上的command buffer可能还在执行旧swapchain的帧
+        std::vector<uint64_t>     m_swapchain_image_timeline_values;
+        uint32_t                  m_acquired_image_index = 0;
 
         void createSwapchain();
 
@@ -124,18 +203,59 @@ namespace VulkanAPI
 
         VkFormat findDepthStencilFormat();
 
+        // 检查格式能否作为采样纹理使用，压缩格式还需要设备开启对应特性
+        bool isSampledImageFormatSupported(VkFormat format);
+
+        // 查询device local堆的预算和当前用量，不支持VK_EXT_memory_budget时返回false，
+        // 此时budget为堆的总大小，usage为0
+        bool queryDeviceLocalMemoryBudget(VkDeviceSize &budget, VkDeviceSize &usage);
+
         void initSemaphoreObjects();
 
         void createSwapchainImageViews();
 
-        void submitDrawSwapchainImageCmdBuffer(VkCommandBuffer *p_command_buffer);
+        // timeline_waits用于等待其他队列(如异步计算)上本帧依赖的提交
+        void submitDrawSwapchainImageCmdBuffer(VkCommandBuffer *p_command_buffer,
+                                               const std::vector<TimelineWait> &timeline_waits = {});
 
         uint32_t getNextSwapchainImageIndex(std::function<void()> swapchainRecreateCallback);
 
         void presentSwapchainImage(uint32_t swapchain_image_index, std::function<void()> swapchainRecreateCallback);
 
+        // 等待所有队列上已提交的工作完成
         void waitForFrameInFlightFence();
 
+        // 只等待某个帧槽位的提交完成
+        void waitForFrameSlot(uint32_t frame_index);
+
+        // 图形和计算队列族不同时返回两者，否则为空；用于创建两个队列都会读取的buffer
+        [[nodiscard]] std::vector<uint32_t> getGraphicsComputeQueueFamilies() const
+        {
+            if (_queue_indices.graphicsFamily == _queue_indices.computeFamily)
+            {
+                return {};
+            }
+            return {_queue_indices.graphicsFamily.value(), _queue_indices.computeFamily.value()};
+        }
+
+        // 在采样输入之前调用：等待当前帧槽位的提交完成并执行帧率限制，
+        // 之后采样的输入不会再因为CPU等待GPU而变旧
+        void beginFrame();
+
+        // present_mode变化时在下一次获取swapchain image时重建swapchain，
+        // frames_in_flight在下一次beginFrame时生效
+        void setFramePacingSettings(const FramePacingSettings &settings);
+
+        [[nodiscard]] const FramePacingSettings &getFramePacingSettings() const
+        {
+            return m_frame_pacing_settings;
+        }
+
+        [[nodiscard]] const FrameLatencyStats &getFrameLatencyStats() const
+        {
+            return m_frame_latency_stats;
+        }
+
     private:
         const std::vector<char const *> m_validation_layers  = {"VK_LAYER_KHRONOS_validation"};
         uint32_t                        m_vulkan_api_version = VK_API_VERSION_1_0;
@@ -156,6 +276,31 @@ namespace VulkanAPI
 
         void createAssetAllocator();
 
+    private:
+        using FrameClock = std::chrono::steady_clock;
+
+        FramePacingSettings    m_frame_pacing_settings;
+        FrameLatencyStats      m_frame_latency_stats;
+        bool                   m_present_mode_dirty{false};
+        FrameClock::time_point m_next_frame_deadline{};
+        FrameClock::time_point m_frame_input_time{};
+        // 每个帧槽位上已提交但还没统计GPU完成延迟的帧，只在不支持present wait时使用
+        bool                   m_frame_latency_pending[kMaxFramesInFlight]{};
+        FrameClock::time_point m_frame_input_times[kMaxFramesInFlight]{};
+        uint64_t               m_present_id{0};
+        // 支持present wait时在这个线程上按present顺序阻塞等待上屏，结果写入m_present_latency_ms
+        std::shared_ptr<Thread> m_present_wait_thread;
+        std::mutex              m_present_latency_mutex;
+        float                   m_present_latency_ms{0.0f};
+
+        void applyFramesInFlight();
+
+        void limitFrameRate();
+
+        void collectFrameLatency();
+
+        void waitForPresentAsync(uint64_t present_id, FrameClock::time_point input_time);
+
     private:
         VkDebugUtilsMessengerEXT m_debug_messenger = VK_NULL_HANDLE;
 
@@ -178,6 +323,8 @@ namespace VulkanAPI
 
         bool checkDeviceExtensionSupport(VkPhysicalDevice physical_device);
 
+        bool isDeviceExtensionAvailable(VkPhysicalDevice physical_device, const char *extension_name);
+
         bool isDeviceSuitable(VkPhysicalDevice physical_device);
 
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice physical_device);
@@ -0,0 +1,59 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#ifndef XEXAMPLE_VULKAN_DELETION_QUEUE_H
+#define XEXAMPLE_VULKAN_DELETION_QUEUE_H
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <functional>
+#include <cstdint>
+
+namespace VulkanAPI
+{
+    // 延迟销毁队列：资源释放时先登记，等引用它的帧在GPU上执行完再真正销毁
+    // 登记发生在某一帧录制前或录制中，该帧提交时用图形timeline的值封存；
+    // 计算队列的提交都会被同一帧的图形提交等待，所以只需要跟踪图形timeline
+    class VulkanDeletionQueue
+    {
+    public:
+        void Initialize(VkDevice device);
+
+        // 可以在任意线程调用
+        void Push(std::function<void()> &&deleter);
+
+        void DestroyBuffer(VkBuffer buffer, VkDeviceMemory memory);
+
+        void DestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory);
+
+        void DestroyFramebuffer(VkFramebuffer framebuffer);
+
+        void DestroyRenderPass(VkRenderPass render_pass);
+
+        // 把目前登记的资源绑定到刚提交的帧
+        void Seal(uint64_t timeline_value);
+
+        // 销毁timeline已经完成的帧登记的资源
+        void Collect(uint64_t completed_value);
+
+        // 调用前必须保证GPU空闲
+        void Flush();
+
+        [[nodiscard]] size_t GetPendingCount();
+
+    private:
+        VkDevice   m_device{VK_NULL_HANDLE};
+        std::mutex m_mutex;
+
+        // 还没有提交的帧可能引用的资源
+        std::vector<std::function<void()>>                                    m_open_deleters;
+        // 按提交顺序排列的(timeline值, 该帧之前登记的资源)
+        std::deque<std::pair<uint64_t, std::vector<std::function<void()>>>> m_sealed_deleters;
+    };
+}
+
+#endif //XEXAMPLE_VULKAN_DELETION_QUEUE_H
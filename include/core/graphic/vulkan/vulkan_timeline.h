@@ -0,0 +1,88 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#ifndef XEXAMPLE_VULKAN_TIMELINE_H
+#define XEXAMPLE_VULKAN_TIMELINE_H
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <deque>
+#include <utility>
+#include <cstdint>
+
+namespace VulkanAPI
+{
+    class VulkanTimeline;
+
+    // 提交前需要等待的另一条timeline上的值
+    struct TimelineWait
+    {
+        VulkanTimeline       *timeline{nullptr};
+        uint64_t             value{0};
+        VkPipelineStageFlags stage{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+    };
+
+    // 一个队列上单调递增的GPU进度计数器，每次Submit返回该次提交完成时的值
+    // 支持VK_KHR_timeline_semaphore时就是一个timeline semaphore，CPU可以直接查询进度；
+    // 不支持时每次提交附带一个fence来模拟，跨队列等待退化为CPU等待
+    class VulkanTimeline
+    {
+    public:
+        VulkanTimeline() = default;
+
+        VulkanTimeline(const VulkanTimeline &) = delete;
+
+        VulkanTimeline &operator=(const VulkanTimeline &) = delete;
+
+        void Initialize(VkDevice device, bool timeline_semaphore_supported);
+
+        void Destroy();
+
+        // submit_info中原有的binary semaphore保持不变，timeline的信号追加在最后
+        uint64_t Submit(VkQueue queue,
+                        const VkSubmitInfo &submit_info,
+                        const std::vector<TimelineWait> &timeline_waits = {});
+
+        // 不阻塞地查询GPU已经完成到哪个值
+        uint64_t GetCompletedValue();
+
+        void Wait(uint64_t value);
+
+        void WaitIdle()
+        {
+            Wait(m_last_submitted_value);
+        }
+
+        [[nodiscard]] bool IsCompleted(uint64_t value)
+        {
+            return value <= m_completed_value || value <= GetCompletedValue();
+        }
+
+        [[nodiscard]] uint64_t GetLastSubmittedValue() const
+        {
+            return m_last_submitted_value;
+        }
+
+    private:
+        VkDevice    m_device{VK_NULL_HANDLE};
+        bool        m_timeline_semaphore_supported{false};
+        VkSemaphore m_semaphore{VK_NULL_HANDLE};
+
+        uint64_t m_last_submitted_value{0};
+        uint64_t m_completed_value{0};
+
+        // 不支持timeline semaphore时按提交顺序排列的(值, fence)
+        std::deque<std::pair<uint64_t, VkFence>> m_pending_fences;
+        std::vector<VkFence>                     m_free_fences;
+
+        PFN_vkWaitSemaphoresKHR           m_vkWaitSemaphoresKHR{nullptr};
+        PFN_vkGetSemaphoreCounterValueKHR m_vkGetSemaphoreCounterValueKHR{nullptr};
+
+        VkFence acquireFence();
+
+        void retireFences(bool wait, uint64_t value);
+    };
+}
+
+#endif //XEXAMPLE_VULKAN_TIMELINE_H
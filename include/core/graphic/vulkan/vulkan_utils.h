@@ -22,6 +22,7 @@
 #include <iostream>
 #include <unordered_map>
 #include <vector>
+#include <memory>
 
 namespace VulkanAPI
 {
@@ -37,13 +38,16 @@ namespace VulkanAPI
 
         static VkShaderModule createShaderModule(VkDevice device, const std::vector<unsigned char> &shader_code);
 
+        // concurrent_queue_families包含多个队列族时以CONCURRENT模式创建，各队列访问前不需要转移所有权
         static void createBuffer(std::shared_ptr<VulkanContext> p_context,
                                  VkDeviceSize size,
                                  VkBufferUsageFlags usage,
                                  VkMemoryPropertyFlags properties,
                                  VkBuffer &buffer,
-                                 VkDeviceMemory &buffer_memory);
+                                 VkDeviceMemory &buffer_memory,
+                                 const std::vector<uint32_t> &concurrent_queue_families = {});
 
+        // 在传输队列上复制，dstBuffer必须是EXCLUSIVE模式，返回时所有权已经交给图形队列
         static void copyBuffer(std::shared_ptr<VulkanContext> p_context,
                                VkBuffer srcBuffer,
                                VkBuffer dstBuffer,
@@ -97,6 +101,7 @@ namespace VulkanAPI
                                           uint32_t miplevels,
                                           VkImageAspectFlags aspect_mask_bits);
 
+        // 在传输队列上上传，image之前的内容被丢弃，返回时整个image处于TRANSFER_DST_OPTIMAL
         static void copyBufferToImage(std::shared_ptr<VulkanContext> p_context,
                                       VkBuffer buffer,
                                       VkImage image,
@@ -104,11 +109,20 @@ namespace VulkanAPI
                                       uint32_t height,
                                       uint32_t layer_count);
 
+        // 一次提交多个区域，用于上传预先生成的mip链
+        static void copyBufferToImage(std::shared_ptr<VulkanContext> p_context,
+                                      VkBuffer buffer,
+                                      VkImage image,
+                                      const std::vector<VkBufferImageCopy> &regions);
+
+        // 用blit逐级生成mip链，layer_count>1时同时处理cubemap/纹理数组的所有层
         static void genMipmappedImage(std::shared_ptr<VulkanContext> p_context,
                                       VkImage image,
+                                      VkFormat image_format,
                                       uint32_t width,
                                       uint32_t height,
-                                      uint32_t mip_levels);
+                                      uint32_t mip_levels,
+                                      uint32_t layer_count = 1);
 
         static VkSampler getOrCreateMipmapSampler(std::shared_ptr<VulkanContext> p_context,
                                                   uint32_t mip_levels);
@@ -119,7 +133,7 @@ namespace VulkanAPI
 
         static VkSampler getOrCreateDepthSampler(std::shared_ptr<VulkanContext> p_context);
 
-        static VkSampler getOrCreateCubeMapSampler(std::shared_ptr<VulkanContext> p_context, uint32_t mip_levels);
+        static VkSampler getOrCreateCubeMapSampler(std::shared_ptr<VulkanContext> p_context);
 
         static void destroyMipmappedSampler(VkDevice device);
 
@@ -8,9 +8,12 @@
 #include <vulkan/vulkan.h>
 #include "core/graphic/vulkan/vulkan_context.h"
 #include "core/graphic/vulkan/vulkan_utils.h"
+#include "core/math/math.h"
 #include "core/threadpool.h"
 #include <memory>
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 
 namespace RenderSystem
 {
@@ -27,15 +30,78 @@ namespace RenderSystem
         std::vector<VkCommandBuffer> command_buffers;
     };
 
+    // FNV-1a，用于判断绘制状态是否变化
+    static constexpr uint64_t kHashSeed = 14695981039346656037ull;
+
+    inline void HashCombine(uint64_t &hash, const void *data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    // 每个swapchain image上secondary command buffer录制时的状态key
+    // key不变时上一次录制的命令仍然有效，直接vkCmdExecuteCommands，跳过录制
+    struct RecordedCommandCache
+    {
+        static constexpr uint64_t kInvalidKey = 0;
+
+        std::vector<uint64_t> keys;
+
+        [[nodiscard]] bool IsValid(uint32_t command_buffer_index, uint64_t key) const
+        {
+            return key != kInvalidKey && command_buffer_index < keys.size() && keys[command_buffer_index] == key;
+        }
+
+        void Store(uint32_t command_buffer_index, uint64_t key)
+        {
+            if (command_buffer_index >= keys.size())
+            {
+                keys.resize(command_buffer_index + 1, kInvalidKey);
+            }
+            keys[command_buffer_index] = key;
+        }
+
+        void Invalidate()
+        {
+            keys.assign(keys.size(), kInvalidKey);
+        }
+    };
+
     struct DirectionLightInfo
     {
-        VkDeviceSize shadowmap_width  = 1400;
-        VkDeviceSize shadowmap_height = 1400;
-        float        camera_width     = 150;
-        float        camera_height    = 150;
-        float        camera_near      = 1.0f;
-        float        camera_far       = 100.0f;
-        VkFormat     depth_format     = VK_FORMAT_D32_SFLOAT;
+        // 所有级联打包在一张shadow_atlas_size * shadow_atlas_size的深度图中
+        // 最重要的光源每个级联使用max_shadow_tile_size，其余光源按亮度比例缩小
+        uint32_t     shadow_atlas_size    = 2048;
+        uint32_t     max_shadow_tile_size = 1024;
+        uint32_t     cascade_count        = 4;
+        // 对数划分与均匀划分的混合比例，越大近处级联越小
+        float        cascade_split_lambda = 0.75f;
+        // 级联覆盖的最远距离，超出部分不接收阴影
+        float        shadow_distance      = 100.0f;
+        // 级联包围球之外沿光源方向额外包含的投射体距离
+        float        caster_distance      = 50.0f;
+        VkFormat     depth_format         = VK_FORMAT_D32_SFLOAT;
+    };
+
+    struct PointLightShadowInfo
+    {
+        // 每个投射阴影的点光源占cube array中的6层，最多MAX_POINT_LIGHT_SHADOW_COUNT个
+        uint32_t shadowmap_size = 512;
+        float    znear          = 0.05f;
+        VkFormat depth_format   = VK_FORMAT_D32_SFLOAT;
+    };
+
+    // 主相机参数，用于划分阴影级联
+    struct RenderCameraInfo
+    {
+        Math::Matrix4x4 view;
+        float           fov;
+        float           aspect;
+        float           znear;
+        float           zfar;
     };
 
     struct RenderPassInitInfo
@@ -49,6 +115,9 @@ namespace RenderSystem
         VkDescriptorPool *descriptor_pool = nullptr;
 
         std::vector<VkClearValue> clearValues;
+
+        // 支持的pass用VK_KHR_dynamic_rendering代替render pass和framebuffer
+        bool use_dynamic_rendering = false;
     };
 
     struct ImageAttachment
@@ -63,6 +132,7 @@ namespace RenderSystem
         VkImageViewType    view_type{VK_IMAGE_VIEW_TYPE_2D};
         VkDeviceSize       width{0}, height{0};
         uint32_t           layer_count{1};
+        VkImageCreateFlags create_flags{0};
 
 
         void init()
@@ -77,7 +147,7 @@ namespace RenderSystem
                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                                image,
                                                mem,
-                                               0,
+                                               create_flags,
                                                layer_count,
                                                1);
 
@@ -92,12 +162,39 @@ namespace RenderSystem
 
         }
 
+        // framebuffer允许小于附件，尺寸不超过已分配的图像时可以直接复用
+        [[nodiscard]] bool fits(uint32_t required_width, uint32_t required_height) const
+        {
+            return image != VK_NULL_HANDLE && required_width <= width && required_height <= height;
+        }
+
+        // 随交换链尺寸调整，只在放不下时按新尺寸重建并返回true，
+        // 此时引用旧image view的descriptor需要重新写入
+        bool fitExtent(uint32_t required_width, uint32_t required_height)
+        {
+            if (fits(required_width, required_height))
+            {
+                return false;
+            }
+            if (image != VK_NULL_HANDLE)
+            {
+                g_p_vulkan_context->_deletion_queue.DestroyImage(image, view, mem);
+            }
+            // 只增不减，窗口来回拖动时不会反复重建
+            width  = std::max<VkDeviceSize>(width, required_width);
+            height = std::max<VkDeviceSize>(height, required_height);
+            init();
+            return true;
+        }
+
+        // 实际销毁推迟到引用它的帧执行完
         void destroy()
         {
             assert(g_p_vulkan_context != nullptr);
-            vkDestroyImageView(g_p_vulkan_context->_device, view, nullptr);
-            vkDestroyImage(g_p_vulkan_context->_device, image, nullptr);
-            vkFreeMemory(g_p_vulkan_context->_device, mem, nullptr);
+            g_p_vulkan_context->_deletion_queue.DestroyImage(image, view, mem);
+            image  = VK_NULL_HANDLE;
+            view   = VK_NULL_HANDLE;
+            mem    = VK_NULL_HANDLE;
             format = VK_FORMAT_UNDEFINED;
             layout = VK_IMAGE_LAYOUT_UNDEFINED;
             width  = 0;
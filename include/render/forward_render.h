@@ -20,13 +20,16 @@ namespace RenderSystem
         enum _renderpasses
         {
             _directional_light_shadowmap_renderpass = 0,
+            _point_light_shadowmap_renderpass,
             _main_camera_renderpass,
             _ui_overlay_renderpass,
             _renderpass_count
         };
 
+        // 每个级联一个light_proj，按minUniformBufferOffsetAlignment(不超过256)对齐存放
         ForwardRender()
-                : m_render_light_project_ubo_list(MAX_DIRECTIONAL_LIGHT_COUNT * sizeof(VulkanLightProjectDefine))
+                : m_render_light_project_ubo_list(MAX_DIRECTIONAL_LIGHT_COUNT * MAX_SHADOW_CASCADE_COUNT * 256),
+                  m_render_point_light_shadow_ubo_list(MAX_POINT_LIGHT_SHADOW_COUNT * 512)
         {}
 
         void initialize() override;
@@ -61,12 +64,19 @@ namespace RenderSystem
 
         void SetupSkyboxTexture(const std::shared_ptr<TextureCube> &skybox_texture) override;
 
-        void UpdateLightProjectionList(std::vector<Scene::DirectionLight> &directional_light_list) override;
+        void UpdateLightProjectionList(const RenderCameraInfo &camera_info,
+                                       std::vector<Scene::DirectionLight> &directional_light_list) override;
+
+        void UpdateLocalLightList(const RenderCameraInfo &camera_info,
+                                  std::vector<Scene::PointLight> &point_light_list,
+                                  std::vector<Scene::SpotLight> &spot_light_list) override;
 
         void SetupShadowMapTexture(std::vector<Scene::DirectionLight> &directional_light_list) override;
 
         void FlushRenderbuffer() override;
 
+        void ImGuiDebugPanel() override;
+
     private:
 
         void setupCommandBuffer();
@@ -79,6 +89,8 @@ namespace RenderSystem
 
         void setupRenderDescriptorSetLayout();
 
+        void drawShadowPasses(uint32_t image_index);
+
     private:
         VkCommandPool                m_command_pool{VK_NULL_HANDLE};
         std::vector<VkCommandBuffer> m_command_buffers;
@@ -88,24 +100,40 @@ namespace RenderSystem
         std::vector<ImageAttachment> m_render_targets;
         std::vector<ImageAttachment> m_backup_targets;
         ImageAttachment              m_directional_light_shadow;
+        ImageAttachment              m_point_light_shadow;
+        ShadowAtlas                  m_shadow_atlas;
         // render submesh cache
         std::vector<RenderSubmesh>   m_render_submeshes;
         // ubo
         RenderPerFrameUBO            m_render_per_frame_ubo;
-        RenderModelUBOList           m_render_model_ubo_list;
+        RenderModelStorageBuffer     m_render_model_buffer;
         RenderLightProjectUBOList    m_render_light_project_ubo_list;
+        RenderPointLightShadowUBOList m_render_point_light_shadow_ubo_list;
+        // meshlet剔除
+        MeshletCulling               m_meshlet_culling;
+        // 点光源和聚光灯的分簇剔除
+        LightClusterCulling          m_light_cluster_culling;
+        // 剔除放到计算队列，与阴影pass重叠执行
+        AsyncComputeScheduler        m_async_compute;
         // texture info list
         VkDescriptorSetLayout        m_texture_descriptor_set_layout{VK_NULL_HANDLE};
         std::vector<VkDescriptorSet> m_texture_descriptor_sets;
+        // 纹理descriptor set单独的pool，纹理变化时整体替换
+        VkDescriptorPool             m_texture_descriptor_pool{VK_NULL_HANDLE};
         // directional light info list
         VkDescriptorSetLayout        m_directional_light_shadow_set_layout{VK_NULL_HANDLE};
-        VkDescriptorSet              m_directional_light_shadow_set{VK_NULL_HANDLE};    // use texture array
+        VkDescriptorSet              m_directional_light_shadow_set{VK_NULL_HANDLE};    // use shadow atlas
         // skybox info
         VkDescriptorSetLayout        m_skybox_descriptor_set_layout{VK_NULL_HANDLE};
         VkDescriptorSet              m_skybox_descriptor_set{VK_NULL_HANDLE};
 
         Matrix4x4 m_view_matrix;
         Matrix4x4 m_proj_matrix;
+
+        // 运行时切换，便于对比不同场景下深度预渲染的收益
+        bool m_depth_prepass_enabled{true};
+        // 默认只在支持timeline semaphore时开启，否则跨队列等待会退化为CPU等待
+        bool m_async_compute_enabled{false};
     };
 }
 #endif //XEXAMPLE_FORWARD_RENDER_H
@@ -8,6 +8,8 @@
 #include "render/resource/render_ubo.h"
 #include "scene/model.h"
 #include "scene/direction_light.h"
+#include "scene/point_light.h"
+#include "scene/spot_light.h"
 #include <memory>
 
 #pragma once
@@ -41,6 +43,9 @@ namespace RenderSystem
 
         static void setupGlobally(GLFWwindow *window);
 
+        // 所有持有GPU资源的对象析构之后调用
+        static void clearGlobally();
+
         void setUIOverlay(UIOverlayPtr ui_overlay)
         {
             m_p_ui_overlay = ui_overlay;
@@ -60,7 +65,13 @@ namespace RenderSystem
         virtual void SetupSkyboxTexture(const std::shared_ptr<TextureCube> &skybox_texture)
         {}
 
-        virtual void UpdateLightProjectionList(std::vector<Scene::DirectionLight> &directional_light_list)
+        virtual void UpdateLightProjectionList(const RenderCameraInfo &camera_info,
+                                               std::vector<Scene::DirectionLight> &directional_light_list)
+        {}
+
+        virtual void UpdateLocalLightList(const RenderCameraInfo &camera_info,
+                                          std::vector<Scene::PointLight> &point_light_list,
+                                          std::vector<Scene::SpotLight> &spot_light_list)
         {}
 
         virtual void SetupShadowMapTexture(std::vector<Scene::DirectionLight> &directional_light_list)
@@ -69,6 +80,19 @@ namespace RenderSystem
         virtual void FlushRenderbuffer()
         {}
 
+        // 渲染设置，挂到UIOverlay的Debug Panel上
+        virtual void ImGuiDebugPanel()
+        {}
+
+        // 帧节奏设置和延迟统计，挂到UIOverlay的Debug Panel上
+        void FramePacingDebugPanel();
+
+        // 在采样输入之前调用，见VulkanContext::beginFrame
+        void BeginFrame()
+        {
+            g_p_vulkan_context->beginFrame();
+        }
+
         virtual void Tick()
         {
             if (m_frame_count == 0)
@@ -96,6 +120,11 @@ namespace RenderSystem
         uint32_t                     m_frame_count{0};
         float                        m_frame_time{0};
         UIOverlayPtr                 m_p_ui_overlay;
+        // 纹理描述符集原地更新后，已录制的command buffer不能再复用
+        uint32_t                     m_texture_generation{0};
+
+        // 在UpdateMeshlets之后调用，结果写入m_render_resource_info.draw_list_hash
+        void updateDrawListHash();
     private:
         uint64_t m_last_frame_time{0};
         uint64_t m_current_frame_time{0};
@@ -3,6 +3,7 @@
 //
 
 #include "renderpass_base.h"
+#include "render/subpass/directional_light_shadow.h"
 
 #ifndef XEXAMPLE_DIRECTION_LIGHT_SHADOW_RENDERPASS_H
 #define XEXAMPLE_DIRECTION_LIGHT_SHADOW_RENDERPASS_H
@@ -39,6 +40,10 @@ namespace RenderSystem
                 vkDestroyFramebuffer(g_p_vulkan_context->_device, m_framebuffer_per_rendertarget[i], nullptr);
             for(int i=0; i < m_renderpass_attachments.size(); i++)
                 vkDestroyImageView(g_p_vulkan_context->_device, m_renderpass_attachments[i].view, nullptr);
+            vkDestroyFramebuffer(g_p_vulkan_context->_device, m_static_cache_framebuffer, nullptr);
+            if (m_static_cache.image != VK_NULL_HANDLE)
+                m_static_cache.destroy();
+            vkDestroyRenderPass(g_p_vulkan_context->_device, m_static_cache_renderpass, nullptr);
             vkDestroyRenderPass(g_p_vulkan_context->_device, m_renderpass, nullptr);
         }
 
@@ -55,11 +60,49 @@ namespace RenderSystem
     private:
         ImageAttachment *m_p_shadowmap_attachment;
 
+        // 静态投射体的阴影缓存，与阴影图集同样大小
+        // 每帧先把缓存中所有tile拷贝到图集，再在其上绘制动态投射体；只有光源矩阵、tile区间或静态物体集合变化的tile才重新绘制缓存
+        // 级联中心按ShadowCascade::kCenterSnapDivisions的格子对齐，相机在格子内移动时缓存命中，
+        // 跨过格子、光源旋转或相机fov/宽高比/远平面变化时对应级联重新绘制
+        ImageAttachment               m_static_cache;
+        VkFramebuffer                 m_static_cache_framebuffer{VK_NULL_HANDLE};
+        VkRenderPass                  m_static_cache_renderpass{VK_NULL_HANDLE};
+        bool                          m_static_cache_initialized{false};
+        std::vector<RenderThreadData> m_static_thread_data;
+        std::vector<Math::Matrix4x4>  m_static_cache_light_proj;
+        std::vector<ShadowAtlasTile>  m_static_cache_tiles;
+        std::vector<bool>             m_static_cache_valid;
+        uint64_t                      m_static_caster_hash{0};
+
+        void setupStaticCache();
+
         void setupRenderPass();
 
         void setupFrameBuffer();
 
         void setupSubpass() override;
+
+        // 比较光源矩阵、tile区间和静态投射体集合，返回需要重新绘制的tile
+        std::vector<uint32_t> updateStaticCacheState();
+
+        [[nodiscard]] uint64_t hashStaticCasters() const;
+
+        // 动态投射体的secondary command buffer录制时依赖的状态
+        [[nodiscard]] uint64_t dynamicCasterCommandKey(const std::vector<uint32_t> &tile_indices) const;
+
+        void beginShadowRenderPass(VkRenderPass renderpass, VkFramebuffer framebuffer, VkSubpassContents contents);
+
+        // 清空需要重新绘制的静态缓存tile，首次使用时先转换缓存的布局
+        void clearStaticCacheTiles(const std::vector<uint32_t> &tile_indices);
+
+        void copyStaticCacheTiles();
+
+        void drawTiles(const std::vector<uint32_t> &tile_indices,
+                       SubPass::DirectionalLightShadowPass::_shadow_caster_type caster_type);
+
+        void drawTilesMultiThreading(const std::vector<uint32_t> &tile_indices,
+                                     SubPass::DirectionalLightShadowPass::_shadow_caster_type caster_type,
+                                     uint32_t command_buffer_index);
     };
 }
 #endif //XEXAMPLE_DIRECTION_LIGHT_SHADOW_RENDERPASS_H
@@ -32,7 +32,6 @@ namespace RenderSystem
         {
             _main_camera_defer_gbuffer_color_attachment,
             _main_camera_defer_gbuffer_normal_attachment,
-            _main_camera_defer_gbuffer_position_attachment,
             _main_camera_defer_color_attachment,
             _main_camera_defer_depth_attachment,
             _main_camera_defer_attachment_count
@@ -65,10 +64,15 @@ namespace RenderSystem
 
         void setupRenderpassAttachments();
 
+        // gbuffer和深度附件随交换链尺寸调整，返回是否重建了图像
+        bool resizeRenderpassAttachments();
+
         void setupFrameBuffer();
 
         void setupSubpass() override;
 
+        // gbuffer的secondary command buffer只依赖绘制列表、framebuffer和viewport
+        [[nodiscard]] uint64_t recordedCommandKey(uint32_t render_target_index) const;
     };
 }
 
@@ -22,6 +22,7 @@ namespace RenderSystem
     public:
         enum _main_camera_subpass : unsigned int
         {
+            _main_camera_subpass_depth_prepass,
             _main_camera_subpass_mesh,
             _main_camera_subpass_skybox,
             _main_camera_subpass_count
@@ -56,15 +57,46 @@ namespace RenderSystem
 
         void updateAfterSwapchainRecreate() override;
 
+        // 关闭时深度预渲染subpass不绘制任何内容，光照pass恢复LESS测试并写深度
+        void setDepthPrepassEnabled(bool enabled);
+
     private:
         void setupRenderPass();
 
         void setupRenderpassAttachments();
 
+        // 附件随交换链尺寸调整，返回是否重建了图像
+        bool resizeRenderpassAttachments();
+
         void setupFrameBuffer();
 
         void setupSubpass() override;
 
+        void drawMultiThreadingDynamicRendering(uint32_t render_target_index, uint32_t command_buffer_index);
+
+        // 绘制列表没有变化时沿用上次录制的secondary command buffer
+        void recordSecondaryCommandBuffers(VkCommandBufferInheritanceInfo &prepass_inheritance_info,
+                                           VkCommandBufferInheritanceInfo &inheritance_info,
+                                           uint32_t render_target_index,
+                                           uint32_t command_buffer_index);
+
+        void executeSecondaryCommandBuffers(uint32_t thread_start_index,
+                                            uint32_t thread_count,
+                                            uint32_t command_buffer_index,
+                                            const char *label);
+
+        void beginDynamicRendering(VkCommandBuffer command_buffer,
+                                   uint32_t render_target_index,
+                                   VkRenderingFlagsKHR flags);
+
+        void transitionAttachmentsBeforeRendering(VkCommandBuffer command_buffer, uint32_t render_target_index);
+
+        void transitionAttachmentsAfterRendering(VkCommandBuffer command_buffer, uint32_t render_target_index);
+
+        // 绘制列表、framebuffer、viewport和深度预渲染开关共同决定录制的内容
+        [[nodiscard]] uint64_t recordedCommandKey(uint32_t render_target_index) const;
+
+        bool m_depth_prepass_enabled{false};
     };
 }
 
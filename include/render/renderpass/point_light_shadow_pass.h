@@ -0,0 +1,74 @@
+//
+// Created by kyrosz7u on 2023/7/20.
+//
+
+#include "renderpass_base.h"
+#include "render/subpass/point_light_shadow.h"
+
+#ifndef XEXAMPLE_POINT_LIGHT_SHADOW_RENDERPASS_H
+#define XEXAMPLE_POINT_LIGHT_SHADOW_RENDERPASS_H
+namespace RenderSystem
+{
+    struct PointLightShadowRenderPassInitInfo : public RenderPassInitInfo
+    {
+        // cube array，每个光源占连续的6层
+        ImageAttachment* shadowmap_attachment;
+    };
+
+    // 每个投射阴影的光源一个renderpass实例，viewMask覆盖6个视图，一次绘制写入cube的六个面
+    // 设备不支持VK_KHR_multiview时只清空阴影图，点光源不产生阴影
+    class PointLightShadowRenderPass : public RenderPassBase
+    {
+    public:
+        enum _point_light_shadow_subpass : unsigned int
+        {
+            _point_light_shadow_subpass_shadow = 0,
+            _point_light_shadow_subpass_count
+        };
+
+        enum _point_light_attachment : unsigned int
+        {
+            _point_light_attachment_depth = 0,
+            _point_light_attachment_count
+        };
+
+        PointLightShadowRenderPass()
+        {
+            m_subpass_list.resize(_point_light_shadow_subpass_count, VK_NULL_HANDLE);
+        }
+
+        ~PointLightShadowRenderPass()
+        {
+            for(int i = 0; i < m_framebuffer_per_rendertarget.size(); i++)
+                vkDestroyFramebuffer(g_p_vulkan_context->_device, m_framebuffer_per_rendertarget[i], nullptr);
+            for(int i=0; i < m_renderpass_attachments.size(); i++)
+                vkDestroyImageView(g_p_vulkan_context->_device, m_renderpass_attachments[i].view, nullptr);
+            vkDestroyRenderPass(g_p_vulkan_context->_device, m_renderpass, nullptr);
+        }
+
+        void initialize(RenderPassInitInfo *renderpass_init_info) override;
+
+        void setupRenderpassAttachments();
+
+        void updateAfterSwapchainRecreate() override;
+
+        void draw(uint32_t render_target_index) override;
+
+        // 投射阴影的光源很少，直接在主command buffer中录制
+        void drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index) override
+        {
+            draw(render_target_index);
+        }
+
+    private:
+        ImageAttachment *m_p_shadowmap_attachment;
+        bool            m_multiview_enabled{false};
+
+        void setupRenderPass();
+
+        void setupFrameBuffer();
+
+        void setupSubpass() override;
+    };
+}
+#endif //XEXAMPLE_POINT_LIGHT_SHADOW_RENDERPASS_H
@@ -35,11 +35,31 @@ namespace RenderSystem
         void setupMultiThreading(uint32_t thread_count=DEFAULT_THREAD_COUNT)
         {
             m_thread_pool.setThreadCount(thread_count);
-            m_thread_data.resize(thread_count);
+            allocateThreadData(m_thread_data, thread_count);
+        }
+
+        virtual void initialize(RenderPassInitInfo *renderpass_init_info) = 0;
+
+        virtual void draw(uint32_t render_image_index) = 0;
+
+        virtual void drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index)
+        {
+            throw std::runtime_error("drawMultiThreading not implemented");
+        }
+
+        virtual void updateAfterSwapchainRecreate() = 0;
+
+    protected:
+        friend struct ImageAttachment;
+
+        // 每个线程一个command pool，每个swapchain image一个secondary command buffer
+        static void allocateThreadData(std::vector<RenderThreadData> &thread_data, uint32_t thread_count)
+        {
+            thread_data.resize(thread_count);
 
             for(int i = 0; i < thread_count; i++)
             {
-                m_thread_data[i].command_buffers.resize(g_p_vulkan_context->_swapchain_images.size());
+                thread_data[i].command_buffers.resize(g_p_vulkan_context->_swapchain_images.size());
 
                 VkCommandPoolCreateInfo command_pool_create_info;
                 command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -50,7 +70,7 @@ namespace RenderSystem
                 if (vkCreateCommandPool(g_p_vulkan_context->_device,
                                         &command_pool_create_info,
                                         nullptr,
-                                        &m_thread_data[i].secondary_command_pool) != VK_SUCCESS)
+                                        &thread_data[i].secondary_command_pool) != VK_SUCCESS)
                 {
                     throw std::runtime_error("vk create secondary command pool");
                 }
@@ -58,38 +78,66 @@ namespace RenderSystem
                 VkCommandBufferAllocateInfo command_buffer_allocate_info{};
                 command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
                 command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-                command_buffer_allocate_info.commandBufferCount = m_thread_data[i].command_buffers.size();
-                command_buffer_allocate_info.commandPool        = m_thread_data[i].secondary_command_pool;
+                command_buffer_allocate_info.commandBufferCount = thread_data[i].command_buffers.size();
+                command_buffer_allocate_info.commandPool        = thread_data[i].secondary_command_pool;
 
                 if (vkAllocateCommandBuffers(g_p_vulkan_context->_device, &command_buffer_allocate_info,
-                                             m_thread_data[i].command_buffers.data()) != VK_SUCCESS)
+                                             thread_data[i].command_buffers.data()) != VK_SUCCESS)
                 {
                     throw std::runtime_error("vk allocate command buffers");
                 }
             }
         }
 
-        virtual void initialize(RenderPassInitInfo *renderpass_init_info) = 0;
-
-        virtual void draw(uint32_t render_image_index) = 0;
+        virtual void setupSubpass() = 0;
 
-        virtual void drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index)
+        // dynamic rendering没有render pass的隐式布局转换和external依赖，由pass自己插入barrier
+        static void transitionAttachmentLayout(VkCommandBuffer command_buffer,
+                                               const ImageAttachment &attachment,
+                                               VkImageLayout old_layout,
+                                               VkImageLayout new_layout,
+                                               VkPipelineStageFlags2KHR src_stage,
+                                               VkAccessFlags2KHR src_access,
+                                               VkPipelineStageFlags2KHR dst_stage,
+                                               VkAccessFlags2KHR dst_access)
         {
-            throw std::runtime_error("drawMultiThreading not implemented");
-        }
-
-        virtual void updateAfterSwapchainRecreate() = 0;
-
-    protected:
-        friend struct ImageAttachment;
+            VkImageMemoryBarrier2KHR image_barrier{};
+            image_barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            image_barrier.srcStageMask                    = src_stage;
+            image_barrier.srcAccessMask                   = src_access;
+            image_barrier.dstStageMask                    = dst_stage;
+            image_barrier.dstAccessMask                   = dst_access;
+            image_barrier.oldLayout                       = old_layout;
+            image_barrier.newLayout                       = new_layout;
+            image_barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.image                           = attachment.image;
+            image_barrier.subresourceRange.aspectMask     = attachment.aspect;
+            image_barrier.subresourceRange.baseMipLevel   = 0;
+            image_barrier.subresourceRange.levelCount     = 1;
+            image_barrier.subresourceRange.baseArrayLayer = 0;
+            image_barrier.subresourceRange.layerCount     = attachment.layer_count;
+            // 没有开启separateDepthStencilLayouts，带模板的深度格式两个aspect要一起转换
+            if (attachment.aspect & VK_IMAGE_ASPECT_DEPTH_BIT &&
+                (attachment.format == VK_FORMAT_D32_SFLOAT_S8_UINT || attachment.format == VK_FORMAT_D24_UNORM_S8_UINT))
+            {
+                image_barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+            }
 
-        virtual void setupSubpass() = 0;
+            VkDependencyInfoKHR dependency_info{};
+            dependency_info.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+            dependency_info.imageMemoryBarrierCount = 1;
+            dependency_info.pImageMemoryBarriers    = &image_barrier;
+            g_p_vulkan_context->_vkCmdPipelineBarrier2KHR(command_buffer, &dependency_info);
+        }
 
         RenderCommandInfo            *m_p_render_command_info;
         RenderGlobalResourceInfo     *m_p_render_resource_info;
         std::vector<ImageAttachment> *m_p_render_targets; // [target_index][render_image_index]
 
-        VkRenderPass                                       m_renderpass;
+        VkRenderPass                                       m_renderpass{VK_NULL_HANDLE};
+        // 为true时m_renderpass和m_framebuffer_per_rendertarget都为空
+        bool                                               m_dynamic_rendering{false};
         std::vector<ImageAttachment>                       m_renderpass_attachments;
         std::vector<VkFramebuffer>                         m_framebuffer_per_rendertarget;
         std::vector<std::shared_ptr<SubPass::SubPassBase>> m_subpass_list;
@@ -97,6 +145,8 @@ namespace RenderSystem
         //multi threading support
         ThreadPool                    m_thread_pool;
         std::vector<RenderThreadData> m_thread_data;
+        // m_thread_data中各swapchain image的secondary command buffer录制时的状态
+        RecordedCommandCache          m_recorded_command_cache;
     };
 }
 
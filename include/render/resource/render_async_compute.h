@@ -0,0 +1,67 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#ifndef XEXAMPLE_RENDER_ASYNC_COMPUTE_H
+#define XEXAMPLE_RENDER_ASYNC_COMPUTE_H
+
+#include "core/graphic/vulkan/vulkan_timeline.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // 把每帧的剔除计算放到计算队列上，与图形队列上的阴影pass并行执行
+    // 一帧拆成三次提交：计算队列上的剔除、图形队列上的阴影、图形队列上的主相机和UI；
+    // 主相机提交通过timeline等待剔除完成，阴影提交不等待任何信号量
+    class AsyncComputeScheduler
+    {
+    public:
+        AsyncComputeScheduler() = default;
+
+        ~AsyncComputeScheduler()
+        {
+            Destroy();
+        }
+
+        AsyncComputeScheduler(const AsyncComputeScheduler &) = delete;
+
+        AsyncComputeScheduler &operator=(const AsyncComputeScheduler &) = delete;
+
+        // 每个swapchain image一组command buffer
+        void Initialize(uint32_t command_buffer_count);
+
+        void Destroy();
+
+        // 返回已开始录制的计算队列command buffer
+        VkCommandBuffer &BeginCompute(uint32_t index);
+
+        // 提交前等待图形队列上一次提交，避免覆盖上一帧仍在读取的剔除结果；
+        // 返回值交给主相机的提交，在wait_stages阶段等待计算完成
+        VulkanAPI::TimelineWait SubmitCompute(uint32_t index, VkPipelineStageFlags wait_stages);
+
+        VkCommandBuffer &BeginOverlappedGraphics(uint32_t index);
+
+        void SubmitOverlappedGraphics(uint32_t index);
+
+        [[nodiscard]] uint32_t GetComputeQueueFamily() const
+        {
+            return m_compute_queue_family;
+        }
+
+    private:
+        uint32_t                     m_compute_queue_family{VK_QUEUE_FAMILY_IGNORED};
+        VkCommandPool                m_compute_command_pool{VK_NULL_HANDLE};
+        std::vector<VkCommandBuffer> m_compute_command_buffers;
+        VkCommandPool                m_graphics_command_pool{VK_NULL_HANDLE};
+        std::vector<VkCommandBuffer> m_graphics_command_buffers;
+
+        void createCommandBuffers(uint32_t queue_family, uint32_t command_buffer_count,
+                                  VkCommandPool &command_pool, std::vector<VkCommandBuffer> &command_buffers);
+
+        static void beginCommandBuffer(VkCommandBuffer command_buffer);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_ASYNC_COMPUTE_H
@@ -11,6 +11,9 @@
 #include <memory>
 
 #define MAX_DIRECTIONAL_LIGHT_COUNT 16
+#define MAX_SHADOW_CASCADE_COUNT 4
+#define MAX_LOCAL_LIGHT_COUNT 1024
+#define MAX_POINT_LIGHT_SHADOW_COUNT 4
 
 using namespace Math;
 
@@ -22,11 +25,39 @@ namespace RenderSystem
         Math::Matrix4x4 normal;
     };
 
+    // 逐draw的push constant，替代每次draw都重新绑定dynamic ubo
+    struct VulkanDrawPushConstant
+    {
+        uint32_t model_index;
+    };
+
+    // 阴影pass的light_proj只在切换tile时更新，model_index每次draw更新
+    struct VulkanShadowDrawPushConstant
+    {
+        Math::Matrix4x4 light_proj;
+        uint32_t        model_index;
+    };
+
     struct VulkanPerFrameSceneDefine
     {
         Math::Matrix4x4 proj_view;
         Math::Vector3   camera_pos;
         uint32_t        directional_light_number;
+        uint32_t        shadow_cascade_count;
+        // 光源矩阵在static buffer中的间隔，以vec4为单位
+        uint32_t        light_proj_stride;
+        uint32_t        local_light_number;
+        // std140下vec4按16字节对齐
+        uint32_t        _padding_view_depth_row;
+        // 与世界坐标点乘得到相机空间深度
+        Math::Vector4   view_depth_row;
+        // 分簇的深度切片：slice = log(depth) * scale + bias
+        float           cluster_depth_scale;
+        float           cluster_depth_bias;
+        float           inv_screen_width;
+        float           inv_screen_height;
+        // 延迟渲染用深度重建世界坐标
+        Math::Matrix4x4 inv_proj_view;
     };
 
     struct VulkanPerFrameDirectionalLightDefine
@@ -36,9 +67,41 @@ namespace RenderSystem
         float         intensity;
     };
 
+    enum _local_light_type
+    {
+        _local_light_point = 0,
+        _local_light_spot
+    };
+
+    // 点光源和聚光灯共用，与shaders/include/local_light.h中的std430布局一致
+    struct VulkanLocalLightDefine
+    {
+        Math::Vector3 position;
+        float         radius;
+        Math::Vector3 color;
+        float         intensity;
+        Math::Vector3 direction;
+        float         spot_outer_cos;
+        float         spot_inner_cos;
+        uint32_t      type;
+        // 在点光源阴影cube array中的序号，-1表示不投射阴影
+        int32_t       shadow_index;
+        float         _padding;
+    };
+
     struct VulkanLightProjectDefine
     {
         Math::Matrix4x4 light_proj;
+        // 级联在阴影图集中的uv区间，xy为偏移，zw为缩放
+        Math::Vector4   atlas_rect;
+    };
+
+    // 点光源阴影cube六个面的投影矩阵，顺序与cube map的+X、-X、+Y、-Y、+Z、-Z一致
+    struct VulkanPointLightShadowDefine
+    {
+        Math::Matrix4x4 face_proj_view[6];
+        Math::Vector3   position;
+        float           radius;
     };
 }
 #endif  //XEXAMPLE_RENDER_COMMON_H
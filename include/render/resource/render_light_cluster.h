@@ -0,0 +1,107 @@
+//
+// Created by kyrosz7u on 2023/7/19.
+//
+
+#ifndef XEXAMPLE_RENDER_LIGHT_CLUSTER_H
+#define XEXAMPLE_RENDER_LIGHT_CLUSTER_H
+
+#include "render/common_define.h"
+#include "render/resource/render_common.h"
+#include "scene/point_light.h"
+#include "scene/spot_light.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // 分簇光照剔除(clustered forward+)
+    // 屏幕划分为kClusterGridX * kClusterGridY个tile，相机空间深度按对数划分为kClusterGridZ个切片；
+    // compute shader为每个cluster找出与之相交的点光源和聚光灯，着色时只遍历所在cluster的光源列表
+    class LightClusterCulling
+    {
+    public:
+        // 与shaders/include/local_light.h一致
+        static constexpr uint32_t kClusterGridX        = 16;
+        static constexpr uint32_t kClusterGridY        = 9;
+        static constexpr uint32_t kClusterGridZ        = 24;
+        static constexpr uint32_t kMaxLightsPerCluster = 128;
+        static constexpr uint32_t kClusterCount        = kClusterGridX * kClusterGridY * kClusterGridZ;
+        static constexpr uint32_t kWorkgroupSize       = 64;
+
+        LightClusterCulling() = default;
+
+        ~LightClusterCulling()
+        {
+            Destroy();
+        }
+
+        LightClusterCulling(const LightClusterCulling &) = delete;
+
+        LightClusterCulling &operator=(const LightClusterCulling &) = delete;
+
+        void Initialize();
+
+        void Destroy();
+
+        // 点光源在前，聚光灯在后，超过MAX_LOCAL_LIGHT_COUNT的部分被忽略
+        void UpdateLights(const std::vector<Scene::PointLight> &point_lights,
+                          const std::vector<Scene::SpotLight> &spot_lights);
+
+        // 同时计算着色时定位cluster所需的参数
+        void UpdateCamera(const RenderCameraInfo &camera_info, VulkanPerFrameSceneDefine &scene_data);
+
+        // 必须在render pass之外录制；dispatch_queue_family与图形队列族不同时，
+        // 结尾的barrier把输出buffer的所有权释放给图形队列，图形队列使用前需要AcquireOwnership
+        void Dispatch(VkCommandBuffer command_buffer, uint32_t dispatch_queue_family = VK_QUEUE_FAMILY_IGNORED);
+
+        // 在图形队列上录制，与Dispatch结尾的释放barrier配对
+        void AcquireOwnership(VkCommandBuffer command_buffer) const;
+
+        [[nodiscard]] uint32_t GetLightCount() const
+        {
+            return m_light_count;
+        }
+
+        // 光源、每个cluster的光源数量、每个cluster的光源索引，供着色pass绑定为storage buffer
+        VkDescriptorBufferInfo light_buffer_info{};
+        VkDescriptorBufferInfo cluster_count_buffer_info{};
+        VkDescriptorBufferInfo cluster_index_buffer_info{};
+
+    private:
+        struct CullPushConstants
+        {
+            Math::Matrix4x4 view;
+            // x: tan(fovy/2) * aspect, y: tan(fovy/2), z: znear, w: zfar
+            float           projection_params[4];
+            uint32_t        light_count;
+        };
+
+        VkDescriptorPool      m_descriptor_pool{VK_NULL_HANDLE};
+        VkDescriptorSetLayout m_descriptor_set_layout{VK_NULL_HANDLE};
+        VkDescriptorSet       m_descriptor_set{VK_NULL_HANDLE};
+        VkPipelineLayout      m_pipeline_layout{VK_NULL_HANDLE};
+        VkPipeline            m_pipeline{VK_NULL_HANDLE};
+
+        VkBuffer       m_light_buffer{VK_NULL_HANDLE};
+        VkDeviceMemory m_light_buffer_memory{VK_NULL_HANDLE};
+        void           *m_mapped_lights{nullptr};
+        VkBuffer       m_cluster_count_buffer{VK_NULL_HANDLE};
+        VkDeviceMemory m_cluster_count_buffer_memory{VK_NULL_HANDLE};
+        VkBuffer       m_cluster_index_buffer{VK_NULL_HANDLE};
+        VkDeviceMemory m_cluster_index_buffer_memory{VK_NULL_HANDLE};
+
+        uint32_t          m_light_count{0};
+        // 上一次Dispatch的队列族，与图形队列族相同时为VK_QUEUE_FAMILY_IGNORED
+        uint32_t          m_dispatch_queue_family{VK_QUEUE_FAMILY_IGNORED};
+        CullPushConstants m_push_constants{};
+
+        void setupBuffers();
+
+        void setupDescriptorSet();
+
+        void setupPipeline();
+    };
+}
+
+#endif //XEXAMPLE_RENDER_LIGHT_CLUSTER_H
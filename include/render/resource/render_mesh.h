@@ -24,6 +24,8 @@ namespace RenderSystem
     extern std::shared_ptr<VulkanAPI::VulkanContext> g_p_vulkan_context;
     class RenderMesh;
 
+    class CookedMeshFile;
+
     typedef std::shared_ptr<RenderMesh> RenderMeshPtr;
 
     struct VulkanMeshVertexPostition
@@ -31,15 +33,24 @@ namespace RenderSystem
         Vector3 position;
     };
 
+    // 法线和切线用八面体映射压缩为两个snorm16，切线手性存放在tangent[1]的符号中
+    // 解码见shaders/include/vertex_compression.h
     struct VulkanMeshVertexNormal
     {
-        Vector3 normal;
-        Vector4 tangent;
+        int16_t normal[2];
+        int16_t tangent[2];
+
+        void Encode(const Vector3 &normal_value, const Vector4 &tangent_value);
+
+        [[nodiscard]] Vector3 DecodeNormal() const;
     };
 
+    // 纹理坐标使用half float
     struct VulkanMeshVertexTexcoord
     {
-        Vector2 texCoord;
+        uint16_t texCoord[2];
+
+        void Encode(const Vector2 &texcoord_value);
     };
 
     struct VulkanMeshVertex
@@ -77,18 +88,18 @@ namespace RenderSystem
             // varying blending
             attribute_descriptions[1].binding  = 1;
             attribute_descriptions[1].location = 1;
-            attribute_descriptions[1].format   = VK_FORMAT_R32G32B32_SFLOAT;
+            attribute_descriptions[1].format   = VK_FORMAT_R16G16_SNORM;
             attribute_descriptions[1].offset   = offsetof(VulkanMeshVertexNormal, normal);
 
             attribute_descriptions[2].binding  = 1;
             attribute_descriptions[2].location = 2;
-            attribute_descriptions[2].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attribute_descriptions[2].format   = VK_FORMAT_R16G16_SNORM;
             attribute_descriptions[2].offset   = offsetof(VulkanMeshVertexNormal, tangent);
 
             // varying texcoord
             attribute_descriptions[3].binding  = 2;
             attribute_descriptions[3].location = 3;
-            attribute_descriptions[3].format   = VK_FORMAT_R32G32_SFLOAT;
+            attribute_descriptions[3].format   = VK_FORMAT_R16G16_SFLOAT;
             attribute_descriptions[3].offset   = offsetof(VulkanMeshVertexTexcoord, texCoord);
 
             return attribute_descriptions;
@@ -119,6 +130,33 @@ namespace RenderSystem
         }
     };
 
+    // 每个submesh最多的LOD层级数，第0级为原始精度
+    static constexpr uint32_t kMaxMeshLodCount = 4;
+
+    // 一级LOD在合并索引数组中的区间，error为相对网格尺寸的简化误差
+    struct RenderSubmeshLod
+    {
+        uint32_t index_offset{0};
+        uint32_t index_count{0};
+        float    error{0.0f};
+    };
+
+    // 导入时按连续三角形划分的cluster，剔除粒度比整个submesh更细
+    // index区间位于所属submesh的LOD0区间内，包围球和法线锥都在模型空间
+    struct RenderMeshlet
+    {
+        float    center[3];
+        float    radius;
+        // 法线锥，cone_cutoff为1时不做背面剔除
+        float    cone_axis[3];
+        float    cone_cutoff;
+        uint32_t index_offset;
+        uint32_t index_count;
+    };
+
+    // 没有参与meshlet剔除的submesh直接绘制
+    static constexpr uint32_t kInvalidMeshletDrawOffset = UINT32_MAX;
+
     struct RenderSubmesh
     {
         uint32_t index_count{0};
@@ -126,6 +164,19 @@ namespace RenderSystem
         uint32_t vertex_offset{};
         int material_index{-1};
         std::weak_ptr<RenderMesh> parent_mesh;
+        // 所有LOD共用同一份顶点缓冲，index_count/index_offset为本帧选中的层级
+        uint32_t                                       lod_count{1};
+        std::array<RenderSubmeshLod, kMaxMeshLodCount> lods{};
+        // 阴影pass使用的层级区间，比主相机更粗糙
+        uint32_t shadow_index_count{0};
+        uint32_t shadow_index_offset{0};
+        // LOD0的meshlet在RenderMesh::m_meshlets中的区间
+        uint32_t meshlet_offset{0};
+        uint32_t meshlet_count{0};
+        // 本帧meshlet在间接绘制缓冲中的起始位置，由MeshletCulling分配
+        uint32_t meshlet_draw_offset{kInvalidMeshletDrawOffset};
+        // 所属模型是否静态，静态投射体只在阴影缓存失效时重新绘制
+        bool     is_static{false};
     };
 
     class RenderMesh
@@ -135,10 +186,22 @@ namespace RenderSystem
         std::vector<VulkanMeshVertexPostition> m_positions;
         std::vector<VulkanMeshVertexNormal>    m_normals;
         std::vector<VulkanMeshVertexTexcoord>  m_texcoords;
-        std::vector<uint16_t>                  m_indices;
+        // CPU端索引统一为32位，上传时再按顶点数选择索引宽度
+        std::vector<uint32_t>                  m_indices;
+        std::vector<RenderMeshlet>             m_meshlets;
         std::vector<RenderSubmesh>             m_submeshes;
 
-        uint16_t m_index_in_dynamic_buffer = 0;
+        Vector3 m_bounding_min = Vector3::ZERO;
+        Vector3 m_bounding_max = Vector3::ZERO;
+
+        // 从烘焙文件加载时顶点流为空，ToGPU直接从文件映射拷贝，上传后释放映射
+        std::shared_ptr<CookedMeshFile> m_cooked_source;
+
+        // 在RenderModelStorageBuffer中的序号，绘制时通过push constant传给shader
+        uint32_t m_index_in_model_buffer = 0;
+
+        // ToGPU时确定，绑定索引缓冲时使用
+        VkIndexType m_index_type = VK_INDEX_TYPE_UINT16;
 
         // TODO: 按层级加载，并赋上不同的材质
 //        std::weak_ptr<RenderMesh> parent_mesh;
@@ -166,6 +229,19 @@ namespace RenderSystem
         void ToGPU();
 
         void ReleaseFromDevice();
+
+        void CalculateBounds();
+
+        // 顶点数不超过65536时索引能用16位表示，节省一半索引带宽
+        static VkIndexType SelectIndexType(size_t vertex_count);
+
+        static uint32_t GetIndexStride(VkIndexType index_type)
+        {
+            return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        }
+
+        // 按index_type的宽度打包索引
+        static std::vector<uint8_t> PackIndices(const std::vector<uint32_t> &indices, VkIndexType index_type);
     };
 }
 #endif //XEXAMPLE_RENDER_MESH_H
@@ -0,0 +1,132 @@
+//
+// Created by kyrosz7u on 2023/7/4.
+//
+
+#ifndef XEXAMPLE_RENDER_MESH_FILE_H
+#define XEXAMPLE_RENDER_MESH_FILE_H
+
+#include "render/resource/render_mesh.h"
+#include "core/file/mapped_file.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace RenderSystem
+{
+    // 烘焙网格文件(.xmesh)布局:
+    // header | positions | normals | texcoords | indices | meshlets | submesh table | material table
+    // 各段按kMeshFileAlignment对齐，顶点流与RenderMesh中的内存布局一致，可以直接拷贝到staging buffer
+    // 简化生成的LOD索引追加在索引段末尾，由submesh表中的lods引用
+    // meshlet段保存LOD0的cluster包围球和法线锥，由submesh表中的meshlet区间引用
+    const uint32_t kMeshFileMagic              = 0x48534D58; // "XMSH"
+    const uint32_t kMeshFileVersion            = 4;
+    const uint32_t kMeshFileAlignment          = 16;
+    const uint32_t kMeshFileMaterialNameLength = 128;
+
+    struct MeshFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint32_t submesh_count;
+        uint32_t material_count;
+        uint32_t meshlet_count;
+        // 用于检查烘焙时与运行时的顶点结构是否一致
+        uint32_t position_stride;
+        uint32_t normal_stride;
+        uint32_t texcoord_stride;
+        uint32_t index_stride;
+        uint32_t meshlet_stride;
+        float    bounding_min[3];
+        float    bounding_max[3];
+        uint64_t position_offset;
+        uint64_t normal_offset;
+        uint64_t texcoord_offset;
+        uint64_t index_offset;
+        uint64_t meshlet_offset;
+        uint64_t submesh_offset;
+        uint64_t material_offset;
+    };
+
+    struct MeshFileLod
+    {
+        uint32_t index_offset;
+        uint32_t index_count;
+        float    error;
+    };
+
+    struct MeshFileSubmesh
+    {
+        uint32_t    index_count;
+        uint32_t    index_offset;
+        uint32_t    vertex_offset;
+        int32_t     material_index;
+        // lods[0]与index_offset/index_count相同
+        uint32_t    lod_count;
+        MeshFileLod lods[kMaxMeshLodCount];
+        uint32_t    meshlet_offset;
+        uint32_t    meshlet_count;
+    };
+
+    struct MeshFileMaterial
+    {
+        char name[kMeshFileMaterialNameLength];
+    };
+
+    class CookedMeshFile;
+
+    typedef std::shared_ptr<CookedMeshFile> CookedMeshFilePtr;
+
+    class CookedMeshFile
+    {
+    public:
+        CookedMeshFile()
+        {}
+
+        ~CookedMeshFile()
+        {}
+
+        CookedMeshFile(const CookedMeshFile &) = delete;
+
+        CookedMeshFile &operator=(const CookedMeshFile &) = delete;
+
+        // 映射文件并校验头部与各段范围
+        bool Open(const std::string &path);
+
+        static bool Write(const std::string &path,
+                          const RenderMesh &mesh,
+                          const std::vector<MeshFileSubmesh> &submeshes,
+                          const std::vector<std::string> &material_names);
+
+        [[nodiscard]] inline const MeshFileHeader &GetHeader() const
+        {
+            return *reinterpret_cast<const MeshFileHeader *>(m_file.data());
+        }
+
+        [[nodiscard]] inline const uint8_t *GetSection(uint64_t offset) const
+        {
+            return m_file.data() + offset;
+        }
+
+        [[nodiscard]] inline const RenderMeshlet *GetMeshlets() const
+        {
+            return reinterpret_cast<const RenderMeshlet *>(GetSection(GetHeader().meshlet_offset));
+        }
+
+        [[nodiscard]] inline const MeshFileSubmesh *GetSubmeshes() const
+        {
+            return reinterpret_cast<const MeshFileSubmesh *>(GetSection(GetHeader().submesh_offset));
+        }
+
+        [[nodiscard]] inline const MeshFileMaterial *GetMaterials() const
+        {
+            return reinterpret_cast<const MeshFileMaterial *>(GetSection(GetHeader().material_offset));
+        }
+
+    private:
+        MappedFile m_file;
+    };
+}
+
+#endif //XEXAMPLE_RENDER_MESH_FILE_H
@@ -0,0 +1,59 @@
+//
+// Created by kyrosz7u on 2023/7/12.
+//
+
+#ifndef XEXAMPLE_RENDER_MESH_OPTIMIZER_H
+#define XEXAMPLE_RENDER_MESH_OPTIMIZER_H
+
+#include "render/resource/render_mesh.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace RenderSystem
+{
+    // submesh在合并索引数组中的区间
+    struct MeshIndexRange
+    {
+        uint32_t index_offset;
+        uint32_t index_count;
+    };
+
+    struct VertexCacheStatistics
+    {
+        uint32_t vertices_transformed{0};
+        // average cache miss ratio：每个三角形平均的顶点变换次数，理想值0.5
+        float    acmr{0.0f};
+        // average transformed vertex ratio：变换次数/实际顶点数，理想值1.0
+        float    atvr{0.0f};
+    };
+
+    // 导入时的网格优化，只改变三角形和顶点的顺序，不改变渲染结果
+    // 顶点焊接由assimp的aiProcess_JoinIdenticalVertices完成
+    class MeshOptimizer
+    {
+    public:
+        // 统计用的FIFO post-transform cache大小
+        static constexpr uint32_t kStatisticsCacheSize = 16;
+        // Forsyth算法模拟的LRU cache大小
+        static constexpr uint32_t kVertexCacheSize     = 32;
+        // overdraw排序允许的ACMR上限（相对于vertex cache优化结果）
+        static constexpr float    kOverdrawThreshold   = 1.05f;
+
+        // 各区间内做vertex cache优化和overdraw排序，再对整个mesh按首次使用顺序重排顶点
+        static void Optimize(RenderMesh &mesh, const std::vector<MeshIndexRange> &ranges);
+
+        static VertexCacheStatistics AnalyzeVertexCache(const uint32_t *indices, size_t index_count,
+                                                        size_t vertex_count, uint32_t cache_size);
+
+        // Forsyth线性时间vertex cache优化，原地重排三角形顺序
+        static void OptimizeVertexCache(uint32_t *indices, size_t index_count);
+
+    private:
+        static void optimizeOverdraw(uint32_t *indices, size_t index_count, const RenderMesh &mesh);
+
+        static void optimizeVertexFetch(RenderMesh &mesh, std::vector<uint32_t> &indices);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_MESH_OPTIMIZER_H
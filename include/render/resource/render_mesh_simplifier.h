@@ -0,0 +1,46 @@
+//
+// Created by kyrosz7u on 2023/7/14.
+//
+
+#ifndef XEXAMPLE_RENDER_MESH_SIMPLIFIER_H
+#define XEXAMPLE_RENDER_MESH_SIMPLIFIER_H
+
+#include "render/resource/render_mesh.h"
+#include "render/resource/render_mesh_optimizer.h"
+#include <vector>
+#include <array>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    typedef std::array<RenderSubmeshLod, kMaxMeshLodCount> RenderSubmeshLodChain;
+
+    // 基于二次误差度量(QEM)的边坍缩简化，只把顶点坍缩到已有的相邻顶点上，
+    // 简化结果与原网格共用顶点缓冲，LOD只是追加的索引区间
+    class MeshSimplifier
+    {
+    public:
+        // 每级LOD的目标三角形数相对上一级的比例
+        static constexpr float kLodReduction    = 0.5f;
+        // 实际三角形数没有降到上一级的该比例以下时不再继续生成
+        static constexpr float kMinLodReduction = 0.85f;
+        // 相对网格尺寸的最大误差
+        static constexpr float kMaxLodError     = 0.05f;
+
+        // 为每个区间生成LOD链，简化后的索引做vertex cache优化后追加到mesh.m_indices末尾
+        // 返回的lod_counts[i]为区间i的层级数，lod_chains[i][0]为原区间
+        static void GenerateLods(RenderMesh &mesh,
+                                 const std::vector<MeshIndexRange> &ranges,
+                                 std::vector<uint32_t> &lod_counts,
+                                 std::vector<RenderSubmeshLodChain> &lod_chains);
+
+        // 把三角形列表简化到不超过target_index_count个索引，误差超过target_error(相对extent)时提前停止
+        // 返回实际的相对误差
+        static float Simplify(const RenderMesh &mesh,
+                              const uint32_t *indices, size_t index_count,
+                              size_t target_index_count, float target_error, float extent,
+                              std::vector<uint32_t> &result);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_MESH_SIMPLIFIER_H
@@ -0,0 +1,40 @@
+//
+// Created by kyrosz7u on 2023/7/16.
+//
+
+#ifndef XEXAMPLE_RENDER_MESHLET_H
+#define XEXAMPLE_RENDER_MESHLET_H
+
+#include "render/resource/render_mesh.h"
+#include "render/resource/render_mesh_optimizer.h"
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // submesh的meshlet在RenderMesh::m_meshlets中的区间
+    struct MeshletRange
+    {
+        uint32_t meshlet_offset;
+        uint32_t meshlet_count;
+    };
+
+    class MeshletBuilder
+    {
+    public:
+        static constexpr uint32_t kMaxMeshletVertices  = 64;
+        static constexpr uint32_t kMaxMeshletTriangles = 124;
+        // 法线锥张角过大时背面剔除几乎不会生效，直接关闭
+        static constexpr float    kMinConeDot          = 0.1f;
+
+        // 按索引顺序贪心划分三角形，不改变索引数组，需要在vertex cache优化之后调用
+        static void Build(RenderMesh &mesh,
+                          const std::vector<MeshIndexRange> &ranges,
+                          std::vector<MeshletRange> &meshlet_ranges);
+
+    private:
+        static RenderMeshlet computeBounds(const RenderMesh &mesh, uint32_t index_offset, uint32_t index_count);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_MESHLET_H
@@ -0,0 +1,132 @@
+//
+// Created by kyrosz7u on 2023/7/16.
+//
+
+#ifndef XEXAMPLE_RENDER_MESHLET_CULLING_H
+#define XEXAMPLE_RENDER_MESHLET_CULLING_H
+
+#include "render/resource/render_mesh.h"
+#include "render/resource/render_common.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // meshlet级别的视锥剔除和背面(法线锥)剔除
+    // 每帧把使用LOD0的submesh展开为meshlet，compute shader为每个meshlet写一条VkDrawIndexedIndirectCommand，
+    // 被剔除的meshlet instanceCount为0；mesh pass通过vkCmdDrawIndexedIndirect绘制，仍然走普通的顶点管线
+    class MeshletCulling
+    {
+    public:
+        static constexpr uint32_t kWorkgroupSize         = 64;
+        // 扩容后旧的descriptor set要等引用它的帧执行完才释放，同时存在的数量不超过在途帧数加一
+        static constexpr uint32_t kMaxDescriptorSetCount = 4;
+
+        MeshletCulling() = default;
+
+        ~MeshletCulling()
+        {
+            Destroy();
+        }
+
+        MeshletCulling(const MeshletCulling &) = delete;
+
+        MeshletCulling &operator=(const MeshletCulling &) = delete;
+
+        void Initialize();
+
+        void Destroy();
+
+        // 为参与剔除的submesh分配间接绘制区间(meshlet_draw_offset)并上传meshlet和模型矩阵
+        void UpdateMeshlets(std::vector<RenderSubmesh> &submeshes, const std::vector<VulkanModelDefine> &models);
+
+        void UpdateCamera(const Math::Matrix4x4 &proj_view, const Math::Vector3 &camera_pos);
+
+        // 必须在render pass之外录制；dispatch_queue_family与图形队列族不同时，
+        // 结尾的barrier把输出buffer的所有权释放给图形队列，图形队列使用前需要AcquireOwnership
+        void Dispatch(VkCommandBuffer command_buffer, uint32_t dispatch_queue_family = VK_QUEUE_FAMILY_IGNORED);
+
+        // 在图形队列上录制，与Dispatch结尾的释放barrier配对
+        void AcquireOwnership(VkCommandBuffer command_buffer) const;
+
+        // 参与剔除的submesh使用间接绘制，其余直接绘制
+        void DrawSubmesh(VkCommandBuffer command_buffer, const RenderSubmesh &submesh) const;
+
+        [[nodiscard]] uint32_t GetMeshletCount() const
+        {
+            return m_meshlet_count;
+        }
+
+        // 每次重建buffer加一，录制了DrawSubmesh的command buffer据此判断是否还能复用
+        [[nodiscard]] uint32_t GetBufferGeneration() const
+        {
+            return m_buffer_generation;
+        }
+
+    private:
+        // 与shaders/meshlet_cull.comp中的std430布局一致
+        struct MeshletCullData
+        {
+            float    bounding_sphere[4];
+            float    cone[4];
+            uint32_t model_index;
+            uint32_t index_count;
+            uint32_t first_index;
+            int32_t  vertex_offset;
+        };
+
+        struct CullPushConstants
+        {
+            float    frustum_planes[6][4];
+            float    camera_pos[3];
+            uint32_t meshlet_count;
+        };
+
+        VkDescriptorPool      m_descriptor_pool{VK_NULL_HANDLE};
+        VkDescriptorSetLayout m_descriptor_set_layout{VK_NULL_HANDLE};
+        VkDescriptorSet       m_descriptor_set{VK_NULL_HANDLE};
+        VkPipelineLayout      m_pipeline_layout{VK_NULL_HANDLE};
+        VkPipeline            m_pipeline{VK_NULL_HANDLE};
+
+        // meshlet和模型矩阵每帧由CPU写入，每个在途帧占一段region，Dispatch时用dynamic offset选择；
+        // 间接绘制命令只由GPU写，靠Dispatch中的barrier(或计算队列的timeline等待)排序，所有帧共用
+        VkBuffer       m_meshlet_buffer{VK_NULL_HANDLE};
+        VkDeviceMemory m_meshlet_buffer_memory{VK_NULL_HANDLE};
+        void           *m_mapped_meshlets{nullptr};
+        VkBuffer       m_model_buffer{VK_NULL_HANDLE};
+        VkDeviceMemory m_model_buffer_memory{VK_NULL_HANDLE};
+        void           *m_mapped_models{nullptr};
+        VkBuffer       m_draw_command_buffer{VK_NULL_HANDLE};
+        VkDeviceMemory m_draw_command_buffer_memory{VK_NULL_HANDLE};
+
+        VkDeviceSize      m_meshlet_region_size{0};
+        VkDeviceSize      m_model_region_size{0};
+        // UpdateMeshlets写入的region，等于当时的帧槽位
+        uint32_t          m_frame_region{0};
+        uint32_t          m_meshlet_capacity{0};
+        uint32_t          m_model_capacity{0};
+        uint32_t          m_meshlet_count{0};
+        uint32_t          m_buffer_generation{0};
+        // 上一次Dispatch的队列族，与图形队列族相同时为VK_QUEUE_FAMILY_IGNORED
+        uint32_t          m_dispatch_queue_family{VK_QUEUE_FAMILY_IGNORED};
+        CullPushConstants m_push_constants{};
+
+        // binding 0和1按帧槽位取region，使用dynamic描述符；binding 2是间接绘制命令
+        static VkDescriptorType descriptorType(uint32_t binding);
+
+        void setupDescriptorSet();
+
+        void allocateDescriptorSet();
+
+        void setupPipeline();
+
+        void reserveBuffers(uint32_t meshlet_count, uint32_t model_count);
+
+        void releaseBuffers();
+
+        void updateDescriptorSet();
+    };
+}
+
+#endif //XEXAMPLE_RENDER_MESHLET_CULLING_H
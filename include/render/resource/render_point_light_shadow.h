@@ -0,0 +1,45 @@
+//
+// Created by kyrosz7u on 2023/7/20.
+//
+
+#ifndef XEXAMPLE_RENDER_POINT_LIGHT_SHADOW_H
+#define XEXAMPLE_RENDER_POINT_LIGHT_SHADOW_H
+
+#include "render/common_define.h"
+#include "render/resource/render_common.h"
+#include "scene/point_light.h"
+#include "scene/spot_light.h"
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // 点光源和聚光灯的cube阴影，每个光源的六个面在一次multiview pass中绘制
+    // 深度图中保存片元到光源的距离除以radius，着色时沿光源到片元的方向采样比较
+    class PointLightShadow
+    {
+    public:
+        static constexpr uint32_t kFaceCount = 6;
+
+        // 点光源在前，聚光灯在后，依次为cast_shadow的光源分配阴影序号，与LightClusterCulling::UpdateLights一致
+        static int32_t AssignShadowIndex(bool cast_shadow, uint32_t &shadow_count)
+        {
+            if (!cast_shadow || shadow_count >= MAX_POINT_LIGHT_SHADOW_COUNT)
+            {
+                return -1;
+            }
+            return static_cast<int32_t>(shadow_count++);
+        }
+
+        // 相机空间朝向+z，right、up与cube map各个面的纹理坐标方向一致
+        static Math::Matrix4x4 GetFaceView(uint32_t face, const Math::Vector3 &position);
+
+        // 计算所有投射阴影的光源六个面的投影矩阵，shadow_projections[i]对应阴影序号i
+        static void UpdateShadowProjections(const std::vector<Scene::PointLight> &point_lights,
+                                            const std::vector<Scene::SpotLight> &spot_lights,
+                                            const PointLightShadowInfo &shadow_info,
+                                            std::vector<VulkanPointLightShadowDefine> &shadow_projections);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_POINT_LIGHT_SHADOW_H
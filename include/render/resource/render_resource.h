@@ -11,6 +11,10 @@
 #include "render_mesh.h"
 #include "ui/ui_overlay.h"
 #include "render_texture.h"
+#include "render_meshlet_culling.h"
+#include "render_light_cluster.h"
+#include "render_async_compute.h"
+#include "render_shadow_atlas.h"
 #include "../common_define.h"
 #include <memory>
 
@@ -18,21 +22,31 @@ using namespace VulkanAPI;
 
 namespace RenderSystem
 {
-    typedef RenderDynamicBuffer<VulkanModelDefine>        RenderModelUBOList;
-    typedef RenderDynamicBuffer<VulkanLightProjectDefine> RenderLightProjectUBOList;
+    typedef RenderStorageBuffer<VulkanModelDefine>            RenderModelStorageBuffer;
+    typedef RenderDynamicBuffer<VulkanLightProjectDefine>     RenderLightProjectUBOList;
+    typedef RenderDynamicBuffer<VulkanPointLightShadowDefine> RenderPointLightShadowUBOList;
 
 
     struct RenderGlobalResourceInfo
     {
-        std::vector<RenderSubmesh>   *p_render_submeshes;
-        std::vector<VkDescriptorSet> *p_texture_descriptor_sets;
-        VkDescriptorSet              *p_skybox_descriptor_set;
-        VkDescriptorSet              *p_directional_light_shadow_map_descriptor_set;
-        RenderModelUBOList           *p_render_model_ubo_list;
-        RenderLightProjectUBOList    *p_render_light_project_ubo_list;
-        RenderPerFrameUBO            *p_render_per_frame_ubo;
-        std::weak_ptr<UIOverlay>     p_ui_overlay;
-        DirectionLightInfo           kDirectionalLightInfo;
+        std::vector<RenderSubmesh>    *p_render_submeshes;
+        std::vector<VkDescriptorSet>  *p_texture_descriptor_sets;
+        VkDescriptorSet               *p_skybox_descriptor_set;
+        VkDescriptorSet               *p_directional_light_shadow_map_descriptor_set;
+        RenderModelStorageBuffer      *p_render_model_buffer;
+        RenderLightProjectUBOList     *p_render_light_project_ubo_list;
+        RenderPointLightShadowUBOList *p_render_point_light_shadow_ubo_list;
+        RenderPerFrameUBO             *p_render_per_frame_ubo;
+        MeshletCulling                *p_meshlet_culling;
+        LightClusterCulling           *p_light_cluster_culling;
+        ShadowAtlas                   *p_shadow_atlas;
+        std::weak_ptr<UIOverlay>      p_ui_overlay;
+        DirectionLightInfo            kDirectionalLightInfo;
+        PointLightShadowInfo          kPointLightShadowInfo;
+        // 绘制列表(submesh、LOD区间、材质、meshlet区间)的哈希，每帧由渲染器计算
+        uint64_t                      draw_list_hash{0};
+        // 绘制列表和pipeline状态不变时复用上一次录制的secondary command buffer
+        bool                          reuse_secondary_command_buffers{true};
     };
 }
 
@@ -0,0 +1,65 @@
+//
+// Created by kyrosz7u on 2023/7/18.
+//
+
+#ifndef XEXAMPLE_RENDER_SHADOW_ATLAS_H
+#define XEXAMPLE_RENDER_SHADOW_ATLAS_H
+
+#include "core/math/math.h"
+#include "scene/direction_light.h"
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // tile在阴影图集中的像素区间，尺寸为2的幂
+    struct ShadowAtlasTile
+    {
+        uint32_t x{0};
+        uint32_t y{0};
+        uint32_t size{0};
+
+        bool operator==(const ShadowAtlasTile &other) const
+        {
+            return x == other.x && y == other.y && size == other.size;
+        }
+    };
+
+    // 所有平行光的级联阴影共用一张深度图，每个级联占一个正方形tile
+    // tile边长按光源重要性(亮度)分配，tile按光源顺序排列：light_index * cascade_count + cascade
+    class ShadowAtlas
+    {
+    public:
+        static constexpr uint32_t kMinTileSize = 128;
+
+        void Initialize(uint32_t atlas_size, uint32_t max_tile_size);
+
+        // 重新计算每个光源的tile尺寸，尺寸变化时重新打包，返回tile是否变化
+        bool Update(const std::vector<Scene::DirectionLight> &directional_light_list, uint32_t cascade_count);
+
+        [[nodiscard]] const std::vector<ShadowAtlasTile> &GetTiles() const
+        {
+            return m_tiles;
+        }
+
+        [[nodiscard]] uint32_t GetSize() const
+        {
+            return m_atlas_size;
+        }
+
+        // xy为tile在图集中的uv偏移，zw为uv缩放
+        [[nodiscard]] Math::Vector4 GetUVRect(uint32_t tile_index) const;
+
+        // 尺寸从大到小依次放入四叉树空闲节点，2的幂尺寸下总面积不超过图集即可全部放下
+        static bool Pack(const std::vector<uint32_t> &tile_sizes, uint32_t atlas_size,
+                         std::vector<ShadowAtlasTile> &tiles);
+
+    private:
+        uint32_t                     m_atlas_size{0};
+        uint32_t                     m_max_tile_size{0};
+        std::vector<uint32_t>        m_tile_sizes;
+        std::vector<ShadowAtlasTile> m_tiles;
+    };
+}
+
+#endif //XEXAMPLE_RENDER_SHADOW_ATLAS_H
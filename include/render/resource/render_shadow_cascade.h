@@ -0,0 +1,57 @@
+//
+// Created by kyrosz7u on 2023/7/17.
+//
+
+#ifndef XEXAMPLE_RENDER_SHADOW_CASCADE_H
+#define XEXAMPLE_RENDER_SHADOW_CASCADE_H
+
+#include "render/common_define.h"
+#include "render/resource/render_common.h"
+#include "render/resource/render_shadow_atlas.h"
+#include "scene/direction_light.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // 平行光级联阴影：把相机视锥按距离分段，每段用一个正交投影覆盖
+    // 阴影图集第light_index * cascade_count + cascade个tile对应一个级联，级联从近到远排列
+    class ShadowCascade
+    {
+    public:
+        // 包围球半径的量化精度，避免浮点误差引起投影尺寸抖动
+        static constexpr float kRadiusQuantization = 16.0f;
+        // 投影宽度内光源空间中心对齐的格子数，格子宽度是texel的整数倍（tile边长为8的倍数时）
+        static constexpr uint32_t kCenterSnapDivisions = 8;
+
+        [[nodiscard]] static uint32_t GetCascadeCount(const DirectionLightInfo &light_info)
+        {
+            return std::clamp(light_info.cascade_count, 1u, uint32_t(MAX_SHADOW_CASCADE_COUNT));
+        }
+
+        // 对数划分与均匀划分按split_lambda混合，splits[i]为第i级的远平面距离
+        static void ComputeSplits(float znear, float zfar, uint32_t cascade_count, float split_lambda,
+                                  float *splits);
+
+        // 用包围球拟合视锥分段，投影尺寸不随相机旋转变化；
+        // 包围球中心在光源空间的x/y/深度都对齐到投影宽度1/kCenterSnapDivisions的格子，
+        // 相机在格子内移动或旋转时返回的矩阵逐位相同，静态阴影缓存可以直接复用；
+        // 格子宽度是texel的整数倍，跨格子时阴影边缘也不会闪烁
+        static Math::Matrix4x4 FitCascade(const RenderCameraInfo &camera_info,
+                                          float split_near,
+                                          float split_far,
+                                          const Math::Matrix4x4 &light_rotation,
+                                          uint32_t shadowmap_size,
+                                          float caster_distance);
+
+        // 计算所有光源所有级联的light_proj和图集区间，light_projections与图集tile一一对应
+        static void UpdateLightProjections(const RenderCameraInfo &camera_info,
+                                           const std::vector<Scene::DirectionLight> &directional_light_list,
+                                           const DirectionLightInfo &light_info,
+                                           const ShadowAtlas &shadow_atlas,
+                                           std::vector<VulkanLightProjectDefine> &light_projections);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_SHADOW_CASCADE_H
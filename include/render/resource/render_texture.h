@@ -6,8 +6,10 @@
 #define XEXAMPLE_RENDER_TEXTURE_H
 
 #include "core/graphic/vulkan/vulkan_context.h"
+#include "core/file/mapped_file.h"
 #include <vulkan/vulkan.h>
 #include <string>
+#include <vector>
 #include <memory>
 
 namespace RenderSystem
@@ -18,16 +20,69 @@ namespace RenderSystem
 
     class TextureCube;
 
-    typedef std::shared_ptr<Texture2D>   Texture2DPtr;
-    typedef std::shared_ptr<TextureCube> TextureCubePtr;
+    class TextureImage;
+
+    typedef std::shared_ptr<Texture2D>    Texture2DPtr;
+    typedef std::shared_ptr<TextureCube>  TextureCubePtr;
+    typedef std::shared_ptr<TextureImage> TextureImagePtr;
+
+    struct TextureImageLevel
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t     width;
+        uint32_t     height;
+    };
+
+    // CPU端的纹理数据，不依赖vulkan命令，可以在工作线程中构造
+    // 同目录下存在更新的.ktx2时直接映射预压缩的mip链，否则用stb解码为RGBA8
+    class TextureImage
+    {
+    public:
+        std::string   path;
+        uint32_t      width{0}, height{0};
+        unsigned char *pixels{nullptr};
+
+        VkFormat                       format{VK_FORMAT_R8G8B8A8_UNORM};
+        std::vector<TextureImageLevel> levels;
+    public:
+        explicit TextureImage(const std::string &path, bool prefer_cooked = true);
+
+        ~TextureImage();
+
+        TextureImage(const TextureImage &) = delete;
+
+        TextureImage &operator=(const TextureImage &) = delete;
+
+        [[nodiscard]] inline bool IsCooked() const
+        {
+            return m_cooked_file.data() != nullptr;
+        }
+
+        [[nodiscard]] inline const uint8_t *GetLevelData(uint32_t level) const
+        {
+            return m_cooked_file.data() + levels[level].offset;
+        }
+
+    private:
+        MappedFile m_cooked_file;
+
+        bool loadKtx2(const std::string &ktx2_path);
+    };
 
     class Texture2D
     {
     public:
+        // 流式纹理初始只上传边长不超过该值的mip尾部
+        static constexpr uint32_t kStreamingTailSize = 128;
+
         std::string name;
         std::string path;
         uint32_t    width, height;
         uint32_t    mip_levels;
+        // 显存中实际驻留的最高精度层级，0表示完整mip链
+        uint32_t    resident_level{0};
+        VkDeviceSize resident_size{0};
 
         VkImage               image;
         VkDeviceMemory        memory;
@@ -39,7 +94,38 @@ namespace RenderSystem
         Texture2D(const std::string &path, const std::string &name, bool gen_mipmap = false,
                   VkFormat image_format = VK_FORMAT_R8G8B8A8_UNORM);
 
+        Texture2D(const TextureImage &texture_image, const std::string &name, bool gen_mipmap = false,
+                  VkFormat image_format = VK_FORMAT_R8G8B8A8_UNORM);
+
+        // 可流式加载的纹理，只对预烘焙的KTX2生效：保留文件映射，初始只驻留mip尾部，
+        // 之后由TextureResidencyManager调整驻留层级；未烘焙的图像按原尺寸常驻
+        Texture2D(const TextureImagePtr &texture_image, const std::string &name);
+
         ~Texture2D();
+
+        [[nodiscard]] inline bool IsStreamable() const
+        {
+            return m_stream_source != nullptr;
+        }
+
+        // 允许驻留的最低精度层级
+        [[nodiscard]] uint32_t GetTailLevel() const;
+
+        // 从base_level开始的mip链的数据大小，用于预算估计
+        [[nodiscard]] VkDeviceSize GetLevelChainSize(uint32_t base_level) const;
+
+        // 重建只包含[base_level, mip_levels)的图像，调用方需保证GPU已不再使用旧图像，
+        // 并在之后重新写入引用info的descriptor
+        void SetResidentLevel(uint32_t base_level);
+
+    private:
+        TextureImagePtr m_stream_source;
+
+        void setupFromImage(const TextureImage &texture_image, bool gen_mipmap, VkFormat image_format);
+
+        void setupFromCookedImage(const TextureImage &texture_image, uint32_t base_level = 0);
+
+        void releaseImage();
     };
 
     class TextureCube
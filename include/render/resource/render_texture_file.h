@@ -0,0 +1,77 @@
+//
+// Created by kyrosz7u on 2023/7/6.
+//
+
+#ifndef XEXAMPLE_RENDER_TEXTURE_FILE_H
+#define XEXAMPLE_RENDER_TEXTURE_FILE_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // KTX2容器(https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html)
+    // 只支持无超压缩(supercompressionScheme = 0)的单层2D纹理
+    const uint8_t kKtx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    struct Ktx2Header
+    {
+        uint8_t  identifier[12];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        uint32_t dfd_byte_offset;
+        uint32_t dfd_byte_length;
+        uint32_t kvd_byte_offset;
+        uint32_t kvd_byte_length;
+        uint64_t sgd_byte_offset;
+        uint64_t sgd_byte_length;
+    };
+
+    struct Ktx2LevelIndex
+    {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+
+    struct TextureFormatInfo
+    {
+        uint32_t block_width;
+        uint32_t block_height;
+        uint32_t block_byte_size;
+    };
+
+    // 返回false表示不支持的格式
+    bool GetTextureFormatInfo(VkFormat format, TextureFormatInfo &format_info);
+
+    // 离线纹理烘焙：生成完整mip链并压缩为BC7，写出KTX2
+    class TextureCooker
+    {
+    public:
+        static bool CookTextureFile(const std::string &source_path, const std::string &cooked_path);
+
+        // rgba为4x4块的RGBA8像素，输出16字节的BC7块(mode 6)
+        static void CompressBC7Block(const uint8_t *rgba, uint8_t *block);
+
+        static std::vector<uint8_t> CompressBC7Image(const uint8_t *rgba, uint32_t width, uint32_t height);
+
+        static std::vector<uint8_t> DownsampleImage(const uint8_t *rgba, uint32_t width, uint32_t height);
+
+        static bool WriteKtx2File(const std::string &path,
+                                  VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  const std::vector<std::vector<uint8_t>> &levels);
+    };
+}
+
+#endif //XEXAMPLE_RENDER_TEXTURE_FILE_H
@@ -0,0 +1,79 @@
+//
+// Created by kyrosz7u on 2023/7/9.
+//
+
+#ifndef XEXAMPLE_RENDER_TEXTURE_RESIDENCY_H
+#define XEXAMPLE_RENDER_TEXTURE_RESIDENCY_H
+
+#include "render/resource/render_texture.h"
+#include "core/math/math.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+namespace RenderSystem
+{
+    // 纹理驻留管理
+    // 每帧根据物体在屏幕上的尺寸估计其纹理需要的mip层级，每隔若干帧统一调整流式纹理的驻留层级；
+    // 超出显存预算时从最久未使用(LRU)的纹理开始降低精度，最低降到mip尾部
+    class TextureResidencyManager
+    {
+    public:
+        struct Config
+        {
+            // 纹理可用的显存上限，支持VK_EXT_memory_budget时还受驱动报告的剩余预算约束
+            VkDeviceSize budget_bytes{512ull * 1024 * 1024};
+            // 驱动预算中留给纹理的比例
+            float        budget_fraction{0.8f};
+            // 两次调整之间的帧数，调整时需要等待GPU空闲
+            uint32_t     update_interval{30};
+            // 单次调整最多流入的数据量，避免一次卡顿过长
+            VkDeviceSize max_upload_bytes{64ull * 1024 * 1024};
+        };
+
+        TextureResidencyManager() = default;
+
+        explicit TextureResidencyManager(const Config &config) : m_config(config)
+        {}
+
+        void SetTextures(const std::vector<Texture2DPtr> &textures);
+
+        // 记录本帧对纹理的使用，screen_extent为使用该纹理的物体在屏幕上的像素尺寸
+        void RequestTexture(int texture_index, float screen_extent);
+
+        // 返回true表示有纹理重建了图像，需要重新写入纹理descriptor
+        bool Update();
+
+        // 包围盒投影到屏幕后的最大边长(像素)，完全在视口外时返回0
+        static float EstimateScreenExtent(const Math::Matrix4x4 &proj_view_model,
+                                          const Math::Vector3 &bounding_min,
+                                          const Math::Vector3 &bounding_max,
+                                          float viewport_height);
+
+        void ImGuiDebugPanel();
+
+    private:
+        struct TextureState
+        {
+            uint32_t desired_level{0};
+            uint64_t last_used_frame{0};
+        };
+
+        Config                    m_config;
+        std::vector<Texture2DPtr> m_textures;
+        std::vector<TextureState> m_states;
+        uint64_t                  m_frame_index{0};
+        uint64_t                  m_last_update_frame{0};
+        VkDeviceSize              m_budget{0};
+        VkDeviceSize              m_resident_bytes{0};
+        bool                      m_budget_from_driver{false};
+
+        VkDeviceSize queryBudget();
+
+        void resetDesiredLevels();
+
+        void updateResidentBytes();
+    };
+}
+
+#endif //XEXAMPLE_RENDER_TEXTURE_RESIDENCY_H
@@ -99,6 +99,85 @@ namespace RenderSystem
         }
     };
 
+    // 按std430紧密排列的storage buffer，整个pass只绑定一次，shader通过push constant传入的序号索引
+    // 每个在途帧独占一段region，CPU写当前帧的region时不会覆盖GPU还在读的数据，
+    // 描述符类型为STORAGE_BUFFER_DYNAMIC，绑定时用GetDynamicOffset()选择当前帧的region
+    template<typename T>
+    class RenderStorageBuffer
+    {
+    public:
+        uint32_t               capacity;
+        VkDeviceSize           region_size;
+        VkDeviceSize           buffer_size;
+        std::vector<T>         data_list;
+        VkBuffer               storage_buffer;
+        VkDeviceMemory         storage_buffer_memory;
+        void                   *mapped_buffer_ptr;
+        VkDescriptorBufferInfo buffer_info;
+
+    public:
+        explicit RenderStorageBuffer(uint32_t capacity = MAX_MODEL_COUNT) : capacity(capacity)
+        {
+            // region的起始偏移既是dynamic offset，也是flush的起点，需要同时满足两种对齐
+            const auto &limits = g_p_vulkan_context->_physical_device_properties.limits;
+            VkDeviceSize region_alignment = std::max(limits.minStorageBufferOffsetAlignment, limits.nonCoherentAtomSize);
+
+            region_size = capacity * sizeof(T);
+            region_size = (region_size + region_alignment - 1) & ~(region_alignment - 1);
+            buffer_size = region_size * VulkanContext::kMaxFramesInFlight;
+
+            VulkanUtil::createBuffer(g_p_vulkan_context,
+                                     buffer_size,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     storage_buffer, storage_buffer_memory);
+
+            // 每帧都要更新，保持映射
+            vkMapMemory(g_p_vulkan_context->_device, storage_buffer_memory, 0,
+                        buffer_size, 0, &mapped_buffer_ptr);
+
+            buffer_info.buffer = storage_buffer;
+            buffer_info.offset = 0;
+            // dynamic描述符的range只覆盖一个region
+            buffer_info.range  = region_size;
+        }
+
+        ~RenderStorageBuffer()
+        {
+            vkUnmapMemory(g_p_vulkan_context->_device, storage_buffer_memory);
+            vkDestroyBuffer(g_p_vulkan_context->_device, storage_buffer, nullptr);
+            vkFreeMemory(g_p_vulkan_context->_device, storage_buffer_memory, nullptr);
+        }
+
+        RenderStorageBuffer(const RenderStorageBuffer &other) = delete;
+
+        RenderStorageBuffer &operator=(const RenderStorageBuffer &other) = delete;
+
+        // 写入当前帧槽位对应的region，beginFrame已经等到该槽位上一次提交完成
+        void ToGPU()
+        {
+            if (data_list.size() > capacity)
+            {
+                throw std::runtime_error("render storage buffer overflow");
+            }
+            memcpy((uint8_t *) mapped_buffer_ptr + GetDynamicOffset(), data_list.data(), data_list.size() * sizeof(T));
+
+            VkMappedMemoryRange mappedMemoryRange{};
+            mappedMemoryRange.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            mappedMemoryRange.memory = storage_buffer_memory;
+            mappedMemoryRange.offset = GetDynamicOffset();
+            mappedMemoryRange.size   = region_size;
+
+            vkFlushMappedMemoryRanges(g_p_vulkan_context->_device, 1, &mappedMemoryRange);
+        }
+
+        // 当前帧槽位的region偏移，ToGPU和录制命令时取到的是同一个值
+        uint32_t GetDynamicOffset() const
+        {
+            return uint32_t(region_size * g_p_vulkan_context->m_current_frame_index);
+        }
+    };
+
     // 保存场景中全局信息，如相机矩阵，光照参数等
     class RenderPerFrameUBO
     {
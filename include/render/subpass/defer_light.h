@@ -18,7 +18,7 @@ namespace RenderSystem
         {
             ImageAttachment *gbuffer_color_attachment;
             ImageAttachment *gbuffer_normal_attachment;
-            ImageAttachment *gbuffer_position_attachment;
+            ImageAttachment *depth_attachment;
         };
 
         class DeferLightPass : public SubPassBase
@@ -54,9 +54,9 @@ namespace RenderSystem
             VkDescriptorSet m_scence_ubo_descriptor_set = VK_NULL_HANDLE;
             VkDescriptorSet m_gbuffer_descriptor_set    = VK_NULL_HANDLE;
 
-            ImageAttachment *m_p_gbuffer_color_attachment    = nullptr;
-            ImageAttachment *m_p_gbuffer_normal_attachment   = nullptr;
-            ImageAttachment *m_p_gbuffer_position_attachment = nullptr;
+            ImageAttachment *m_p_gbuffer_color_attachment  = nullptr;
+            ImageAttachment *m_p_gbuffer_normal_attachment = nullptr;
+            ImageAttachment *m_p_depth_attachment          = nullptr;
 
             void updateGlobalDescriptorSet();
 
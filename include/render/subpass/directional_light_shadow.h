@@ -6,6 +6,7 @@
 #define XEXAMPLE_DIRECTIONAL_LIGHT_SHADOW_H
 
 #include "subpass_base.h"
+#include "render/resource/render_mesh.h"
 
 namespace RenderSystem
 {
@@ -18,12 +19,22 @@ namespace RenderSystem
         class DirectionalLightShadowPass : public SubPassBase
         {
         public:
+            // 投影到当前级联后小于该texel数的投射体不绘制
+            static constexpr float kMinCasterTexels = 1.0f;
+
             enum _directional_light_shadow_pass_pipeline_layout_define
             {
                 _directional_shadow_layout = 0,
                 _pipeline_layout_count
             };
 
+            // 静态投射体绘制到阴影缓存，动态投射体每帧叠加到缓存拷贝之上
+            enum _shadow_caster_type
+            {
+                _shadow_caster_static = 0,
+                _shadow_caster_dynamic
+            };
+
             DirectionalLightShadowPass()
             {
                 name = "directional_light_shadow_subpass";
@@ -43,9 +54,15 @@ namespace RenderSystem
 
             void updateAfterSwapchainRecreate() override;
 
-            void setDirectionalLightIndex(uint32_t index)
+            // 本次绘制的图集tile，每个tile对应一个级联的light_proj
+            void setShadowTiles(const std::vector<uint32_t> &tile_indices)
             {
-                m_directional_light_index = index;
+                m_tile_indices = tile_indices;
+            }
+
+            void setShadowCasterType(_shadow_caster_type caster_type)
+            {
+                m_caster_type = caster_type;
             }
 
         private:
@@ -57,8 +74,14 @@ namespace RenderSystem
 
             void setupPipelines() override;
 
-            VkDescriptorSet m_dir_shadow_ubo_descriptor_set = VK_NULL_HANDLE;
-            uint32_t        m_directional_light_index       = 0;
+            [[nodiscard]] bool isMeshInShadowTile(const RenderMesh &mesh, uint32_t tile_index) const;
+
+            // 每个submesh只绑定一次顶点缓冲，依次用各tile的viewport绘制
+            void drawSubmeshes(VkCommandBuffer command_buffer, uint32_t submesh_start_index, uint32_t submesh_end_index);
+
+            VkDescriptorSet       m_dir_shadow_ubo_descriptor_set = VK_NULL_HANDLE;
+            std::vector<uint32_t> m_tile_indices;
+            _shadow_caster_type   m_caster_type                   = _shadow_caster_dynamic;
 
             void drawSingleThread(VkCommandBuffer &command_buffer, VkCommandBufferInheritanceInfo &inheritance_info,
                                   uint32_t submesh_start_index, uint32_t submesh_end_index);
@@ -0,0 +1,68 @@
+//
+// Created by kyrosz7u on 2023/7/21.
+//
+
+#ifndef XEXAMPLE_MESH_DEPTH_PREPASS_H
+#define XEXAMPLE_MESH_DEPTH_PREPASS_H
+
+#include "subpass_base.h"
+#include "render/resource/render_mesh.h"
+
+namespace RenderSystem
+{
+    namespace SubPass
+    {
+        struct MeshDepthPrepassInitInfo : public SubPassInitInfo
+        {
+        };
+
+        // 只输出深度的预渲染，使用与阴影pass相同的只含位置的顶点流；
+        // 之后的光照pass以EQUAL做深度测试，每个像素只着色一次
+        class MeshDepthPrepass : public SubPassBase
+        {
+        public:
+            enum _mesh_depth_prepass_pipeline_layout_define
+            {
+                _mesh_depth_prepass_ubo_data_layout = 0,
+                _mesh_depth_prepass_pipeline_layout_count
+            };
+
+            MeshDepthPrepass()
+            {
+                name = "mesh_depth_prepass_subpass";
+                m_descriptor_set_layouts.resize(_mesh_depth_prepass_pipeline_layout_count);
+            }
+
+            void draw() override;
+
+            void drawMultiThreading(ThreadPool &thread_pool,
+                                    std::vector<RenderThreadData> &thread_data,
+                                    VkCommandBufferInheritanceInfo &inheritance_info,
+                                    uint32_t command_buffer_index,
+                                    uint32_t thread_start_index,
+                                    uint32_t thread_count) override;
+
+            void updateGlobalRenderDescriptorSet();
+
+            void updateAfterSwapchainRecreate() override;
+
+        private:
+            void initialize(SubPassInitInfo *subPassInitInfo) override;
+
+            void setupPipeLineLayout();
+
+            void setupDescriptorSet() override;
+
+            void setupPipelines() override;
+
+            void drawSubmeshes(VkCommandBuffer command_buffer, uint32_t submesh_start_index, uint32_t submesh_end_index);
+
+            void drawSingleThread(VkCommandBuffer &command_buffer, VkCommandBufferInheritanceInfo &inheritance_info,
+                                  uint32_t submesh_start_index, uint32_t submesh_end_index);
+
+            VkDescriptorSet m_depth_ubo_descriptor_set = VK_NULL_HANDLE;
+        };
+    }
+}
+
+#endif //XEXAMPLE_MESH_DEPTH_PREPASS_H
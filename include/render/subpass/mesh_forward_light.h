@@ -48,12 +48,28 @@ namespace RenderSystem
 
             void updateAfterSwapchainRecreate() override;
 
+            // 深度已由预渲染写入时使用EQUAL且不写深度的管线
+            void setDepthPrepassEnabled(bool enabled)
+            {
+                m_depth_prepass_enabled = enabled;
+            }
+
         private:
             void initialize(SubPassInitInfo *subPassInitInfo) override;
             void setupPipeLineLayout();
             void setupDescriptorSet() override;
             void setupPipelines() override;
             VkDescriptorSet m_mesh_ubo_descriptor_set = VK_NULL_HANDLE;
+            VkPipeline      m_depth_equal_pipeline    = VK_NULL_HANDLE;
+            bool            m_depth_prepass_enabled   = false;
+
+            [[nodiscard]] VkPipeline currentPipeline() const
+            {
+                return m_depth_prepass_enabled ? m_depth_equal_pipeline : m_pipeline;
+            }
+
+            // 与draw无关的set每个pass只绑定一次
+            void bindGlobalDescriptorSets(VkCommandBuffer command_buffer);
 
             void drawSingleThread(VkCommandBuffer &command_buffer, VkCommandBufferInheritanceInfo &inheritance_info,
                                   uint32_t submesh_start_index, uint32_t submesh_end_index);
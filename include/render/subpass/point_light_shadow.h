@@ -0,0 +1,65 @@
+//
+// Created by kyrosz7u on 2023/7/20.
+//
+
+#ifndef XEXAMPLE_POINT_LIGHT_SHADOW_H
+#define XEXAMPLE_POINT_LIGHT_SHADOW_H
+
+#include "subpass_base.h"
+#include "render/resource/render_mesh.h"
+
+namespace RenderSystem
+{
+    namespace SubPass
+    {
+        struct PointLightShadowPassInitInfo : public SubPassInitInfo
+        {
+        };
+
+        // 通过multiview一次绘制cube的六个面，renderpass的viewMask决定视图数量
+        class PointLightShadowPass : public SubPassBase
+        {
+        public:
+            enum _point_light_shadow_pass_pipeline_layout_define
+            {
+                _point_shadow_layout = 0,
+                _pipeline_layout_count
+            };
+
+            PointLightShadowPass()
+            {
+                name = "point_light_shadow_subpass";
+                m_descriptor_set_layouts.resize(_pipeline_layout_count);
+            }
+
+            void draw() override;
+
+            void updateGlobalRenderDescriptorSet();
+
+            void updateAfterSwapchainRecreate() override;
+
+            // 本次绘制的光源在阴影cube array中的序号
+            void setShadowIndex(uint32_t shadow_index)
+            {
+                m_shadow_index = shadow_index;
+            }
+
+        private:
+            void initialize(SubPassInitInfo *subPassInitInfo) override;
+
+            void setupPipeLineLayout();
+
+            void setupDescriptorSet() override;
+
+            void setupPipelines() override;
+
+            // 包围盒与光源照射范围(球)不相交的物体不绘制
+            [[nodiscard]] bool isMeshInLightRange(const RenderMesh &mesh) const;
+
+            VkDescriptorSet m_point_shadow_ubo_descriptor_set = VK_NULL_HANDLE;
+            uint32_t        m_shadow_index                    = 0;
+        };
+    }
+}
+
+#endif //XEXAMPLE_POINT_LIGHT_SHADOW_H
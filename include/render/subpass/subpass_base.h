@@ -38,12 +38,21 @@ namespace RenderSystem
             VkDescriptorSet       descriptor_set;
         };
 
+        // dynamic rendering下pipeline不绑定render pass，只声明所在pass实例的附件格式
+        struct RenderingAttachmentFormats
+        {
+            std::vector<VkFormat> color_formats;
+            VkFormat              depth_format{VK_FORMAT_UNDEFINED};
+        };
+
         struct SubPassInitInfo
         {
-            RenderCommandInfo        *p_render_command_info;
-            RenderGlobalResourceInfo *p_render_resource_info;
-            uint32_t                 subpass_index;
-            VkRenderPass             renderpass;
+            RenderCommandInfo          *p_render_command_info;
+            RenderGlobalResourceInfo   *p_render_resource_info;
+            uint32_t                   subpass_index;
+            // 为VK_NULL_HANDLE时使用dynamic rendering，pipeline按rendering_formats创建
+            VkRenderPass               renderpass;
+            RenderingAttachmentFormats rendering_formats;
         };
 
         class SubPassBase
@@ -100,11 +109,45 @@ namespace RenderSystem
             virtual void setupPipelines()
             {}
 
+            // 有render pass时绑定到其中的subpass，否则通过pNext声明dynamic rendering的附件格式
+            void setupPipelineRenderingTarget(VkGraphicsPipelineCreateInfo &pipeline_create_info)
+            {
+                if (m_renderpass != VK_NULL_HANDLE)
+                {
+                    pipeline_create_info.renderPass = m_renderpass;
+                    pipeline_create_info.subpass    = m_subpass_index;
+                    return;
+                }
+
+                m_pipeline_rendering_create_info = {};
+                m_pipeline_rendering_create_info.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+                m_pipeline_rendering_create_info.colorAttachmentCount    =
+                        static_cast<uint32_t>(m_rendering_formats.color_formats.size());
+                m_pipeline_rendering_create_info.pColorAttachmentFormats = m_rendering_formats.color_formats.data();
+                m_pipeline_rendering_create_info.depthAttachmentFormat   = m_rendering_formats.depth_format;
+                pipeline_create_info.pNext      = &m_pipeline_rendering_create_info;
+                pipeline_create_info.renderPass = VK_NULL_HANDLE;
+                pipeline_create_info.subpass    = 0;
+            }
+
+            // 复用时secondary command buffer会被多次提交而不重新begin，需要SIMULTANEOUS_USE
+            [[nodiscard]] VkCommandBufferUsageFlags secondaryCommandBufferUsage() const
+            {
+                VkCommandBufferUsageFlags usage = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                if (m_p_render_resource_info->reuse_secondary_command_buffers)
+                {
+                    usage |= VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+                }
+                return usage;
+            }
+
             RenderCommandInfo        *m_p_render_command_info  = nullptr;
             RenderGlobalResourceInfo *m_p_render_resource_info = nullptr;
 
             VkRenderPass                            m_renderpass    = VK_NULL_HANDLE;
             uint32_t                                m_subpass_index = VK_SUBPASS_EXTERNAL;
+            RenderingAttachmentFormats              m_rendering_formats;
+            VkPipelineRenderingCreateInfoKHR        m_pipeline_rendering_create_info{};
             VkPipelineLayout                   pipeline_layout = VK_NULL_HANDLE;
             VkPipeline                         m_pipeline      = VK_NULL_HANDLE;
 //            std::vector<DescriptorSet>              m_descriptorset_list;
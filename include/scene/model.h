@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
 
 using namespace RenderSystem;
 
@@ -22,6 +23,8 @@ namespace Scene
         std::string name;
         std::string path;
         Transform   transform;
+        // 静态模型的阴影缓存在光源和静态物体集合不变时复用
+        bool        is_static{false};
     public:
         Model()
         {}
@@ -33,6 +36,13 @@ namespace Scene
 
         bool LoadModelFile(const std::string &model_path, const std::string &model_name);
 
+        // 加载离线烘焙的.xmesh文件，顶点数据在ToGPU时直接从文件映射上传
+        bool LoadCookedFile(const std::string &cooked_path, const std::string &model_name);
+
+        // 只在CPU端导入模型并写出.xmesh文件，不需要vulkan设备
+        bool CookModelFile(const std::string &model_path, const std::string &model_name,
+                           const std::string &cooked_path);
+
         void ToGPU()
         {
             mesh_loaded->ToGPU();
@@ -40,7 +50,7 @@ namespace Scene
 
         void SetMeshIndex(uint32_t index)
         {
-            mesh_loaded->m_index_in_dynamic_buffer = index;
+            mesh_loaded->m_index_in_model_buffer = index;
         }
 
         [[nodiscard]]inline const Matrix4x4 &GetModelMatrix() const
@@ -63,14 +73,60 @@ namespace Scene
             return textures_loaded;
         }
 
+        [[nodiscard]]inline const Vector3 &GetBoundingMin() const
+        {
+            return mesh_loaded->m_bounding_min;
+        }
+
+        [[nodiscard]]inline const Vector3 &GetBoundingMax() const
+        {
+            return mesh_loaded->m_bounding_max;
+        }
+
     private:
+        friend class ModelLoader;
+
+        // 单个aiMesh在合并后的顶点/索引数组中的位置
+        struct MeshRange
+        {
+            const aiMesh *mesh;
+            uint32_t     vertex_offset;
+            uint32_t     index_offset;
+            uint32_t     index_count;
+            std::string  material_name;
+            // 简化生成的LOD区间，lods[0]为原始区间
+            uint32_t     lod_count;
+            std::array<RenderSystem::RenderSubmeshLod, RenderSystem::kMaxMeshLodCount> lods;
+            // LOD0的meshlet区间
+            uint32_t     meshlet_offset;
+            uint32_t     meshlet_count;
+        };
+
+        static const aiScene *importScene(Assimp::Importer &importer, const std::string &model_path);
+
+        bool importCookedFile(const std::string &cooked_path, const std::string &model_name);
+
         void processModelNode(aiNode *node, const aiScene *scene);
 
-        void processMesh(aiMesh *mesh, const aiScene *scene);
+        void prepareMeshStorage();
+
+        // 转换完成后做vertex cache/overdraw/vertex fetch优化并生成LOD，烘焙和直接加载共用
+        void optimizeMesh();
+
+        static void convertMeshVertices(const MeshRange &range, RenderSystem::RenderMesh &mesh,
+                                        uint32_t vertex_begin, uint32_t vertex_end);
+
+        static void convertMeshIndices(const MeshRange &range, RenderSystem::RenderMesh &mesh);
+
+        std::string getMaterialTexturePath(const std::string &material_name) const;
+
+        void setupSubmeshes(const std::map<std::string, TextureImagePtr> *decoded_images);
 
         uint32_t                                 m_index_count{0};
+        uint32_t                                 m_vertex_count{0};
         Matrix4x4                                model_matrix  = Matrix4x4::IDENTITY;
         Matrix4x4                                normal_matrix = Matrix4x4::IDENTITY;
+        std::vector<MeshRange>                   m_mesh_ranges;
         std::vector<RenderSystem::RenderSubmesh> m_submeshes;
         RenderMeshPtr                            mesh_loaded;
         std::vector<Texture2DPtr>                textures_loaded;
@@ -0,0 +1,47 @@
+//
+// Created by kyrosz7u on 2023/7/2.
+//
+
+#ifndef XEXAMPLE_MODEL_LOADER_H
+#define XEXAMPLE_MODEL_LOADER_H
+
+#include "scene/model.h"
+#include "core/threadpool.h"
+#include <vector>
+#include <string>
+#include <functional>
+
+namespace Scene
+{
+    struct ModelLoadInfo
+    {
+        std::string path;
+        std::string name;
+        // 存在时优先加载烘焙后的.xmesh文件，跳过assimp
+        std::string cooked_path;
+    };
+
+    // 批量加载模型：assimp导入、顶点转换和纹理解码都在线程池中并行执行，
+    // 纹理的GPU上传仍然在调用线程中完成
+    class ModelLoader
+    {
+    public:
+        explicit ModelLoader(uint32_t thread_count = std::thread::hardware_concurrency());
+
+        ~ModelLoader()
+        {}
+
+        bool LoadModelFiles(const std::vector<ModelLoadInfo> &load_infos, std::vector<Model> &models);
+
+    private:
+        // 单个aiMesh超过该顶点数时拆分成多个转换任务
+        static constexpr uint32_t kVertexBatchSize = 16384;
+
+        ThreadPool m_thread_pool;
+        uint32_t   m_next_thread{0};
+
+        void addJob(std::function<void()> job);
+    };
+}
+
+#endif //XEXAMPLE_MODEL_LOADER_H
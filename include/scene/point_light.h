@@ -0,0 +1,29 @@
+//
+// Created by kyrosz7u on 2023/7/19.
+//
+
+#include "core/math/math.h"
+#include "transform.h"
+
+#ifndef XEXAMPLE_POINT_LIGHT_H
+#define XEXAMPLE_POINT_LIGHT_H
+namespace Scene
+{
+    // 点光源，只照亮radius以内的区域
+    class PointLight
+    {
+    public:
+        float intensity{1.0f};
+        float radius{10.0f};
+        // 阴影cube array容量有限，按添加顺序分配，超出的光源不投射阴影
+        bool cast_shadow{false};
+        Math::Color color;
+        Transform transform;
+
+    public:
+        PointLight() {}
+        ~PointLight() {}
+    };
+}
+
+#endif //XEXAMPLE_POINT_LIGHT_H
@@ -1,8 +1,11 @@
 #include "scene/model.h"
 #include "scene/camera.h"
 #include "scene/direction_light.h"
+#include "scene/point_light.h"
+#include "scene/spot_light.h"
 #include "render/forward_render.h"
 #include "render/defer_render.h"
+#include "render/resource/render_texture_residency.h"
 #include "camera.h"
 #include <memory>
 
@@ -29,15 +32,33 @@ namespace Scene
             m_directional_lights.push_back(light);
         }
 
+        void AddLight(PointLight light)
+        {
+            m_point_lights.push_back(light);
+        }
+
+        void AddLight(SpotLight light)
+        {
+            m_spot_lights.push_back(light);
+        }
+
         void LoadSkybox(const std::vector<std::string> &pathes)
         {
-            m_skybox = std::make_shared<TextureCube>(pathes, "skybox");
+            m_skybox = std::make_shared<TextureCube>(pathes, "skybox", true);
         }
 
+        // 帧节奏控制，必须在InputSystem.Tick之前调用
+        void BeginFrame();
+
         void Tick();
     private:
         friend class Camera;
 
+        // 简化误差投影到屏幕后允许的像素数
+        static constexpr float    kLodPixelError = 1.0f;
+        // 阴影pass在主相机层级基础上再降低的LOD级数
+        static constexpr uint32_t kShadowLodBias = 1;
+
         std::shared_ptr<RenderBase>        m_render;
         UIOverlayPtr                       m_ui_overlay;
         // models
@@ -46,12 +67,17 @@ namespace Scene
         std::vector<RenderSubmesh>         m_visible_submeshes;
         // texture
         std::vector<Texture2DPtr>          m_visible_textures;
+        TextureResidencyManager            m_texture_residency;
         std::shared_ptr<TextureCube>       m_skybox;
         // scence ubo
         std::shared_ptr<Camera>            m_main_camera;
         std::vector<Scene::DirectionLight> m_directional_lights;
+        std::vector<Scene::PointLight>     m_point_lights;
+        std::vector<Scene::SpotLight>      m_spot_lights;
 
         void updateScene();
+
+        static uint32_t selectLod(const RenderSubmesh &submesh, float screen_extent);
     };
 }
 
@@ -0,0 +1,31 @@
+//
+// Created by kyrosz7u on 2023/7/19.
+//
+
+#include "core/math/math.h"
+#include "transform.h"
+
+#ifndef XEXAMPLE_SPOT_LIGHT_H
+#define XEXAMPLE_SPOT_LIGHT_H
+namespace Scene
+{
+    // 聚光灯，沿transform的forward方向照射，角度为半角(度)
+    class SpotLight
+    {
+    public:
+        float intensity{1.0f};
+        float radius{10.0f};
+        // 与点光源共用阴影cube array，排在所有点光源之后分配
+        bool cast_shadow{false};
+        float inner_angle{20.0f};
+        float outer_angle{30.0f};
+        Math::Color color;
+        Transform transform;
+
+    public:
+        SpotLight() {}
+        ~SpotLight() {}
+    };
+}
+
+#endif //XEXAMPLE_SPOT_LIGHT_H
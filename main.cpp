@@ -2,6 +2,7 @@
 #include "core/window/glfw_window.h"
 #include "scene/camera.h"
 #include "scene/model.h"
+#include "scene/model_loader.h"
 #include "scene/scene_manager.h"
 #include "render/resource/render_mesh.h"
 #include "input/input_system.h"
@@ -17,27 +18,41 @@ int main()
     InputSystem.initialize(window);
     RenderBase::setupGlobally(window->getWindowHandler());
 
-    Scene::Model model;
-
     auto scene_manager = std::make_shared<Scene::SceneManager>();
 
-    model.LoadModelFile("assets/models/Kong.fbx","Kong");
-    model.ToGPU();
-    scene_manager->AddModel(model);
+    // 模型导入、顶点转换和纹理解码在线程池中并行完成
+    std::vector<Scene::Model> models;
+    Scene::ModelLoader        model_loader;
+    // 优先使用XMeshCooker生成的assets/cooked/*.xmesh
+    if (!model_loader.LoadModelFiles({{"assets/models/Kong.fbx",    "Kong",    "assets/cooked/Kong.fbx.xmesh"},
+                                      {"assets/models/capsule.obj", "capsule", "assets/cooked/capsule.obj.xmesh"},
+                                      {"assets/models/plane.obj",   "plane",   "assets/cooked/plane.obj.xmesh"}}, models))
+    {
+        LOG_ERROR("failed to load scene models")
+        models.clear();
+        scene_manager.reset();
+        RenderBase::clearGlobally();
+        return -1;
+    }
 
-//    mainCamera.m_render->loadSingleMesh(model.mesh_loaded);
-    model.LoadModelFile("assets/models/capsule.obj", "capsule");
-    model.transform.position = Math::Vector3(10, 10, 0);
-    model.transform.scale= Math::Vector3(8.0f, 10.0f, 12.0f);
-//    model.transform.rotation = Math::Vector3(90, 0, 0);
-    model.ToGPU();
-    scene_manager->AddModel(model);
+    auto &kong = models[0];
+    kong.is_static = true;
+    kong.ToGPU();
+    scene_manager->AddModel(kong);
 
-    model.LoadModelFile("assets/models/plane.obj", "plane");
-    model.transform.position = Math::Vector3(0, 0, 0);
-    model.transform.scale    = Math::Vector3(6.0f, 1.0f, 6.0f);
-    model.ToGPU();
-    scene_manager->AddModel(model);
+    auto &capsule = models[1];
+    capsule.transform.position = Math::Vector3(10, 10, 0);
+    capsule.transform.scale    = Math::Vector3(8.0f, 10.0f, 12.0f);
+//    capsule.transform.rotation = Math::Vector3(90, 0, 0);
+    capsule.ToGPU();
+    scene_manager->AddModel(capsule);
+
+    auto &plane = models[2];
+    plane.transform.position = Math::Vector3(0, 0, 0);
+    plane.transform.scale    = Math::Vector3(6.0f, 1.0f, 6.0f);
+    plane.is_static          = true;
+    plane.ToGPU();
+    scene_manager->AddModel(plane);
 
     // +X，-X，+Y，-Y，+Z，-Z
     std::vector<std::string> skybox_faces = {
@@ -57,11 +72,43 @@ int main()
     light.color     = Color(1, float(244) / 255, float(214) / 255, 1.0f);
     scene_manager->AddLight(light);
 
+    // 地面上方均匀分布的点光源，光照通过分簇剔除只计算影响到的片元
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int j = 0; j < 16; ++j)
+        {
+            Scene::PointLight point_light;
+            point_light.intensity = 4.0f;
+            point_light.radius    = 6.0f;
+            point_light.color     = Color(0.5f + 0.5f * float(i % 2), 0.5f + 0.5f * float(j % 2),
+                                          0.5f + 0.5f * float((i + j) % 3 == 0), 1.0f);
+            point_light.transform.position = Math::Vector3(-30.0f + 4.0f * i, 1.5f, -30.0f + 4.0f * j);
+            // 场景中心的两个点光源投射阴影
+            point_light.cast_shadow        = i == 7 && (j == 7 || j == 8);
+            scene_manager->AddLight(point_light);
+        }
+    }
+
+    Scene::SpotLight spot_light;
+    spot_light.intensity   = 20.0f;
+    spot_light.radius      = 30.0f;
+    spot_light.color       = Color(1.0f, 1.0f, 1.0f, 1.0f);
+    spot_light.cast_shadow = true;
+    spot_light.transform   = Transform(Math::Vector3(0, 20, -10), Math::EulerAngle(60, 0, 0), Math::Vector3(1, 1, 1));
+    scene_manager->AddLight(spot_light);
+
     scene_manager->PostInitialize();
     while (!window->shouldClose())
     {
+        scene_manager->BeginFrame();
         InputSystem.Tick();
         scene_manager->Tick();
     }
+
+    // mesh和纹理析构时把GPU资源登记到延迟删除队列，先释放场景和模型，
+    // 再清理context，登记的资源才会被真正销毁
+    models.clear();
+    scene_manager.reset();
+    RenderBase::clearGlobally();
     return 0;
 }
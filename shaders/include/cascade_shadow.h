@@ -0,0 +1,43 @@
+// 平行光级联阴影采样
+// 使用前需声明shadow_cascade_count、light_proj_stride、directional_light_proj_rows和directional_light_shadowmap
+// light_proj按dynamic buffer的对齐间隔存放，每个级联占light_proj_stride个vec4，前4个为矩阵的行，第5个为图集中的uv区间
+
+highp vec4 directional_light_project(highp int layer, highp vec3 world_pos)
+{
+    highp int  base = layer * light_proj_stride;
+    highp vec4 pos  = vec4(world_pos, 1.0);
+    return vec4(dot(directional_light_proj_rows[base + 0], pos),
+                dot(directional_light_proj_rows[base + 1], pos),
+                dot(directional_light_proj_rows[base + 2], pos),
+                dot(directional_light_proj_rows[base + 3], pos));
+}
+
+// xy为tile在图集中的起点，zw为tile的尺寸
+highp vec4 directional_light_atlas_rect(highp int layer)
+{
+    return directional_light_proj_rows[layer * light_proj_stride + 4];
+}
+
+// 级联从近到远排列，取第一个完整覆盖该点的级联；所有级联都不覆盖时视为不在阴影中
+highp float calculate_visibility(highp vec3 world_pos, highp int light_index)
+{
+    for (highp int cascade = 0; cascade < shadow_cascade_count; ++cascade)
+    {
+        highp int  layer               = light_index * shadow_cascade_count + cascade;
+        highp vec4 light_space_pos     = directional_light_project(layer, world_pos);
+        highp vec3 light_space_pos_ndc = light_space_pos.xyz / light_space_pos.w;
+
+        // 留出少量边界，避免在级联边缘采样到相邻的tile
+        if (any(greaterThan(abs(light_space_pos_ndc.xy), vec2(0.98))) ||
+            light_space_pos_ndc.z >= 1.0 || light_space_pos_ndc.z <= 0.0)
+        {
+            continue;
+        }
+
+        highp vec4  atlas_rect         = directional_light_atlas_rect(layer);
+        highp vec2  light_space_pos_uv = atlas_rect.xy + (light_space_pos_ndc.xy * 0.5 + 0.5) * atlas_rect.zw;
+        highp float light_space_depth  = texture(directional_light_shadowmap, light_space_pos_uv).r;
+        return light_space_depth < light_space_pos_ndc.z - 0.005 ? 0.0 : 1.0;
+    }
+    return 1.0;
+}
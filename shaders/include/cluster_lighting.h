@@ -0,0 +1,75 @@
+// 分簇光照：片元只遍历所在cluster的点光源和聚光灯
+// 使用前需声明view_depth_row、cluster_depth_scale、cluster_depth_bias、inv_screen_width、inv_screen_height、
+// local_light_number、local_lights、cluster_light_count、cluster_light_index和point_light_shadowmap
+
+highp uint get_cluster_index(highp vec2 frag_coord, highp vec3 world_pos)
+{
+    highp float view_depth = dot(view_depth_row, vec4(world_pos, 1.0));
+    highp float slice      = log(max(view_depth, 0.0001)) * cluster_depth_scale + cluster_depth_bias;
+    highp vec2  tile       = frag_coord * vec2(inv_screen_width, inv_screen_height) *
+                             vec2(float(CLUSTER_GRID_X), float(CLUSTER_GRID_Y));
+
+    highp uint cluster_x = uint(clamp(tile.x, 0.0, float(CLUSTER_GRID_X - 1u)));
+    highp uint cluster_y = uint(clamp(tile.y, 0.0, float(CLUSTER_GRID_Y - 1u)));
+    highp uint cluster_z = uint(clamp(slice, 0.0, float(CLUSTER_GRID_Z - 1u)));
+    return (cluster_z * CLUSTER_GRID_Y + cluster_y) * CLUSTER_GRID_X + cluster_x;
+}
+
+// 距离衰减在radius处平滑降为0，聚光灯在内外锥角之间过渡
+highp float local_light_attenuation(LocalLight light, highp vec3 light_vector)
+{
+    highp float distance2   = dot(light_vector, light_vector);
+    highp float ratio2      = distance2 / (light.radius * light.radius);
+    highp float window      = clamp(1.0 - ratio2 * ratio2, 0.0, 1.0);
+    highp float attenuation = window * window / (distance2 + 1.0);
+    if (light.type == LOCAL_LIGHT_SPOT)
+    {
+        highp float cos_angle = dot(-normalize(light_vector), light.direction);
+        attenuation *= smoothstep(light.spot_outer_cos, light.spot_inner_cos, cos_angle);
+    }
+    return attenuation;
+}
+
+// cube阴影中保存的是到光源的距离除以radius，沿光源到片元的方向采样
+highp float local_light_visibility(LocalLight light, highp vec3 light_vector)
+{
+    if (light.shadow_index < 0)
+    {
+        return 1.0;
+    }
+
+    highp float depth        = length(light_vector) / light.radius;
+    highp float shadow_depth = texture(point_light_shadowmap, vec4(-light_vector, float(light.shadow_index))).r;
+    return shadow_depth < depth - 0.01 ? 0.0 : 1.0;
+}
+
+highp vec3 calculate_local_lighting(highp vec2 frag_coord, highp vec3 world_pos, highp vec3 normal,
+                                    highp vec3 view_dir, highp vec3 albedo)
+{
+    highp vec3 color = vec3(0.0, 0.0, 0.0);
+    if (local_light_number == 0)
+    {
+        return color;
+    }
+
+    highp uint cluster     = get_cluster_index(frag_coord, world_pos);
+    highp uint light_count = min(cluster_light_count[cluster], MAX_LIGHTS_PER_CLUSTER);
+    for (highp uint i = 0u; i < light_count; ++i)
+    {
+        LocalLight  light        = local_lights[cluster_light_index[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+        highp vec3  light_vector = light.position - world_pos;
+        highp vec3  light_dir    = normalize(light_vector);
+        highp float NdotL        = max(dot(normal, light_dir), 0.0);
+        if (NdotL <= 0.0)
+        {
+            continue;
+        }
+
+        highp vec3 radiance = light.color * light.intensity * local_light_attenuation(light, light_vector) *
+                              local_light_visibility(light, light_vector);
+        highp vec3 half_dir = normalize(light_dir + view_dir);
+        color += 0.6 * albedo * radiance * NdotL;
+        color += 0.4 * radiance * pow(max(dot(normal, half_dir), 0.0), 8.0);
+    }
+    return color;
+}
@@ -1,63 +1,90 @@
-struct PGBufferData
-{
-    highp vec3  worldNormal;
-    highp vec3  baseColor;
-    highp float metallic;
-    highp float specular;
-    highp float roughness;
-    highp uint  shadingModelID;
-};
-
-#define SHADINGMODELID_UNLIT 0U
-#define SHADINGMODELID_DEFAULT_LIT 1U
-
-highp vec3 EncodeNormal(highp vec3 N) { return N * 0.5 + 0.5; }
-
-highp vec3 DecodeNormal(highp vec3 N) { return N * 2.0 - 1.0; }
-
-highp vec3 EncodeBaseColor(highp vec3 baseColor)
-{
-    // we use sRGB on the render target to give more precision to the darks
-    return baseColor;
-}
-
-highp vec3 DecodeBaseColor(highp vec3 baseColor)
-{
-    // we use sRGB on the render target to give more precision to the darks
-    return baseColor;
-}
-
-highp float EncodeShadingModelId(highp uint ShadingModelId)
-{
-    highp uint Value = ShadingModelId;
-    return (float(Value) / float(255));
-}
-
-highp uint DecodeShadingModelId(highp float InPackedChannel) { return uint(round(InPackedChannel * float(255))); }
-
-void EncodeGBufferData(PGBufferData   InGBuffer,
-                       out highp vec4 OutGBufferA,
-                       out highp vec4 OutGBufferB,
-                       out highp vec4 OutGBufferC)
-{
-    OutGBufferA.rgb = EncodeNormal(InGBuffer.worldNormal);
-
-    OutGBufferB.r = InGBuffer.metallic;
-    OutGBufferB.g = InGBuffer.specular;
-    OutGBufferB.b = InGBuffer.roughness;
-    OutGBufferB.a = EncodeShadingModelId(InGBuffer.shadingModelID);
-
-    OutGBufferC.rgb = EncodeBaseColor(InGBuffer.baseColor);
-}
-
-void DecodeGBufferData(out PGBufferData OutGBuffer, highp vec4 InGBufferA, highp vec4 InGBufferB, highp vec4 InGBufferC)
-{
-    OutGBuffer.worldNormal = DecodeNormal(InGBufferA.xyz);
-
-    OutGBuffer.metallic       = InGBufferB.r;
-    OutGBuffer.specular       = InGBufferB.g;
-    OutGBuffer.roughness      = InGBufferB.b;
-    OutGBuffer.shadingModelID = DecodeShadingModelId(InGBufferB.a);
-
-    OutGBuffer.baseColor = DecodeBaseColor(InGBufferC.rgb);
+struct PGBufferData
+{
+    highp vec3  worldNormal;
+    highp vec3  baseColor;
+    highp float metallic;
+    highp float specular;
+    highp float roughness;
+    highp uint  shadingModelID;
+};
+
+#define SHADINGMODELID_UNLIT 0U
+#define SHADINGMODELID_DEFAULT_LIT 1U
+
+highp vec3 EncodeNormal(highp vec3 N) { return N * 0.5 + 0.5; }
+
+highp vec3 DecodeNormal(highp vec3 N) { return N * 2.0 - 1.0; }
+
+// 八面体编码：单位法线投影到八面体再展开到[-1, 1]^2，两个通道即可保存
+highp vec2 OctahedronWrap(highp vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+highp vec2 EncodeNormalOctahedron(highp vec3 N)
+{
+    N /= abs(N.x) + abs(N.y) + abs(N.z);
+    return N.z >= 0.0 ? N.xy : OctahedronWrap(N.xy);
+}
+
+highp vec3 DecodeNormalOctahedron(highp vec2 F)
+{
+    highp vec3  N = vec3(F.x, F.y, 1.0 - abs(F.x) - abs(F.y));
+    highp float t = clamp(-N.z, 0.0, 1.0);
+    N.xy += vec2(N.x >= 0.0 ? -t : t, N.y >= 0.0 ? -t : t);
+    return normalize(N);
+}
+
+// 由屏幕坐标和深度缓冲的值重建世界坐标，depth为[0, 1]
+highp vec3 ReconstructWorldPosition(highp vec2 screen_uv, highp float depth, highp mat4 inv_proj_view)
+{
+    highp vec4 position = inv_proj_view * vec4(screen_uv * 2.0 - 1.0, depth, 1.0);
+    return position.xyz / position.w;
+}
+
+highp vec3 EncodeBaseColor(highp vec3 baseColor)
+{
+    // we use sRGB on the render target to give more precision to the darks
+    return baseColor;
+}
+
+highp vec3 DecodeBaseColor(highp vec3 baseColor)
+{
+    // we use sRGB on the render target to give more precision to the darks
+    return baseColor;
+}
+
+highp float EncodeShadingModelId(highp uint ShadingModelId)
+{
+    highp uint Value = ShadingModelId;
+    return (float(Value) / float(255));
+}
+
+highp uint DecodeShadingModelId(highp float InPackedChannel) { return uint(round(InPackedChannel * float(255))); }
+
+void EncodeGBufferData(PGBufferData   InGBuffer,
+                       out highp vec4 OutGBufferA,
+                       out highp vec4 OutGBufferB,
+                       out highp vec4 OutGBufferC)
+{
+    OutGBufferA.rgb = EncodeNormal(InGBuffer.worldNormal);
+
+    OutGBufferB.r = InGBuffer.metallic;
+    OutGBufferB.g = InGBuffer.specular;
+    OutGBufferB.b = InGBuffer.roughness;
+    OutGBufferB.a = EncodeShadingModelId(InGBuffer.shadingModelID);
+
+    OutGBufferC.rgb = EncodeBaseColor(InGBuffer.baseColor);
+}
+
+void DecodeGBufferData(out PGBufferData OutGBuffer, highp vec4 InGBufferA, highp vec4 InGBufferB, highp vec4 InGBufferC)
+{
+    OutGBuffer.worldNormal = DecodeNormal(InGBufferA.xyz);
+
+    OutGBuffer.metallic       = InGBufferB.r;
+    OutGBuffer.specular       = InGBufferB.g;
+    OutGBuffer.roughness      = InGBufferB.b;
+    OutGBuffer.shadingModelID = DecodeShadingModelId(InGBufferB.a);
+
+    OutGBuffer.baseColor = DecodeBaseColor(InGBufferC.rgb);
 }
\ No newline at end of file
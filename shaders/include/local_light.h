@@ -0,0 +1,24 @@
+// 点光源和聚光灯的定义，与render_common.h中的VulkanLocalLightDefine和render_light_cluster.h一致
+
+#define CLUSTER_GRID_X 16u
+#define CLUSTER_GRID_Y 9u
+#define CLUSTER_GRID_Z 24u
+#define MAX_LIGHTS_PER_CLUSTER 128u
+
+#define LOCAL_LIGHT_POINT 0u
+#define LOCAL_LIGHT_SPOT 1u
+
+struct LocalLight
+{
+    highp vec3  position;
+    highp float radius;
+    highp vec3  color;
+    highp float intensity;
+    highp vec3  direction;
+    highp float spot_outer_cos;
+    highp float spot_inner_cos;
+    highp uint  type;
+    // 在point_light_shadowmap中的cube序号，-1表示不投射阴影
+    highp int   shadow_index;
+    highp float _padding;
+};
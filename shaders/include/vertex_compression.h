@@ -0,0 +1,19 @@
+// 与render_mesh.cpp中VulkanMeshVertexNormal::Encode的编码对应
+
+vec3 octahedral_decode(vec2 encoded)
+{
+    vec3 direction = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0)
+    {
+        direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(direction);
+}
+
+// tangent.y被映射到[1,32767]并乘以手性
+vec4 tangent_decode(vec2 encoded)
+{
+    float handedness = encoded.y < 0.0 ? -1.0 : 1.0;
+    float y          = (abs(encoded.y) * 32767.0 - 1.0) / 32766.0 * 2.0 - 1.0;
+    return vec4(octahedral_decode(vec2(encoded.x, y)), handedness);
+}
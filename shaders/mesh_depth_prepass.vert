@@ -0,0 +1,32 @@
+#version 310 es
+
+layout(set=0,binding = 0,row_major) uniform _per_frame_ubo_data
+{
+    mat4 camera_proj_view;
+};
+
+struct ModelData
+{
+    highp mat4 model_matrix;
+    highp mat4 normal_matrix;
+};
+
+layout(std430,set=0,binding=1,row_major) readonly buffer _per_object_data
+{
+    ModelData models[];
+};
+
+layout(push_constant) uniform _draw_constants
+{
+    highp uint model_index;
+};
+
+layout(location=0) in vec3 in_position;
+
+// 与mesh_forward.vert的计算保持一致，光照pass的EQUAL深度测试依赖两者输出完全相同
+invariant gl_Position;
+
+void main()
+{
+    gl_Position =  camera_proj_view * models[model_index].model_matrix * vec4(in_position, 1.0);
+}
\ No newline at end of file
@@ -1,18 +1,26 @@
 #version 450
 
-layout(set=0,binding=0,row_major) uniform _per_light_project_ubo_data
+struct ModelData
 {
-    mat4 project_matrix;
+    mat4 model_matrix;
+    mat4 normal_matrix;
 };
 
-layout(set=0,binding=1,row_major) uniform _per_object_ubo_data
+layout(std430,set=0,binding=0,row_major) readonly buffer _per_object_data
 {
-    mat4 model_matrix;
+    ModelData models[];
+};
+
+// project_matrix只在切换图集tile时更新
+layout(push_constant,row_major) uniform _shadow_draw_constants
+{
+    mat4 project_matrix;
+    uint model_index;
 };
 
 layout(location=0) in vec3 in_position;
 
 void main()
 {
-    gl_Position = project_matrix * model_matrix * vec4(in_position,1.0);
+    gl_Position = project_matrix * models[model_index].model_matrix * vec4(in_position,1.0);
 }
\ No newline at end of file
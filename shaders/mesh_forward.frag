@@ -1,8 +1,12 @@
 #version 310 es
 
 #extension GL_GOOGLE_include_directive: enable
+#extension GL_EXT_texture_cube_map_array: enable
 
 #define m_max_direction_light_count 16
+#define m_max_shadow_cascade_count 4
+
+#include "local_light.h"
 
 struct DirectionalLight
 {
@@ -16,6 +20,14 @@ layout (set = 0, binding = 0, row_major) uniform _per_frame_ubo_data
     highp mat4 camera_proj_view;
     highp vec3 camera_pos;
     highp int directional_light_number;
+    highp int shadow_cascade_count;
+    highp int light_proj_stride;
+    highp int local_light_number;
+    highp vec4 view_depth_row;
+    highp float cluster_depth_scale;
+    highp float cluster_depth_bias;
+    highp float inv_screen_width;
+    highp float inv_screen_height;
 };
 
 layout (set = 0, binding = 2) uniform _directional_light
@@ -23,47 +35,42 @@ layout (set = 0, binding = 2) uniform _directional_light
     DirectionalLight directional_light[m_max_direction_light_count];
 };
 
-layout (set = 0, binding = 3, row_major) uniform _directional_light_projection
+layout (set = 0, binding = 3) uniform _directional_light_projection
 {
-    highp mat4 directional_light_proj[m_max_direction_light_count];
+    // 每个级联占16个vec4(256字节对齐时)，实际间隔为light_proj_stride；前4个为矩阵，第5个为图集uv区间
+    highp vec4 directional_light_proj_rows[m_max_direction_light_count * m_max_shadow_cascade_count * 16];
 };
 
 
 layout (set = 1, binding = 0) uniform sampler2D base_color_texture_sampler;
 
-layout (set = 2, binding = 0) uniform highp sampler2DArray directional_light_shadowmap_array;
+layout (set = 2, binding = 0) uniform highp sampler2D directional_light_shadowmap;
+layout (set = 2, binding = 1) uniform highp samplerCubeArray point_light_shadowmap;
 
-layout (location = 0) in highp vec3 world_pos;
-layout (location = 1) in highp vec3 normal;
-layout (location = 2) in highp vec4 tangent;
-layout (location = 3) in highp vec2 texcoord;
+layout (std430, set = 0, binding = 4) readonly buffer _local_light_data
+{
+    LocalLight local_lights[];
+};
 
-layout (location = 0) out highp vec4 out_color;
+layout (std430, set = 0, binding = 5) readonly buffer _cluster_light_count
+{
+    highp uint cluster_light_count[];
+};
 
-highp float calculate_visibility(highp vec3 world_pos, highp int light_index)
+layout (std430, set = 0, binding = 6) readonly buffer _cluster_light_index
 {
-    highp vec4 light_space_pos = directional_light_proj[light_index] * vec4(world_pos, 1.0);
-    highp vec3 light_space_pos_ndc = light_space_pos.xyz / light_space_pos.w;
+    highp uint cluster_light_index[];
+};
 
-    if(light_space_pos_ndc.z >= 1.0f || light_space_pos_ndc.z <= 0.0f)
-    {
-        return 1.0f;
-    }
+#include "cascade_shadow.h"
+#include "cluster_lighting.h"
 
-    highp vec3 light_space_pos_uv = light_space_pos_ndc * 0.5 + 0.5;
-    highp vec3 light_space_pos_uv_y_inverted = vec3(light_space_pos_uv.x, light_space_pos_uv.y, float(light_index));
-    highp float light_space_depth = texture(directional_light_shadowmap_array, light_space_pos_uv_y_inverted).r;
-    if(light_space_depth < light_space_pos_ndc.z - 0.005)
-    {
-        return 0.0f;
-    }
-    else
-    {
-        return 1.0f;
-    }
+layout (location = 0) in highp vec3 world_pos;
+layout (location = 1) in highp vec3 normal;
+layout (location = 2) in highp vec4 tangent;
+layout (location = 3) in highp vec2 texcoord;
 
-//    return light_space_depth;
-}
+layout (location = 0) out highp vec4 out_color;
 
 void main()
 {
@@ -99,8 +106,12 @@ void main()
     diffuse_color /= float(directional_light_number);
     specular_color/=float(directional_light_number);
 
+    // 点光源和聚光灯只遍历所在cluster的光源
+    highp vec3 local_color = calculate_local_lighting(gl_FragCoord.xy, world_pos, normalize(normal),
+                                                      normalize(camera_pos - world_pos), diffuse_texture.xyz);
+
 //    out_color = vec4(visibility,0.0f,0.0f,1.0f);
 
-    out_color = vec4(ambient_color+diffuse_color+specular_color, 1.0);
+    out_color = vec4(ambient_color+diffuse_color+specular_color+local_color, 1.0);
 
 }
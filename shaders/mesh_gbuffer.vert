@@ -1,19 +1,34 @@
 #version 450
 
+#extension GL_GOOGLE_include_directive : enable
+
+#include "vertex_compression.h"
+
 layout(set=0,binding = 0,row_major) uniform _per_frame_ubo_data
 {
     mat4 camera_proj_view;
 };
 
-layout(set=0,binding=1,row_major) uniform _per_object_ubo_data
+struct ModelData
+{
+    highp mat4 model_matrix;
+    highp mat4 normal_matrix;
+};
+
+// 所有物体的数据只绑定一次，每次draw通过push constant传入序号
+layout(std430,set=0,binding=1,row_major) readonly buffer _per_object_data
 {
-    mat4 model_matrix;
-    mat4 normal_matrix;
+    ModelData models[];
+};
+
+layout(push_constant) uniform _draw_constants
+{
+    highp uint model_index;
 };
 
 layout(location=0) in vec3 in_position;
-layout(location=1) in vec3 in_normal;
-layout(location=2) in vec4 in_tangent;
+layout(location=1) in vec2 in_normal_encoded;
+layout(location=2) in vec2 in_tangent_encoded;
 layout(location=3) in vec2 in_texCoord;
 
 layout(location=0) out vec3 world_pos;
@@ -23,6 +38,12 @@ layout(location=3) out vec2 texcoord;
 
 void main()
 {
+    highp mat4 model_matrix  = models[model_index].model_matrix;
+    highp mat4 normal_matrix = models[model_index].normal_matrix;
+
+    vec3 in_normal  = octahedral_decode(in_normal_encoded);
+    vec4 in_tangent = tangent_decode(in_tangent_encoded);
+
     world_pos = (model_matrix * vec4(in_position, 1.0)).xyz;
     normal = (normal_matrix*vec4(in_normal,0.0)).xyz;
     tangent = model_matrix *in_tangent;
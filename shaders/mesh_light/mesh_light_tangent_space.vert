@@ -2,6 +2,8 @@
 
 #extension GL_GOOGLE_include_directive : enable
 
+#include "vertex_compression.h"
+
 layout(set=0,binding = 0,row_major) uniform _per_frame_ubo_data
 {
     mat4 proj_view;
@@ -16,8 +18,8 @@ layout(set=0,binding=1,row_major) uniform _per_object_ubo_data
 };
 
 layout(location=0) in vec3 in_position;
-layout(location=1) in vec3 in_normal;
-layout(location=2) in vec4 in_tangent;
+layout(location=1) in vec2 in_normal_encoded;
+layout(location=2) in vec2 in_tangent_encoded;
 layout(location=3) in vec2 in_texCoord;
 
 layout(location=0) out vec3 world_pos;
@@ -27,6 +29,9 @@ layout(location=3) out vec2 texcoord;
 
 void main()
 {
+    vec3 in_normal  = octahedral_decode(in_normal_encoded);
+    vec4 in_tangent = tangent_decode(in_tangent_encoded);
+
     world_pos = (model_matrix * vec4(in_position, 1.0)).xyz;
 
     float model_x1 = length(model_matrix[0].xyz);
@@ -1,37 +1,17 @@
-#version 310 es
+#version 450
 
-#extension GL_GOOGLE_include_directive : enable
-
-// TODO: geometry shader is inefficient for Mali GPU
-#extension GL_EXT_geometry_shader : enable
-
-#include "constants.h"
-
-layout(set = 0, binding = 0) readonly buffer _unused_name_global_set_per_frame_binding_buffer
+layout(set=0,binding=0,row_major) uniform _point_light_shadow_ubo_data
 {
-    uint point_light_count;
-    uint _padding_point_light_count_0;
-    uint _padding_point_light_count_1;
-    uint _padding_point_light_count_2;
-    highp vec4 point_lights_position_and_radius[m_max_point_light_count];
+    mat4 face_proj_view[6];
+    vec3 light_position;
+    float light_radius;
 };
 
-layout(location = 0) in highp float in_inv_length;
-// NOTE: we can't interpolate the length of "position_view_space" directly, otherwise the result is incorrect
-layout(location = 1) in highp vec3 in_inv_length_position_view_space;
-
-layout(location = 0) out highp float out_depth;
+// 光源到片元的向量在世界空间线性插值，长度在片元中计算
+layout(location=0) in vec3 in_light_vector;
 
 void main()
 {
-    // perspective correct interpolation_
-    highp vec3 position_view_space = in_inv_length_position_view_space / in_inv_length;
-
-    highp float point_light_radius = point_lights_position_and_radius[gl_Layer / 2].w;
-
-    highp float ratio = length(position_view_space) / point_light_radius;
-
-    // Trick: we don't write to depth, and thus we can use early depth test
-    gl_FragDepth = ratio;
-    out_depth = ratio;
+    // 深度保存为到光源的距离除以radius，着色时无需知道每个面的投影矩阵
+    gl_FragDepth = length(in_light_vector) / light_radius;
 }
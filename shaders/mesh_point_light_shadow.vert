@@ -1,72 +1,38 @@
-#version 310 es
+#version 450
 
-#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
 
-#include "constants.h"
-#include "structures.h"
+// cube的六个面作为multiview的六个视图，gl_ViewIndex对应cube map的面序号
+layout(set=0,binding=0,row_major) uniform _point_light_shadow_ubo_data
+{
+    mat4 face_proj_view[6];
+    vec3 light_position;
+    float light_radius;
+};
 
-layout(set = 0, binding = 1) readonly buffer _unused_name_per_drawcall
+struct ModelData
 {
-    VulkanMeshInstance mesh_instances[m_mesh_per_drawcall_max_instance_count];
+    highp mat4 model_matrix;
+    highp mat4 normal_matrix;
 };
 
-layout(set = 0, binding = 2) readonly buffer _unused_name_per_drawcall_vertex_blending
+layout(std430,set=0,binding=1,row_major) readonly buffer _per_object_data
 {
-    mat4 joint_matrices[m_mesh_vertex_blending_max_joint_count * m_mesh_per_drawcall_max_instance_count];
+    ModelData models[];
 };
 
-layout(set = 1, binding = 0) readonly buffer _unused_name_per_mesh_joint_binding
+layout(push_constant) uniform _draw_constants
 {
-    VulkanMeshVertexJointBinding indices_and_weights[];
+    highp uint model_index;
 };
 
-layout(location = 0) in highp vec3 in_position;
+layout(location=0) in vec3 in_position;
 
-layout(location = 0) out highp vec3 out_position_world_space;
+layout(location=0) out vec3 out_light_vector;
 
 void main()
 {
-    highp mat4 model_matrix = mesh_instances[gl_InstanceIndex].model_matrix;
-    highp float enable_vertex_blending = mesh_instances[gl_InstanceIndex].enable_vertex_blending;
-
-    highp vec3 model_position;
-    if (enable_vertex_blending > 0.0)
-    {
-        highp ivec4 in_indices = indices_and_weights[gl_VertexIndex].indices;
-        highp vec4 in_weights = indices_and_weights[gl_VertexIndex].weights;
-
-        highp mat4 vertex_blending_matrix = mat4x4(
-            vec4(0.0, 0.0, 0.0, 0.0),
-            vec4(0.0, 0.0, 0.0, 0.0),
-            vec4(0.0, 0.0, 0.0, 0.0),
-            vec4(0.0, 0.0, 0.0, 0.0));
-
-        if (in_weights.x > 0.0 && in_indices.x > 0)
-        {
-            vertex_blending_matrix += joint_matrices[m_mesh_vertex_blending_max_joint_count * gl_InstanceIndex + in_indices.x] * in_weights.x;
-        }
-
-        if (in_weights.y > 0.0 && in_indices.y > 0)
-        {
-            vertex_blending_matrix += joint_matrices[m_mesh_vertex_blending_max_joint_count * gl_InstanceIndex + in_indices.y] * in_weights.y;
-        }
-
-        if (in_weights.z > 0.0 && in_indices.z > 0)
-        {
-            vertex_blending_matrix += joint_matrices[m_mesh_vertex_blending_max_joint_count * gl_InstanceIndex + in_indices.z] * in_weights.z;
-        }
-
-        if (in_weights.w > 0.0 && in_indices.w > 0)
-        {
-            vertex_blending_matrix += joint_matrices[m_mesh_vertex_blending_max_joint_count * gl_InstanceIndex + in_indices.w] * in_weights.w;
-        }
-
-        model_position = (vertex_blending_matrix * vec4(in_position, 1.0)).xyz;
-    }
-    else
-    {
-        model_position = in_position;
-    }
-
-    out_position_world_space = (model_matrix * vec4(model_position, 1.0)).xyz;
+    vec4 position_world_space = models[model_index].model_matrix * vec4(in_position, 1.0);
+    out_light_vector = position_world_space.xyz - light_position;
+    gl_Position = face_proj_view[gl_ViewIndex] * position_world_space;
 }
@@ -0,0 +1,110 @@
+//
+// Created by kyrosz7u on 2023/7/4.
+//
+
+#include "core/file/mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    m_file_handle = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(file_size.QuadPart);
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        close();
+        return false;
+    }
+    m_mapping_handle = mapping;
+
+    m_data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        close();
+        return false;
+    }
+#else
+    m_file_descriptor = ::open(path.c_str(), O_RDONLY);
+    if (m_file_descriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat{};
+    if (fstat(m_file_descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(file_stat.st_size);
+
+    void *mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file_descriptor, 0);
+    if (mapping == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    // 整个文件会被顺序拷贝到staging buffer，提示内核预读
+    madvise(mapping, m_size, MADV_WILLNEED);
+    m_data = static_cast<const uint8_t *>(mapping);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping_handle != nullptr)
+    {
+        CloseHandle(m_mapping_handle);
+    }
+    if (m_file_handle != nullptr)
+    {
+        CloseHandle(m_file_handle);
+    }
+    m_mapping_handle = nullptr;
+    m_file_handle    = nullptr;
+#else
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+    if (m_file_descriptor >= 0)
+    {
+        ::close(m_file_descriptor);
+    }
+    m_file_descriptor = -1;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
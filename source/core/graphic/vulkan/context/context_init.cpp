@@ -7,6 +7,7 @@
 #include "core/graphic/vulkan/vulkan_context.h"
 #include "core/graphic/vulkan/vulkan_utils.h"
 #include "core/logger/logger_macros.h"
+#include "core/threadpool.h"
 
 #define MACRO_XSTR(s) MACRO_STR(s)
 #define MACRO_STR(s) #s
@@ -261,7 +262,9 @@ void VulkanContext::createLogicalDevice()
     _queue_indices = findQueueFamilies(_physical_device);
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos; // all queues that need to be created
     std::set<uint32_t>                   queue_families = {_queue_indices.graphicsFamily.value(),
-                                                           _queue_indices.presentFamily.value()};
+                                                           _queue_indices.presentFamily.value(),
+                                                           _queue_indices.computeFamily.value(),
+                                                           _queue_indices.transferFamily.value()};
 
     float         queue_priority = 1.0f;
     for (uint32_t queue_family: queue_families)
@@ -278,6 +281,8 @@ void VulkanContext::createLogicalDevice()
     physical_device_features.samplerAnisotropy        = VK_TRUE;
     physical_device_features.fragmentStoresAndAtomics = VK_TRUE;
     physical_device_features.independentBlend         = VK_TRUE;
+    // 点光源阴影使用cube array
+    physical_device_features.imageCubeArray           = VK_TRUE;
 #if defined(__MACH__)
     // M1 Pro GPU不支持GeometryShader，原因暂时未知
     physical_device_features.geometryShader = VK_FALSE;
@@ -285,13 +290,125 @@ void VulkanContext::createLogicalDevice()
     physical_device_features.geometryShader = VK_TRUE;
 #endif
 
+    // 块压缩纹理(KTX2)：BC用于桌面GPU，ASTC用于移动端和Apple GPU
+    VkPhysicalDeviceFeatures supported_device_features;
+    vkGetPhysicalDeviceFeatures(_physical_device, &supported_device_features);
+    physical_device_features.textureCompressionBC       = supported_device_features.textureCompressionBC;
+    physical_device_features.textureCompressionASTC_LDR = supported_device_features.textureCompressionASTC_LDR;
+    // meshlet剔除后一次间接绘制多个meshlet
+    physical_device_features.multiDrawIndirect          = supported_device_features.multiDrawIndirect;
+    _enabled_device_features = physical_device_features;
+
+    // 可选扩展：VK_EXT_memory_budget用于纹理驻留管理的显存预算
+    std::vector<char const *> enabled_device_extensions = m_device_extensions;
+    _memory_budget_supported = isDeviceExtensionAvailable(_physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (_memory_budget_supported)
+    {
+        enabled_device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // 可选扩展：VK_KHR_multiview，支持该扩展的设备必须支持multiview特性
+    VkPhysicalDeviceMultiviewFeaturesKHR multiview_features{};
+    multiview_features.sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+    multiview_features.multiview = VK_TRUE;
+    _multiview_supported = isDeviceExtensionAvailable(_physical_device, VK_KHR_MULTIVIEW_EXTENSION_NAME);
+    if (_multiview_supported)
+    {
+        enabled_device_extensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+    }
+
+    // 可选扩展：VK_KHR_present_id + VK_KHR_present_wait，等待某次present真正上屏，用于测量呈现延迟
+    // 可选扩展：VK_KHR_timeline_semaphore，CPU不借助fence即可查询各队列的进度
+    // 可选扩展：VK_KHR_dynamic_rendering + VK_KHR_synchronization2，pass直接引用image view，布局转换由显式barrier完成
+    VkPhysicalDevicePresentIdFeaturesKHR          present_id_features{};
+    VkPhysicalDevicePresentWaitFeaturesKHR        present_wait_features{};
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features{};
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR  dynamic_rendering_features{};
+    VkPhysicalDeviceSynchronization2FeaturesKHR  synchronization2_features{};
+    present_id_features.sType         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    present_wait_features.sType       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    dynamic_rendering_features.sType  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    synchronization2_features.sType   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    auto get_physical_device_features2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(
+            _instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (get_physical_device_features2 != nullptr)
+    {
+        VkPhysicalDeviceFeatures2KHR supported_features2{};
+        supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        supported_features2.pNext   = &present_id_features;
+        present_id_features.pNext   = &present_wait_features;
+        present_wait_features.pNext = &timeline_semaphore_features;
+        timeline_semaphore_features.pNext = &dynamic_rendering_features;
+        dynamic_rendering_features.pNext  = &synchronization2_features;
+        get_physical_device_features2(_physical_device, &supported_features2);
+
+        _present_wait_supported       =
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) &&
+                present_id_features.presentId && present_wait_features.presentWait;
+        _timeline_semaphore_supported =
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) &&
+                timeline_semaphore_features.timelineSemaphore;
+        // 在1.0上VK_KHR_dynamic_rendering依赖depth_stencil_resolve -> create_renderpass2 -> multiview + maintenance2
+        _dynamic_rendering_supported  =
+                _multiview_supported &&
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_MAINTENANCE_2_EXTENSION_NAME) &&
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) &&
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+                isDeviceExtensionAvailable(_physical_device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) &&
+                dynamic_rendering_features.dynamicRendering && synchronization2_features.synchronization2;
+    }
+
+    void *device_create_next = nullptr;
+    if (_multiview_supported)
+    {
+        multiview_features.pNext = device_create_next;
+        device_create_next       = &multiview_features;
+    }
+    if (_timeline_semaphore_supported)
+    {
+        enabled_device_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timeline_semaphore_features.pNext = device_create_next;
+        device_create_next                = &timeline_semaphore_features;
+    }
+    else
+    {
+        LOG_WARN("VK_KHR_timeline_semaphore is not supported, queue timelines fall back to fences")
+    }
+    if (_dynamic_rendering_supported)
+    {
+        enabled_device_extensions.push_back(VK_KHR_MAINTENANCE_2_EXTENSION_NAME);
+        enabled_device_extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        enabled_device_extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+        enabled_device_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        enabled_device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        synchronization2_features.pNext  = device_create_next;
+        dynamic_rendering_features.pNext = &synchronization2_features;
+        device_create_next               = &dynamic_rendering_features;
+    }
+    else
+    {
+        LOG_WARN("VK_KHR_dynamic_rendering is not supported, passes fall back to render pass objects")
+    }
+    if (_present_wait_supported)
+    {
+        enabled_device_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        enabled_device_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        present_wait_features.pNext = device_create_next;
+        present_id_features.pNext   = &present_wait_features;
+        device_create_next          = &present_id_features;
+    }
+
     VkDeviceCreateInfo device_create_info{};
     device_create_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_create_info.pNext                   = device_create_next;
     device_create_info.pQueueCreateInfos       = queue_create_infos.data();
     device_create_info.queueCreateInfoCount    = static_cast<uint32_t>(queue_create_infos.size());
     device_create_info.pEnabledFeatures        = &physical_device_features;
-    device_create_info.enabledExtensionCount   = static_cast<uint32_t>(m_device_extensions.size());
-    device_create_info.ppEnabledExtensionNames = m_device_extensions.data();
+    device_create_info.enabledExtensionCount   = static_cast<uint32_t>(enabled_device_extensions.size());
+    device_create_info.ppEnabledExtensionNames = enabled_device_extensions.data();
     device_create_info.enabledLayerCount       = 0;
 
     if (vkCreateDevice(_physical_device, &device_create_info, nullptr, &_device) != VK_SUCCESS)
@@ -300,6 +417,8 @@ void VulkanContext::createLogicalDevice()
     }
     vkGetDeviceQueue(_device, _queue_indices.graphicsFamily.value(), 0, &_graphics_queue);
     vkGetDeviceQueue(_device, _queue_indices.presentFamily.value(), 0, &_present_queue);
+    vkGetDeviceQueue(_device, _queue_indices.computeFamily.value(), 0, &_compute_queue);
+    vkGetDeviceQueue(_device, _queue_indices.transferFamily.value(), 0, &_transfer_queue);
 
     // more efficient pointer
     _vkWaitForFences          = (PFN_vkWaitForFences) vkGetDeviceProcAddr(_device, "vkWaitForFences");
@@ -317,12 +436,25 @@ void VulkanContext::createLogicalDevice()
     _vkCmdBindVertexBuffers   = (PFN_vkCmdBindVertexBuffers) vkGetDeviceProcAddr(_device, "vkCmdBindVertexBuffers");
     _vkCmdBindIndexBuffer     = (PFN_vkCmdBindIndexBuffer) vkGetDeviceProcAddr(_device, "vkCmdBindIndexBuffer");
     _vkCmdBindDescriptorSets  = (PFN_vkCmdBindDescriptorSets) vkGetDeviceProcAddr(_device, "vkCmdBindDescriptorSets");
+    _vkCmdPushConstants       = (PFN_vkCmdPushConstants) vkGetDeviceProcAddr(_device, "vkCmdPushConstants");
     _vkCmdDraw                = (PFN_vkCmdDraw) vkGetDeviceProcAddr(_device, "vkCmdDraw");
     _vkCmdDrawIndexed         = (PFN_vkCmdDrawIndexed) vkGetDeviceProcAddr(_device, "vkCmdDrawIndexed");
+    _vkCmdDrawIndexedIndirect = (PFN_vkCmdDrawIndexedIndirect) vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirect");
     _vkCmdClearAttachments    = (PFN_vkCmdClearAttachments) vkGetDeviceProcAddr(_device, "vkCmdClearAttachments");
     _vkAllocateDescriptorSets = (PFN_vkAllocateDescriptorSets) vkGetDeviceProcAddr(_device, "vkAllocateDescriptorSets");
     _vkUpdateDescriptorSets   = (PFN_vkUpdateDescriptorSets) vkGetDeviceProcAddr(_device, "vkUpdateDescriptorSets");
     _vkFreeDescriptorSets     = (PFN_vkFreeDescriptorSets) vkGetDeviceProcAddr(_device, "vkFreeDescriptorSets");
+    if (_present_wait_supported)
+    {
+        _vkWaitForPresentKHR  = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(_device, "vkWaitForPresentKHR");
+        m_present_wait_thread = std::make_shared<Thread>();
+    }
+    if (_dynamic_rendering_supported)
+    {
+        _vkCmdBeginRenderingKHR   = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(_device, "vkCmdBeginRenderingKHR");
+        _vkCmdEndRenderingKHR     = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(_device, "vkCmdEndRenderingKHR");
+        _vkCmdPipelineBarrier2KHR = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(_device, "vkCmdPipelineBarrier2KHR");
+    }
 
     _depth_image_format = findDepthFormat();
 }
@@ -340,6 +472,13 @@ void VulkanContext::createCommandPool()
     {
         throw std::runtime_error("vk create command pool");
     }
+
+    command_pool_create_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    command_pool_create_info.queueFamilyIndex = _queue_indices.transferFamily.value();
+    if (vkCreateCommandPool(_device, &command_pool_create_info, nullptr, &_transfer_command_pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("vk create transfer command pool");
+    }
 }
 
 void VulkanContext::createSwapchain()
@@ -392,7 +531,8 @@ void VulkanContext::createSwapchain()
     createInfo.presentMode    = chosen_presentMode;
     createInfo.clipped        = VK_TRUE;
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // 重建时交给驱动复用旧swapchain的资源，旧swapchain上已提交的present仍会完成
+    createInfo.oldSwapchain = _swapchain;
 
     if (vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapchain) != VK_SUCCESS)
     {
@@ -1,18 +1,24 @@
 #include "core/graphic/vulkan/vulkan_context.h"
 #include "core/logger/logger_macros.h"
+#include "core/threadpool.h"
+#include <thread>
 
 using namespace VulkanAPI;
 
+// 正常情况下几帧之内就会上屏，超时说明呈现被挂起，丢弃这一帧的统计
+static constexpr uint64_t kPresentWaitTimeoutNs = 100000000;
+
+static float smoothLatency(float average_ms, float sample_ms)
+{
+    return average_ms == 0.0f ? sample_ms : average_ms + 0.1f * (sample_ms - average_ms);
+}
+
 void VulkanContext::initSemaphoreObjects()
 {
     VkSemaphoreCreateInfo semaphore_create_info {};
     semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fence_create_info {};
-    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // the fence is initialized as signaled
-
-    for (uint32_t i = 0; i < m_max_frames_in_flight; i++)
+    for (uint32_t i = 0; i < kMaxFramesInFlight; i++)
     {
         assert(vkCreateSemaphore(_device,
                               &semaphore_create_info,
@@ -22,16 +28,27 @@ void VulkanContext::initSemaphoreObjects()
                               &semaphore_create_info,
                               nullptr,
                               &m_image_finished_for_presentation_semaphores[i]) == VK_SUCCESS);
-        assert(vkCreateFence(_device, &fence_create_info, nullptr, &m_is_frame_in_flight_fences[i]) == VK_SUCCESS);
     }
+
+    // acquire/present仍然使用binary semaphore，帧和上传的完成情况通过各队列的timeline查询
+    _graphics_timeline.Initialize(_device, _timeline_semaphore_supported);
+    _compute_timeline.Initialize(_device, _timeline_semaphore_supported);
+    _transfer_timeline.Initialize(_device, _timeline_semaphore_supported);
+    _deletion_queue.Initialize(_device);
 }
 
 uint32_t VulkanContext::getNextSwapchainImageIndex(std::function<void()> swapchainRecreateCallback)
 {
+    // 切换present mode需要重建swapchain
+    if (m_present_mode_dirty)
+    {
+        recreateSwapChain();
+        swapchainRecreateCallback();
+        return -1;
+    }
+
     // sync device
-     VkResult res_wait_for_fences = _vkWaitForFences(
-             _device, 1, &m_is_frame_in_flight_fences[m_current_frame_index], VK_TRUE, UINT64_MAX);
-     assert(VK_SUCCESS == res_wait_for_fences);
+    waitForFrameSlot(m_current_frame_index);
 
     uint32_t next_swapchain_image_index;
     VkResult acquire_image_result =
@@ -64,15 +81,9 @@ uint32_t VulkanContext::getNextSwapchainImageIndex(std::function<void()> swapcha
         submit_info.signalSemaphoreCount   = 0;
         submit_info.pSignalSemaphores      = NULL;
 
-        VkResult res_reset_fences = _vkResetFences(
-                _device, 1, &m_is_frame_in_flight_fences[m_current_frame_index]);
-        assert(VK_SUCCESS == res_reset_fences);
-
-        VkResult res_queue_submit = vkQueueSubmit(
-                _graphics_queue, 1, &submit_info, m_is_frame_in_flight_fences[m_current_frame_index]);
-        assert(VK_SUCCESS == res_queue_submit);
+        m_frame_timeline_values[m_current_frame_index] = _graphics_timeline.Submit(_graphics_queue, submit_info);
 
-        m_current_frame_index = (m_current_frame_index + 1) % m_max_frames_in_flight;
+        m_current_frame_index = (m_current_frame_index + 1) % m_frames_in_flight;
         return -1;
     }
     else
@@ -80,10 +91,19 @@ uint32_t VulkanContext::getNextSwapchainImageIndex(std::function<void()> swapcha
         assert(acquire_image_result == VK_SUCCESS);
     }
 
+    // 调用方接下来会重置并重新录制这个索引上的command buffer
+    if (next_swapchain_image_index >= m_swapchain_image_timeline_values.size())
+    {
+        m_swapchain_image_timeline_values.resize(next_swapchain_image_index + 1, 0);
+    }
+    _graphics_timeline.Wait(m_swapchain_image_timeline_values[next_swapchain_image_index]);
+    m_acquired_image_index = next_swapchain_image_index;
+
     return next_swapchain_image_index;
 }
 
-void VulkanContext::submitDrawSwapchainImageCmdBuffer(VkCommandBuffer* p_command_buffer)
+void VulkanContext::submitDrawSwapchainImageCmdBuffer(VkCommandBuffer* p_command_buffer,
+                                                      const std::vector<TimelineWait> &timeline_waits)
 {
     VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSubmitInfo         submit_info   = {};
@@ -96,13 +116,16 @@ void VulkanContext::submitDrawSwapchainImageCmdBuffer(VkCommandBuffer* p_command
     submit_info.signalSemaphoreCount   = 1;
     submit_info.pSignalSemaphores      = &m_image_finished_for_presentation_semaphores[m_current_frame_index];
 
-    VkResult res_reset_fences = _vkResetFences(
-            _device, 1, &m_is_frame_in_flight_fences[m_current_frame_index]);
-    assert(VK_SUCCESS == res_reset_fences);
+    m_frame_timeline_values[m_current_frame_index] =
+            _graphics_timeline.Submit(_graphics_queue, submit_info, timeline_waits);
+    _deletion_queue.Seal(m_frame_timeline_values[m_current_frame_index]);
+    m_swapchain_image_timeline_values[m_acquired_image_index] = m_frame_timeline_values[m_current_frame_index];
 
-    VkResult res_queue_submit = vkQueueSubmit(
-            _graphics_queue, 1, &submit_info, m_is_frame_in_flight_fences[m_current_frame_index]);
-    assert(VK_SUCCESS == res_queue_submit);
+    auto submit_time = FrameClock::now();
+    m_frame_latency_stats.input_to_submit_ms = smoothLatency(
+            m_frame_latency_stats.input_to_submit_ms,
+            std::chrono::duration<float, std::milli>(submit_time - m_frame_input_time).count());
+    m_frame_input_times[m_current_frame_index] = m_frame_input_time;
 }
 
 void VulkanContext::presentSwapchainImage(uint32_t swapchain_image_index, std::function<void()> swapchainRecreateCallback)
@@ -116,7 +139,29 @@ void VulkanContext::presentSwapchainImage(uint32_t swapchain_image_index, std::f
     present_info.pSwapchains        = &_swapchain;
     present_info.pImageIndices      = &swapchain_image_index;
 
+    VkPresentIdKHR present_id_info{};
+    if (_present_wait_supported)
+    {
+        ++m_present_id;
+        present_id_info.sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id_info.swapchainCount = 1;
+        present_id_info.pPresentIds    = &m_present_id;
+        present_info.pNext             = &present_id_info;
+    }
+
     VkResult present_result = vkQueuePresentKHR(_present_queue, &present_info);
+    if (_present_wait_supported)
+    {
+        if (VK_SUCCESS == present_result || VK_SUBOPTIMAL_KHR == present_result)
+        {
+            waitForPresentAsync(m_present_id, m_frame_input_times[m_current_frame_index]);
+        }
+    }
+    else
+    {
+        // swapchain重建时会清掉这一帧的统计
+        m_frame_latency_pending[m_current_frame_index] = true;
+    }
     if (VK_ERROR_OUT_OF_DATE_KHR == present_result || VK_SUBOPTIMAL_KHR == present_result)
     {
        recreateSwapChain();
@@ -127,7 +172,7 @@ void VulkanContext::presentSwapchainImage(uint32_t swapchain_image_index, std::f
         assert(VK_SUCCESS == present_result);
     }
 
-    m_current_frame_index = (m_current_frame_index + 1) % m_max_frames_in_flight;
+    m_current_frame_index = (m_current_frame_index + 1) % m_frames_in_flight;
 }
 
 void VulkanContext::recreateSwapChain()
@@ -140,23 +185,160 @@ void VulkanContext::recreateSwapChain()
         glfwWaitEvents();
     }
 
-    VkResult res_wait_for_fences = _vkWaitForFences(
-            _device, m_max_frames_in_flight, m_is_frame_in_flight_fences, VK_TRUE, UINT64_MAX);
-    assert(VK_SUCCESS == res_wait_for_fences);
+    // present id属于旧的swapchain，未统计的帧直接丢弃；
+    // 旧swapchain上的等待会以上屏或VK_ERROR_OUT_OF_DATE_KHR返回，等它们结束后再退役swapchain
+    std::fill(std::begin(m_frame_latency_pending), std::end(m_frame_latency_pending), false);
+    if (m_present_wait_thread != nullptr)
+    {
+        m_present_wait_thread->wait();
+    }
+    m_present_mode_dirty = false;
+
+    // 不等待图形队列，旧swapchain作为oldSwapchain传给新swapchain后退役，
+    // 它和image view在引用它们的帧执行完之后再销毁
+    std::vector<VkImageView> retired_imageviews;
+    retired_imageviews.swap(_swapchain_imageviews);
+    VkSwapchainKHR retired_swapchain = _swapchain;
 
-    clearSwapchain();
     createSwapchain();
     createSwapchainImageViews();
 
+    VkDevice device = _device;
+    _deletion_queue.Push([device, retired_imageviews, retired_swapchain]()
+                         {
+                             for (auto imageview: retired_imageviews)
+                             {
+                                 vkDestroyImageView(device, imageview, nullptr);
+                             }
+                             vkDestroySwapchainKHR(device, retired_swapchain, nullptr);
+                         });
+
     LOG_INFO("swapchain has recreated successfully. width: {}, height: {}", width, height);
 }
 
 void VulkanContext::waitForFrameInFlightFence()
 {
     // 等待所有的提交的commandbuffer执行完毕
-    VkResult res_wait_for_fences = _vkWaitForFences(
-            _device, m_max_frames_in_flight, m_is_frame_in_flight_fences, VK_TRUE, UINT64_MAX);
-    assert(VK_SUCCESS == res_wait_for_fences);
+    _graphics_timeline.WaitIdle();
+    _compute_timeline.WaitIdle();
+    _transfer_timeline.WaitIdle();
+}
+
+void VulkanContext::waitForFrameSlot(uint32_t frame_index)
+{
+    _graphics_timeline.Wait(m_frame_timeline_values[frame_index]);
+}
+
+void VulkanContext::beginFrame()
+{
+    applyFramesInFlight();
+
+    // 在这里等待而不是在获取swapchain image时等待，CPU阻塞发生在采样输入之前
+    waitForFrameSlot(m_current_frame_index);
+    _deletion_queue.Collect(_graphics_timeline.GetCompletedValue());
+
+    collectFrameLatency();
+    limitFrameRate();
+
+    m_frame_input_time = FrameClock::now();
+}
+
+void VulkanContext::setFramePacingSettings(const FramePacingSettings &settings)
+{
+    FramePacingSettings clamped_settings = settings;
+    clamped_settings.frames_in_flight = std::clamp(settings.frames_in_flight, 1u, kMaxFramesInFlight);
+    clamped_settings.max_frame_rate   = std::max(settings.max_frame_rate, 0.0f);
+
+    if (clamped_settings.present_mode != m_frame_pacing_settings.present_mode)
+    {
+        m_present_mode_dirty = true;
+    }
+    m_frame_pacing_settings = clamped_settings;
+}
+
+void VulkanContext::applyFramesInFlight()
+{
+    if (m_frames_in_flight == m_frame_pacing_settings.frames_in_flight)
+    {
+        return;
+    }
+
+    // 槽位数量变化前等待所有帧执行完，此时所有信号量都已被消费
+    waitForFrameInFlightFence();
+    collectFrameLatency();
+
+    m_frames_in_flight    = m_frame_pacing_settings.frames_in_flight;
+    m_current_frame_index = 0;
+    LOG_INFO("frames in flight changed to {}", m_frames_in_flight)
+}
+
+void VulkanContext::limitFrameRate()
+{
+    if (m_frame_pacing_settings.max_frame_rate <= 0.0f)
+    {
+        return;
+    }
+
+    auto frame_period = std::chrono::duration_cast<FrameClock::duration>(
+            std::chrono::duration<double>(1.0 / m_frame_pacing_settings.max_frame_rate));
+    auto now          = FrameClock::now();
+    // 落后超过一帧时重新对齐，避免之后连续多帧不限速地追赶
+    if (now > m_next_frame_deadline + frame_period)
+    {
+        m_next_frame_deadline = now;
+    }
+    else
+    {
+        std::this_thread::sleep_until(m_next_frame_deadline);
+    }
+    m_next_frame_deadline += frame_period;
+}
+
+void VulkanContext::collectFrameLatency()
+{
+    m_frame_latency_stats.present_wait_timing = _present_wait_supported;
+    if (_present_wait_supported)
+    {
+        std::lock_guard<std::mutex> lock(m_present_latency_mutex);
+        m_frame_latency_stats.input_to_present_ms = m_present_latency_ms;
+        return;
+    }
+
+    // 轮询到的完成时间晚于GPU实际完成的时间，最多偏大一个CPU帧
+    auto now = FrameClock::now();
+    for (uint32_t i = 0; i < kMaxFramesInFlight; ++i)
+    {
+        if (!m_frame_latency_pending[i] || !_graphics_timeline.IsCompleted(m_frame_timeline_values[i]))
+        {
+            continue;
+        }
+
+        m_frame_latency_stats.input_to_present_ms = smoothLatency(
+                m_frame_latency_stats.input_to_present_ms,
+                std::chrono::duration<float, std::milli>(now - m_frame_input_times[i]).count());
+        m_frame_latency_pending[i] = false;
+    }
+}
+
+void VulkanContext::waitForPresentAsync(uint64_t present_id, FrameClock::time_point input_time)
+{
+    // present id按提交顺序上屏，单线程依次等待即可；在vkWaitForPresentKHR返回时取时间，不受帧循环的轮询间隔影响
+    VkSwapchainKHR swapchain = _swapchain;
+    m_present_wait_thread->addJob([this, swapchain, present_id, input_time]()
+                                  {
+                                      VkResult result = _vkWaitForPresentKHR(_device, swapchain, present_id,
+                                                                             kPresentWaitTimeoutNs);
+                                      auto present_time = FrameClock::now();
+                                      if (result != VK_SUCCESS)
+                                      {
+                                          return;
+                                      }
+
+                                      std::lock_guard<std::mutex> lock(m_present_latency_mutex);
+                                      m_present_latency_ms = smoothLatency(
+                                              m_present_latency_ms,
+                                              std::chrono::duration<float, std::milli>(present_time - input_time).count());
+                                  });
 }
 
 
@@ -2,10 +2,13 @@
 // Created by kyrosz7u on 4/5/23.
 //
 #include "core/graphic/vulkan/vulkan_context.h"
+#include "core/logger/logger_macros.h"
+#include "core/graphic/vulkan/vulkan_utils.h"
 
 #include <iostream>
 #include <set>
 #include <string>
+#include <cstring>
 
 using namespace VulkanAPI;
 
@@ -139,6 +142,30 @@ QueueFamilyIndices VulkanContext::findQueueFamilies(VkPhysicalDevice physical_de
         }
         i++;
     }
+
+    // 优先选择独立的计算/传输队列族，它们的提交不会排在图形队列的帧后面
+    for (uint32_t family = 0; family < queue_family_count; ++family)
+    {
+        VkQueueFlags flags = queue_families[family].queueFlags;
+        if (!indices.computeFamily.has_value() &&
+            (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            indices.computeFamily = family;
+        }
+        if (!indices.transferFamily.has_value() &&
+            (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            indices.transferFamily = family;
+        }
+    }
+    if (!indices.computeFamily.has_value())
+    {
+        indices.computeFamily = indices.graphicsFamily;
+    }
+    if (!indices.transferFamily.has_value())
+    {
+        indices.transferFamily = indices.computeFamily;
+    }
     return indices;
 }
 
@@ -178,6 +205,84 @@ VkFormat VulkanContext::findSupportedFormat(const std::vector<VkFormat>& candida
     throw std::runtime_error("findSupportedFormat failed");
 }
 
+bool VulkanContext::isSampledImageFormatSupported(VkFormat format)
+{
+    if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK &&
+        !_enabled_device_features.textureCompressionBC)
+    {
+        return false;
+    }
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK &&
+        !_enabled_device_features.textureCompressionASTC_LDR)
+    {
+        return false;
+    }
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(_physical_device, format, &props);
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool VulkanContext::isDeviceExtensionAvailable(VkPhysicalDevice physical_device, const char *extension_name)
+{
+    uint32_t extension_count;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data());
+
+    for (const auto &extension: available_extensions)
+    {
+        if (strcmp(extension.extensionName, extension_name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VulkanContext::queryDeviceLocalMemoryBudget(VkDeviceSize &budget, VkDeviceSize &usage)
+{
+    budget = 0;
+    usage  = 0;
+
+    auto get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)
+            vkGetInstanceProcAddr(_instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+
+    if (!_memory_budget_supported || get_memory_properties2 == nullptr)
+    {
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        vkGetPhysicalDeviceMemoryProperties(_physical_device, &memory_properties);
+        for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i)
+        {
+            if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            {
+                budget += memory_properties.memoryHeaps[i].size;
+            }
+        }
+        return false;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+    budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2KHR memory_properties2{};
+    memory_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+    memory_properties2.pNext = &budget_properties;
+    get_memory_properties2(_physical_device, &memory_properties2);
+
+    const auto &memory_properties = memory_properties2.memoryProperties;
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i)
+    {
+        if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            budget += budget_properties.heapBudget[i];
+            usage += budget_properties.heapUsage[i];
+        }
+    }
+    return true;
+}
+
 SwapChainSupportDetails VulkanContext::querySwapChainSupport(VkPhysicalDevice physical_device)
 {
     SwapChainSupportDetails details_result;
@@ -226,15 +331,15 @@ VkPresentModeKHR VulkanContext::chooseSwapchainPresentModeFromDetails(
         const std::vector<VkPresentModeKHR>& available_present_modes)
 {
     // VK_PRESENT_MODE_MAILBOX_KHR是三缓冲模式，m1pro gpu好像不支持
-    // 故需要设置为VK_PRESENT_MODE_FIFO_KHR，设置为VK_PRESENT_MODE_IMMEDIATE_KHR
-    // 会导致报错
+    // 设备不支持设置中的模式时回退到所有设备都支持的VK_PRESENT_MODE_FIFO_KHR
     for (VkPresentModeKHR present_mode : available_present_modes)
     {
-        if (VK_PRESENT_MODE_MAILBOX_KHR == present_mode)
+        if (m_frame_pacing_settings.present_mode == present_mode)
         {
-            return VK_PRESENT_MODE_MAILBOX_KHR;
+            return present_mode;
         }
     }
+    LOG_WARN("present mode {} is not supported, fall back to FIFO", static_cast<int>(m_frame_pacing_settings.present_mode))
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -280,7 +385,8 @@ VkCommandBuffer VulkanContext::beginSingleTimeCommands()
     return command_buffer;
 }
 
-void VulkanContext::endSingleTimeCommands(VkCommandBuffer command_buffer)
+void VulkanContext::endSingleTimeCommands(VkCommandBuffer command_buffer,
+                                          const std::vector<TimelineWait> &timeline_waits)
 {
     _vkEndCommandBuffer(command_buffer);
 
@@ -289,13 +395,128 @@ void VulkanContext::endSingleTimeCommands(VkCommandBuffer command_buffer)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers    = &command_buffer;
 
-    vkQueueSubmit(_graphics_queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(_graphics_queue);
+    // 只等待这一次提交，不再等待图形队列上还在执行的帧
+    _graphics_timeline.Wait(_graphics_timeline.Submit(_graphics_queue, submitInfo, timeline_waits));
 
     vkFreeCommandBuffers(_device, _command_pool, 1, &command_buffer);
 }
 
+VkCommandBuffer VulkanContext::beginTransferCommands()
+{
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool        = _transfer_command_pool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer;
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(_device, &allocInfo, &command_buffer))
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    _vkBeginCommandBuffer(command_buffer, &beginInfo);
+
+    return command_buffer;
+}
+
+void VulkanContext::endTransferCommands(VkCommandBuffer command_buffer,
+                                        std::vector<VkBufferMemoryBarrier> buffer_barriers,
+                                        std::vector<VkImageMemoryBarrier> image_barriers)
+{
+    uint32_t transfer_family = _queue_indices.transferFamily.value();
+    uint32_t graphics_family = _queue_indices.graphicsFamily.value();
+    bool     ownership_transfer = transfer_family != graphics_family &&
+                                  (!buffer_barriers.empty() || !image_barriers.empty());
+
+    for (auto &barrier: buffer_barriers)
+    {
+        barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = transfer_family;
+        barrier.dstQueueFamilyIndex = graphics_family;
+    }
+    for (auto &barrier: image_barriers)
+    {
+        barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = transfer_family;
+        barrier.dstQueueFamilyIndex = graphics_family;
+    }
+
+    if (ownership_transfer)
+    {
+        // 释放：只需要让传输写入可用，目标访问由获取屏障定义
+        for (auto &barrier: buffer_barriers)
+        {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+        }
+        for (auto &barrier: image_barriers)
+        {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+        }
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0,
+                             0, nullptr,
+                             static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+    }
+
+    _vkEndCommandBuffer(command_buffer);
+
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &command_buffer;
+
+    uint64_t transfer_value = _transfer_timeline.Submit(_transfer_queue, submitInfo);
+
+    if (ownership_transfer)
+    {
+        // 获取：图形队列在GPU上等待传输完成，之后的图形提交都排在它后面
+        for (auto &barrier: buffer_barriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        }
+        for (auto &barrier: image_barriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        }
+
+        VkCommandBuffer acquire_command_buffer = beginSingleTimeCommands();
+        vkCmdPipelineBarrier(acquire_command_buffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             0, nullptr,
+                             static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        endSingleTimeCommands(acquire_command_buffer,
+                              {{&_transfer_timeline, transfer_value, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT}});
+    }
+    else
+    {
+        // 传输和图形是同一个队列族，也就是同一个队列，提交顺序已经保证先后
+        _transfer_timeline.Wait(transfer_value);
+    }
+
+    vkFreeCommandBuffers(_device, _transfer_command_pool, 1, &command_buffer);
+}
+
 void VulkanContext::clear()
 {
+    // 等待线程析构时会先处理完队列中的present
+    m_present_wait_thread.reset();
+    // mesh和纹理析构时登记的资源也在这里销毁，调用前它们必须已经全部析构
+    VK_CHECK_RESULT(vkDeviceWaitIdle(_device))
+    _deletion_queue.Flush();
+    _graphics_timeline.Destroy();
+    _compute_timeline.Destroy();
+    _transfer_timeline.Destroy();
     destroyDebugUtilsMessengerEXT(_instance, m_debug_messenger, nullptr);
 }
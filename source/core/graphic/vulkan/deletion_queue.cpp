@@ -0,0 +1,146 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#include "core/graphic/vulkan/vulkan_deletion_queue.h"
+#include <iterator>
+
+using namespace VulkanAPI;
+
+void VulkanDeletionQueue::Initialize(VkDevice device)
+{
+    m_device = device;
+}
+
+void VulkanDeletionQueue::Push(std::function<void()> &&deleter)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_open_deleters.push_back(std::move(deleter));
+}
+
+void VulkanDeletionQueue::DestroyBuffer(VkBuffer buffer, VkDeviceMemory memory)
+{
+    if (buffer == VK_NULL_HANDLE && memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VkDevice device = m_device;
+    Push([device, buffer, memory]()
+         {
+             vkDestroyBuffer(device, buffer, nullptr);
+             vkFreeMemory(device, memory, nullptr);
+         });
+}
+
+void VulkanDeletionQueue::DestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory)
+{
+    if (image == VK_NULL_HANDLE && view == VK_NULL_HANDLE && memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VkDevice device = m_device;
+    Push([device, image, view, memory]()
+         {
+             vkDestroyImageView(device, view, nullptr);
+             vkDestroyImage(device, image, nullptr);
+             vkFreeMemory(device, memory, nullptr);
+         });
+}
+
+void VulkanDeletionQueue::DestroyFramebuffer(VkFramebuffer framebuffer)
+{
+    if (framebuffer == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VkDevice device = m_device;
+    Push([device, framebuffer]()
+         {
+             vkDestroyFramebuffer(device, framebuffer, nullptr);
+         });
+}
+
+void VulkanDeletionQueue::DestroyRenderPass(VkRenderPass render_pass)
+{
+    if (render_pass == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VkDevice device = m_device;
+    Push([device, render_pass]()
+         {
+             vkDestroyRenderPass(device, render_pass, nullptr);
+         });
+}
+
+void VulkanDeletionQueue::Seal(uint64_t timeline_value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_open_deleters.empty())
+    {
+        return;
+    }
+    m_sealed_deleters.emplace_back(timeline_value, std::move(m_open_deleters));
+    m_open_deleters.clear();
+}
+
+void VulkanDeletionQueue::Collect(uint64_t completed_value)
+{
+    std::vector<std::function<void()>> deleters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_sealed_deleters.empty() && m_sealed_deleters.front().first <= completed_value)
+        {
+            auto &frame_deleters = m_sealed_deleters.front().second;
+            deleters.insert(deleters.end(),
+                            std::make_move_iterator(frame_deleters.begin()),
+                            std::make_move_iterator(frame_deleters.end()));
+            m_sealed_deleters.pop_front();
+        }
+    }
+
+    // deleter可能再次登记资源，不能持有锁
+    for (auto &deleter: deleters)
+    {
+        deleter();
+    }
+}
+
+void VulkanDeletionQueue::Flush()
+{
+    std::vector<std::function<void()>> deleters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &frame: m_sealed_deleters)
+        {
+            deleters.insert(deleters.end(),
+                            std::make_move_iterator(frame.second.begin()),
+                            std::make_move_iterator(frame.second.end()));
+        }
+        deleters.insert(deleters.end(),
+                        std::make_move_iterator(m_open_deleters.begin()),
+                        std::make_move_iterator(m_open_deleters.end()));
+        m_sealed_deleters.clear();
+        m_open_deleters.clear();
+    }
+
+    for (auto &deleter: deleters)
+    {
+        deleter();
+    }
+}
+
+size_t VulkanDeletionQueue::GetPendingCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = m_open_deleters.size();
+    for (const auto &frame: m_sealed_deleters)
+    {
+        count += frame.second.size();
+    }
+    return count;
+}
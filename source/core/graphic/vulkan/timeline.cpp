@@ -0,0 +1,212 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#include "core/graphic/vulkan/vulkan_timeline.h"
+#include "core/graphic/vulkan/vulkan_utils.h"
+#include "core/logger/logger_macros.h"
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+
+using namespace VulkanAPI;
+
+void VulkanTimeline::Initialize(VkDevice device, bool timeline_semaphore_supported)
+{
+    m_device                       = device;
+    m_timeline_semaphore_supported = timeline_semaphore_supported;
+    m_last_submitted_value         = 0;
+    m_completed_value              = 0;
+
+    if (!m_timeline_semaphore_supported)
+    {
+        return;
+    }
+
+    m_vkWaitSemaphoresKHR           = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    m_vkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(
+            device, "vkGetSemaphoreCounterValueKHR");
+    if (m_vkWaitSemaphoresKHR == nullptr || m_vkGetSemaphoreCounterValueKHR == nullptr)
+    {
+        throw std::runtime_error("get timeline semaphore functions fault.");
+    }
+
+    VkSemaphoreTypeCreateInfoKHR semaphore_type_create_info{};
+    semaphore_type_create_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    semaphore_type_create_info.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphore_create_info{};
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create_info.pNext = &semaphore_type_create_info;
+    VK_CHECK_RESULT(vkCreateSemaphore(m_device, &semaphore_create_info, nullptr, &m_semaphore))
+}
+
+void VulkanTimeline::Destroy()
+{
+    if (m_device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    if (m_semaphore != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(m_device, m_semaphore, nullptr);
+        m_semaphore = VK_NULL_HANDLE;
+    }
+    for (auto &pending: m_pending_fences)
+    {
+        vkDestroyFence(m_device, pending.second, nullptr);
+    }
+    for (VkFence fence: m_free_fences)
+    {
+        vkDestroyFence(m_device, fence, nullptr);
+    }
+    m_pending_fences.clear();
+    m_free_fences.clear();
+    m_device = VK_NULL_HANDLE;
+}
+
+uint64_t VulkanTimeline::Submit(VkQueue queue,
+                                const VkSubmitInfo &submit_info,
+                                const std::vector<TimelineWait> &timeline_waits)
+{
+    const uint64_t signal_value = m_last_submitted_value + 1;
+
+    std::vector<VkSemaphore>          wait_semaphores(submit_info.pWaitSemaphores,
+                                                      submit_info.pWaitSemaphores + submit_info.waitSemaphoreCount);
+    std::vector<VkPipelineStageFlags> wait_stages(submit_info.pWaitDstStageMask,
+                                                  submit_info.pWaitDstStageMask + submit_info.waitSemaphoreCount);
+    // binary semaphore对应的值会被忽略
+    std::vector<uint64_t>             wait_values(wait_semaphores.size(), 0);
+    for (const auto &wait: timeline_waits)
+    {
+        if (m_timeline_semaphore_supported)
+        {
+            wait_semaphores.push_back(wait.timeline->m_semaphore);
+            wait_stages.push_back(wait.stage);
+            wait_values.push_back(wait.value);
+        }
+        else
+        {
+            wait.timeline->Wait(wait.value);
+        }
+    }
+
+    std::vector<VkSemaphore> signal_semaphores(submit_info.pSignalSemaphores,
+                                               submit_info.pSignalSemaphores + submit_info.signalSemaphoreCount);
+    std::vector<uint64_t>    signal_values(signal_semaphores.size(), 0);
+
+    VkSubmitInfo                     timeline_submit_info = submit_info;
+    VkTimelineSemaphoreSubmitInfoKHR timeline_values_info{};
+    VkFence                          fence                = VK_NULL_HANDLE;
+    if (m_timeline_semaphore_supported)
+    {
+        signal_semaphores.push_back(m_semaphore);
+        signal_values.push_back(signal_value);
+
+        timeline_values_info.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timeline_values_info.pNext                     = submit_info.pNext;
+        timeline_values_info.waitSemaphoreValueCount   = static_cast<uint32_t>(wait_values.size());
+        timeline_values_info.pWaitSemaphoreValues      = wait_values.data();
+        timeline_values_info.signalSemaphoreValueCount = static_cast<uint32_t>(signal_values.size());
+        timeline_values_info.pSignalSemaphoreValues    = signal_values.data();
+        timeline_submit_info.pNext                     = &timeline_values_info;
+    }
+    else
+    {
+        fence = acquireFence();
+    }
+
+    timeline_submit_info.waitSemaphoreCount   = static_cast<uint32_t>(wait_semaphores.size());
+    timeline_submit_info.pWaitSemaphores      = wait_semaphores.data();
+    timeline_submit_info.pWaitDstStageMask    = wait_stages.data();
+    timeline_submit_info.signalSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size());
+    timeline_submit_info.pSignalSemaphores    = signal_semaphores.data();
+
+    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &timeline_submit_info, fence))
+
+    if (fence != VK_NULL_HANDLE)
+    {
+        m_pending_fences.emplace_back(signal_value, fence);
+    }
+    m_last_submitted_value = signal_value;
+    return signal_value;
+}
+
+uint64_t VulkanTimeline::GetCompletedValue()
+{
+    if (m_timeline_semaphore_supported)
+    {
+        uint64_t value = 0;
+        VK_CHECK_RESULT(m_vkGetSemaphoreCounterValueKHR(m_device, m_semaphore, &value))
+        m_completed_value = std::max(m_completed_value, value);
+    }
+    else
+    {
+        retireFences(false, 0);
+    }
+    return m_completed_value;
+}
+
+void VulkanTimeline::Wait(uint64_t value)
+{
+    if (value <= m_completed_value)
+    {
+        return;
+    }
+    assert(value <= m_last_submitted_value);
+
+    if (m_timeline_semaphore_supported)
+    {
+        VkSemaphoreWaitInfoKHR wait_info{};
+        wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores    = &m_semaphore;
+        wait_info.pValues        = &value;
+        VK_CHECK_RESULT(m_vkWaitSemaphoresKHR(m_device, &wait_info, UINT64_MAX))
+        m_completed_value = std::max(m_completed_value, value);
+    }
+    else
+    {
+        retireFences(true, value);
+    }
+}
+
+VkFence VulkanTimeline::acquireFence()
+{
+    if (!m_free_fences.empty())
+    {
+        VkFence fence = m_free_fences.back();
+        m_free_fences.pop_back();
+        return fence;
+    }
+
+    VkFenceCreateInfo fence_create_info{};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    VK_CHECK_RESULT(vkCreateFence(m_device, &fence_create_info, nullptr, &fence))
+    return fence;
+}
+
+void VulkanTimeline::retireFences(bool wait, uint64_t value)
+{
+    // 同一队列上的提交按顺序完成，遇到第一个未完成的fence即可停止
+    while (!m_pending_fences.empty())
+    {
+        auto [fence_value, fence] = m_pending_fences.front();
+        if (wait && fence_value <= value)
+        {
+            VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX))
+        }
+        else if (vkGetFenceStatus(m_device, fence) != VK_SUCCESS)
+        {
+            break;
+        }
+
+        VK_CHECK_RESULT(vkResetFences(m_device, 1, &fence))
+        m_free_fences.push_back(fence);
+        m_pending_fences.pop_front();
+        m_completed_value = fence_value;
+    }
+}
@@ -100,13 +100,20 @@ void VulkanUtil::createBuffer(std::shared_ptr<VulkanContext> p_context,
                               VkBufferUsageFlags usage,
                               VkMemoryPropertyFlags properties,
                               VkBuffer &buffer,
-                              VkDeviceMemory &buffer_memory)
+                              VkDeviceMemory &buffer_memory,
+                              const std::vector<uint32_t> &concurrent_queue_families)
 {
     VkBufferCreateInfo buffer_create_info{};
     buffer_create_info.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_create_info.size        = size;
     buffer_create_info.usage       = usage;                     // use as a vertex/staging/index buffer
     buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // not sharing among queue families
+    if (concurrent_queue_families.size() > 1)
+    {
+        buffer_create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        buffer_create_info.queueFamilyIndexCount = static_cast<uint32_t>(concurrent_queue_families.size());
+        buffer_create_info.pQueueFamilyIndices   = concurrent_queue_families.data();
+    }
 
     if (vkCreateBuffer(p_context->_device, &buffer_create_info, nullptr, &buffer) != VK_SUCCESS)
     {
@@ -142,12 +149,16 @@ void VulkanUtil::copyBuffer(std::shared_ptr<VulkanContext> p_context,
 {
     assert(p_context);
 
-    VkCommandBuffer command_buffer = p_context->beginSingleTimeCommands();
+    VkCommandBuffer command_buffer = p_context->beginTransferCommands();
 
     VkBufferCopy copyRegion = {srcOffset, dstOffset, size};
     vkCmdCopyBuffer(command_buffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
-    p_context->endSingleTimeCommands(command_buffer);
+    VkBufferMemoryBarrier barrier{};
+    barrier.buffer = dstBuffer;
+    barrier.offset = dstOffset;
+    barrier.size   = size;
+    p_context->endTransferCommands(command_buffer, {barrier}, {});
 }
 
 void VulkanUtil::createImage(std::shared_ptr<VulkanContext> p_context,
@@ -406,10 +417,6 @@ void VulkanUtil::copyBufferToImage(std::shared_ptr<VulkanContext> p_context,
                                    uint32_t height,
                                    uint32_t layer_count)
 {
-    assert(p_context);
-
-    VkCommandBuffer commandBuffer = p_context->beginSingleTimeCommands();
-
     VkBufferImageCopy region{};
     region.bufferOffset                    = 0;
     region.bufferRowLength                 = 0;
@@ -421,52 +428,93 @@ void VulkanUtil::copyBufferToImage(std::shared_ptr<VulkanContext> p_context,
     region.imageOffset                     = {0, 0, 0};
     region.imageExtent                     = {width, height, 1};
 
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    copyBufferToImage(p_context, buffer, image, {region});
+}
 
-    p_context->endSingleTimeCommands(commandBuffer);
+void VulkanUtil::copyBufferToImage(std::shared_ptr<VulkanContext> p_context,
+                                   VkBuffer buffer,
+                                   VkImage image,
+                                   const std::vector<VkBufferImageCopy> &regions)
+{
+    assert(p_context);
+
+    VkCommandBuffer commandBuffer = p_context->beginTransferCommands();
+
+    // image在传输队列上转为TRANSFER_DST，原有内容被丢弃；
+    // 随后所有权交给图形队列，由调用方在图形队列上生成mip或转为着色器可读
+    VkImageMemoryBarrier barrier{};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask                   = 0;
+    barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = image;
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = VK_REMAINING_ARRAY_LAYERS;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()), regions.data());
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    p_context->endTransferCommands(commandBuffer, {}, {barrier});
 }
 
 void VulkanUtil::genMipmappedImage(std::shared_ptr<VulkanContext> p_context,
                                    VkImage image,
+                                   VkFormat image_format,
                                    uint32_t width,
                                    uint32_t height,
-                                   uint32_t mip_levels)
+                                   uint32_t mip_levels,
+                                   uint32_t layer_count)
 {
+    // 调用前所有mip层级都应处于TRANSFER_DST_OPTIMAL，且第0级已写入数据；
+    // 返回后整个mip链处于SHADER_READ_ONLY_OPTIMAL
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(p_context->_physical_device, image_format, &format_properties);
+    if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+    {
+        throw std::runtime_error("texture image format does not support linear blitting!");
+    }
+
     VkCommandBuffer commandBuffer = p_context->beginSingleTimeCommands();
 
+    VkImageMemoryBarrier barrier{};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = image;
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = layer_count;
+
+    int32_t mip_width  = static_cast<int32_t>(width);
+    int32_t mip_height = static_cast<int32_t>(height);
+
     for (uint32_t i = 1; i < mip_levels; i++)
     {
-        VkImageBlit imageBlit{};
-        imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageBlit.srcSubresource.layerCount = 1;
-        imageBlit.srcSubresource.mipLevel   = i - 1;
-        imageBlit.srcOffsets[1].x           = std::max((int32_t) (width >> (i - 1)), 1);
-        imageBlit.srcOffsets[1].y           = std::max((int32_t) (height >> (i - 1)), 1);
-        imageBlit.srcOffsets[1].z           = 1;
-
-        imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageBlit.dstSubresource.layerCount = 1;
-        imageBlit.dstSubresource.mipLevel   = i;
-        imageBlit.dstOffsets[1].x           = std::max((int32_t) (width >> i), 1);
-        imageBlit.dstOffsets[1].y           = std::max((int32_t) (height >> i), 1);
-        imageBlit.dstOffsets[1].z           = 1;
-
-        VkImageSubresourceRange mipSubRange{};
-        mipSubRange.aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT;
-        mipSubRange.baseMipLevel = i;
-        mipSubRange.levelCount   = 1;
-        mipSubRange.layerCount   = 1;
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.srcAccessMask       = 0;
-        barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image               = image;
-        barrier.subresourceRange    = mipSubRange;
+        // 上一级写入完成后转为blit源
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout                     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask                 = VK_ACCESS_TRANSFER_READ_BIT;
 
         vkCmdPipelineBarrier(commandBuffer,
                              VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -479,6 +527,23 @@ void VulkanUtil::genMipmappedImage(std::shared_ptr<VulkanContext> p_context,
                              1,
                              &barrier);
 
+        int32_t next_width  = std::max(mip_width / 2, 1);
+        int32_t next_height = std::max(mip_height / 2, 1);
+
+        // 一次blit覆盖所有array layer（cubemap的6个面/纹理数组）
+        VkImageBlit imageBlit{};
+        imageBlit.srcSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBlit.srcSubresource.mipLevel       = i - 1;
+        imageBlit.srcSubresource.baseArrayLayer = 0;
+        imageBlit.srcSubresource.layerCount     = layer_count;
+        imageBlit.srcOffsets[1]                 = {mip_width, mip_height, 1};
+
+        imageBlit.dstSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBlit.dstSubresource.mipLevel       = i;
+        imageBlit.dstSubresource.baseArrayLayer = 0;
+        imageBlit.dstSubresource.layerCount     = layer_count;
+        imageBlit.dstOffsets[1]                 = {next_width, next_height, 1};
+
         vkCmdBlitImage(commandBuffer,
                        image,
                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -488,14 +553,15 @@ void VulkanUtil::genMipmappedImage(std::shared_ptr<VulkanContext> p_context,
                        &imageBlit,
                        VK_FILTER_LINEAR);
 
-        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        // 上一级已不再被读取，直接转为着色器可读
+        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
         vkCmdPipelineBarrier(commandBuffer,
                              VK_PIPELINE_STAGE_TRANSFER_BIT,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                              0,
                              0,
                              nullptr,
@@ -503,24 +569,17 @@ void VulkanUtil::genMipmappedImage(std::shared_ptr<VulkanContext> p_context,
                              nullptr,
                              1,
                              &barrier);
+
+        mip_width  = next_width;
+        mip_height = next_height;
     }
 
-    VkImageSubresourceRange mipSubRange{};
-    mipSubRange.aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT;
-    mipSubRange.baseMipLevel = 0;
-    mipSubRange.levelCount   = mip_levels;
-    mipSubRange.layerCount   = 1;
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-    barrier.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
-    barrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image               = image;
-    barrier.subresourceRange    = mipSubRange;
+    // 最后一级只被写入过
+    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+    barrier.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout                     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask                 = VK_ACCESS_SHADER_READ_BIT;
 
     vkCmdPipelineBarrier(commandBuffer,
                          VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -684,7 +743,7 @@ VkSampler VulkanUtil::getOrCreateDepthSampler(std::shared_ptr<VulkanContext> p_c
     return m_depth_sampler;
 }
 
-VkSampler VulkanUtil::getOrCreateCubeMapSampler(std::shared_ptr<VulkanContext> p_context, uint32_t mip_levels)
+VkSampler VulkanUtil::getOrCreateCubeMapSampler(std::shared_ptr<VulkanContext> p_context)
 {
     if (m_cubemap_sampler==VK_NULL_HANDLE)
     {
@@ -706,10 +765,11 @@ VkSampler VulkanUtil::getOrCreateCubeMapSampler(std::shared_ptr<VulkanContext> p
         samplerInfo.unnormalizedCoordinates = VK_FALSE;
         samplerInfo.compareEnable           = VK_FALSE;
         samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
-        samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 
+        // sampler全局共享，实际可访问的层级由image view限制
         samplerInfo.minLod                  = 0.0f;
-        samplerInfo.maxLod                  = 8.0f; // todo: why??
+        samplerInfo.maxLod                  = VK_LOD_CLAMP_NONE;
 
         if (vkCreateSampler(p_context->_device, &samplerInfo, nullptr, &m_cubemap_sampler) != VK_SUCCESS)
         {
@@ -3,9 +3,13 @@
 //
 
 #include "render/defer_render.h"
+#include "render/resource/render_shadow_cascade.h"
+#include "render/resource/render_point_light_shadow.h"
 #include "render/renderpass/directional_light_shadow_pass.h"
+#include "render/renderpass/point_light_shadow_pass.h"
 #include "render/renderpass/main_camera_defer_pass.h"
 #include "render/renderpass/ui_overlay_pass.h"
+#include <imgui.h>
 
 using namespace RenderSystem;
 
@@ -17,9 +21,14 @@ void DeferRender::initialize()
 
     m_render_resource_info.p_render_submeshes              = &m_render_submeshes;
     m_render_resource_info.p_texture_descriptor_sets       = &m_texture_descriptor_sets;
-    m_render_resource_info.p_render_model_ubo_list         = &m_render_model_ubo_list;
+    m_render_resource_info.p_render_model_buffer           = &m_render_model_buffer;
     m_render_resource_info.p_render_light_project_ubo_list = &m_render_light_project_ubo_list;
     m_render_resource_info.p_render_per_frame_ubo          = &m_render_per_frame_ubo;
+    m_render_resource_info.p_render_point_light_shadow_ubo_list =
+            &m_render_point_light_shadow_ubo_list;
+    m_render_resource_info.p_meshlet_culling               = &m_meshlet_culling;
+    m_render_resource_info.p_light_cluster_culling         = &m_light_cluster_culling;
+    m_render_resource_info.p_shadow_atlas                  = &m_shadow_atlas;
     m_render_resource_info.p_ui_overlay                    = m_p_ui_overlay;
     m_render_resource_info.p_skybox_descriptor_set         = &m_skybox_descriptor_set;
     m_render_resource_info.p_directional_light_shadow_map_descriptor_set =
@@ -32,6 +41,10 @@ void DeferRender::initialize()
     setupDescriptorPool();
     setViewport();
     setupRenderDescriptorSetLayout();
+    m_meshlet_culling.Initialize();
+    m_light_cluster_culling.Initialize();
+    m_async_compute.Initialize(g_p_vulkan_context->_swapchain_images.size());
+    m_async_compute_enabled = g_p_vulkan_context->_timeline_semaphore_supported;
 }
 
 void DeferRender::postInitialize()
@@ -95,9 +108,11 @@ void DeferRender::setupDescriptorPool()
     std::vector<VkDescriptorPoolSize> descriptor_types =
                                               {
                                                       {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         3 + 3 + 1},
-                                                      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 + 1},
+                                                      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+                                                      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3},
                                                       {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       3 + 2},
-                                                      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8 + 1 + 1 + 1}
+                                                      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8 + 1 + 1 + 1 + 1},
+                                                      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         3 + 1 + 1 + 1}
                                               };
 
     VkDescriptorPoolCreateInfo descriptorPoolInfo{};
@@ -106,7 +121,7 @@ void DeferRender::setupDescriptorPool()
     descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(descriptor_types.size());
     descriptorPoolInfo.pPoolSizes    = descriptor_types.data();
     // NOTICE: the maxSets must be equal to the descriptorSets in all subpasses
-    descriptorPoolInfo.maxSets       = 13 + 1 + 1 + 2;
+    descriptorPoolInfo.maxSets       = 13 + 1 + 1 + 2 + 1;
 
     VK_CHECK_RESULT(vkCreateDescriptorPool(g_p_vulkan_context->_device,
                                            &descriptorPoolInfo,
@@ -116,31 +131,12 @@ void DeferRender::setupDescriptorPool()
 
 void DeferRender::setupBackupBuffer()
 {
-    m_backup_targets[0] = ImageAttachment{
-            VK_NULL_HANDLE,
-            VK_NULL_HANDLE,
-            VK_NULL_HANDLE,
-            VK_FORMAT_R8G8B8A8_UNORM,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-    VulkanUtil::createImage(g_p_vulkan_context,
-                            g_p_vulkan_context->_swapchain_extent.width,
-                            g_p_vulkan_context->_swapchain_extent.height,
-                            m_backup_targets[0].format,
-                            VK_IMAGE_TILING_OPTIMAL,
-                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                            m_backup_targets[0].image,
-                            m_backup_targets[0].mem,
-                            0,
-                            1,
-                            1);
-
-    m_backup_targets[0].view = VulkanUtil::createImageView(g_p_vulkan_context,
-                                                           m_backup_targets[0].image,
-                                                           m_backup_targets[0].format,
-                                                           VK_IMAGE_ASPECT_COLOR_BIT,
-                                                           VK_IMAGE_VIEW_TYPE_2D, 1);
+    m_backup_targets[0].format = VK_FORMAT_R8G8B8A8_UNORM;
+    m_backup_targets[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    m_backup_targets[0].usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    m_backup_targets[0].aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    m_backup_targets[0].fitExtent(g_p_vulkan_context->_swapchain_extent.width,
+                                  g_p_vulkan_context->_swapchain_extent.height);
 }
 
 void DeferRender::setViewport()
@@ -158,6 +154,7 @@ void DeferRender::setupRenderpass()
     m_render_passes.resize(_renderpass_count);
 
     m_render_passes[_directional_light_shadowmap_renderpass] = std::make_shared<DirectionalLightShadowRenderPass>();
+    m_render_passes[_point_light_shadowmap_renderpass]       = std::make_shared<PointLightShadowRenderPass>();
     m_render_passes[_main_camera_renderpass]                 = std::make_shared<MainCameraDeferRenderPass>();
     m_render_passes[_ui_overlay_renderpass]                  = std::make_shared<UIOverlayRenderPass>();
 
@@ -167,6 +164,12 @@ void DeferRender::setupRenderpass()
     directional_light_shadowmap_renderpass_init_info.descriptor_pool      = &m_descriptor_pool;
     directional_light_shadowmap_renderpass_init_info.shadowmap_attachment = &m_directional_light_shadow;
 
+    PointLightShadowRenderPassInitInfo point_light_shadowmap_renderpass_init_info;
+    point_light_shadowmap_renderpass_init_info.render_command_info  = &m_render_command_info;
+    point_light_shadowmap_renderpass_init_info.render_resource_info = &m_render_resource_info;
+    point_light_shadowmap_renderpass_init_info.descriptor_pool      = &m_descriptor_pool;
+    point_light_shadowmap_renderpass_init_info.shadowmap_attachment = &m_point_light_shadow;
+
     MainCameraDeferRenderPassInitInfo maincamera_renderpass_init_info;
     maincamera_renderpass_init_info.render_command_info  = &m_render_command_info;
     maincamera_renderpass_init_info.render_resource_info = &m_render_resource_info;
@@ -182,6 +185,7 @@ void DeferRender::setupRenderpass()
 
     m_render_passes[_directional_light_shadowmap_renderpass]->initialize(
             &directional_light_shadowmap_renderpass_init_info);
+    m_render_passes[_point_light_shadowmap_renderpass]->initialize(&point_light_shadowmap_renderpass_init_info);
     m_render_passes[_main_camera_renderpass]->initialize(&maincamera_renderpass_init_info);
     m_render_passes[_ui_overlay_renderpass]->initialize(&ui_overlay_renderpass_init_info);
 }
@@ -217,11 +221,35 @@ void DeferRender::draw()
 
     // record command buffer
     m_render_command_info.p_current_command_buffer = &m_primary_command_buffers[next_image_index];
+    std::vector<TimelineWait> compute_waits;
+    if (m_async_compute_enabled)
+    {
+        // 剔除结果只被主相机pass使用，阴影pass可以与之并行
+        VkCommandBuffer &compute_command_buffer = m_async_compute.BeginCompute(next_image_index);
+        m_meshlet_culling.Dispatch(compute_command_buffer, m_async_compute.GetComputeQueueFamily());
+        m_light_cluster_culling.Dispatch(compute_command_buffer, m_async_compute.GetComputeQueueFamily());
+        compute_waits.push_back(m_async_compute.SubmitCompute(
+                next_image_index, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+
+        m_render_command_info.p_current_command_buffer = &m_async_compute.BeginOverlappedGraphics(next_image_index);
+        drawShadowPasses(next_image_index);
+        m_async_compute.SubmitOverlappedGraphics(next_image_index);
+
+        m_render_command_info.p_current_command_buffer = &m_primary_command_buffers[next_image_index];
+        m_meshlet_culling.AcquireOwnership(m_primary_command_buffers[next_image_index]);
+        m_light_cluster_culling.AcquireOwnership(m_primary_command_buffers[next_image_index]);
+    }
+    else
+    {
+        // 剔除结果写入间接绘制缓冲，必须在render pass之外
+        m_meshlet_culling.Dispatch(m_primary_command_buffers[next_image_index]);
+        m_light_cluster_culling.Dispatch(m_primary_command_buffers[next_image_index]);
+        drawShadowPasses(next_image_index);
+    }
+
 #ifdef MULTI_THREAD_RENDERING
-    m_render_passes[_directional_light_shadowmap_renderpass]->drawMultiThreading(0, next_image_index);
     m_render_passes[_main_camera_renderpass]->drawMultiThreading(0, next_image_index);
 #else
-    m_render_passes[_directional_light_shadowmap_renderpass]->draw(0);
     m_render_passes[_main_camera_renderpass]->draw(0);
 #endif
     m_render_passes[_ui_overlay_renderpass]->draw(next_image_index);
@@ -231,23 +259,35 @@ void DeferRender::draw()
             m_primary_command_buffers[next_image_index]);
     assert(VK_SUCCESS == res_end_command_buffer);
 
-    g_p_vulkan_context->submitDrawSwapchainImageCmdBuffer(&m_primary_command_buffers[next_image_index]);
+    g_p_vulkan_context->submitDrawSwapchainImageCmdBuffer(&m_primary_command_buffers[next_image_index],
+                                                          compute_waits);
     g_p_vulkan_context->presentSwapchainImage(next_image_index, [this]
     { updateAfterSwapchainRecreate(); });
 }
 
+void DeferRender::drawShadowPasses(uint32_t image_index)
+{
+#ifdef MULTI_THREAD_RENDERING
+    m_render_passes[_directional_light_shadowmap_renderpass]->drawMultiThreading(0, image_index);
+    m_render_passes[_point_light_shadowmap_renderpass]->drawMultiThreading(0, image_index);
+#else
+    m_render_passes[_directional_light_shadowmap_renderpass]->draw(0);
+    m_render_passes[_point_light_shadowmap_renderpass]->draw(0);
+#endif
+}
+
 void DeferRender::UpdateRenderModelList(const std::vector<Scene::Model> &_visible_models,
                                         const std::vector<RenderSubmesh> &_visible_submeshes)
 {
-    if (m_render_model_ubo_list.ubo_data_list.size() != _visible_models.size())
+    if (m_render_model_buffer.data_list.size() != _visible_models.size())
     {
-        m_render_model_ubo_list.ubo_data_list.resize(_visible_models.size());
+        m_render_model_buffer.data_list.resize(_visible_models.size());
     }
 
     for (int i = 0; i < _visible_models.size(); ++i)
     {
-        m_render_model_ubo_list.ubo_data_list[i].model  = _visible_models[i].GetModelMatrix();
-        m_render_model_ubo_list.ubo_data_list[i].normal = _visible_models[i].GetNormalMatrix();
+        m_render_model_buffer.data_list[i].model  = _visible_models[i].GetModelMatrix();
+        m_render_model_buffer.data_list[i].normal = _visible_models[i].GetNormalMatrix();
     }
 
     m_render_submeshes.clear();
@@ -255,6 +295,8 @@ void DeferRender::UpdateRenderModelList(const std::vector<Scene::Model> &_visibl
     {
         m_render_submeshes.push_back(_visible_submeshes[i]);
     }
+    m_meshlet_culling.UpdateMeshlets(m_render_submeshes, m_render_model_buffer.data_list);
+    updateDrawListHash();
 }
 
 void DeferRender::UpdateRenderPerFrameScenceUBO(
@@ -263,8 +305,13 @@ void DeferRender::UpdateRenderPerFrameScenceUBO(
         std::vector<Scene::DirectionLight> &directional_light_list)
 {
     m_render_per_frame_ubo.scene_data_ubo.proj_view                = proj_view;
+    m_render_per_frame_ubo.scene_data_ubo.inv_proj_view            = proj_view.inverse();
     m_render_per_frame_ubo.scene_data_ubo.camera_pos               = camera_pos;
     m_render_per_frame_ubo.scene_data_ubo.directional_light_number = directional_light_list.size();
+    m_render_per_frame_ubo.scene_data_ubo.shadow_cascade_count     =
+            ShadowCascade::GetCascadeCount(m_render_resource_info.kDirectionalLightInfo);
+    m_render_per_frame_ubo.scene_data_ubo.light_proj_stride        =
+            m_render_light_project_ubo_list.dynamic_alignment / (4 * sizeof(float));
     assert(directional_light_list.size() <= MAX_DIRECTIONAL_LIGHT_COUNT);
     for (int i = 0; i < directional_light_list.size(); ++i)
     {
@@ -272,43 +319,44 @@ void DeferRender::UpdateRenderPerFrameScenceUBO(
         m_render_per_frame_ubo.directional_lights_ubo[i].color     = directional_light_list[i].color;
         m_render_per_frame_ubo.directional_lights_ubo[i].direction = -directional_light_list[i].transform.GetForward();
     }
+    m_meshlet_culling.UpdateCamera(proj_view, camera_pos);
 }
 
-void DeferRender::UpdateLightProjectionList(std::vector<Scene::DirectionLight> &directional_light_list)
+void DeferRender::UpdateLightProjectionList(const RenderCameraInfo &camera_info,
+                                             std::vector<Scene::DirectionLight> &directional_light_list)
 {
-    if (m_render_light_project_ubo_list.ubo_data_list.size() != directional_light_list.size())
-    {
-        m_render_light_project_ubo_list.ubo_data_list.resize(directional_light_list.size());
-    }
-
-    for (int i = 0; i < directional_light_list.size(); ++i)
-    {
-        auto dummy_transform = directional_light_list[i].transform;
-        auto forward         = dummy_transform.GetForward();
-        auto projection      = Math::Matrix4x4::makeOrthogonalMatrix(
-                m_render_resource_info.kDirectionalLightInfo.camera_width,
-                m_render_resource_info.kDirectionalLightInfo.camera_height,
-                m_render_resource_info.kDirectionalLightInfo.camera_near,
-                m_render_resource_info.kDirectionalLightInfo.camera_far);
-
-//        auto projection      = Math::Matrix4x4::makePerspectiveMatrix(90,1.33,1.0,50);
-
-        forward.normalise();
-        dummy_transform.position = Math::Vector3(10, 0, -10) - forward * 30;
-
-        auto r_inverse   = getRotationMatrix(dummy_transform.rotation).transpose();
-        auto t_inverse   = Matrix4x4::getTrans(-dummy_transform.position);
-        auto view_matrix = r_inverse * t_inverse;
+    const auto &light_info = m_render_resource_info.kDirectionalLightInfo;
+    m_shadow_atlas.Update(directional_light_list, ShadowCascade::GetCascadeCount(light_info));
+    ShadowCascade::UpdateLightProjections(camera_info,
+                                          directional_light_list,
+                                          light_info,
+                                          m_shadow_atlas,
+                                          m_render_light_project_ubo_list.ubo_data_list);
+}
 
-        m_render_light_project_ubo_list.ubo_data_list[i].light_proj = projection * view_matrix;
-    }
+void DeferRender::UpdateLocalLightList(const RenderCameraInfo &camera_info,
+                                       std::vector<Scene::PointLight> &point_light_list,
+                                       std::vector<Scene::SpotLight> &spot_light_list)
+{
+    m_light_cluster_culling.UpdateLights(point_light_list, spot_light_list);
+    m_light_cluster_culling.UpdateCamera(camera_info, m_render_per_frame_ubo.scene_data_ubo);
+    PointLightShadow::UpdateShadowProjections(point_light_list,
+                                              spot_light_list,
+                                              m_render_resource_info.kPointLightShadowInfo,
+                                              m_render_point_light_shadow_ubo_list.ubo_data_list);
+    m_render_per_frame_ubo.scene_data_ubo.inv_screen_width  = 1.0f / m_viewport.width;
+    m_render_per_frame_ubo.scene_data_ubo.inv_screen_height = 1.0f / m_viewport.height;
 }
 
 void DeferRender::FlushRenderbuffer()
 {
     m_render_per_frame_ubo.ToGPU();
-    m_render_model_ubo_list.ToGPU();
+    m_render_model_buffer.ToGPU();
     m_render_light_project_ubo_list.ToGPU();
+    if (!m_render_point_light_shadow_ubo_list.ubo_data_list.empty())
+    {
+        m_render_point_light_shadow_ubo_list.ToGPU();
+    }
 }
 
 void DeferRender::setupRenderDescriptorSetLayout()
@@ -362,7 +410,7 @@ void DeferRender::setupRenderDescriptorSetLayout()
                                                 &m_skybox_descriptor_set_layout));
 
     std::vector<VkDescriptorSetLayoutBinding> light_project_layout_bindings;
-    light_project_layout_bindings.resize(1);
+    light_project_layout_bindings.resize(2);
 
     VkDescriptorSetLayoutBinding &light_project_binding = light_project_layout_bindings[0];
     light_project_binding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -370,6 +418,13 @@ void DeferRender::setupRenderDescriptorSetLayout()
     light_project_binding.binding         = 0;
     light_project_binding.descriptorCount = 1;
 
+    // 点光源阴影cube array
+    VkDescriptorSetLayoutBinding &point_light_shadow_binding = light_project_layout_bindings[1];
+    point_light_shadow_binding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    point_light_shadow_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+    point_light_shadow_binding.binding         = 1;
+    point_light_shadow_binding.descriptorCount = 1;
+
     VkDescriptorSetLayoutCreateInfo light_project_desc_set_layout_create_info;
     light_project_desc_set_layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     light_project_desc_set_layout_create_info.flags        = 0;
@@ -385,39 +440,54 @@ void DeferRender::setupRenderDescriptorSetLayout()
 
 void DeferRender::SetupModelRenderTextures(const std::vector<Texture2DPtr> &_visible_textures)
 {
-    // wait for device idle
-    // 很慢的，慎用
-    vkDeviceWaitIdle(g_p_vulkan_context->_device);
-    if (m_texture_descriptor_sets.size() != _visible_textures.size())
+    ++m_texture_generation;
+
+    // 之前的帧可能还在使用旧的descriptor set，不能原地更新或立即释放；
+    // 每次都从新的pool分配，旧pool交给延迟删除队列，在引用它的帧完成后销毁
+    if (m_texture_descriptor_pool != VK_NULL_HANDLE)
     {
-        if (!m_texture_descriptor_sets.empty())
-        {
-            g_p_vulkan_context->_vkFreeDescriptorSets(g_p_vulkan_context->_device,
-                                                      m_descriptor_pool,
-                                                      m_texture_descriptor_sets.size(),
-                                                      m_texture_descriptor_sets.data());
-        }
-
-        m_texture_descriptor_sets.resize(_visible_textures.size());
-        if (!m_texture_descriptor_sets.empty())
-        {
-            std::vector<VkDescriptorSetLayout> layouts(m_texture_descriptor_sets.size(),
-                                                       m_texture_descriptor_set_layout);
-
-            VkDescriptorSetAllocateInfo texture_descriptor_set_allocate_info;
-            texture_descriptor_set_allocate_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            texture_descriptor_set_allocate_info.pNext              = nullptr;
-            texture_descriptor_set_allocate_info.descriptorPool     = m_descriptor_pool;
-            texture_descriptor_set_allocate_info.descriptorSetCount = layouts.size();
-            texture_descriptor_set_allocate_info.pSetLayouts        = layouts.data();
-
-            VK_CHECK_RESULT(vkAllocateDescriptorSets(g_p_vulkan_context->_device,
-                                                     &texture_descriptor_set_allocate_info,
-                                                     m_texture_descriptor_sets.data()));
-        }
+        VkDevice         device       = g_p_vulkan_context->_device;
+        VkDescriptorPool retired_pool = m_texture_descriptor_pool;
+        g_p_vulkan_context->_deletion_queue.Push([device, retired_pool]()
+                                                 {
+                                                     vkDestroyDescriptorPool(device, retired_pool, nullptr);
+                                                 });
+        m_texture_descriptor_pool = VK_NULL_HANDLE;
     }
 
-    assert(m_texture_descriptor_sets.size() == _visible_textures.size());
+    m_texture_descriptor_sets.resize(_visible_textures.size());
+    if (m_texture_descriptor_sets.empty())
+    {
+        return;
+    }
+
+    VkDescriptorPoolSize texture_pool_size{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                           static_cast<uint32_t>(m_texture_descriptor_sets.size())};
+
+    VkDescriptorPoolCreateInfo texture_pool_info{};
+    texture_pool_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    texture_pool_info.poolSizeCount = 1;
+    texture_pool_info.pPoolSizes    = &texture_pool_size;
+    texture_pool_info.maxSets       = static_cast<uint32_t>(m_texture_descriptor_sets.size());
+
+    VK_CHECK_RESULT(vkCreateDescriptorPool(g_p_vulkan_context->_device,
+                                           &texture_pool_info,
+                                           nullptr,
+                                           &m_texture_descriptor_pool))
+
+    std::vector<VkDescriptorSetLayout> layouts(m_texture_descriptor_sets.size(),
+                                               m_texture_descriptor_set_layout);
+
+    VkDescriptorSetAllocateInfo texture_descriptor_set_allocate_info;
+    texture_descriptor_set_allocate_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    texture_descriptor_set_allocate_info.pNext              = nullptr;
+    texture_descriptor_set_allocate_info.descriptorPool     = m_texture_descriptor_pool;
+    texture_descriptor_set_allocate_info.descriptorSetCount = layouts.size();
+    texture_descriptor_set_allocate_info.pSetLayouts        = layouts.data();
+
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(g_p_vulkan_context->_device,
+                                             &texture_descriptor_set_allocate_info,
+                                             m_texture_descriptor_sets.data()))
 
     for (int i = 0; i < _visible_textures.size(); ++i)
     {
@@ -497,7 +567,9 @@ void DeferRender::SetupSkyboxTexture(const std::shared_ptr<TextureCube> &skybox_
 
 void DeferRender::SetupShadowMapTexture(std::vector<Scene::DirectionLight> &directional_light_list)
 {
-    uint32_t directional_light_num = directional_light_list.size();
+    const auto &light_info = m_render_resource_info.kDirectionalLightInfo;
+    m_shadow_atlas.Initialize(light_info.shadow_atlas_size, light_info.max_shadow_tile_size);
+    m_shadow_atlas.Update(directional_light_list, ShadowCascade::GetCascadeCount(light_info));
 
     if (m_directional_light_shadow_set != VK_NULL_HANDLE)
     {
@@ -526,44 +598,73 @@ void DeferRender::SetupShadowMapTexture(std::vector<Scene::DirectionLight> &dire
         m_directional_light_shadow.destroy();
     }
 
-    m_directional_light_shadow.width       = m_render_resource_info.kDirectionalLightInfo.shadowmap_width;
-    m_directional_light_shadow.height      = m_render_resource_info.kDirectionalLightInfo.shadowmap_height;
-    m_directional_light_shadow.layer_count = directional_light_num;
-    m_directional_light_shadow.format      = m_render_resource_info.kDirectionalLightInfo.depth_format;
+    // 所有级联打包到一张图集
+    m_directional_light_shadow.width       = light_info.shadow_atlas_size;
+    m_directional_light_shadow.height      = light_info.shadow_atlas_size;
+    m_directional_light_shadow.layer_count = 1;
+    m_directional_light_shadow.format      = light_info.depth_format;
     m_directional_light_shadow.layout      = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // 每帧从静态阴影缓存拷贝
     m_directional_light_shadow.usage =
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     m_directional_light_shadow.aspect    = VK_IMAGE_ASPECT_DEPTH_BIT;
-    m_directional_light_shadow.view_type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    m_directional_light_shadow.view_type = VK_IMAGE_VIEW_TYPE_2D;
     m_directional_light_shadow.init();
 
-    VkDescriptorImageInfo info;
+    // 点光源阴影与光源数量无关，只创建一次
+    if (m_point_light_shadow.image == VK_NULL_HANDLE)
+    {
+        const auto &point_shadow_info = m_render_resource_info.kPointLightShadowInfo;
+        m_point_light_shadow.width        = point_shadow_info.shadowmap_size;
+        m_point_light_shadow.height       = point_shadow_info.shadowmap_size;
+        m_point_light_shadow.layer_count  = MAX_POINT_LIGHT_SHADOW_COUNT * PointLightShadow::kFaceCount;
+        m_point_light_shadow.format       = point_shadow_info.depth_format;
+        m_point_light_shadow.layout       = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        m_point_light_shadow.usage        = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        m_point_light_shadow.aspect       = VK_IMAGE_ASPECT_DEPTH_BIT;
+        m_point_light_shadow.view_type    = VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+        m_point_light_shadow.create_flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+        m_point_light_shadow.init();
+    }
+
+    VkDescriptorImageInfo infos[2];
+
+    infos[0].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    infos[0].imageView   = m_directional_light_shadow.view;
+    infos[0].sampler     = VulkanUtil::getOrCreateDepthSampler(g_p_vulkan_context);
 
-    info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-    info.imageView   = m_directional_light_shadow.view;
-    info.sampler     = VulkanUtil::getOrCreateDepthSampler(g_p_vulkan_context);
+    infos[1].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    infos[1].imageView   = m_point_light_shadow.view;
+    infos[1].sampler     = VulkanUtil::getOrCreateDepthSampler(g_p_vulkan_context);
 
-    VkWriteDescriptorSet descriptor_write{};
-    descriptor_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_write.dstSet          = m_directional_light_shadow_set;
-    descriptor_write.dstBinding      = 0;
-    descriptor_write.dstArrayElement = 0;
-    descriptor_write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptor_write.descriptorCount = 1;
-    descriptor_write.pImageInfo      = &info;
+    VkWriteDescriptorSet descriptor_writes[2] = {};
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        descriptor_writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[i].dstSet          = m_directional_light_shadow_set;
+        descriptor_writes[i].dstBinding      = i;
+        descriptor_writes[i].dstArrayElement = 0;
+        descriptor_writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptor_writes[i].descriptorCount = 1;
+        descriptor_writes[i].pImageInfo      = &infos[i];
+    }
 
     vkUpdateDescriptorSets(g_p_vulkan_context->_device,
-                           1,
-                           &descriptor_write,
+                           sizeof(descriptor_writes) / sizeof(descriptor_writes[0]),
+                           descriptor_writes,
                            0,
                            nullptr);
 }
 
 void DeferRender::updateAfterSwapchainRecreate()
 {
-    vkDestroyImage(g_p_vulkan_context->_device, m_backup_targets[0].image, nullptr);
-    vkDestroyImageView(g_p_vulkan_context->_device, m_backup_targets[0].view, nullptr);
-    vkFreeMemory(g_p_vulkan_context->_device, m_backup_targets[0].mem, nullptr);
+    // 屏幕大小的附件都按同样的规则只增不减，缩小时全部原样复用，各pass的descriptor不变；
+    // 放大时各pass要重写引用新附件的descriptor，需要先等在途帧执行完
+    if (!m_backup_targets[0].fits(g_p_vulkan_context->_swapchain_extent.width,
+                                  g_p_vulkan_context->_swapchain_extent.height))
+    {
+        g_p_vulkan_context->_graphics_timeline.WaitIdle();
+    }
 
     setupBackupBuffer();
     setupRenderTargets();
@@ -579,12 +680,33 @@ void DeferRender::destroy()
 {
     g_p_vulkan_context->waitForFrameInFlightFence();
     vkDeviceWaitIdle(g_p_vulkan_context->_device);
+    m_meshlet_culling.Destroy();
+    m_light_cluster_culling.Destroy();
+    m_async_compute.Destroy();
+    if (m_point_light_shadow.image != VK_NULL_HANDLE)
+    {
+        m_point_light_shadow.destroy();
+    }
+    if (m_texture_descriptor_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(g_p_vulkan_context->_device, m_texture_descriptor_pool, nullptr);
+    }
     vkDestroyDescriptorSetLayout(g_p_vulkan_context->_device, m_texture_descriptor_set_layout, nullptr);
     vkDestroyDescriptorSetLayout(g_p_vulkan_context->_device, m_skybox_descriptor_set_layout, nullptr);
 
     vkDestroyCommandPool(g_p_vulkan_context->_device, m_primary_command_pool, nullptr);
     vkDestroyDescriptorPool(g_p_vulkan_context->_device, m_descriptor_pool, nullptr);
-}
-
 
+    // 设备已经空闲，剩下的延迟销毁可以立即执行
+    g_p_vulkan_context->_deletion_queue.Flush();
+}
 
+void DeferRender::ImGuiDebugPanel()
+{
+    ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+    if (ImGui::TreeNode("DeferRender"))
+    {
+        ImGui::Checkbox("async compute culling", &m_async_compute_enabled);
+        ImGui::TreePop();
+    }
+}
@@ -1,5 +1,6 @@
 #include "render/render_base.h"
 #include "render/common_define.h"
+#include <imgui.h>
 
 namespace RenderSystem
 {
@@ -14,6 +15,112 @@ namespace RenderSystem
         g_p_vulkan_context = std::make_shared<VulkanContext>();
         g_p_vulkan_context->initialize(window);
     }
+
+    void RenderBase::clearGlobally()
+    {
+        g_p_vulkan_context->clear();
+    }
+
+    void RenderBase::FramePacingDebugPanel()
+    {
+        static const VkPresentModeKHR kPresentModes[]     = {VK_PRESENT_MODE_FIFO_KHR,
+                                                             VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                                             VK_PRESENT_MODE_MAILBOX_KHR,
+                                                             VK_PRESENT_MODE_IMMEDIATE_KHR};
+        static const char *const      kPresentModeNames[] = {"FIFO", "FIFO relaxed", "mailbox", "immediate"};
+
+        ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+        if (ImGui::TreeNode("FramePacing"))
+        {
+            FramePacingSettings settings = g_p_vulkan_context->getFramePacingSettings();
+
+            int present_mode_index = 0;
+            for (int i = 0; i < IM_ARRAYSIZE(kPresentModes); ++i)
+            {
+                if (kPresentModes[i] == settings.present_mode)
+                {
+                    present_mode_index = i;
+                }
+            }
+            bool changed = ImGui::Combo("present mode", &present_mode_index, kPresentModeNames,
+                                        IM_ARRAYSIZE(kPresentModeNames));
+            settings.present_mode = kPresentModes[present_mode_index];
+
+            int frames_in_flight = static_cast<int>(settings.frames_in_flight);
+            changed |= ImGui::SliderInt("frames in flight", &frames_in_flight, 1, VulkanContext::kMaxFramesInFlight);
+            settings.frames_in_flight = static_cast<uint32_t>(frames_in_flight);
+
+            changed |= ImGui::DragFloat("max frame rate", &settings.max_frame_rate, 1.0f, 0.0f, 1000.0f, "%.0f");
+
+            if (changed)
+            {
+                g_p_vulkan_context->setFramePacingSettings(settings);
+            }
+
+            const FrameLatencyStats &latency = g_p_vulkan_context->getFrameLatencyStats();
+            ImGui::Text("input to submit: %.2f ms", latency.input_to_submit_ms);
+            ImGui::Text("input to %s: %.2f ms", latency.present_wait_timing ? "present" : "gpu done",
+                        latency.input_to_present_ms);
+            ImGui::Text("pending deletions: %zu", g_p_vulkan_context->_deletion_queue.GetPendingCount());
+            ImGui::TreePop();
+        }
+    }
+
+    void RenderBase::updateDrawListHash()
+    {
+        uint64_t hash    = kHashSeed;
+        auto     combine = [&hash](const void *data, size_t size)
+        {
+            HashCombine(hash, data, size);
+        };
+
+        for (const auto &submesh: *m_render_resource_info.p_render_submeshes)
+        {
+            const auto        parent_mesh = submesh.parent_mesh.lock();
+            const RenderMesh *mesh        = parent_mesh.get();
+            uint32_t          model_index = parent_mesh != nullptr ? parent_mesh->m_index_in_model_buffer : 0;
+            combine(&mesh, sizeof(mesh));
+            combine(&model_index, sizeof(model_index));
+            // 录制时绑定的是buffer句柄，mesh重新上传后指针不变但句柄已经换掉
+            if (mesh != nullptr)
+            {
+                VkBuffer buffers[] = {mesh->mesh_vertex_position_buffer, mesh->mesh_vertex_normal_buffer,
+                                      mesh->mesh_vertex_texcoord_buffer, mesh->mesh_index_buffer};
+                combine(buffers, sizeof(buffers));
+                combine(&mesh->m_index_type, sizeof(mesh->m_index_type));
+            }
+            combine(&submesh.index_count, sizeof(submesh.index_count));
+            combine(&submesh.index_offset, sizeof(submesh.index_offset));
+            combine(&submesh.vertex_offset, sizeof(submesh.vertex_offset));
+            combine(&submesh.material_index, sizeof(submesh.material_index));
+            combine(&submesh.shadow_index_count, sizeof(submesh.shadow_index_count));
+            combine(&submesh.shadow_index_offset, sizeof(submesh.shadow_index_offset));
+            combine(&submesh.meshlet_draw_offset, sizeof(submesh.meshlet_draw_offset));
+            combine(&submesh.meshlet_count, sizeof(submesh.meshlet_count));
+            combine(&submesh.is_static, sizeof(submesh.is_static));
+        }
+
+        const auto &texture_sets = *m_render_resource_info.p_texture_descriptor_sets;
+        combine(texture_sets.data(), texture_sets.size() * sizeof(VkDescriptorSet));
+        combine(&m_texture_generation, sizeof(m_texture_generation));
+
+        // 阴影图集和天空盒重建时descriptor set会重新分配
+        VkDescriptorSet shadow_map_set = *m_render_resource_info.p_directional_light_shadow_map_descriptor_set;
+        VkDescriptorSet skybox_set     = *m_render_resource_info.p_skybox_descriptor_set;
+        combine(&shadow_map_set, sizeof(shadow_map_set));
+        combine(&skybox_set, sizeof(skybox_set));
+
+        uint32_t meshlet_generation = m_render_resource_info.p_meshlet_culling->GetBufferGeneration();
+        uint32_t meshlet_count      = m_render_resource_info.p_meshlet_culling->GetMeshletCount();
+        combine(&meshlet_generation, sizeof(meshlet_generation));
+        combine(&meshlet_count, sizeof(meshlet_count));
+
+        // 模型storage buffer按帧槽位切换region，录制时烘焙的dynamic offset随之变化
+        uint32_t model_dynamic_offset = m_render_resource_info.p_render_model_buffer->GetDynamicOffset();
+        combine(&model_dynamic_offset, sizeof(model_dynamic_offset));
+
+        m_render_resource_info.draw_list_hash = hash;
+    }
 }
 
 
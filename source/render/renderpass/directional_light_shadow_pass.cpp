@@ -4,8 +4,10 @@
 
 #include "render/renderpass/directional_light_shadow_pass.h"
 #include "render/subpass/directional_light_shadow.h"
+#include "render/resource/render_mesh.h"
 #include "mesh_directional_light_shadow_vert.h"
 #include "mesh_directional_light_shadow_frag.h"
+#include <numeric>
 
 using namespace RenderSystem;
 
@@ -17,61 +19,77 @@ void DirectionalLightShadowRenderPass::initialize(RenderPassInitInfo *renderpass
     m_p_shadowmap_attachment = direction_light_shadow_renderpass_init_info->shadowmap_attachment;
 
     setupRenderpassAttachments();
+    setupStaticCache();
     setupRenderPass();
     setupFrameBuffer();
     setupSubpass();
 #ifdef MULTI_THREAD_RENDERING
-    setupMultiThreading(m_p_shadowmap_attachment->layer_count * MESH_DRAW_THREAD_NUM);
+    // 所有tile在同一个renderpass中绘制，线程数与光源数量无关
+    setupMultiThreading(MESH_DRAW_THREAD_NUM);
+    // 静态缓存和动态投射体使用同一组线程，但secondary command buffer要分开
+    allocateThreadData(m_static_thread_data, MESH_DRAW_THREAD_NUM);
 #endif
 }
 
 void DirectionalLightShadowRenderPass::setupRenderpassAttachments()
 {
     assert(m_p_shadowmap_attachment != nullptr);
-    uint32_t direction_light_nums = m_p_shadowmap_attachment->layer_count;
 
-    m_renderpass_attachments.resize(direction_light_nums);
+    m_renderpass_attachments.resize(_direction_light_attachment_count);
 
-    for (int i = 0; i < direction_light_nums; ++i)
-    {
-        m_renderpass_attachments[i] = *m_p_shadowmap_attachment;
-
-        m_renderpass_attachments[i].layer_count = 1;
-        m_renderpass_attachments[i].view        = VulkanUtil::createImageView(g_p_vulkan_context,
-                                                                              m_renderpass_attachments[i].image,
-                                                                              m_renderpass_attachments[i].format,
-                                                                              VK_IMAGE_ASPECT_DEPTH_BIT,
-                                                                              VK_IMAGE_VIEW_TYPE_2D, 1,
-                                                                              i, 1);
-    }
+    m_renderpass_attachments[_direction_light_attachment_depth]      = *m_p_shadowmap_attachment;
+    m_renderpass_attachments[_direction_light_attachment_depth].view =
+            VulkanUtil::createImageView(g_p_vulkan_context,
+                                        m_p_shadowmap_attachment->image,
+                                        m_p_shadowmap_attachment->format,
+                                        VK_IMAGE_ASPECT_DEPTH_BIT,
+                                        VK_IMAGE_VIEW_TYPE_2D, 1,
+                                        0, 1);
 }
 
-void DirectionalLightShadowRenderPass::setupRenderPass()
+void DirectionalLightShadowRenderPass::setupStaticCache()
 {
-    std::vector<VkAttachmentDescription> attachments;
-    attachments.resize(_direction_light_attachment_count);
+    m_static_cache.width       = m_p_shadowmap_attachment->width;
+    m_static_cache.height      = m_p_shadowmap_attachment->height;
+    m_static_cache.layer_count = 1;
+    m_static_cache.format      = m_p_shadowmap_attachment->format;
+    m_static_cache.usage       = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    m_static_cache.aspect      = VK_IMAGE_ASPECT_DEPTH_BIT;
+    m_static_cache.view_type   = VK_IMAGE_VIEW_TYPE_2D;
+    m_static_cache.init();
+
+    m_static_cache_initialized = false;
+    m_static_cache_light_proj.clear();
+    m_static_cache_tiles.clear();
+    m_static_cache_valid.clear();
+}
 
-    VkAttachmentDescription &depth_attachment_description = attachments[0];
-    depth_attachment_description.format         = m_renderpass_attachments[0].format;
+static VkRenderPass createShadowRenderPass(VkFormat format,
+                                           VkAttachmentLoadOp load_op,
+                                           VkImageLayout initial_layout,
+                                           VkImageLayout final_layout,
+                                           VkPipelineStageFlags src_stage_mask,
+                                           VkAccessFlags src_access_mask,
+                                           VkPipelineStageFlags dst_stage_mask,
+                                           VkAccessFlags dst_access_mask)
+{
+    VkAttachmentDescription depth_attachment_description{};
+    depth_attachment_description.format         = format;
     depth_attachment_description.samples        = VK_SAMPLE_COUNT_1_BIT;
-    depth_attachment_description.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment_description.loadOp         = load_op;
     depth_attachment_description.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
     depth_attachment_description.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depth_attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     // renderpass初始化和结束时图像的布局
-    depth_attachment_description.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-    depth_attachment_description.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-
-    std::vector<VkSubpassDescription> subpasses;
-    subpasses.resize(_direction_light_shadow_subpass_count);
+    depth_attachment_description.initialLayout  = initial_layout;
+    depth_attachment_description.finalLayout    = final_layout;
 
     VkAttachmentReference depth_attachment_reference{};
     depth_attachment_reference.attachment = 0;
     // 指定在subpass执行时，管线访问图像的布局
     depth_attachment_reference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkSubpassDescription &base_pass = subpasses[_direction_light_shadow_subpass_shadow];
+    VkSubpassDescription base_pass{};
     base_pass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
     base_pass.colorAttachmentCount    = 0;
     base_pass.pColorAttachments       = nullptr;
@@ -79,69 +97,107 @@ void DirectionalLightShadowRenderPass::setupRenderPass()
     base_pass.preserveAttachmentCount = 0;
     base_pass.pPreserveAttachments    = NULL;
 
+    VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
     std::vector<VkSubpassDependency> dependencies;
     dependencies.resize(2);
 
     VkSubpassDependency &base_pass_dependency = dependencies[0];
     base_pass_dependency.srcSubpass      = VK_SUBPASS_EXTERNAL;
-    base_pass_dependency.dstSubpass      = _direction_light_shadow_subpass_shadow;
-    base_pass_dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    base_pass_dependency.dstStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    base_pass_dependency.srcAccessMask   = VK_ACCESS_NONE;
-    base_pass_dependency.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    base_pass_dependency.dstSubpass      = 0;
+    base_pass_dependency.srcStageMask    = src_stage_mask;
+    base_pass_dependency.dstStageMask    = depth_stages;
+    base_pass_dependency.srcAccessMask   = src_access_mask;
+    base_pass_dependency.dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     base_pass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     VkSubpassDependency &other_pass_dependency = dependencies[1];
-    other_pass_dependency.srcSubpass      = _direction_light_shadow_subpass_shadow;
+    other_pass_dependency.srcSubpass      = 0;
     other_pass_dependency.dstSubpass      = VK_SUBPASS_EXTERNAL;
-    other_pass_dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    other_pass_dependency.dstStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    other_pass_dependency.srcAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    other_pass_dependency.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    other_pass_dependency.srcStageMask    = depth_stages;
+    other_pass_dependency.dstStageMask    = dst_stage_mask;
+    other_pass_dependency.srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    other_pass_dependency.dstAccessMask   = dst_access_mask;
     other_pass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     VkRenderPassCreateInfo renderpass_create_info{};
     renderpass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderpass_create_info.attachmentCount = attachments.size();
-    renderpass_create_info.pAttachments    = attachments.data();
-    renderpass_create_info.subpassCount    = subpasses.size();
-    renderpass_create_info.pSubpasses      = subpasses.data();
+    renderpass_create_info.attachmentCount = 1;
+    renderpass_create_info.pAttachments    = &depth_attachment_description;
+    renderpass_create_info.subpassCount    = 1;
+    renderpass_create_info.pSubpasses      = &base_pass;
     renderpass_create_info.dependencyCount = dependencies.size();
     renderpass_create_info.pDependencies   = dependencies.data();
 
+    VkRenderPass renderpass = VK_NULL_HANDLE;
     if (vkCreateRenderPass(
             g_p_vulkan_context->_device, &renderpass_create_info,
-            nullptr, &m_renderpass) != VK_SUCCESS)
+            nullptr, &renderpass) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to create main camera render pass");
+        throw std::runtime_error("failed to create directional light shadow render pass");
     }
+    return renderpass;
+}
+
+void DirectionalLightShadowRenderPass::setupRenderPass()
+{
+    static_assert(_direction_light_attachment_count == 1 && _direction_light_shadow_subpass_count == 1);
+
+    // 动态投射体绘制在静态缓存的拷贝之上，渲染结束后供光照pass采样
+    m_renderpass = createShadowRenderPass(m_renderpass_attachments[_direction_light_attachment_depth].format,
+                                          VK_ATTACHMENT_LOAD_OP_LOAD,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                          VK_ACCESS_SHADER_READ_BIT);
+
+    // 静态缓存只重绘部分tile，其余tile保留；前后可能是上一次的拷贝或另一个缓存renderpass
+    m_static_cache_renderpass = createShadowRenderPass(m_static_cache.format,
+                                                       VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                                       VK_ACCESS_TRANSFER_READ_BIT);
 }
 
 void DirectionalLightShadowRenderPass::setupFrameBuffer()
 {
-    uint32_t direction_light_nums = m_p_shadowmap_attachment->layer_count;
-    assert(m_renderpass_attachments.size() == direction_light_nums);
+    m_framebuffer_per_rendertarget.resize(1);
+
+    VkFramebufferCreateInfo framebuffer_create_info{};
+    framebuffer_create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_create_info.renderPass      = m_renderpass;
+    framebuffer_create_info.attachmentCount = _direction_light_attachment_count;
+    framebuffer_create_info.pAttachments    = &m_renderpass_attachments[_direction_light_attachment_depth].view;
+    framebuffer_create_info.width           = m_p_shadowmap_attachment->width;
+    framebuffer_create_info.height          = m_p_shadowmap_attachment->height;
+    framebuffer_create_info.layers          = 1;
+
+    if (vkCreateFramebuffer(g_p_vulkan_context->_device,
+                            &framebuffer_create_info,
+                            nullptr,
+                            &m_framebuffer_per_rendertarget[0]) != VK_SUCCESS)
+    {
+        throw std::runtime_error("create directional light shadow framebuffer");
+    }
 
-    m_framebuffer_per_rendertarget.resize(direction_light_nums);
+    // 两个renderpass兼容，静态缓存的framebuffer只是换了attachment
+    framebuffer_create_info.renderPass   = m_static_cache_renderpass;
+    framebuffer_create_info.pAttachments = &m_static_cache.view;
 
-    for (int i = 0; i < direction_light_nums; ++i)
+    if (vkCreateFramebuffer(g_p_vulkan_context->_device,
+                            &framebuffer_create_info,
+                            nullptr,
+                            &m_static_cache_framebuffer) != VK_SUCCESS)
     {
-        VkFramebufferCreateInfo framebuffer_create_info{};
-        framebuffer_create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebuffer_create_info.renderPass      = m_renderpass;
-        framebuffer_create_info.attachmentCount = _direction_light_attachment_count;
-        framebuffer_create_info.pAttachments    = &m_renderpass_attachments[i].view;
-        framebuffer_create_info.width           = m_renderpass_attachments[i].width;
-        framebuffer_create_info.height          = m_renderpass_attachments[i].height;
-        framebuffer_create_info.layers          = 1;
-
-        if (vkCreateFramebuffer(g_p_vulkan_context->_device,
-                                &framebuffer_create_info,
-                                nullptr,
-                                &m_framebuffer_per_rendertarget[i]) != VK_SUCCESS)
-        {
-            throw std::runtime_error("create main camera framebuffer");
-        }
+        throw std::runtime_error("create directional light shadow cache framebuffer");
     }
 }
 
@@ -161,100 +217,362 @@ void DirectionalLightShadowRenderPass::setupSubpass()
     m_subpass_list[_direction_light_shadow_subpass_shadow]->initialize(&directinal_light_shadow_pass_init_info);
 }
 
-void DirectionalLightShadowRenderPass::drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index)
+uint64_t DirectionalLightShadowRenderPass::hashStaticCasters() const
+{
+    const auto &models = m_p_render_resource_info->p_render_model_buffer->data_list;
+
+    uint64_t hash    = kHashSeed;
+    auto     combine = [&hash](const void *data, size_t size)
+    {
+        HashCombine(hash, data, size);
+    };
+
+    for (const auto &submesh: *m_p_render_resource_info->p_render_submeshes)
+    {
+        if (!submesh.is_static)
+        {
+            continue;
+        }
+        const auto parent_mesh = submesh.parent_mesh.lock();
+        if (parent_mesh == nullptr)
+        {
+            continue;
+        }
+
+        const RenderMesh *mesh = parent_mesh.get();
+        combine(&mesh, sizeof(mesh));
+        combine(&submesh.vertex_offset, sizeof(submesh.vertex_offset));
+        combine(&submesh.shadow_index_offset, sizeof(submesh.shadow_index_offset));
+        combine(&submesh.shadow_index_count, sizeof(submesh.shadow_index_count));
+        if (parent_mesh->m_index_in_model_buffer < models.size())
+        {
+            combine(&models[parent_mesh->m_index_in_model_buffer].model, sizeof(Math::Matrix4x4));
+        }
+    }
+    return hash;
+}
+
+uint64_t DirectionalLightShadowRenderPass::dynamicCasterCommandKey(const std::vector<uint32_t> &tile_indices) const
+{
+    const auto &models            = m_p_render_resource_info->p_render_model_buffer->data_list;
+    const auto &light_projections = m_p_render_resource_info->p_render_light_project_ubo_list->ubo_data_list;
+    const auto &tiles             = m_p_render_resource_info->p_shadow_atlas->GetTiles();
+
+    // 每个tile的剔除结果取决于light_proj和投射体的模型矩阵，viewport取决于tile区间
+    uint64_t key = m_p_render_resource_info->draw_list_hash;
+    for (uint32_t tile_index: tile_indices)
+    {
+        HashCombine(key, &tile_index, sizeof(tile_index));
+        if (tile_index < tiles.size())
+        {
+            HashCombine(key, &tiles[tile_index], sizeof(ShadowAtlasTile));
+        }
+        if (tile_index < light_projections.size())
+        {
+            HashCombine(key, &light_projections[tile_index].light_proj, sizeof(Math::Matrix4x4));
+        }
+    }
+
+    for (const auto &submesh: *m_p_render_resource_info->p_render_submeshes)
+    {
+        const auto parent_mesh = submesh.parent_mesh.lock();
+        if (submesh.is_static || parent_mesh == nullptr)
+        {
+            continue;
+        }
+        if (parent_mesh->m_index_in_model_buffer < models.size())
+        {
+            HashCombine(key, &models[parent_mesh->m_index_in_model_buffer].model, sizeof(Math::Matrix4x4));
+        }
+    }
+    return key;
+}
+
+std::vector<uint32_t> DirectionalLightShadowRenderPass::updateStaticCacheState()
+{
+    const auto &light_projections = m_p_render_resource_info->p_render_light_project_ubo_list->ubo_data_list;
+    const auto &tiles             = m_p_render_resource_info->p_shadow_atlas->GetTiles();
+
+    uint64_t static_caster_hash = hashStaticCasters();
+    bool     static_set_changed = static_caster_hash != m_static_caster_hash;
+    m_static_caster_hash = static_caster_hash;
+
+    if (m_static_cache_valid.size() != tiles.size())
+    {
+        m_static_cache_light_proj.assign(tiles.size(), Math::Matrix4x4::IDENTITY);
+        m_static_cache_tiles.assign(tiles.size(), {});
+        m_static_cache_valid.assign(tiles.size(), false);
+    }
+
+    std::vector<uint32_t> dirty_tiles;
+    for (uint32_t i = 0; i < tiles.size(); ++i)
+    {
+        const Math::Matrix4x4 &light_proj = i < light_projections.size() ? light_projections[i].light_proj
+                                                                          : Math::Matrix4x4::IDENTITY;
+        if (static_set_changed || !m_static_cache_valid[i] ||
+            !(light_proj == m_static_cache_light_proj[i]) || !(tiles[i] == m_static_cache_tiles[i]))
+        {
+            m_static_cache_light_proj[i] = light_proj;
+            m_static_cache_tiles[i]      = tiles[i];
+            m_static_cache_valid[i]      = true;
+            dirty_tiles.push_back(i);
+        }
+    }
+    return dirty_tiles;
+}
+
+void DirectionalLightShadowRenderPass::beginShadowRenderPass(VkRenderPass renderpass,
+                                                             VkFramebuffer framebuffer,
+                                                             VkSubpassContents contents)
 {
     VkClearValue clear_values[_direction_light_attachment_count] = {};
     clear_values[_direction_light_attachment_depth].depthStencil = {1.0f, 0};
 
-    uint32_t direction_light_nums = m_p_shadowmap_attachment->layer_count;
-    assert(m_framebuffer_per_rendertarget.size() == direction_light_nums);
+    VkExtent2D extent = {static_cast<uint32_t>(m_p_shadowmap_attachment->width),
+                         static_cast<uint32_t>(m_p_shadowmap_attachment->height)};
+
+    VkRenderPassBeginInfo renderpass_begin_info{};
+    renderpass_begin_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderpass_begin_info.renderPass        = renderpass;
+    renderpass_begin_info.framebuffer       = framebuffer;
+    renderpass_begin_info.renderArea.offset = {0, 0};
+    renderpass_begin_info.renderArea.extent = extent;
+    renderpass_begin_info.clearValueCount   = (sizeof(clear_values) / sizeof(clear_values[0]));
+    renderpass_begin_info.pClearValues      = clear_values;
+
+    g_p_vulkan_context->_vkCmdBeginRenderPass(*m_p_render_command_info->p_current_command_buffer,
+                                              &renderpass_begin_info,
+                                              contents);
+}
+
+void DirectionalLightShadowRenderPass::clearStaticCacheTiles(const std::vector<uint32_t> &tile_indices)
+{
+    VkCommandBuffer command_buffer = *m_p_render_command_info->p_current_command_buffer;
+    const auto      &tiles         = m_p_render_resource_info->p_shadow_atlas->GetTiles();
+
+    if (!m_static_cache_initialized)
+    {
+        // 缓存renderpass要求初始布局为TRANSFER_SRC，首次使用时内容未定义，所有tile都会被清空重绘
+        VkImageMemoryBarrier barrier{};
+        barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask                   = 0;
+        barrier.dstAccessMask                   = 0;
+        barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                           = m_static_cache.image;
+        barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.levelCount     = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+        m_static_cache_initialized = true;
+    }
+
+    // secondary command buffer模式下renderpass内只能执行vkCmdExecuteCommands，清空单独放在一个inline的renderpass中
+    beginShadowRenderPass(m_static_cache_renderpass, m_static_cache_framebuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkClearAttachment clear_attachment{};
+    clear_attachment.aspectMask                      = VK_IMAGE_ASPECT_DEPTH_BIT;
+    clear_attachment.colorAttachment                 = _direction_light_attachment_depth;
+    clear_attachment.clearValue.depthStencil         = {1.0f, 0};
+
+    std::vector<VkClearRect> clear_rects;
+    for (uint32_t tile_index: tile_indices)
+    {
+        const auto  &tile = tiles[tile_index];
+        VkClearRect clear_rect{};
+        clear_rect.rect.offset    = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)};
+        clear_rect.rect.extent    = {tile.size, tile.size};
+        clear_rect.baseArrayLayer = 0;
+        clear_rect.layerCount     = 1;
+        clear_rects.push_back(clear_rect);
+    }
+
+    g_p_vulkan_context->_vkCmdClearAttachments(command_buffer,
+                                               1,
+                                               &clear_attachment,
+                                               clear_rects.size(),
+                                               clear_rects.data());
+    g_p_vulkan_context->_vkCmdEndRenderPass(command_buffer);
+}
+
+void DirectionalLightShadowRenderPass::copyStaticCacheTiles()
+{
+    VkCommandBuffer command_buffer = *m_p_render_command_info->p_current_command_buffer;
+    const auto      &tiles         = m_p_render_resource_info->p_shadow_atlas->GetTiles();
+
+    // 上一帧光照pass采样完成后才能覆盖阴影图集，图集中未分配的区域不会被采样
+    VkImageMemoryBarrier barrier{};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask                   = 0;
+    barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = m_p_shadowmap_attachment->image;
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = 1;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+
+    std::vector<VkImageCopy> regions;
+    for (const auto &tile: tiles)
+    {
+        VkImageCopy region{};
+        region.srcSubresource.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT;
+        region.srcSubresource.mipLevel       = 0;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount     = 1;
+        region.srcOffset                     = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y), 0};
+        region.dstSubresource                = region.srcSubresource;
+        region.dstOffset                     = region.srcOffset;
+        region.extent                        = {tile.size, tile.size, 1};
+        regions.push_back(region);
+    }
 
-    VkExtent2D extent = {static_cast<uint32_t>(m_renderpass_attachments[0].width),
-                         static_cast<uint32_t>(m_renderpass_attachments[0].height)};
+    if (!regions.empty())
+    {
+        vkCmdCopyImage(command_buffer,
+                       m_static_cache.image,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       m_p_shadowmap_attachment->image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       regions.size(),
+                       regions.data());
+    }
+}
 
-    for (uint32_t i = 0; i < direction_light_nums; ++i)
+void DirectionalLightShadowRenderPass::drawTilesMultiThreading(
+        const std::vector<uint32_t> &tile_indices,
+        SubPass::DirectionalLightShadowPass::_shadow_caster_type caster_type,
+        uint32_t command_buffer_index)
+{
+    bool          is_static    = caster_type == SubPass::DirectionalLightShadowPass::_shadow_caster_static;
+    VkRenderPass  renderpass   = is_static ? m_static_cache_renderpass : m_renderpass;
+    VkFramebuffer framebuffer  = is_static ? m_static_cache_framebuffer : m_framebuffer_per_rendertarget[0];
+    auto          &thread_data = is_static ? m_static_thread_data : m_thread_data;
+
+    beginShadowRenderPass(renderpass, framebuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    auto shadow_subpass = std::reinterpret_pointer_cast<SubPass::DirectionalLightShadowPass>(
+            m_subpass_list[_direction_light_shadow_subpass_shadow]);
+    shadow_subpass->setShadowTiles(tile_indices);
+    shadow_subpass->setShadowCasterType(caster_type);
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass  = renderpass;
+    inheritance_info.framebuffer = framebuffer;
+
+    VkDebugUtilsLabelEXT label_info = {
+            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr,
+            is_static ? "Directional light shadow cache MultiThread" : "Directional light shadow MultiThread",
+            {1.0f, 1.0f, 1.0f, 1.0f}};
+    g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
+
+    // 静态缓存只在失效时绘制，不需要复用；动态投射体在光源矩阵和投射体都不变时复用上一次的录制
+    bool     reuse_enabled = !is_static && m_p_render_resource_info->reuse_secondary_command_buffers;
+    uint64_t recorded_key  = reuse_enabled ? dynamicCasterCommandKey(tile_indices) : RecordedCommandCache::kInvalidKey;
+    if (!reuse_enabled || !m_recorded_command_cache.IsValid(command_buffer_index, recorded_key))
     {
-        VkRenderPassBeginInfo renderpass_begin_info{};
-        renderpass_begin_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderpass_begin_info.renderPass        = m_renderpass;
-        renderpass_begin_info.framebuffer       = m_framebuffer_per_rendertarget[i];
-        renderpass_begin_info.renderArea.offset = {0, 0};
-        renderpass_begin_info.renderArea.extent = extent;
-        renderpass_begin_info.clearValueCount   = (sizeof(clear_values) / sizeof(clear_values[0]));
-        renderpass_begin_info.pClearValues      = clear_values;
-
-        g_p_vulkan_context->_vkCmdBeginRenderPass(*m_p_render_command_info->p_current_command_buffer,
-                                                  &renderpass_begin_info,
-                                                  VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
-        std::reinterpret_pointer_cast<SubPass::DirectionalLightShadowPass>(
-                m_subpass_list[_direction_light_shadow_subpass_shadow])->setDirectionalLightIndex(i);
-
-        VkCommandBufferInheritanceInfo inheritance_info{};
-        inheritance_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-        inheritance_info.renderPass  = m_renderpass;
-        inheritance_info.framebuffer = m_framebuffer_per_rendertarget[i];
-
-        VkDebugUtilsLabelEXT label_info = {
-                VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, "Directional light shadow MultiThread", {1.0f, 1.0f, 1.0f, 1.0f}};
-        g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
         m_subpass_list[_direction_light_shadow_subpass_shadow]->drawMultiThreading(m_thread_pool,
-                                                                                   m_thread_data,
+                                                                                   thread_data,
                                                                                    inheritance_info,
                                                                                    command_buffer_index,
-                                                                                   i * MESH_DRAW_THREAD_NUM,
+                                                                                   0,
                                                                                    MESH_DRAW_THREAD_NUM);
 
         m_thread_pool.wait();
-
-        std::vector<VkCommandBuffer> recorded_command_buffers;
-        for (uint32_t i = 0; i < m_thread_data.size(); ++i)
+        if (!is_static)
         {
-            recorded_command_buffers.push_back(m_thread_data[i].command_buffers[command_buffer_index]);
+            m_recorded_command_cache.Store(command_buffer_index, recorded_key);
         }
+    }
 
-        g_p_vulkan_context->_vkCmdExecuteCommands(*m_p_render_command_info->p_current_command_buffer,
-                                                  recorded_command_buffers.size(),
-                                                  recorded_command_buffers.data());
-        g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer);
-
-        g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
+    std::vector<VkCommandBuffer> recorded_command_buffers;
+    for (uint32_t i = 0; i < thread_data.size(); ++i)
+    {
+        recorded_command_buffers.push_back(thread_data[i].command_buffers[command_buffer_index]);
     }
+
+    g_p_vulkan_context->_vkCmdExecuteCommands(*m_p_render_command_info->p_current_command_buffer,
+                                              recorded_command_buffers.size(),
+                                              recorded_command_buffers.data());
+    g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer);
+
+    g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
 }
 
-void DirectionalLightShadowRenderPass::draw(uint32_t render_target_index)
+void DirectionalLightShadowRenderPass::drawTiles(const std::vector<uint32_t> &tile_indices,
+                                                 SubPass::DirectionalLightShadowPass::_shadow_caster_type caster_type)
 {
-    VkClearValue clear_values[_direction_light_attachment_count] = {};
-    clear_values[_direction_light_attachment_depth].depthStencil = {1.0f, 0};
+    bool is_static = caster_type == SubPass::DirectionalLightShadowPass::_shadow_caster_static;
+    beginShadowRenderPass(is_static ? m_static_cache_renderpass : m_renderpass,
+                          is_static ? m_static_cache_framebuffer : m_framebuffer_per_rendertarget[0],
+                          VK_SUBPASS_CONTENTS_INLINE);
+
+    auto shadow_subpass = std::reinterpret_pointer_cast<SubPass::DirectionalLightShadowPass>(
+            m_subpass_list[_direction_light_shadow_subpass_shadow]);
+    shadow_subpass->setShadowTiles(tile_indices);
+    shadow_subpass->setShadowCasterType(caster_type);
+
+    m_subpass_list[_direction_light_shadow_subpass_shadow]->draw();
+    g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
+}
 
-    uint32_t direction_light_nums = m_p_shadowmap_attachment->layer_count;
-    assert(m_framebuffer_per_rendertarget.size() == direction_light_nums);
+void DirectionalLightShadowRenderPass::drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index)
+{
+    std::vector<uint32_t> dirty_tiles = updateStaticCacheState();
+    if (!dirty_tiles.empty())
+    {
+        clearStaticCacheTiles(dirty_tiles);
+        drawTilesMultiThreading(dirty_tiles, SubPass::DirectionalLightShadowPass::_shadow_caster_static,
+                                command_buffer_index);
+    }
+    copyStaticCacheTiles();
 
-    VkExtent2D extent = {static_cast<uint32_t>(m_renderpass_attachments[0].width),
-                         static_cast<uint32_t>(m_renderpass_attachments[0].height)};
+    std::vector<uint32_t> all_tiles(m_p_render_resource_info->p_shadow_atlas->GetTiles().size());
+    std::iota(all_tiles.begin(), all_tiles.end(), 0);
+    drawTilesMultiThreading(all_tiles, SubPass::DirectionalLightShadowPass::_shadow_caster_dynamic,
+                            command_buffer_index);
+}
 
-    for (uint32_t i = 0; i < direction_light_nums; ++i)
+void DirectionalLightShadowRenderPass::draw(uint32_t render_target_index)
+{
+    std::vector<uint32_t> dirty_tiles = updateStaticCacheState();
+    if (!dirty_tiles.empty())
     {
-        VkRenderPassBeginInfo renderpass_begin_info{};
-        renderpass_begin_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderpass_begin_info.renderPass        = m_renderpass;
-        renderpass_begin_info.framebuffer       = m_framebuffer_per_rendertarget[i];
-        renderpass_begin_info.renderArea.offset = {0, 0};
-        renderpass_begin_info.renderArea.extent = extent;
-        renderpass_begin_info.clearValueCount   = (sizeof(clear_values) / sizeof(clear_values[0]));
-        renderpass_begin_info.pClearValues      = clear_values;
-
-        g_p_vulkan_context->_vkCmdBeginRenderPass(*m_p_render_command_info->p_current_command_buffer,
-                                                  &renderpass_begin_info,
-                                                  VK_SUBPASS_CONTENTS_INLINE);
-        std::reinterpret_pointer_cast<SubPass::DirectionalLightShadowPass>(
-                m_subpass_list[_direction_light_shadow_subpass_shadow])->setDirectionalLightIndex(i);
-
-        m_subpass_list[_direction_light_shadow_subpass_shadow]->draw();
-        g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
+        clearStaticCacheTiles(dirty_tiles);
+        drawTiles(dirty_tiles, SubPass::DirectionalLightShadowPass::_shadow_caster_static);
     }
+    copyStaticCacheTiles();
+
+    std::vector<uint32_t> all_tiles(m_p_render_resource_info->p_shadow_atlas->GetTiles().size());
+    std::iota(all_tiles.begin(), all_tiles.end(), 0);
+    drawTiles(all_tiles, SubPass::DirectionalLightShadowPass::_shadow_caster_dynamic);
 }
 
 void DirectionalLightShadowRenderPass::updateAfterSwapchainRecreate()
 {
-
+    m_recorded_command_cache.Invalidate();
 }
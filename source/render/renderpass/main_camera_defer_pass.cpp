@@ -42,12 +42,10 @@ void MainCameraDeferRenderPass::setupRenderpassAttachments()
     m_renderpass_attachments[_main_camera_defer_gbuffer_color_attachment].format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
     m_renderpass_attachments[_main_camera_defer_gbuffer_color_attachment].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    m_renderpass_attachments[_main_camera_defer_gbuffer_normal_attachment].format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    // 法线使用八面体编码，只占两个通道；世界坐标不再写入gbuffer，由深度重建
+    m_renderpass_attachments[_main_camera_defer_gbuffer_normal_attachment].format = VK_FORMAT_R16G16_SFLOAT;
     m_renderpass_attachments[_main_camera_defer_gbuffer_normal_attachment].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    m_renderpass_attachments[_main_camera_defer_gbuffer_position_attachment].format = VK_FORMAT_R16G16B16A16_SFLOAT;
-    m_renderpass_attachments[_main_camera_defer_gbuffer_position_attachment].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
     m_renderpass_attachments[_main_camera_defer_color_attachment].format = (*m_p_render_targets)[0].format;
     m_renderpass_attachments[_main_camera_defer_color_attachment].layout = (*m_p_render_targets)[0].layout;
 
@@ -56,53 +54,32 @@ void MainCameraDeferRenderPass::setupRenderpassAttachments()
 
     for (int i = 0; i < m_renderpass_attachments.size() - 2; ++i)
     {
-        auto &renderpass_attachment = m_renderpass_attachments[i];
-        VulkanUtil::createImage(g_p_vulkan_context,
-                                g_p_vulkan_context->_swapchain_extent.width,
-                                g_p_vulkan_context->_swapchain_extent.height,
-                                renderpass_attachment.format,
-                                VK_IMAGE_TILING_OPTIMAL,
-                                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-                                VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                renderpass_attachment.image,
-                                renderpass_attachment.mem,
-                                0,
-                                1,
-                                1);
-
-        renderpass_attachment.view = VulkanUtil::createImageView(g_p_vulkan_context,
-                                                                 renderpass_attachment.image,
-                                                                 renderpass_attachment.format,
-                                                                 VK_IMAGE_ASPECT_COLOR_BIT,
-                                                                 VK_IMAGE_VIEW_TYPE_2D,
-                                                                 1);
+        m_renderpass_attachments[i].usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        m_renderpass_attachments[i].aspect = VK_IMAGE_ASPECT_COLOR_BIT;
     }
 
-    m_renderpass_attachments[_main_camera_defer_color_attachment].format = (*m_p_render_targets)[0].format;
-    m_renderpass_attachments[_main_camera_defer_color_attachment].layout = (*m_p_render_targets)[0].layout;
-
     auto &depth_attachment = m_renderpass_attachments[_main_camera_defer_depth_attachment];
-    VulkanUtil::createImage(g_p_vulkan_context,
-                            g_p_vulkan_context->_swapchain_extent.width,
-                            g_p_vulkan_context->_swapchain_extent.height,
-                            depth_attachment.format,
-                            VK_IMAGE_TILING_OPTIMAL,
-                            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                            depth_attachment.image,
-                            depth_attachment.mem,
-                            0,
-                            1,
-                            1);
-
-    depth_attachment.view = VulkanUtil::createImageView(g_p_vulkan_context,
-                                                        depth_attachment.image,
-                                                        depth_attachment.format,
-                                                        VK_IMAGE_ASPECT_DEPTH_BIT,
-                                                        VK_IMAGE_VIEW_TYPE_2D,
-                                                        1);
+    depth_attachment.usage  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    depth_attachment.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    resizeRenderpassAttachments();
+}
+
+bool MainCameraDeferRenderPass::resizeRenderpassAttachments()
+{
+    const VkExtent2D &extent = g_p_vulkan_context->_swapchain_extent;
 
+    bool reallocated = false;
+    for (int i = 0; i < m_renderpass_attachments.size(); ++i)
+    {
+        // 最终输出的颜色附件是交换链图像
+        if (i == _main_camera_defer_color_attachment)
+        {
+            continue;
+        }
+        reallocated |= m_renderpass_attachments[i].fitExtent(extent.width, extent.height);
+    }
+    return reallocated;
 }
 
 void MainCameraDeferRenderPass::setupRenderPass()
@@ -129,16 +106,6 @@ void MainCameraDeferRenderPass::setupRenderPass()
     gbuffer_normal_attachment_description.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
     gbuffer_normal_attachment_description.finalLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    VkAttachmentDescription &gbuffer_worldpos_attachment_description = attachments[_main_camera_defer_gbuffer_position_attachment];
-    gbuffer_worldpos_attachment_description.format         = m_renderpass_attachments[_main_camera_defer_gbuffer_position_attachment].format;
-    gbuffer_worldpos_attachment_description.samples        = VK_SAMPLE_COUNT_1_BIT;
-    gbuffer_worldpos_attachment_description.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    gbuffer_worldpos_attachment_description.storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    gbuffer_worldpos_attachment_description.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    gbuffer_worldpos_attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    gbuffer_worldpos_attachment_description.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-    gbuffer_worldpos_attachment_description.finalLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
     VkAttachmentDescription &framebuffer_image_attachment_description = attachments[_main_camera_defer_color_attachment];
     framebuffer_image_attachment_description.format         = m_renderpass_attachments[_main_camera_defer_color_attachment].format;
     framebuffer_image_attachment_description.samples        = VK_SAMPLE_COUNT_1_BIT;
@@ -162,7 +129,7 @@ void MainCameraDeferRenderPass::setupRenderPass()
 
     VkSubpassDescription subpasses[_main_camera_subpass_count] = {};
 
-    VkAttachmentReference gbuffer_attachments_reference[3] = {};
+    VkAttachmentReference gbuffer_attachments_reference[2] = {};
     gbuffer_attachments_reference[0].attachment =
             &gbuffer_color_attachment_description - attachments;
     // 指定在subpass执行时，管线访问图像的布局
@@ -172,14 +139,15 @@ void MainCameraDeferRenderPass::setupRenderPass()
             &gbuffer_normal_attachment_description - attachments;
     gbuffer_attachments_reference[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    gbuffer_attachments_reference[2].attachment =
-            &gbuffer_worldpos_attachment_description - attachments;
-    gbuffer_attachments_reference[2].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
     VkAttachmentReference depth_attachment_reference{};
     depth_attachment_reference.attachment = &depth_attachment_description - attachments;
     depth_attachment_reference.layout     = depth_attachment_description.finalLayout;
 
+    // 光照和天空盒只读深度，使用只读布局时深度可以同时作为input attachment和深度测试的附件
+    VkAttachmentReference depth_read_only_attachment_reference{};
+    depth_read_only_attachment_reference.attachment = &depth_attachment_description - attachments;
+    depth_read_only_attachment_reference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
     VkSubpassDescription &gbuffer_pass = subpasses[_main_camera_gbuffer_subpass];
     gbuffer_pass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     gbuffer_pass.colorAttachmentCount =
@@ -189,7 +157,7 @@ void MainCameraDeferRenderPass::setupRenderPass()
     gbuffer_pass.preserveAttachmentCount = 0;
     gbuffer_pass.pPreserveAttachments    = nullptr;
 
-    VkAttachmentReference defer_lighting_input_attachment_description[_main_camera_defer_attachment_count - 2];
+    VkAttachmentReference defer_lighting_input_attachment_description[3];
 
     defer_lighting_input_attachment_description[0].attachment = &gbuffer_color_attachment_description - attachments;
     defer_lighting_input_attachment_description[0].layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -197,8 +165,7 @@ void MainCameraDeferRenderPass::setupRenderPass()
     defer_lighting_input_attachment_description[1].attachment = &gbuffer_normal_attachment_description - attachments;
     defer_lighting_input_attachment_description[1].layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    defer_lighting_input_attachment_description[2].attachment = &gbuffer_worldpos_attachment_description - attachments;
-    defer_lighting_input_attachment_description[2].layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    defer_lighting_input_attachment_description[2] = depth_read_only_attachment_reference;
 
     VkAttachmentReference framebuffer_image_attachment_reference{};
     framebuffer_image_attachment_reference.attachment = &framebuffer_image_attachment_description - attachments;
@@ -219,7 +186,7 @@ void MainCameraDeferRenderPass::setupRenderPass()
     skybox_pass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
     skybox_pass.colorAttachmentCount    = 1;
     skybox_pass.pColorAttachments       = &framebuffer_image_attachment_reference;
-    skybox_pass.pDepthStencilAttachment = &depth_attachment_reference;
+    skybox_pass.pDepthStencilAttachment = &depth_read_only_attachment_reference;
     skybox_pass.preserveAttachmentCount = 0;
     skybox_pass.pPreserveAttachments    = nullptr;
 
@@ -237,10 +204,12 @@ void MainCameraDeferRenderPass::setupRenderPass()
     VkSubpassDependency &defer_lighting_depend_on_gbuffer = dependencies[1];
     defer_lighting_depend_on_gbuffer.srcSubpass      = _main_camera_gbuffer_subpass;
     defer_lighting_depend_on_gbuffer.dstSubpass      = _main_camera_defer_lighting_subpass;
-    defer_lighting_depend_on_gbuffer.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    defer_lighting_depend_on_gbuffer.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
     defer_lighting_depend_on_gbuffer.dstStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    defer_lighting_depend_on_gbuffer.srcAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    defer_lighting_depend_on_gbuffer.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    defer_lighting_depend_on_gbuffer.srcAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    defer_lighting_depend_on_gbuffer.dstAccessMask   = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
     defer_lighting_depend_on_gbuffer.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     VkSubpassDependency &skybox_pass_depend_on_lighting = dependencies[2];
@@ -296,8 +265,6 @@ void MainCameraDeferRenderPass::setupFrameBuffer()
                 m_renderpass_attachments[_main_camera_defer_gbuffer_color_attachment].view;
         framebuffer_attachments[_main_camera_defer_gbuffer_normal_attachment]   =
                 m_renderpass_attachments[_main_camera_defer_gbuffer_normal_attachment].view;
-        framebuffer_attachments[_main_camera_defer_gbuffer_position_attachment] =
-                m_renderpass_attachments[_main_camera_defer_gbuffer_position_attachment].view;
         framebuffer_attachments[_main_camera_defer_color_attachment] = (*m_p_render_targets)[i].view;
         framebuffer_attachments[_main_camera_defer_depth_attachment] =
                 m_renderpass_attachments[_main_camera_defer_depth_attachment].view;
@@ -340,9 +307,9 @@ void MainCameraDeferRenderPass::setupSubpass()
     lighting_pass_init_info.p_render_resource_info      = m_p_render_resource_info;
     lighting_pass_init_info.renderpass                  = m_renderpass;
     lighting_pass_init_info.subpass_index               = _main_camera_defer_lighting_subpass;
-    lighting_pass_init_info.gbuffer_color_attachment    = &m_renderpass_attachments[_main_camera_defer_gbuffer_color_attachment];
-    lighting_pass_init_info.gbuffer_normal_attachment   = &m_renderpass_attachments[_main_camera_defer_gbuffer_normal_attachment];
-    lighting_pass_init_info.gbuffer_position_attachment = &m_renderpass_attachments[_main_camera_defer_gbuffer_position_attachment];
+    lighting_pass_init_info.gbuffer_color_attachment  = &m_renderpass_attachments[_main_camera_defer_gbuffer_color_attachment];
+    lighting_pass_init_info.gbuffer_normal_attachment = &m_renderpass_attachments[_main_camera_defer_gbuffer_normal_attachment];
+    lighting_pass_init_info.depth_attachment          = &m_renderpass_attachments[_main_camera_defer_depth_attachment];
 
     m_subpass_list[_main_camera_defer_lighting_subpass] = std::make_shared<SubPass::DeferLightPass>();
     m_subpass_list[_main_camera_defer_lighting_subpass]->setShader(SubPass::VERTEX_SHADER, FULL_SCREEN_VERT);
@@ -366,11 +333,10 @@ void MainCameraDeferRenderPass::setupSubpass()
 void MainCameraDeferRenderPass::drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index)
 {
     VkClearValue clear_values[_main_camera_defer_attachment_count] = {};
-    clear_values[_main_camera_defer_gbuffer_color_attachment].color    = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_gbuffer_normal_attachment].color   = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_gbuffer_position_attachment].color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_color_attachment].color            = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_depth_attachment].depthStencil     = {1.0f, 0};
+    clear_values[_main_camera_defer_gbuffer_color_attachment].color  = {0.0f, 0.0f, 0.0f, 1.0f};
+    clear_values[_main_camera_defer_gbuffer_normal_attachment].color = {0.0f, 0.0f, 0.0f, 1.0f};
+    clear_values[_main_camera_defer_color_attachment].color          = {0.0f, 0.0f, 0.0f, 1.0f};
+    clear_values[_main_camera_defer_depth_attachment].depthStencil   = {1.0f, 0};
 
     VkRenderPassBeginInfo renderpass_begin_info{};
     renderpass_begin_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -393,13 +359,21 @@ void MainCameraDeferRenderPass::drawMultiThreading(uint32_t render_target_index,
     VkDebugUtilsLabelEXT label_info = {
             VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, "Mesh GBuffer", {1.0f, 1.0f, 1.0f, 1.0f}};
     g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
-    m_subpass_list[_main_camera_gbuffer_subpass]->drawMultiThreading(m_thread_pool,
-                                                                     m_thread_data,
-                                                                     inheritance_info,
-                                                                     command_buffer_index,
-                                                                     0,
-                                                                     MESH_DRAW_THREAD_NUM);
-    m_thread_pool.wait();
+
+    bool     reuse_enabled = m_p_render_resource_info->reuse_secondary_command_buffers;
+    uint64_t recorded_key  = recordedCommandKey(render_target_index);
+    if (!reuse_enabled || !m_recorded_command_cache.IsValid(command_buffer_index, recorded_key))
+    {
+        m_subpass_list[_main_camera_gbuffer_subpass]->drawMultiThreading(m_thread_pool,
+                                                                         m_thread_data,
+                                                                         inheritance_info,
+                                                                         command_buffer_index,
+                                                                         0,
+                                                                         MESH_DRAW_THREAD_NUM);
+        m_thread_pool.wait();
+        m_recorded_command_cache.Store(command_buffer_index,
+                                       reuse_enabled ? recorded_key : RecordedCommandCache::kInvalidKey);
+    }
 
     std::vector<VkCommandBuffer> recorded_command_buffers;
     for (uint32_t i = 0; i < m_thread_data.size(); ++i)
@@ -424,11 +398,10 @@ void MainCameraDeferRenderPass::drawMultiThreading(uint32_t render_target_index,
 void MainCameraDeferRenderPass::draw(uint32_t render_target_index)
 {
     VkClearValue clear_values[_main_camera_defer_attachment_count] = {};
-    clear_values[_main_camera_defer_gbuffer_color_attachment].color    = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_gbuffer_normal_attachment].color   = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_gbuffer_position_attachment].color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_color_attachment].color            = {0.0f, 0.0f, 0.0f, 1.0f};
-    clear_values[_main_camera_defer_depth_attachment].depthStencil     = {1.0f, 0};
+    clear_values[_main_camera_defer_gbuffer_color_attachment].color  = {0.0f, 0.0f, 0.0f, 1.0f};
+    clear_values[_main_camera_defer_gbuffer_normal_attachment].color = {0.0f, 0.0f, 0.0f, 1.0f};
+    clear_values[_main_camera_defer_color_attachment].color          = {0.0f, 0.0f, 0.0f, 1.0f};
+    clear_values[_main_camera_defer_depth_attachment].depthStencil   = {1.0f, 0};
 
     VkRenderPassBeginInfo renderpass_begin_info{};
     renderpass_begin_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -453,29 +426,41 @@ void MainCameraDeferRenderPass::draw(uint32_t render_target_index)
     g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
 }
 
+uint64_t MainCameraDeferRenderPass::recordedCommandKey(uint32_t render_target_index) const
+{
+    uint64_t key = m_p_render_resource_info->draw_list_hash;
+    HashCombine(key, &render_target_index, sizeof(render_target_index));
+    HashCombine(key, m_p_render_command_info->p_viewport, sizeof(VkViewport));
+    HashCombine(key, m_p_render_command_info->p_scissor, sizeof(VkRect2D));
+    return key;
+}
+
 void MainCameraDeferRenderPass::updateAfterSwapchainRecreate()
 {
     m_thread_pool.wait();
-    for (int i = 0; i < _main_camera_defer_attachment_count - 2; ++i)
+    // framebuffer重建后已录制的命令全部失效
+    m_recorded_command_cache.Invalidate();
+
+    // render pass只依赖附件格式，沿用原来的对象，已创建的pipeline也保持兼容
+    if ((*m_p_render_targets)[0].format != m_renderpass_attachments[_main_camera_defer_color_attachment].format)
     {
-        if (m_renderpass_attachments[i].image != VK_NULL_HANDLE)
-        {
-            m_renderpass_attachments[i].destroy();
-        }
+        throw std::runtime_error("swapchain format changed on recreate");
     }
+
+    bool attachments_reallocated = resizeRenderpassAttachments();
     for (int i = 0; i < m_framebuffer_per_rendertarget.size(); ++i)
     {
-        vkDestroyFramebuffer(g_p_vulkan_context->_device, m_framebuffer_per_rendertarget[i], nullptr);
+        g_p_vulkan_context->_deletion_queue.DestroyFramebuffer(m_framebuffer_per_rendertarget[i]);
     }
-    vkDestroyRenderPass(g_p_vulkan_context->_device, m_renderpass, nullptr);
-
-    setupRenderpassAttachments();
-    setupRenderPass();
     setupFrameBuffer();
 
-    for (int i = 0; i < m_subpass_list.size(); ++i)
+    // gbuffer没有重建时光照pass的input attachment descriptor仍然有效，不能改写在途帧正在使用的descriptor set
+    if (attachments_reallocated)
     {
-        m_subpass_list[i]->updateAfterSwapchainRecreate();
+        for (int i = 0; i < m_subpass_list.size(); ++i)
+        {
+            m_subpass_list[i]->updateAfterSwapchainRecreate();
+        }
     }
 }
 
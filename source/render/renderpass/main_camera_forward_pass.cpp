@@ -4,9 +4,11 @@
 
 
 #include "core/graphic/vulkan/vulkan_utils.h"
+#include "render/subpass/mesh_depth_prepass.h"
 #include "render/subpass/mesh_forward_light.h"
 #include "render/subpass/skybox.h"
 #include "render/renderpass/main_camera_forward_pass.h"
+#include "mesh_depth_prepass_vert.h"
 #include "mesh_forward_vert.h"
 #include "mesh_forward_frag.h"
 #include "skybox_vert.h"
@@ -20,13 +22,19 @@ void MainCameraForwardRenderPass::initialize(RenderPassInitInfo *renderpass_init
     m_p_render_command_info  = main_camera_renderpass_init_info->render_command_info;
     m_p_render_resource_info = main_camera_renderpass_init_info->render_resource_info;
     m_p_render_targets       = main_camera_renderpass_init_info->render_targets;
+    m_dynamic_rendering      = main_camera_renderpass_init_info->use_dynamic_rendering &&
+                               g_p_vulkan_context->_dynamic_rendering_supported;
 
     setupRenderpassAttachments();
-    setupRenderPass();
-    setupFrameBuffer();
+    if (!m_dynamic_rendering)
+    {
+        setupRenderPass();
+        setupFrameBuffer();
+    }
     setupSubpass();
 #ifdef MULTI_THREAD_RENDERING
-    setupMultiThreading(MESH_DRAW_THREAD_NUM);
+    // 前一半线程录制深度预渲染，后一半录制光照
+    setupMultiThreading(MESH_DRAW_THREAD_NUM * 2);
 #endif
 }
 
@@ -38,30 +46,19 @@ void MainCameraForwardRenderPass::setupRenderpassAttachments()
     m_renderpass_attachments[_main_camera_framebuffer_attachment_color].format = (*m_p_render_targets)[0].format;
     m_renderpass_attachments[_main_camera_framebuffer_attachment_color].layout = (*m_p_render_targets)[0].layout;
 
-    m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].format = g_p_vulkan_context->findDepthFormat();
-    m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VulkanUtil::createImage(g_p_vulkan_context,
-                            g_p_vulkan_context->_swapchain_extent.width,
-                            g_p_vulkan_context->_swapchain_extent.height,
-                            m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].format,
-                            VK_IMAGE_TILING_OPTIMAL,
-                            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
-                            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
-                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                            m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].image,
-                            m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].mem,
-                            0,
-                            1,
-                            1);
-
-    m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].view =
-            VulkanUtil::createImageView(g_p_vulkan_context,
-                                        m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].image,
-                                        m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].format,
-                                        VK_IMAGE_ASPECT_DEPTH_BIT,
-                                        VK_IMAGE_VIEW_TYPE_2D,
-                                        1);
+    auto &depth_attachment = m_renderpass_attachments[_main_camera_framebuffer_attachment_depth];
+    depth_attachment.format = g_p_vulkan_context->findDepthFormat();
+    depth_attachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.usage  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    depth_attachment.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    resizeRenderpassAttachments();
+}
+
+bool MainCameraForwardRenderPass::resizeRenderpassAttachments()
+{
+    const VkExtent2D &extent = g_p_vulkan_context->_swapchain_extent;
+    return m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].fitExtent(extent.width, extent.height);
 }
 
 void MainCameraForwardRenderPass::setupRenderPass()
@@ -101,6 +98,14 @@ void MainCameraForwardRenderPass::setupRenderPass()
     depth_attachment_reference.attachment = &depth_attachment_description - attachments;
     depth_attachment_reference.layout     = depth_attachment_description.finalLayout;
 
+    VkSubpassDescription &depth_prepass = subpasses[_main_camera_subpass_depth_prepass];
+    depth_prepass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    depth_prepass.colorAttachmentCount    = 0;
+    depth_prepass.pColorAttachments       = NULL;
+    depth_prepass.pDepthStencilAttachment = &depth_attachment_reference;
+    depth_prepass.preserveAttachmentCount = 0;
+    depth_prepass.pPreserveAttachments    = NULL;
+
     VkSubpassDescription &base_pass = subpasses[_main_camera_subpass_mesh];
     base_pass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     base_pass.colorAttachmentCount =
@@ -118,7 +123,7 @@ void MainCameraForwardRenderPass::setupRenderPass()
     skybox_pass.preserveAttachmentCount = 0;
     skybox_pass.pPreserveAttachments    = NULL;
 
-    VkSubpassDependency dependencies[2];
+    VkSubpassDependency dependencies[3];
 
     VkSubpassDependency &base_pass_dependency = dependencies[0];
     base_pass_dependency.srcSubpass    = VK_SUBPASS_EXTERNAL;
@@ -129,7 +134,17 @@ void MainCameraForwardRenderPass::setupRenderPass()
     base_pass_dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     base_pass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-    VkSubpassDependency &skybox_pass_dependency = dependencies[1];
+    VkSubpassDependency &base_pass_depend_on_prepass = dependencies[1];
+    base_pass_depend_on_prepass.srcSubpass      = _main_camera_subpass_depth_prepass;
+    base_pass_depend_on_prepass.dstSubpass      = _main_camera_subpass_mesh;
+    base_pass_depend_on_prepass.srcStageMask    = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    base_pass_depend_on_prepass.dstStageMask    = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    base_pass_depend_on_prepass.srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    base_pass_depend_on_prepass.dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    base_pass_depend_on_prepass.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    VkSubpassDependency &skybox_pass_dependency = dependencies[2];
     skybox_pass_dependency.srcSubpass      = _main_camera_subpass_mesh;
     skybox_pass_dependency.dstSubpass      = _main_camera_subpass_skybox;
     skybox_pass_dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -196,10 +211,30 @@ void MainCameraForwardRenderPass::setupFrameBuffer()
 
 void MainCameraForwardRenderPass::setupSubpass()
 {
+    // 三个subpass在dynamic rendering下属于同一个pass实例，附件相同
+    SubPass::RenderingAttachmentFormats rendering_formats;
+    if (m_dynamic_rendering)
+    {
+        rendering_formats.color_formats = {m_renderpass_attachments[_main_camera_framebuffer_attachment_color].format};
+        rendering_formats.depth_format  = m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].format;
+    }
+
+    SubPass::MeshDepthPrepassInitInfo depth_prepass_init_info{};
+    depth_prepass_init_info.p_render_command_info  = m_p_render_command_info;
+    depth_prepass_init_info.p_render_resource_info = m_p_render_resource_info;
+    depth_prepass_init_info.renderpass             = m_renderpass;
+    depth_prepass_init_info.rendering_formats      = rendering_formats;
+    depth_prepass_init_info.subpass_index          = _main_camera_subpass_depth_prepass;
+
+    m_subpass_list[_main_camera_subpass_depth_prepass] = std::make_shared<SubPass::MeshDepthPrepass>();
+    m_subpass_list[_main_camera_subpass_depth_prepass]->setShader(SubPass::VERTEX_SHADER, MESH_DEPTH_PREPASS_VERT);
+    m_subpass_list[_main_camera_subpass_depth_prepass]->initialize(&depth_prepass_init_info);
+
     SubPass::SubPassInitInfo mesh_pass_init_info{};
     mesh_pass_init_info.p_render_command_info  = m_p_render_command_info;
     mesh_pass_init_info.p_render_resource_info = m_p_render_resource_info;
     mesh_pass_init_info.renderpass             = m_renderpass;
+    mesh_pass_init_info.rendering_formats      = rendering_formats;
     mesh_pass_init_info.subpass_index          = _main_camera_subpass_mesh;
 
     m_subpass_list[_main_camera_subpass_mesh] = std::make_shared<SubPass::MeshForwardLightingPass>();
@@ -211,6 +246,7 @@ void MainCameraForwardRenderPass::setupSubpass()
     skybox_pass_init_info.p_render_command_info  = m_p_render_command_info;
     skybox_pass_init_info.p_render_resource_info = m_p_render_resource_info;
     skybox_pass_init_info.renderpass             = m_renderpass;
+    skybox_pass_init_info.rendering_formats      = rendering_formats;
     skybox_pass_init_info.subpass_index          = _main_camera_subpass_skybox;
 
     m_subpass_list[_main_camera_subpass_skybox] = std::make_shared<SubPass::SkyBoxPass>();
@@ -221,6 +257,12 @@ void MainCameraForwardRenderPass::setupSubpass()
 
 void MainCameraForwardRenderPass::drawMultiThreading(uint32_t render_target_index, uint32_t command_buffer_index)
 {
+    if (m_dynamic_rendering)
+    {
+        drawMultiThreadingDynamicRendering(render_target_index, command_buffer_index);
+        return;
+    }
+
     VkClearValue clear_values[_main_camera_framebuffer_attachment_count] = {};
     clear_values[_main_camera_framebuffer_attachment_color].color        = {0.0f, 0.0f, 0.0f, 1.0f};
     clear_values[_main_camera_framebuffer_attachment_depth].depthStencil = {1.0f, 0};
@@ -238,42 +280,177 @@ void MainCameraForwardRenderPass::drawMultiThreading(uint32_t render_target_inde
                                               &renderpass_begin_info,
                                               VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
+    VkCommandBufferInheritanceInfo prepass_inheritance_info{};
+    prepass_inheritance_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    prepass_inheritance_info.renderPass  = m_renderpass;
+    prepass_inheritance_info.subpass     = _main_camera_subpass_depth_prepass;
+    prepass_inheritance_info.framebuffer = m_framebuffer_per_rendertarget[render_target_index];
+
+    VkCommandBufferInheritanceInfo inheritance_info = prepass_inheritance_info;
+    inheritance_info.subpass = _main_camera_subpass_mesh;
+
+    recordSecondaryCommandBuffers(prepass_inheritance_info, inheritance_info, render_target_index, command_buffer_index);
+
+    if (m_depth_prepass_enabled)
+    {
+        executeSecondaryCommandBuffers(0, MESH_DRAW_THREAD_NUM, command_buffer_index, "Mesh Depth Prepass MultiThread");
+    }
+
+    g_p_vulkan_context->_vkCmdNextSubpass(*m_p_render_command_info->p_current_command_buffer,
+                                          VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    executeSecondaryCommandBuffers(MESH_DRAW_THREAD_NUM,
+                                   m_thread_data.size() - MESH_DRAW_THREAD_NUM,
+                                   command_buffer_index,
+                                   "Mesh Forward Lighting MultiThread");
+
+    g_p_vulkan_context->_vkCmdNextSubpass(*m_p_render_command_info->p_current_command_buffer,
+                                          VK_SUBPASS_CONTENTS_INLINE);
+    m_subpass_list[_main_camera_subpass_skybox]->draw();
+
+    g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
+}
+
+void MainCameraForwardRenderPass::drawMultiThreadingDynamicRendering(uint32_t render_target_index,
+                                                                     uint32_t command_buffer_index)
+{
+    VkCommandBuffer command_buffer = *m_p_render_command_info->p_current_command_buffer;
+
+    // 同一个pass实例按内容拆成几段：secondary command buffer和inline绘制不能出现在同一段中，
+    // 前一段挂起、后一段恢复，附件在段之间不会被存储和重新加载
+    VkRenderingFlagsKHR prepass_flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR |
+                                        VK_RENDERING_SUSPENDING_BIT_KHR;
+    VkRenderingFlagsKHR mesh_flags    = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR |
+                                        VK_RENDERING_SUSPENDING_BIT_KHR;
+    VkRenderingFlagsKHR skybox_flags  = VK_RENDERING_RESUMING_BIT_KHR;
+    if (m_depth_prepass_enabled)
+    {
+        mesh_flags |= VK_RENDERING_RESUMING_BIT_KHR;
+    }
+
+    VkFormat color_format = m_renderpass_attachments[_main_camera_framebuffer_attachment_color].format;
+
+    VkCommandBufferInheritanceRenderingInfoKHR prepass_rendering_inheritance_info{};
+    prepass_rendering_inheritance_info.sType                   =
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    prepass_rendering_inheritance_info.flags                   =
+            prepass_flags & ~VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+    prepass_rendering_inheritance_info.colorAttachmentCount    = 1;
+    prepass_rendering_inheritance_info.pColorAttachmentFormats = &color_format;
+    prepass_rendering_inheritance_info.depthAttachmentFormat   =
+            m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].format;
+    prepass_rendering_inheritance_info.rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceRenderingInfoKHR rendering_inheritance_info = prepass_rendering_inheritance_info;
+    rendering_inheritance_info.flags = mesh_flags & ~VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+
+    VkCommandBufferInheritanceInfo prepass_inheritance_info{};
+    prepass_inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    prepass_inheritance_info.pNext = &prepass_rendering_inheritance_info;
+
     VkCommandBufferInheritanceInfo inheritance_info{};
-    inheritance_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-    inheritance_info.renderPass  = m_renderpass;
-    inheritance_info.framebuffer = m_framebuffer_per_rendertarget[render_target_index];
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.pNext = &rendering_inheritance_info;
 
-    VkDebugUtilsLabelEXT label_info = {
-            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, "Mesh Forward Lighting MultiThread", {1.0f, 1.0f, 1.0f, 1.0f}};
-    g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
+    recordSecondaryCommandBuffers(prepass_inheritance_info, inheritance_info, render_target_index, command_buffer_index);
+
+    transitionAttachmentsBeforeRendering(command_buffer, render_target_index);
+
+    if (m_depth_prepass_enabled)
+    {
+        beginDynamicRendering(command_buffer, render_target_index, prepass_flags);
+        executeSecondaryCommandBuffers(0, MESH_DRAW_THREAD_NUM, command_buffer_index, "Mesh Depth Prepass MultiThread");
+        g_p_vulkan_context->_vkCmdEndRenderingKHR(command_buffer);
+    }
+
+    beginDynamicRendering(command_buffer, render_target_index, mesh_flags);
+    executeSecondaryCommandBuffers(MESH_DRAW_THREAD_NUM,
+                                   m_thread_data.size() - MESH_DRAW_THREAD_NUM,
+                                   command_buffer_index,
+                                   "Mesh Forward Lighting MultiThread");
+    g_p_vulkan_context->_vkCmdEndRenderingKHR(command_buffer);
+
+    beginDynamicRendering(command_buffer, render_target_index, skybox_flags);
+    m_subpass_list[_main_camera_subpass_skybox]->draw();
+    g_p_vulkan_context->_vkCmdEndRenderingKHR(command_buffer);
+
+    transitionAttachmentsAfterRendering(command_buffer, render_target_index);
+}
+
+void MainCameraForwardRenderPass::recordSecondaryCommandBuffers(VkCommandBufferInheritanceInfo &prepass_inheritance_info,
+                                                                VkCommandBufferInheritanceInfo &inheritance_info,
+                                                                uint32_t render_target_index,
+                                                                uint32_t command_buffer_index)
+{
+    bool     reuse_enabled = m_p_render_resource_info->reuse_secondary_command_buffers;
+    uint64_t recorded_key  = recordedCommandKey(render_target_index);
+    if (reuse_enabled && m_recorded_command_cache.IsValid(command_buffer_index, recorded_key))
+    {
+        return;
+    }
+
+    // 两个subpass的secondary command buffer同时录制
+    if (m_depth_prepass_enabled)
+    {
+        m_subpass_list[_main_camera_subpass_depth_prepass]->drawMultiThreading(m_thread_pool,
+                                                                               m_thread_data,
+                                                                               prepass_inheritance_info,
+                                                                               command_buffer_index,
+                                                                               0,
+                                                                               MESH_DRAW_THREAD_NUM);
+    }
     m_subpass_list[_main_camera_subpass_mesh]->drawMultiThreading(m_thread_pool,
                                                                      m_thread_data,
                                                                      inheritance_info,
                                                                      command_buffer_index,
-                                                                     0,
+                                                                     MESH_DRAW_THREAD_NUM,
                                                                      MESH_DRAW_THREAD_NUM);
     m_thread_pool.wait();
+    m_recorded_command_cache.Store(command_buffer_index,
+                                   reuse_enabled ? recorded_key : RecordedCommandCache::kInvalidKey);
+}
+
+void MainCameraForwardRenderPass::executeSecondaryCommandBuffers(uint32_t thread_start_index,
+                                                                 uint32_t thread_count,
+                                                                 uint32_t command_buffer_index,
+                                                                 const char *label)
+{
+    VkDebugUtilsLabelEXT label_info = {
+            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, label, {1.0f, 1.0f, 1.0f, 1.0f}};
+    g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
 
     std::vector<VkCommandBuffer> recorded_command_buffers;
-    for (uint32_t i = 0; i < m_thread_data.size(); ++i)
+    for (uint32_t i = thread_start_index; i < thread_start_index + thread_count; ++i)
     {
         recorded_command_buffers.push_back(m_thread_data[i].command_buffers[command_buffer_index]);
     }
-
     g_p_vulkan_context->_vkCmdExecuteCommands(*m_p_render_command_info->p_current_command_buffer,
                                               recorded_command_buffers.size(),
                                               recorded_command_buffers.data());
-    g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer);
-
-    g_p_vulkan_context->_vkCmdNextSubpass(*m_p_render_command_info->p_current_command_buffer,
-                                          VK_SUBPASS_CONTENTS_INLINE);
-    m_subpass_list[_main_camera_subpass_skybox]->draw();
 
-    g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
+    g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer);
 }
 
 void MainCameraForwardRenderPass::draw(uint32_t render_target_index)
 {
+    if (m_dynamic_rendering)
+    {
+        VkCommandBuffer command_buffer = *m_p_render_command_info->p_current_command_buffer;
+
+        // 三个subpass共用附件，深度预渲染与光照之间靠光栅化顺序保证，不需要额外的barrier
+        transitionAttachmentsBeforeRendering(command_buffer, render_target_index);
+        beginDynamicRendering(command_buffer, render_target_index, 0);
+        if (m_depth_prepass_enabled)
+        {
+            m_subpass_list[_main_camera_subpass_depth_prepass]->draw();
+        }
+        m_subpass_list[_main_camera_subpass_mesh]->draw();
+        m_subpass_list[_main_camera_subpass_skybox]->draw();
+        g_p_vulkan_context->_vkCmdEndRenderingKHR(command_buffer);
+        transitionAttachmentsAfterRendering(command_buffer, render_target_index);
+        return;
+    }
+
     VkClearValue clear_values[_main_camera_framebuffer_attachment_count] = {};
     clear_values[_main_camera_framebuffer_attachment_color].color        = {0.0f, 0.0f, 0.0f, 1.0f};
     clear_values[_main_camera_framebuffer_attachment_depth].depthStencil = {1.0f, 0};
@@ -291,6 +468,12 @@ void MainCameraForwardRenderPass::draw(uint32_t render_target_index)
                                               &renderpass_begin_info,
                                               VK_SUBPASS_CONTENTS_INLINE);
 
+    if (m_depth_prepass_enabled)
+    {
+        m_subpass_list[_main_camera_subpass_depth_prepass]->draw();
+    }
+    g_p_vulkan_context->_vkCmdNextSubpass(*m_p_render_command_info->p_current_command_buffer,
+                                          VK_SUBPASS_CONTENTS_INLINE);
     m_subpass_list[_main_camera_subpass_mesh]->draw();
     g_p_vulkan_context->_vkCmdNextSubpass(*m_p_render_command_info->p_current_command_buffer,
                                           VK_SUBPASS_CONTENTS_INLINE);
@@ -299,28 +482,130 @@ void MainCameraForwardRenderPass::draw(uint32_t render_target_index)
     g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
 }
 
+void MainCameraForwardRenderPass::beginDynamicRendering(VkCommandBuffer command_buffer,
+                                                        uint32_t render_target_index,
+                                                        VkRenderingFlagsKHR flags)
+{
+    // 恢复挂起的pass实例时load op不会再次执行，各段使用相同的附件描述
+    VkRenderingAttachmentInfoKHR color_attachment_info{};
+    color_attachment_info.sType                   = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color_attachment_info.imageView               = (*m_p_render_targets)[render_target_index].view;
+    color_attachment_info.imageLayout             = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment_info.resolveMode             = VK_RESOLVE_MODE_NONE_KHR;
+    color_attachment_info.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment_info.storeOp                 = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment_info.clearValue.color        = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    VkRenderingAttachmentInfoKHR depth_attachment_info{};
+    depth_attachment_info.sType                   = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depth_attachment_info.imageView               = m_renderpass_attachments[_main_camera_framebuffer_attachment_depth].view;
+    depth_attachment_info.imageLayout             = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment_info.resolveMode             = VK_RESOLVE_MODE_NONE_KHR;
+    depth_attachment_info.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment_info.storeOp                 = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment_info.clearValue.depthStencil = {1.0f, 0};
+
+    VkRenderingInfoKHR rendering_info{};
+    rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    rendering_info.flags                = flags;
+    rendering_info.renderArea.offset    = {0, 0};
+    rendering_info.renderArea.extent    = g_p_vulkan_context->_swapchain_extent;
+    rendering_info.layerCount           = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments    = &color_attachment_info;
+    rendering_info.pDepthAttachment     = &depth_attachment_info;
+
+    g_p_vulkan_context->_vkCmdBeginRenderingKHR(command_buffer, &rendering_info);
+}
+
+void MainCameraForwardRenderPass::transitionAttachmentsBeforeRendering(VkCommandBuffer command_buffer,
+                                                                       uint32_t render_target_index)
+{
+    // 对应render pass中initialLayout为UNDEFINED的两个附件，上一帧的内容直接丢弃；
+    // 颜色附件上一帧还被UI pass作为input attachment读取，只需要执行依赖
+    transitionAttachmentLayout(command_buffer,
+                               (*m_p_render_targets)[render_target_index],
+                               VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                               VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR |
+                               VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                               VK_ACCESS_2_NONE_KHR,
+                               VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                               VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR |
+                               VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR);
+    transitionAttachmentLayout(command_buffer,
+                               m_renderpass_attachments[_main_camera_framebuffer_attachment_depth],
+                               VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                               VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR |
+                               VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+                               VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR |
+                               VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR |
+                               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR);
+}
+
+void MainCameraForwardRenderPass::transitionAttachmentsAfterRendering(VkCommandBuffer command_buffer,
+                                                                      uint32_t render_target_index)
+{
+    // 对应render pass的finalLayout和之后pass的external依赖
+    transitionAttachmentLayout(command_buffer,
+                               (*m_p_render_targets)[render_target_index],
+                               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                               (*m_p_render_targets)[render_target_index].layout,
+                               VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                               VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                               VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR,
+                               VK_ACCESS_2_MEMORY_READ_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR);
+}
+
+void MainCameraForwardRenderPass::setDepthPrepassEnabled(bool enabled)
+{
+    m_depth_prepass_enabled = enabled;
+    std::reinterpret_pointer_cast<SubPass::MeshForwardLightingPass>(
+            m_subpass_list[_main_camera_subpass_mesh])->setDepthPrepassEnabled(enabled);
+}
+
+uint64_t MainCameraForwardRenderPass::recordedCommandKey(uint32_t render_target_index) const
+{
+    uint64_t key = m_p_render_resource_info->draw_list_hash;
+    HashCombine(key, &render_target_index, sizeof(render_target_index));
+    HashCombine(key, &m_depth_prepass_enabled, sizeof(m_depth_prepass_enabled));
+    HashCombine(key, m_p_render_command_info->p_viewport, sizeof(VkViewport));
+    HashCombine(key, m_p_render_command_info->p_scissor, sizeof(VkRect2D));
+    return key;
+}
+
 void MainCameraForwardRenderPass::updateAfterSwapchainRecreate()
 {
-    for (int i = 0; i < _main_camera_framebuffer_attachment_count; ++i)
+    // framebuffer重建后已录制的命令全部失效
+    m_recorded_command_cache.Invalidate();
+
+    // render pass只依赖附件格式，沿用原来的对象，已创建的pipeline也保持兼容
+    if ((*m_p_render_targets)[0].format != m_renderpass_attachments[_main_camera_framebuffer_attachment_color].format)
     {
-        if (m_renderpass_attachments[i].image != VK_NULL_HANDLE)
-        {
-            m_renderpass_attachments[i].destroy();
-        }
+        throw std::runtime_error("swapchain format changed on recreate");
     }
-    for (int i = 0; i < m_framebuffer_per_rendertarget.size(); ++i)
+
+    bool attachments_reallocated = resizeRenderpassAttachments();
+    // dynamic rendering在录制时直接引用image view，没有需要重建的framebuffer
+    if (!m_dynamic_rendering)
     {
-        vkDestroyFramebuffer(g_p_vulkan_context->_device, m_framebuffer_per_rendertarget[i], nullptr);
+        for (int i = 0; i < m_framebuffer_per_rendertarget.size(); ++i)
+        {
+            g_p_vulkan_context->_deletion_queue.DestroyFramebuffer(m_framebuffer_per_rendertarget[i]);
+        }
+        setupFrameBuffer();
     }
-    vkDestroyRenderPass(g_p_vulkan_context->_device, m_renderpass, nullptr);
-
-    setupRenderpassAttachments();
-    setupRenderPass();
-    setupFrameBuffer();
 
-    for (int i = 0; i < m_subpass_list.size(); ++i)
+    // 附件没有重建时descriptor仍然有效，不能改写在途帧正在使用的descriptor set
+    if (attachments_reallocated)
     {
-        m_subpass_list[i]->updateAfterSwapchainRecreate();
+        for (int i = 0; i < m_subpass_list.size(); ++i)
+        {
+            m_subpass_list[i]->updateAfterSwapchainRecreate();
+        }
     }
 }
 
@@ -0,0 +1,222 @@
+//
+// Created by kyrosz7u on 2023/7/20.
+//
+
+#include "render/renderpass/point_light_shadow_pass.h"
+#include "render/subpass/point_light_shadow.h"
+#include "render/resource/render_point_light_shadow.h"
+#include "core/logger/logger_macros.h"
+#include "mesh_point_light_shadow_vert.h"
+#include "mesh_point_light_shadow_frag.h"
+
+using namespace RenderSystem;
+
+void PointLightShadowRenderPass::initialize(RenderPassInitInfo *renderpass_init_info)
+{
+    auto point_light_shadow_renderpass_init_info = static_cast<PointLightShadowRenderPassInitInfo*>(renderpass_init_info);
+    m_p_render_command_info  = point_light_shadow_renderpass_init_info->render_command_info;
+    m_p_render_resource_info = point_light_shadow_renderpass_init_info->render_resource_info;
+    m_p_shadowmap_attachment = point_light_shadow_renderpass_init_info->shadowmap_attachment;
+
+    m_multiview_enabled = g_p_vulkan_context->_multiview_supported;
+    if (!m_multiview_enabled)
+    {
+        LOG_WARN("VK_KHR_multiview is not supported, point light shadows are disabled")
+    }
+
+    setupRenderpassAttachments();
+    setupRenderPass();
+    setupFrameBuffer();
+    setupSubpass();
+}
+
+void PointLightShadowRenderPass::setupRenderpassAttachments()
+{
+    assert(m_p_shadowmap_attachment != nullptr);
+    assert(m_p_shadowmap_attachment->layer_count == MAX_POINT_LIGHT_SHADOW_COUNT * PointLightShadow::kFaceCount);
+
+    // 每个光源的6层单独作为一个2D array view，multiview的第i个视图写入第i层
+    m_renderpass_attachments.resize(MAX_POINT_LIGHT_SHADOW_COUNT);
+    for (uint32_t i = 0; i < MAX_POINT_LIGHT_SHADOW_COUNT; ++i)
+    {
+        m_renderpass_attachments[i]      = *m_p_shadowmap_attachment;
+        m_renderpass_attachments[i].view =
+                VulkanUtil::createImageView(g_p_vulkan_context,
+                                            m_p_shadowmap_attachment->image,
+                                            m_p_shadowmap_attachment->format,
+                                            VK_IMAGE_ASPECT_DEPTH_BIT,
+                                            VK_IMAGE_VIEW_TYPE_2D_ARRAY, 1,
+                                            i * PointLightShadow::kFaceCount, PointLightShadow::kFaceCount);
+    }
+}
+
+void PointLightShadowRenderPass::setupRenderPass()
+{
+    static_assert(_point_light_attachment_count == 1 && _point_light_shadow_subpass_count == 1);
+
+    VkAttachmentDescription depth_attachment_description{};
+    depth_attachment_description.format         = m_p_shadowmap_attachment->format;
+    depth_attachment_description.samples        = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment_description.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment_description.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment_description.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment_description.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment_description.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_reference{};
+    depth_attachment_reference.attachment = _point_light_attachment_depth;
+    depth_attachment_reference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription base_pass{};
+    base_pass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    base_pass.colorAttachmentCount    = 0;
+    base_pass.pColorAttachments       = nullptr;
+    base_pass.pDepthStencilAttachment = &depth_attachment_reference;
+    base_pass.preserveAttachmentCount = 0;
+    base_pass.pPreserveAttachments    = NULL;
+
+    VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+    std::vector<VkSubpassDependency> dependencies;
+    dependencies.resize(2);
+
+    // 上一帧光照pass采样完成后才能覆盖
+    VkSubpassDependency &base_pass_dependency = dependencies[0];
+    base_pass_dependency.srcSubpass      = VK_SUBPASS_EXTERNAL;
+    base_pass_dependency.dstSubpass      = _point_light_shadow_subpass_shadow;
+    base_pass_dependency.srcStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    base_pass_dependency.dstStageMask    = depth_stages;
+    base_pass_dependency.srcAccessMask   = 0;
+    base_pass_dependency.dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    base_pass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    VkSubpassDependency &other_pass_dependency = dependencies[1];
+    other_pass_dependency.srcSubpass      = _point_light_shadow_subpass_shadow;
+    other_pass_dependency.dstSubpass      = VK_SUBPASS_EXTERNAL;
+    other_pass_dependency.srcStageMask    = depth_stages;
+    other_pass_dependency.dstStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    other_pass_dependency.srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    other_pass_dependency.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+    other_pass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // cube的六个面对应视图0~5，各个面之间没有空间相关性，不设置correlation mask
+    uint32_t view_mask = (1u << PointLightShadow::kFaceCount) - 1u;
+
+    VkRenderPassMultiviewCreateInfoKHR multiview_create_info{};
+    multiview_create_info.sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+    multiview_create_info.subpassCount         = 1;
+    multiview_create_info.pViewMasks           = &view_mask;
+    multiview_create_info.dependencyCount      = 0;
+    multiview_create_info.pViewOffsets         = nullptr;
+    multiview_create_info.correlationMaskCount = 0;
+    multiview_create_info.pCorrelationMasks    = nullptr;
+
+    VkRenderPassCreateInfo renderpass_create_info{};
+    renderpass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderpass_create_info.pNext           = m_multiview_enabled ? &multiview_create_info : nullptr;
+    renderpass_create_info.attachmentCount = 1;
+    renderpass_create_info.pAttachments    = &depth_attachment_description;
+    renderpass_create_info.subpassCount    = 1;
+    renderpass_create_info.pSubpasses      = &base_pass;
+    renderpass_create_info.dependencyCount = dependencies.size();
+    renderpass_create_info.pDependencies   = dependencies.data();
+
+    if (vkCreateRenderPass(
+            g_p_vulkan_context->_device, &renderpass_create_info,
+            nullptr, &m_renderpass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create point light shadow render pass");
+    }
+}
+
+void PointLightShadowRenderPass::setupFrameBuffer()
+{
+    m_framebuffer_per_rendertarget.resize(MAX_POINT_LIGHT_SHADOW_COUNT);
+
+    for (uint32_t i = 0; i < MAX_POINT_LIGHT_SHADOW_COUNT; ++i)
+    {
+        VkFramebufferCreateInfo framebuffer_create_info{};
+        framebuffer_create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_create_info.renderPass      = m_renderpass;
+        framebuffer_create_info.attachmentCount = _point_light_attachment_count;
+        framebuffer_create_info.pAttachments    = &m_renderpass_attachments[i].view;
+        framebuffer_create_info.width           = m_p_shadowmap_attachment->width;
+        framebuffer_create_info.height          = m_p_shadowmap_attachment->height;
+        // multiview的framebuffer必须只有1层，不支持时作为layered framebuffer一次清空6层
+        framebuffer_create_info.layers          = m_multiview_enabled ? 1 : PointLightShadow::kFaceCount;
+
+        if (vkCreateFramebuffer(g_p_vulkan_context->_device,
+                                &framebuffer_create_info,
+                                nullptr,
+                                &m_framebuffer_per_rendertarget[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("create point light shadow framebuffer");
+        }
+    }
+}
+
+void PointLightShadowRenderPass::setupSubpass()
+{
+    // 着色器依赖gl_ViewIndex，没有multiview时不创建管线
+    if (!m_multiview_enabled)
+    {
+        return;
+    }
+
+    SubPass::PointLightShadowPassInitInfo point_light_shadow_pass_init_info{};
+    point_light_shadow_pass_init_info.p_render_command_info  = m_p_render_command_info;
+    point_light_shadow_pass_init_info.p_render_resource_info = m_p_render_resource_info;
+    point_light_shadow_pass_init_info.renderpass             = m_renderpass;
+    point_light_shadow_pass_init_info.subpass_index          = _point_light_shadow_subpass_shadow;
+
+    m_subpass_list[_point_light_shadow_subpass_shadow] = std::make_shared<SubPass::PointLightShadowPass>();
+    m_subpass_list[_point_light_shadow_subpass_shadow]->setShader(SubPass::VERTEX_SHADER,
+                                                                  MESH_POINT_LIGHT_SHADOW_VERT);
+    m_subpass_list[_point_light_shadow_subpass_shadow]->setShader(SubPass::FRAGMENT_SHADER,
+                                                                  MESH_POINT_LIGHT_SHADOW_FRAG);
+    m_subpass_list[_point_light_shadow_subpass_shadow]->initialize(&point_light_shadow_pass_init_info);
+}
+
+void PointLightShadowRenderPass::draw(uint32_t render_target_index)
+{
+    uint32_t shadow_count = m_p_render_resource_info->p_render_point_light_shadow_ubo_list->ubo_data_list.size();
+
+    VkClearValue clear_values[_point_light_attachment_count] = {};
+    clear_values[_point_light_attachment_depth].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderpass_begin_info{};
+    renderpass_begin_info.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderpass_begin_info.renderPass        = m_renderpass;
+    renderpass_begin_info.renderArea.offset = {0, 0};
+    renderpass_begin_info.renderArea.extent = {static_cast<uint32_t>(m_p_shadowmap_attachment->width),
+                                               static_cast<uint32_t>(m_p_shadowmap_attachment->height)};
+    renderpass_begin_info.clearValueCount   = (sizeof(clear_values) / sizeof(clear_values[0]));
+    renderpass_begin_info.pClearValues      = clear_values;
+
+    // 未使用的cube也清空一次，保证整个cube array处于着色器可读的布局
+    for (uint32_t i = 0; i < MAX_POINT_LIGHT_SHADOW_COUNT; ++i)
+    {
+        renderpass_begin_info.framebuffer = m_framebuffer_per_rendertarget[i];
+        g_p_vulkan_context->_vkCmdBeginRenderPass(*m_p_render_command_info->p_current_command_buffer,
+                                                  &renderpass_begin_info,
+                                                  VK_SUBPASS_CONTENTS_INLINE);
+
+        if (m_multiview_enabled && i < shadow_count)
+        {
+            auto shadow_subpass = std::reinterpret_pointer_cast<SubPass::PointLightShadowPass>(
+                    m_subpass_list[_point_light_shadow_subpass_shadow]);
+            shadow_subpass->setShadowIndex(i);
+            shadow_subpass->draw();
+        }
+
+        g_p_vulkan_context->_vkCmdEndRenderPass(*m_p_render_command_info->p_current_command_buffer);
+    }
+}
+
+void PointLightShadowRenderPass::updateAfterSwapchainRecreate()
+{
+
+}
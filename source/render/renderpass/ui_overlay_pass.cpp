@@ -37,30 +37,13 @@ void UIOverlayRenderPass::setupRenderpassAttachments()
     m_renderpass_attachments[_ui_overlay_framebuffer_attachment_out_color].format = (*m_p_render_targets)[0].format;
     m_renderpass_attachments[_ui_overlay_framebuffer_attachment_out_color].layout = (*m_p_render_targets)[0].layout;
 
-    m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].format = VK_FORMAT_R8G8B8A8_UNORM;
-    m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VulkanUtil::createImage(g_p_vulkan_context,
-                            g_p_vulkan_context->_swapchain_extent.width,
-                            g_p_vulkan_context->_swapchain_extent.height,
-                            m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].format,
-                            VK_IMAGE_TILING_OPTIMAL,
-                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                            m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].image,
-                            m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].mem,
-                            0,
-                            1,
-                            1);
-
-    m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].view =
-            VulkanUtil::createImageView(g_p_vulkan_context,
-                                        m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].image,
-                                        m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].format,
-                                        VK_IMAGE_ASPECT_COLOR_BIT,
-                                        VK_IMAGE_VIEW_TYPE_2D,
-                                        1);
-
+    auto &backup_attachment = m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color];
+    backup_attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+    backup_attachment.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    backup_attachment.usage  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    backup_attachment.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    backup_attachment.fitExtent(g_p_vulkan_context->_swapchain_extent.width,
+                                g_p_vulkan_context->_swapchain_extent.height);
 }
 
 void UIOverlayRenderPass::setupRenderPass()
@@ -271,23 +254,28 @@ void UIOverlayRenderPass::draw(uint32_t render_target_index)
 
 void UIOverlayRenderPass::updateAfterSwapchainRecreate()
 {
-    vkDestroyImage(g_p_vulkan_context->_device, m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].image, nullptr);
-    vkDestroyImageView(g_p_vulkan_context->_device, m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].view, nullptr);
-    vkFreeMemory(g_p_vulkan_context->_device, m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].mem, nullptr);
-    vkDestroyRenderPass(g_p_vulkan_context->_device, m_renderpass, nullptr);
+    // render pass只依赖附件格式，沿用原来的对象，ImGui和合成pass的pipeline也保持兼容
+    if ((*m_p_render_targets)[0].format != m_renderpass_attachments[_ui_overlay_framebuffer_attachment_out_color].format)
+    {
+        throw std::runtime_error("swapchain format changed on recreate");
+    }
+
+    // 输入的颜色附件和这里的备份附件按同样的规则随交换链放大，两者总是同时重建
+    bool attachments_reallocated = m_renderpass_attachments[_ui_overlay_framebuffer_attachment_backup_color].fitExtent(
+            g_p_vulkan_context->_swapchain_extent.width, g_p_vulkan_context->_swapchain_extent.height);
 
     for (auto& framebuffer : m_framebuffer_per_rendertarget)
     {
-        vkDestroyFramebuffer(g_p_vulkan_context->_device, framebuffer, nullptr);
+        g_p_vulkan_context->_deletion_queue.DestroyFramebuffer(framebuffer);
     }
-
-    setupRenderpassAttachments();
-    setupRenderPass();
     setupFrameBuffer();
 
-    for(int i=0;i<m_subpass_list.size();++i)
+    if (attachments_reallocated)
     {
-        m_subpass_list[i]->updateAfterSwapchainRecreate();
+        for (int i = 0; i < m_subpass_list.size(); ++i)
+        {
+            m_subpass_list[i]->updateAfterSwapchainRecreate();
+        }
     }
 }
 
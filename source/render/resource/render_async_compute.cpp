@@ -0,0 +1,129 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#include "render/resource/render_async_compute.h"
+#include "core/graphic/vulkan/vulkan_context.h"
+#include "core/graphic/vulkan/vulkan_utils.h"
+#include "core/logger/logger_macros.h"
+#include <memory>
+#include <stdexcept>
+
+using namespace RenderSystem;
+using namespace VulkanAPI;
+
+namespace RenderSystem
+{
+    extern std::shared_ptr<VulkanContext> g_p_vulkan_context;
+}
+
+void AsyncComputeScheduler::Initialize(uint32_t command_buffer_count)
+{
+    m_compute_queue_family = g_p_vulkan_context->_queue_indices.computeFamily.value();
+    createCommandBuffers(m_compute_queue_family, command_buffer_count,
+                         m_compute_command_pool, m_compute_command_buffers);
+    createCommandBuffers(g_p_vulkan_context->_queue_indices.graphicsFamily.value(), command_buffer_count,
+                         m_graphics_command_pool, m_graphics_command_buffers);
+}
+
+void AsyncComputeScheduler::Destroy()
+{
+    if (m_compute_command_pool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    g_p_vulkan_context->_compute_timeline.WaitIdle();
+    g_p_vulkan_context->_graphics_timeline.WaitIdle();
+    vkDestroyCommandPool(g_p_vulkan_context->_device, m_compute_command_pool, nullptr);
+    vkDestroyCommandPool(g_p_vulkan_context->_device, m_graphics_command_pool, nullptr);
+    m_compute_command_pool  = VK_NULL_HANDLE;
+    m_graphics_command_pool = VK_NULL_HANDLE;
+    m_compute_command_buffers.clear();
+    m_graphics_command_buffers.clear();
+}
+
+VkCommandBuffer &AsyncComputeScheduler::BeginCompute(uint32_t index)
+{
+    beginCommandBuffer(m_compute_command_buffers[index]);
+    return m_compute_command_buffers[index];
+}
+
+TimelineWait AsyncComputeScheduler::SubmitCompute(uint32_t index, VkPipelineStageFlags wait_stages)
+{
+    VkCommandBuffer command_buffer = m_compute_command_buffers[index];
+    VK_CHECK_RESULT(g_p_vulkan_context->_vkEndCommandBuffer(command_buffer))
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers    = &command_buffer;
+
+    auto &graphics_timeline = g_p_vulkan_context->_graphics_timeline;
+    auto &compute_timeline  = g_p_vulkan_context->_compute_timeline;
+    uint64_t value = compute_timeline.Submit(
+            g_p_vulkan_context->_compute_queue, submit_info,
+            {{&graphics_timeline, graphics_timeline.GetLastSubmittedValue(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT}});
+
+    return {&compute_timeline, value, wait_stages};
+}
+
+VkCommandBuffer &AsyncComputeScheduler::BeginOverlappedGraphics(uint32_t index)
+{
+    beginCommandBuffer(m_graphics_command_buffers[index]);
+    return m_graphics_command_buffers[index];
+}
+
+void AsyncComputeScheduler::SubmitOverlappedGraphics(uint32_t index)
+{
+    VkCommandBuffer command_buffer = m_graphics_command_buffers[index];
+    VK_CHECK_RESULT(g_p_vulkan_context->_vkEndCommandBuffer(command_buffer))
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers    = &command_buffer;
+
+    // 主相机的提交排在同一队列之后，阴影贴图的读写依赖由render pass的subpass dependency保证
+    g_p_vulkan_context->_graphics_timeline.Submit(g_p_vulkan_context->_graphics_queue, submit_info);
+}
+
+void AsyncComputeScheduler::createCommandBuffers(uint32_t queue_family, uint32_t command_buffer_count,
+                                                 VkCommandPool &command_pool,
+                                                 std::vector<VkCommandBuffer> &command_buffers)
+{
+    VkCommandPoolCreateInfo command_pool_create_info{};
+    command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.flags            =
+            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    command_pool_create_info.queueFamilyIndex = queue_family;
+
+    if (vkCreateCommandPool(g_p_vulkan_context->_device, &command_pool_create_info, nullptr,
+                            &command_pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("vk create async compute command pool");
+    }
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+    command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = command_buffer_count;
+    command_buffer_allocate_info.commandPool        = command_pool;
+
+    command_buffers.resize(command_buffer_count);
+    if (vkAllocateCommandBuffers(g_p_vulkan_context->_device, &command_buffer_allocate_info,
+                                 command_buffers.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("vk allocate async compute command buffers");
+    }
+}
+
+void AsyncComputeScheduler::beginCommandBuffer(VkCommandBuffer command_buffer)
+{
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info{};
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(g_p_vulkan_context->_vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))
+}
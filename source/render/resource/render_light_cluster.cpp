@@ -0,0 +1,332 @@
+//
+// Created by kyrosz7u on 2023/7/19.
+//
+
+#include "render/resource/render_light_cluster.h"
+#include "render/resource/render_point_light_shadow.h"
+#include "core/graphic/vulkan/vulkan_utils.h"
+#include "core/logger/logger_macros.h"
+#include "light_cluster_cull_comp.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace RenderSystem;
+using namespace VulkanAPI;
+using namespace Math;
+
+void LightClusterCulling::Initialize()
+{
+    setupBuffers();
+    setupDescriptorSet();
+    setupPipeline();
+}
+
+void LightClusterCulling::Destroy()
+{
+    if (m_pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkDeviceWaitIdle(g_p_vulkan_context->_device);
+    vkUnmapMemory(g_p_vulkan_context->_device, m_light_buffer_memory);
+    vkDestroyBuffer(g_p_vulkan_context->_device, m_light_buffer, nullptr);
+    vkFreeMemory(g_p_vulkan_context->_device, m_light_buffer_memory, nullptr);
+    vkDestroyBuffer(g_p_vulkan_context->_device, m_cluster_count_buffer, nullptr);
+    vkFreeMemory(g_p_vulkan_context->_device, m_cluster_count_buffer_memory, nullptr);
+    vkDestroyBuffer(g_p_vulkan_context->_device, m_cluster_index_buffer, nullptr);
+    vkFreeMemory(g_p_vulkan_context->_device, m_cluster_index_buffer_memory, nullptr);
+    vkDestroyPipeline(g_p_vulkan_context->_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(g_p_vulkan_context->_device, m_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(g_p_vulkan_context->_device, m_descriptor_set_layout, nullptr);
+    vkDestroyDescriptorPool(g_p_vulkan_context->_device, m_descriptor_pool, nullptr);
+
+    m_light_buffer                = VK_NULL_HANDLE;
+    m_light_buffer_memory         = VK_NULL_HANDLE;
+    m_mapped_lights               = nullptr;
+    m_cluster_count_buffer        = VK_NULL_HANDLE;
+    m_cluster_count_buffer_memory = VK_NULL_HANDLE;
+    m_cluster_index_buffer        = VK_NULL_HANDLE;
+    m_cluster_index_buffer_memory = VK_NULL_HANDLE;
+    m_pipeline                    = VK_NULL_HANDLE;
+    m_pipeline_layout             = VK_NULL_HANDLE;
+    m_descriptor_set_layout       = VK_NULL_HANDLE;
+    m_descriptor_pool             = VK_NULL_HANDLE;
+    m_descriptor_set              = VK_NULL_HANDLE;
+    m_light_count                 = 0;
+}
+
+void LightClusterCulling::UpdateLights(const std::vector<Scene::PointLight> &point_lights,
+                                       const std::vector<Scene::SpotLight> &spot_lights)
+{
+    size_t light_count = point_lights.size() + spot_lights.size();
+    if (light_count > MAX_LOCAL_LIGHT_COUNT && m_light_count < MAX_LOCAL_LIGHT_COUNT)
+    {
+        LOG_WARN("local light count {} exceeds {}, extra lights are ignored", light_count, MAX_LOCAL_LIGHT_COUNT)
+    }
+
+    m_light_count = 0;
+    if (m_mapped_lights == nullptr)
+    {
+        return;
+    }
+
+    auto     *light_data  = static_cast<VulkanLocalLightDefine *>(m_mapped_lights);
+    uint32_t shadow_count = 0;
+    for (const auto &point_light: point_lights)
+    {
+        if (m_light_count >= MAX_LOCAL_LIGHT_COUNT)
+        {
+            break;
+        }
+        VulkanLocalLightDefine &data = light_data[m_light_count++];
+        data.position       = point_light.transform.position;
+        data.radius         = point_light.radius;
+        data.color          = Vector3(point_light.color.x, point_light.color.y, point_light.color.z);
+        data.intensity      = point_light.intensity;
+        data.direction      = Vector3(0, 0, 1);
+        data.spot_outer_cos = -1.0f;
+        data.spot_inner_cos = -1.0f;
+        data.type           = _local_light_point;
+        data.shadow_index   = PointLightShadow::AssignShadowIndex(point_light.cast_shadow, shadow_count);
+    }
+
+    for (auto spot_light: spot_lights)
+    {
+        if (m_light_count >= MAX_LOCAL_LIGHT_COUNT)
+        {
+            break;
+        }
+        VulkanLocalLightDefine &data = light_data[m_light_count++];
+        data.position       = spot_light.transform.position;
+        data.radius         = spot_light.radius;
+        data.color          = Vector3(spot_light.color.x, spot_light.color.y, spot_light.color.z);
+        data.intensity      = spot_light.intensity;
+        data.direction      = spot_light.transform.GetForward();
+        data.spot_outer_cos = std::cos(spot_light.outer_angle / 180.0f * Math_PI);
+        data.spot_inner_cos = std::cos(std::min(spot_light.inner_angle, spot_light.outer_angle) / 180.0f * Math_PI);
+        data.type           = _local_light_spot;
+        data.shadow_index   = PointLightShadow::AssignShadowIndex(spot_light.cast_shadow, shadow_count);
+    }
+}
+
+void LightClusterCulling::UpdateCamera(const RenderCameraInfo &camera_info, VulkanPerFrameSceneDefine &scene_data)
+{
+    float tan_half_fovy = tanf(camera_info.fov / 360.0f * Math_PI);
+
+    m_push_constants.view                 = camera_info.view;
+    m_push_constants.projection_params[0] = tan_half_fovy * camera_info.aspect;
+    m_push_constants.projection_params[1] = tan_half_fovy;
+    m_push_constants.projection_params[2] = camera_info.znear;
+    m_push_constants.projection_params[3] = camera_info.zfar;
+
+    // 第k个切片的近平面为znear * (zfar / znear)^(k / kClusterGridZ)
+    float log_depth_range = std::log(camera_info.zfar / camera_info.znear);
+    scene_data.view_depth_row      = Vector4(camera_info.view[2][0], camera_info.view[2][1],
+                                             camera_info.view[2][2], camera_info.view[2][3]);
+    scene_data.cluster_depth_scale = float(kClusterGridZ) / log_depth_range;
+    scene_data.cluster_depth_bias  = -float(kClusterGridZ) * std::log(camera_info.znear) / log_depth_range;
+    scene_data.local_light_number  = m_light_count;
+}
+
+void LightClusterCulling::Dispatch(VkCommandBuffer command_buffer, uint32_t dispatch_queue_family)
+{
+    const uint32_t graphics_queue_family = g_p_vulkan_context->_queue_indices.graphicsFamily.value();
+    m_dispatch_queue_family = dispatch_queue_family == graphics_queue_family ? VK_QUEUE_FAMILY_IGNORED
+                                                                             : dispatch_queue_family;
+    if (m_pipeline == VK_NULL_HANDLE)
+    {
+        m_dispatch_queue_family = VK_QUEUE_FAMILY_IGNORED;
+        return;
+    }
+
+    VkDebugUtilsLabelEXT label_info = {
+            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, "Light Cluster Culling", {1.0f, 1.0f, 1.0f, 1.0f}};
+    g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(command_buffer, &label_info);
+
+    // 上一帧着色读取完成后才能覆盖光源列表；计算队列不支持FRAGMENT_SHADER阶段，
+    // 在独立的计算队列上由提交时等待图形队列的timeline保证
+    if (m_dispatch_queue_family == VK_QUEUE_FAMILY_IGNORED)
+    {
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 0, nullptr);
+    }
+
+    m_push_constants.light_count = m_light_count;
+    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_COMPUTE,
+                                                 m_pipeline_layout,
+                                                 0, 1, &m_descriptor_set,
+                                                 0, nullptr);
+    vkCmdPushConstants(command_buffer,
+                       m_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(CullPushConstants),
+                       &m_push_constants);
+    vkCmdDispatch(command_buffer, (kClusterCount + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+    // cluster列表每帧全部重写，图形队列用完后不需要把所有权还给计算队列
+    bool transfer_ownership = m_dispatch_queue_family != VK_QUEUE_FAMILY_IGNORED;
+
+    VkBufferMemoryBarrier barriers[2]{};
+    for (auto &barrier: barriers)
+    {
+        barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask       = transfer_ownership ? 0 : VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = transfer_ownership ? m_dispatch_queue_family : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = transfer_ownership ? graphics_queue_family : VK_QUEUE_FAMILY_IGNORED;
+        barrier.offset              = 0;
+        barrier.size                = VK_WHOLE_SIZE;
+    }
+    barriers[0].buffer = m_cluster_count_buffer;
+    barriers[1].buffer = m_cluster_index_buffer;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         transfer_ownership ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 2, barriers, 0, nullptr);
+
+    g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(command_buffer);
+}
+
+void LightClusterCulling::setupBuffers()
+{
+    // 大小固定，着色pass的descriptor只需在初始化时写入一次
+    // 光源列表同时被计算队列和着色pass读取
+    VulkanUtil::createBuffer(g_p_vulkan_context,
+                             VkDeviceSize(MAX_LOCAL_LIGHT_COUNT) * sizeof(VulkanLocalLightDefine),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             m_light_buffer, m_light_buffer_memory,
+                             g_p_vulkan_context->getGraphicsComputeQueueFamilies());
+    vkMapMemory(g_p_vulkan_context->_device, m_light_buffer_memory, 0, VK_WHOLE_SIZE, 0, &m_mapped_lights);
+
+    VulkanUtil::createBuffer(g_p_vulkan_context,
+                             VkDeviceSize(kClusterCount) * sizeof(uint32_t),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             m_cluster_count_buffer, m_cluster_count_buffer_memory);
+
+    VulkanUtil::createBuffer(g_p_vulkan_context,
+                             VkDeviceSize(kClusterCount) * kMaxLightsPerCluster * sizeof(uint32_t),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             m_cluster_index_buffer, m_cluster_index_buffer_memory);
+
+    light_buffer_info         = {m_light_buffer, 0, VK_WHOLE_SIZE};
+    cluster_count_buffer_info = {m_cluster_count_buffer, 0, VK_WHOLE_SIZE};
+    cluster_index_buffer_info = {m_cluster_index_buffer, 0, VK_WHOLE_SIZE};
+}
+
+void LightClusterCulling::setupDescriptorSet()
+{
+    VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3};
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info{};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.poolSizeCount = 1;
+    descriptor_pool_create_info.pPoolSizes    = &pool_size;
+    descriptor_pool_create_info.maxSets       = 1;
+
+    VK_CHECK_RESULT(vkCreateDescriptorPool(g_p_vulkan_context->_device,
+                                           &descriptor_pool_create_info,
+                                           nullptr,
+                                           &m_descriptor_pool))
+
+    VkDescriptorSetLayoutBinding layout_bindings[3]{};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        layout_bindings[i].binding         = i;
+        layout_bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layout_bindings[i].descriptorCount = 1;
+        layout_bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info{};
+    layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 3;
+    layout_create_info.pBindings    = layout_bindings;
+
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(g_p_vulkan_context->_device,
+                                                &layout_create_info,
+                                                nullptr,
+                                                &m_descriptor_set_layout))
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool     = m_descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts        = &m_descriptor_set_layout;
+
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(g_p_vulkan_context->_device, &allocate_info, &m_descriptor_set))
+
+    VkDescriptorBufferInfo *buffer_infos[3] = {&light_buffer_info,
+                                               &cluster_count_buffer_info,
+                                               &cluster_index_buffer_info};
+
+    VkWriteDescriptorSet descriptor_writes[3]{};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        descriptor_writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[i].pNext           = nullptr;
+        descriptor_writes[i].dstSet          = m_descriptor_set;
+        descriptor_writes[i].dstBinding      = i;
+        descriptor_writes[i].dstArrayElement = 0;
+        descriptor_writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptor_writes[i].descriptorCount = 1;
+        descriptor_writes[i].pBufferInfo     = buffer_infos[i];
+    }
+
+    vkUpdateDescriptorSets(g_p_vulkan_context->_device, 3, descriptor_writes, 0, nullptr);
+}
+
+void LightClusterCulling::setupPipeline()
+{
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset     = 0;
+    push_constant_range.size       = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+    pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount         = 1;
+    pipeline_layout_create_info.pSetLayouts            = &m_descriptor_set_layout;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges    = &push_constant_range;
+
+    if (vkCreatePipelineLayout(g_p_vulkan_context->_device,
+                               &pipeline_layout_create_info,
+                               nullptr,
+                               &m_pipeline_layout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("create light cluster culling pipeline layout");
+    }
+
+    VkShaderModule shader_module = VulkanUtil::createShaderModule(g_p_vulkan_context->_device,
+                                                                  LIGHT_CLUSTER_CULL_COMP);
+
+    VkComputePipelineCreateInfo pipeline_create_info{};
+    pipeline_create_info.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = shader_module;
+    pipeline_create_info.stage.pName  = "main";
+    pipeline_create_info.layout       = m_pipeline_layout;
+
+    if (vkCreateComputePipelines(g_p_vulkan_context->_device,
+                                 VK_NULL_HANDLE,
+                                 1,
+                                 &pipeline_create_info,
+                                 nullptr,
+                                 &m_pipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("create light cluster culling pipeline");
+    }
+
+    vkDestroyShaderModule(g_p_vulkan_context->_device, shader_module, nullptr);
+}
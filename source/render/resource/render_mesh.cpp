@@ -3,61 +3,158 @@
 //
 
 #include "render/resource/render_mesh.h"
+#include "render/resource/render_mesh_file.h"
 #include "core/graphic/vulkan/vulkan_utils.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace VulkanAPI;
 using namespace RenderSystem;
 
-RenderMesh::RenderMesh()
+namespace
 {
-    assert(g_p_vulkan_context);
-}
-
-RenderMesh::~RenderMesh()
-{
-    if (mesh_vertex_position_buffer)
-    {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_vertex_position_buffer, nullptr);
-    }
-    if (mesh_vertex_position_buffer_memory)
-    {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_vertex_position_buffer_memory, nullptr);
-    }
-    if (mesh_vertex_normal_buffer)
-    {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_vertex_normal_buffer, nullptr);
-    }
-    if (mesh_vertex_normal_buffer_memory)
-    {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_vertex_normal_buffer_memory, nullptr);
-    }
-    if (mesh_vertex_texcoord_buffer)
+    // 单位向量投影到八面体再展开到[-1,1]^2
+    Vector2 octahedralEncode(const Vector3 &direction)
     {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_vertex_texcoord_buffer, nullptr);
+        float length_l1 = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+        if (length_l1 <= 0.0f)
+        {
+            return Vector2::ZERO;
+        }
+        Vector2 encoded(direction.x / length_l1, direction.y / length_l1);
+        if (direction.z < 0.0f)
+        {
+            Vector2 folded((1.0f - std::abs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f),
+                           (1.0f - std::abs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f));
+            encoded = folded;
+        }
+        return encoded;
     }
-    if (mesh_vertex_texcoord_buffer_memory)
+
+    Vector3 octahedralDecode(float x, float y)
     {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_vertex_texcoord_buffer_memory, nullptr);
+        Vector3 direction(x, y, 1.0f - std::abs(x) - std::abs(y));
+        if (direction.z < 0.0f)
+        {
+            float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            direction.x = folded_x;
+            direction.y = folded_y;
+        }
+        return direction.normalisedCopy();
     }
-    if (mesh_index_buffer)
+
+    int16_t toSnorm16(float value)
     {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_index_buffer, nullptr);
+        return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
     }
-    if (mesh_index_buffer_memory)
+
+    uint16_t toHalf(float value)
     {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_index_buffer_memory, nullptr);
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign     = (bits >> 16) & 0x8000;
+        int32_t  exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (((bits >> 23) & 0xFF) == 0xFF)
+        {
+            return uint16_t(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+        }
+        if (exponent >= 31)
+        {
+            return uint16_t(sign | 0x7C00);
+        }
+        if (exponent <= 0)
+        {
+            // 非规格化数
+            if (exponent < -10)
+            {
+                return uint16_t(sign);
+            }
+            mantissa |= 0x800000;
+            uint32_t shift = uint32_t(14 - exponent);
+            return uint16_t(sign | ((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1)));
+        }
+        // 舍入进位到指数位时结果仍然正确
+        return uint16_t((sign | (uint32_t(exponent) << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
     }
 }
 
+void VulkanMeshVertexNormal::Encode(const Vector3 &normal_value, const Vector4 &tangent_value)
+{
+    Vector2 normal_encoded  = octahedralEncode(normal_value);
+    Vector2 tangent_encoded = octahedralEncode(Vector3(tangent_value.x, tangent_value.y, tangent_value.z));
+
+    normal[0]  = toSnorm16(normal_encoded.x);
+    normal[1]  = toSnorm16(normal_encoded.y);
+    tangent[0] = toSnorm16(tangent_encoded.x);
+    // y映射到[1,32767]后乘以手性，保证符号不会因为0而丢失
+    int32_t tangent_y = int32_t(std::lround((tangent_encoded.y * 0.5f + 0.5f) * 32766.0f)) + 1;
+    tangent[1] = static_cast<int16_t>(tangent_value.w < 0.0f ? -tangent_y : tangent_y);
+}
+
+Vector3 VulkanMeshVertexNormal::DecodeNormal() const
+{
+    return octahedralDecode(std::max(normal[0] / 32767.0f, -1.0f), std::max(normal[1] / 32767.0f, -1.0f));
+}
+
+void VulkanMeshVertexTexcoord::Encode(const Vector2 &texcoord_value)
+{
+    texCoord[0] = toHalf(texcoord_value.x);
+    texCoord[1] = toHalf(texcoord_value.y);
+}
+
+RenderMesh::RenderMesh()
+{
+}
+
+RenderMesh::~RenderMesh()
+{
+    ReleaseFromDevice();
+}
+
 void RenderMesh::ToGPU()
 {
+    assert(g_p_vulkan_context);
+
+    std::vector<uint8_t> packed_indices;
+    if (m_cooked_source == nullptr)
+    {
+        m_index_type   = SelectIndexType(m_positions.size());
+        packed_indices = PackIndices(m_indices, m_index_type);
+    }
+
+    const void *vertex_position_data = m_positions.data();
+    const void *vertex_normal_data   = m_normals.data();
+    const void *vertex_texcoord_data = m_texcoords.data();
+    const void *index_data           = packed_indices.data();
+
     VkDeviceSize vertex_position_buffer_size = sizeof(VulkanMeshVertexPostition) * m_positions.size();
     VkDeviceSize vertex_normal_buffer_size   = sizeof(VulkanMeshVertexNormal) * m_normals.size();
     VkDeviceSize vertex_texcoord_buffer_size = sizeof(VulkanMeshVertexTexcoord) * m_texcoords.size();
-    VkDeviceSize index_buffer_size           = sizeof(uint16_t) * m_indices.size();
+    VkDeviceSize index_buffer_size           = packed_indices.size();
+
+    if (m_cooked_source != nullptr)
+    {
+        const auto &header = m_cooked_source->GetHeader();
+        m_index_type = header.index_stride == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+        vertex_position_data = m_cooked_source->GetSection(header.position_offset);
+        vertex_normal_data   = m_cooked_source->GetSection(header.normal_offset);
+        vertex_texcoord_data = m_cooked_source->GetSection(header.texcoord_offset);
+        index_data           = m_cooked_source->GetSection(header.index_offset);
+
+        vertex_position_buffer_size = VkDeviceSize(header.position_stride) * header.vertex_count;
+        vertex_normal_buffer_size   = VkDeviceSize(header.normal_stride) * header.vertex_count;
+        vertex_texcoord_buffer_size = VkDeviceSize(header.texcoord_stride) * header.vertex_count;
+        index_buffer_size           = VkDeviceSize(header.index_stride) * header.index_count;
+    }
 
     VkDeviceSize staging_buffer_size = vertex_position_buffer_size + vertex_normal_buffer_size +
                                        vertex_texcoord_buffer_size + index_buffer_size;
@@ -81,10 +178,10 @@ void RenderMesh::ToGPU()
     void *data;
     vkMapMemory(g_p_vulkan_context->_device, stagingMemory, 0, staging_buffer_size, 0, &data);
     uint8_t *buffer_ptr = (uint8_t *) data;
-    memcpy(buffer_ptr + vertex_position_offset, m_positions.data(), vertex_position_buffer_size);
-    memcpy(buffer_ptr + vertex_normal_offset, m_normals.data(), vertex_normal_buffer_size);
-    memcpy(buffer_ptr + vertex_texcoord_offset, m_texcoords.data(), vertex_texcoord_buffer_size);
-    memcpy(buffer_ptr + index_offset, m_indices.data(), index_buffer_size);
+    memcpy(buffer_ptr + vertex_position_offset, vertex_position_data, vertex_position_buffer_size);
+    memcpy(buffer_ptr + vertex_normal_offset, vertex_normal_data, vertex_normal_buffer_size);
+    memcpy(buffer_ptr + vertex_texcoord_offset, vertex_texcoord_data, vertex_texcoord_buffer_size);
+    memcpy(buffer_ptr + index_offset, index_data, index_buffer_size);
     vkUnmapMemory(g_p_vulkan_context->_device, stagingMemory);
 
     VulkanUtil::createBuffer(g_p_vulkan_context,
@@ -122,51 +219,73 @@ void RenderMesh::ToGPU()
 
     vkDestroyBuffer(g_p_vulkan_context->_device, stagingBuffer, nullptr);
     vkFreeMemory(g_p_vulkan_context->_device, stagingMemory, nullptr);
-}
 
+    // 数据已经在显存中，不再需要保留文件映射
+    m_cooked_source.reset();
+}
 
-void RenderMesh::ReleaseFromDevice()
+void RenderMesh::CalculateBounds()
 {
-    if (mesh_vertex_position_buffer)
-    {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_vertex_position_buffer, nullptr);
-        mesh_vertex_position_buffer = VK_NULL_HANDLE;
-    }
-    if (mesh_vertex_position_buffer_memory)
+    if (m_positions.empty())
     {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_vertex_position_buffer_memory, nullptr);
-        mesh_vertex_position_buffer_memory = VK_NULL_HANDLE;
+        m_bounding_min = Vector3::ZERO;
+        m_bounding_max = Vector3::ZERO;
+        return;
     }
-    if (mesh_vertex_normal_buffer)
-    {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_vertex_normal_buffer, nullptr);
-        mesh_vertex_normal_buffer = VK_NULL_HANDLE;
-    }
-    if (mesh_vertex_normal_buffer_memory)
-    {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_vertex_normal_buffer_memory, nullptr);
-        mesh_vertex_normal_buffer_memory = VK_NULL_HANDLE;
-    }
-    if (mesh_vertex_texcoord_buffer)
+
+    m_bounding_min = m_positions[0].position;
+    m_bounding_max = m_positions[0].position;
+    for (const auto &vertex: m_positions)
     {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_vertex_texcoord_buffer, nullptr);
-        mesh_vertex_texcoord_buffer = VK_NULL_HANDLE;
+        m_bounding_min.makeFloor(vertex.position);
+        m_bounding_max.makeCeil(vertex.position);
     }
-    if (mesh_vertex_texcoord_buffer_memory)
+}
+
+VkIndexType RenderMesh::SelectIndexType(size_t vertex_count)
+{
+    return vertex_count <= size_t(UINT16_MAX) + 1 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::vector<uint8_t> RenderMesh::PackIndices(const std::vector<uint32_t> &indices, VkIndexType index_type)
+{
+    std::vector<uint8_t> packed(indices.size() * GetIndexStride(index_type));
+    if (index_type == VK_INDEX_TYPE_UINT16)
     {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_vertex_texcoord_buffer_memory, nullptr);
-        mesh_vertex_texcoord_buffer_memory = VK_NULL_HANDLE;
-    }
-    if (mesh_index_buffer)
+        auto *packed_indices = reinterpret_cast<uint16_t *>(packed.data());
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            packed_indices[i] = static_cast<uint16_t>(indices[i]);
+        }
+    } else
     {
-        vkDestroyBuffer(g_p_vulkan_context->_device, mesh_index_buffer, nullptr);
-        mesh_index_buffer = VK_NULL_HANDLE;
+        memcpy(packed.data(), indices.data(), packed.size());
     }
-    if (mesh_index_buffer_memory)
+    return packed;
+}
+
+void RenderMesh::ReleaseFromDevice()
+{
+    // 烘焙工具和测试中的网格从未上传，也没有创建Vulkan context
+    if (mesh_vertex_position_buffer == VK_NULL_HANDLE && mesh_index_buffer == VK_NULL_HANDLE)
     {
-        vkFreeMemory(g_p_vulkan_context->_device, mesh_index_buffer_memory, nullptr);
-        mesh_index_buffer_memory = VK_NULL_HANDLE;
+        return;
     }
+
+    // 模型可以在运行时卸载，等引用它的帧执行完再销毁buffer
+    auto &deletion_queue = g_p_vulkan_context->_deletion_queue;
+    deletion_queue.DestroyBuffer(mesh_vertex_position_buffer, mesh_vertex_position_buffer_memory);
+    deletion_queue.DestroyBuffer(mesh_vertex_normal_buffer, mesh_vertex_normal_buffer_memory);
+    deletion_queue.DestroyBuffer(mesh_vertex_texcoord_buffer, mesh_vertex_texcoord_buffer_memory);
+    deletion_queue.DestroyBuffer(mesh_index_buffer, mesh_index_buffer_memory);
+    mesh_vertex_position_buffer        = VK_NULL_HANDLE;
+    mesh_vertex_position_buffer_memory = VK_NULL_HANDLE;
+    mesh_vertex_normal_buffer          = VK_NULL_HANDLE;
+    mesh_vertex_normal_buffer_memory   = VK_NULL_HANDLE;
+    mesh_vertex_texcoord_buffer        = VK_NULL_HANDLE;
+    mesh_vertex_texcoord_buffer_memory = VK_NULL_HANDLE;
+    mesh_index_buffer                  = VK_NULL_HANDLE;
+    mesh_index_buffer_memory           = VK_NULL_HANDLE;
 }
 
 
@@ -0,0 +1,244 @@
+//
+// Created by kyrosz7u on 2023/7/4.
+//
+
+#include "render/resource/render_mesh_file.h"
+#include "core/logger/logger_macros.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+using namespace RenderSystem;
+
+namespace
+{
+    uint64_t alignOffset(uint64_t offset)
+    {
+        return (offset + kMeshFileAlignment - 1) & ~uint64_t(kMeshFileAlignment - 1);
+    }
+
+    bool sectionInRange(uint64_t offset, uint64_t size, size_t file_size)
+    {
+        return offset <= file_size && size <= file_size - offset;
+    }
+
+    // 调用前已确认index_offset + index_count不超过索引段
+    uint32_t maxIndexInRange(const uint8_t *indices, uint32_t index_stride, uint32_t index_offset, uint32_t index_count)
+    {
+        uint32_t max_index = 0;
+        for (uint32_t i = index_offset; i < index_offset + index_count; ++i)
+        {
+            uint32_t index;
+            if (index_stride == sizeof(uint16_t))
+            {
+                uint16_t index16;
+                memcpy(&index16, indices + uint64_t(i) * sizeof(uint16_t), sizeof(uint16_t));
+                index = index16;
+            }
+            else
+            {
+                memcpy(&index, indices + uint64_t(i) * sizeof(uint32_t), sizeof(uint32_t));
+            }
+            max_index = std::max(max_index, index);
+        }
+        return max_index;
+    }
+}
+
+bool CookedMeshFile::Open(const std::string &path)
+{
+    if (!m_file.open(path))
+    {
+        LOG_ERROR("failed to map cooked mesh:{}", path)
+        return false;
+    }
+
+    if (m_file.size() < sizeof(MeshFileHeader))
+    {
+        LOG_ERROR("cooked mesh too small:{}", path)
+        m_file.close();
+        return false;
+    }
+
+    const auto &header = GetHeader();
+    if (header.magic != kMeshFileMagic || header.version != kMeshFileVersion)
+    {
+        LOG_ERROR("cooked mesh version mismatch:{}\tversion:{}\texpected:{}", path, header.version, kMeshFileVersion)
+        m_file.close();
+        return false;
+    }
+
+    if (header.position_stride != sizeof(VulkanMeshVertexPostition) ||
+        header.normal_stride != sizeof(VulkanMeshVertexNormal) ||
+        header.texcoord_stride != sizeof(VulkanMeshVertexTexcoord) ||
+        header.meshlet_stride != sizeof(RenderMeshlet) ||
+        (header.index_stride != sizeof(uint16_t) && header.index_stride != sizeof(uint32_t)) ||
+        header.index_stride < RenderMesh::GetIndexStride(RenderMesh::SelectIndexType(header.vertex_count)))
+    {
+        LOG_ERROR("cooked mesh vertex layout mismatch:{}", path)
+        m_file.close();
+        return false;
+    }
+
+    size_t file_size = m_file.size();
+    if (!sectionInRange(header.position_offset, uint64_t(header.vertex_count) * header.position_stride, file_size) ||
+        !sectionInRange(header.normal_offset, uint64_t(header.vertex_count) * header.normal_stride, file_size) ||
+        !sectionInRange(header.texcoord_offset, uint64_t(header.vertex_count) * header.texcoord_stride, file_size) ||
+        !sectionInRange(header.index_offset, uint64_t(header.index_count) * header.index_stride, file_size) ||
+        !sectionInRange(header.meshlet_offset, uint64_t(header.meshlet_count) * header.meshlet_stride, file_size) ||
+        !sectionInRange(header.submesh_offset, uint64_t(header.submesh_count) * sizeof(MeshFileSubmesh), file_size) ||
+        !sectionInRange(header.material_offset, uint64_t(header.material_count) * sizeof(MeshFileMaterial), file_size))
+    {
+        LOG_ERROR("cooked mesh truncated:{}", path)
+        m_file.close();
+        return false;
+    }
+
+    const auto *meshlets = GetMeshlets();
+    for (uint32_t i = 0; i < header.meshlet_count; ++i)
+    {
+        if (uint64_t(meshlets[i].index_offset) + meshlets[i].index_count > header.index_count)
+        {
+            LOG_ERROR("cooked mesh meshlet {} index range invalid:{}", i, path)
+            m_file.close();
+            return false;
+        }
+    }
+
+    // 损坏的文件会让绘制或上传读到索引段和顶点流之外，交给调用方回退到assimp导入
+    const auto *submeshes = GetSubmeshes();
+    const auto *indices   = GetSection(header.index_offset);
+    for (uint32_t i = 0; i < header.submesh_count; ++i)
+    {
+        const auto &submesh = submeshes[i];
+        if (uint64_t(submesh.index_offset) + submesh.index_count > header.index_count)
+        {
+            LOG_ERROR("cooked mesh submesh {} index range invalid:{}", i, path)
+            m_file.close();
+            return false;
+        }
+
+        bool valid = submesh.lod_count >= 1 && submesh.lod_count <= kMaxMeshLodCount;
+        for (uint32_t lod = 0; valid && lod < submesh.lod_count; ++lod)
+        {
+            valid = uint64_t(submesh.lods[lod].index_offset) + submesh.lods[lod].index_count <= header.index_count;
+        }
+        if (!valid)
+        {
+            LOG_ERROR("cooked mesh submesh {} lod range invalid:{}", i, path)
+            m_file.close();
+            return false;
+        }
+        if (uint64_t(submesh.meshlet_offset) + submesh.meshlet_count > header.meshlet_count)
+        {
+            LOG_ERROR("cooked mesh submesh {} meshlet range invalid:{}", i, path)
+            m_file.close();
+            return false;
+        }
+
+        // 绘制时索引加上vertex_offset，所有引用到的顶点都要落在顶点流内
+        uint32_t max_index = maxIndexInRange(indices, header.index_stride, submesh.index_offset, submesh.index_count);
+        for (uint32_t lod = 0; lod < submesh.lod_count; ++lod)
+        {
+            max_index = std::max(max_index, maxIndexInRange(indices, header.index_stride,
+                                                            submesh.lods[lod].index_offset,
+                                                            submesh.lods[lod].index_count));
+        }
+        for (uint32_t meshlet = submesh.meshlet_offset; meshlet < submesh.meshlet_offset + submesh.meshlet_count; ++meshlet)
+        {
+            max_index = std::max(max_index, maxIndexInRange(indices, header.index_stride,
+                                                            meshlets[meshlet].index_offset,
+                                                            meshlets[meshlet].index_count));
+        }
+        bool has_indices = submesh.index_count > 0 || submesh.meshlet_count > 0;
+        if (submesh.vertex_offset > header.vertex_count ||
+            (has_indices && uint64_t(submesh.vertex_offset) + max_index >= header.vertex_count))
+        {
+            LOG_ERROR("cooked mesh submesh {} vertex range invalid:{}", i, path)
+            m_file.close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CookedMeshFile::Write(const std::string &path,
+                           const RenderMesh &mesh,
+                           const std::vector<MeshFileSubmesh> &submeshes,
+                           const std::vector<std::string> &material_names)
+{
+    MeshFileHeader header{};
+    header.magic           = kMeshFileMagic;
+    header.version         = kMeshFileVersion;
+    header.vertex_count    = mesh.m_positions.size();
+    header.index_count     = mesh.m_indices.size();
+    header.submesh_count   = submeshes.size();
+    header.material_count  = material_names.size();
+    header.meshlet_count   = mesh.m_meshlets.size();
+    header.position_stride = sizeof(VulkanMeshVertexPostition);
+    header.normal_stride   = sizeof(VulkanMeshVertexNormal);
+    header.texcoord_stride = sizeof(VulkanMeshVertexTexcoord);
+    header.index_stride    = RenderMesh::GetIndexStride(RenderMesh::SelectIndexType(mesh.m_positions.size()));
+    header.meshlet_stride  = sizeof(RenderMeshlet);
+
+    header.bounding_min[0] = mesh.m_bounding_min.x;
+    header.bounding_min[1] = mesh.m_bounding_min.y;
+    header.bounding_min[2] = mesh.m_bounding_min.z;
+    header.bounding_max[0] = mesh.m_bounding_max.x;
+    header.bounding_max[1] = mesh.m_bounding_max.y;
+    header.bounding_max[2] = mesh.m_bounding_max.z;
+
+    header.position_offset = alignOffset(sizeof(MeshFileHeader));
+    header.normal_offset   = alignOffset(header.position_offset + uint64_t(header.vertex_count) * header.position_stride);
+    header.texcoord_offset = alignOffset(header.normal_offset + uint64_t(header.vertex_count) * header.normal_stride);
+    header.index_offset    = alignOffset(header.texcoord_offset + uint64_t(header.vertex_count) * header.texcoord_stride);
+    header.meshlet_offset  = alignOffset(header.index_offset + uint64_t(header.index_count) * header.index_stride);
+    header.submesh_offset  = alignOffset(header.meshlet_offset + uint64_t(header.meshlet_count) * header.meshlet_stride);
+    header.material_offset = alignOffset(header.submesh_offset + submeshes.size() * sizeof(MeshFileSubmesh));
+
+    std::vector<MeshFileMaterial> materials(material_names.size());
+    for (size_t i = 0; i < material_names.size(); ++i)
+    {
+        memset(materials[i].name, 0, kMeshFileMaterialNameLength);
+        strncpy(materials[i].name, material_names[i].c_str(), kMeshFileMaterialNameLength - 1);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        LOG_ERROR("failed to open cooked mesh for writing:{}", path)
+        return false;
+    }
+
+    auto write_section = [&file](uint64_t offset, const void *data, size_t size)
+    {
+        // 用0填充到段起始位置
+        static const char padding[kMeshFileAlignment] = {};
+        uint64_t          current = file.tellp();
+        file.write(padding, offset - current);
+        if (size > 0)
+        {
+            file.write(static_cast<const char *>(data), size);
+        }
+    };
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_section(header.position_offset, mesh.m_positions.data(),
+                  mesh.m_positions.size() * sizeof(VulkanMeshVertexPostition));
+    write_section(header.normal_offset, mesh.m_normals.data(),
+                  mesh.m_normals.size() * sizeof(VulkanMeshVertexNormal));
+    write_section(header.texcoord_offset, mesh.m_texcoords.data(),
+                  mesh.m_texcoords.size() * sizeof(VulkanMeshVertexTexcoord));
+    auto packed_indices = RenderMesh::PackIndices(mesh.m_indices,
+                                                  RenderMesh::SelectIndexType(mesh.m_positions.size()));
+    write_section(header.index_offset, packed_indices.data(), packed_indices.size());
+    write_section(header.meshlet_offset, mesh.m_meshlets.data(),
+                  mesh.m_meshlets.size() * sizeof(RenderMeshlet));
+    write_section(header.submesh_offset, submeshes.data(),
+                  submeshes.size() * sizeof(MeshFileSubmesh));
+    write_section(header.material_offset, materials.data(),
+                  materials.size() * sizeof(MeshFileMaterial));
+
+    return file.good();
+}
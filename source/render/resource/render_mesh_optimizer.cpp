@@ -0,0 +1,469 @@
+//
+// Created by kyrosz7u on 2023/7/12.
+//
+
+#include "render/resource/render_mesh_optimizer.h"
+#include "core/logger/logger_macros.h"
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+
+using namespace RenderSystem;
+
+namespace
+{
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    constexpr float kCacheDecayPower   = 1.5f;
+    constexpr float kLastTriScore      = 0.75f;
+    constexpr float kValenceBoostScale = 2.0f;
+    constexpr float kValenceBoostPower = 0.5f;
+
+    float forsythVertexScore(int cache_position, uint32_t remaining_valence)
+    {
+        if (remaining_valence == 0)
+        {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cache_position >= 0)
+        {
+            if (cache_position < 3)
+            {
+                // 刚用过的三角形的顶点，固定分数避免偏向某一个
+                score = kLastTriScore;
+            } else
+            {
+                float scaler = 1.0f / float(MeshOptimizer::kVertexCacheSize - 3);
+                score = std::pow(1.0f - float(cache_position - 3) * scaler, kCacheDecayPower);
+            }
+        }
+        // 剩余三角形少的顶点优先处理，尽早把它们移出cache
+        score += kValenceBoostScale * std::pow(float(remaining_valence), -kValenceBoostPower);
+        return score;
+    }
+
+    // 把区间内的索引压缩到[0, unique_vertices.size())，使各个辅助数组只和区间大小有关
+    void compactIndices(const uint32_t *indices, size_t index_count,
+                        std::vector<uint32_t> &local_indices, std::vector<uint32_t> &unique_vertices)
+    {
+        unique_vertices.assign(indices, indices + index_count);
+        std::sort(unique_vertices.begin(), unique_vertices.end());
+        unique_vertices.erase(std::unique(unique_vertices.begin(), unique_vertices.end()), unique_vertices.end());
+
+        local_indices.resize(index_count);
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            local_indices[i] = uint32_t(std::lower_bound(unique_vertices.begin(), unique_vertices.end(), indices[i]) -
+                                        unique_vertices.begin());
+        }
+    }
+
+    // 用时间戳模拟FIFO cache
+    class FifoCacheSimulator
+    {
+    public:
+        FifoCacheSimulator(size_t vertex_count, uint32_t cache_size)
+                : m_timestamps(vertex_count, 0), m_cache_size(cache_size), m_time(cache_size + 1)
+        {}
+
+        bool Access(uint32_t vertex)
+        {
+            if (m_time - m_timestamps[vertex] > m_cache_size)
+            {
+                m_timestamps[vertex] = m_time++;
+                return true;
+            }
+            return false;
+        }
+
+        uint32_t AccessTriangle(const uint32_t *triangle)
+        {
+            return uint32_t(Access(triangle[0])) + uint32_t(Access(triangle[1])) + uint32_t(Access(triangle[2]));
+        }
+
+        void Reset()
+        {
+            m_time += m_cache_size + 1;
+        }
+
+    private:
+        std::vector<uint32_t> m_timestamps;
+        uint32_t              m_cache_size;
+        uint32_t              m_time;
+    };
+}
+
+void MeshOptimizer::Optimize(RenderMesh &mesh, const std::vector<MeshIndexRange> &ranges)
+{
+    auto optimize_start = std::chrono::steady_clock::now();
+
+    size_t                vertex_count = mesh.m_positions.size();
+    std::vector<uint32_t> indices(mesh.m_indices.begin(), mesh.m_indices.end());
+    if (indices.empty() || vertex_count == 0)
+    {
+        return;
+    }
+    if (*std::max_element(indices.begin(), indices.end()) >= vertex_count)
+    {
+        LOG_WARN("mesh index out of range, skip optimization name:{}", mesh.m_name)
+        return;
+    }
+
+    auto before = AnalyzeVertexCache(indices.data(), indices.size(), vertex_count, kStatisticsCacheSize);
+
+    for (const auto &range: ranges)
+    {
+        size_t index_count = range.index_count - range.index_count % 3;
+        if (index_count < 3 || size_t(range.index_offset) + index_count > indices.size())
+        {
+            continue;
+        }
+        OptimizeVertexCache(indices.data() + range.index_offset, index_count);
+        optimizeOverdraw(indices.data() + range.index_offset, index_count, mesh);
+    }
+
+    // overdraw排序需要原始顶点顺序下的位置，最后再重排顶点
+    optimizeVertexFetch(mesh, indices);
+    mesh.m_indices = indices;
+
+    auto after = AnalyzeVertexCache(indices.data(), indices.size(), mesh.m_positions.size(), kStatisticsCacheSize);
+
+    auto optimize_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimize_start);
+    LOG_INFO("mesh optimized name:{}\tvertices:{}->{}\tacmr:{:.3f}->{:.3f}\tatvr:{:.3f}->{:.3f}\ttime:{:.2f}ms",
+             mesh.m_name, vertex_count, mesh.m_positions.size(),
+             before.acmr, after.acmr, before.atvr, after.atvr,
+             optimize_time.count())
+}
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const uint32_t *indices, size_t index_count,
+                                                         size_t vertex_count, uint32_t cache_size)
+{
+    VertexCacheStatistics statistics;
+    size_t                triangle_count = index_count / 3;
+    if (triangle_count == 0)
+    {
+        return statistics;
+    }
+
+    FifoCacheSimulator cache(vertex_count, cache_size);
+    std::vector<bool>  referenced(vertex_count, false);
+    size_t             referenced_count = 0;
+    for (size_t        i                = 0; i < triangle_count * 3; i += 3)
+    {
+        statistics.vertices_transformed += cache.AccessTriangle(indices + i);
+        for (size_t k = 0; k < 3; ++k)
+        {
+            if (!referenced[indices[i + k]])
+            {
+                referenced[indices[i + k]] = true;
+                referenced_count++;
+            }
+        }
+    }
+
+    statistics.acmr = float(statistics.vertices_transformed) / float(triangle_count);
+    statistics.atvr = float(statistics.vertices_transformed) / float(referenced_count);
+    return statistics;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t *indices, size_t index_count)
+{
+    size_t triangle_count = index_count / 3;
+
+    std::vector<uint32_t> local_indices;
+    std::vector<uint32_t> unique_vertices;
+    compactIndices(indices, index_count, local_indices, unique_vertices);
+    size_t local_vertex_count = unique_vertices.size();
+
+    // 每个顶点相邻的三角形，已输出的三角形通过和末尾交换移除
+    std::vector<uint32_t> remaining_valence(local_vertex_count, 0);
+    for (uint32_t         index: local_indices)
+    {
+        remaining_valence[index]++;
+    }
+    std::vector<uint32_t> adjacency_offsets(local_vertex_count + 1, 0);
+    for (size_t           v = 0; v < local_vertex_count; ++v)
+    {
+        adjacency_offsets[v + 1] = adjacency_offsets[v] + remaining_valence[v];
+    }
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<uint32_t> adjacency_fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (size_t           i = 0; i < index_count; ++i)
+    {
+        adjacency[adjacency_fill[local_indices[i]]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int>   cache_position(local_vertex_count, -1);
+    std::vector<float> vertex_score(local_vertex_count);
+    for (size_t        v = 0; v < local_vertex_count; ++v)
+    {
+        vertex_score[v] = forsythVertexScore(-1, remaining_valence[v]);
+    }
+
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<bool>  triangle_emitted(triangle_count, false);
+    int                best_triangle = -1;
+    float              best_score    = -1.0f;
+    for (size_t        t             = 0; t < triangle_count; ++t)
+    {
+        const uint32_t *triangle = &local_indices[t * 3];
+        triangle_score[t] = vertex_score[triangle[0]] + vertex_score[triangle[1]] + vertex_score[triangle[2]];
+        if (triangle_score[t] > best_score)
+        {
+            best_score    = triangle_score[t];
+            best_triangle = int(t);
+        }
+    }
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    cache.reserve(kVertexCacheSize + 3);
+    new_cache.reserve(kVertexCacheSize + 3);
+
+    std::vector<uint32_t> result;
+    result.reserve(index_count);
+    size_t                dead_end_cursor = 0;
+
+    for (size_t emitted = 0; emitted < triangle_count; ++emitted)
+    {
+        // cache中的顶点已经没有剩余三角形，从头顺序找下一个未输出的三角形
+        if (best_triangle < 0)
+        {
+            while (triangle_emitted[dead_end_cursor])
+            {
+                dead_end_cursor++;
+            }
+            best_triangle = int(dead_end_cursor);
+        }
+
+        triangle_emitted[best_triangle] = true;
+        const uint32_t *triangle = &local_indices[size_t(best_triangle) * 3];
+        for (int       k         = 0; k < 3; ++k)
+        {
+            uint32_t vertex = triangle[k];
+            result.push_back(unique_vertices[vertex]);
+
+            auto begin = adjacency.begin() + adjacency_offsets[vertex];
+            auto end   = begin + remaining_valence[vertex];
+            auto iter  = std::find(begin, end, uint32_t(best_triangle));
+            if (iter != end)
+            {
+                std::iter_swap(iter, end - 1);
+                remaining_valence[vertex]--;
+            }
+        }
+
+        // LRU：新三角形的顶点放到最前面
+        new_cache.clear();
+        for (int k = 0; k < 3; ++k)
+        {
+            if (std::find(new_cache.begin(), new_cache.end(), triangle[k]) == new_cache.end())
+            {
+                new_cache.push_back(triangle[k]);
+            }
+        }
+        for (uint32_t vertex: cache)
+        {
+            if (std::find(new_cache.begin(), new_cache.end(), vertex) == new_cache.end())
+            {
+                new_cache.push_back(vertex);
+            }
+        }
+
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            uint32_t vertex = new_cache[i];
+            cache_position[vertex] = i < kVertexCacheSize ? int(i) : -1;
+            vertex_score[vertex]   = forsythVertexScore(cache_position[vertex], remaining_valence[vertex]);
+        }
+
+        // 只有cache中顶点相邻的三角形分数会变化，从中选出下一个
+        best_triangle = -1;
+        best_score    = -1.0f;
+        for (uint32_t vertex: new_cache)
+        {
+            uint32_t adjacency_begin = adjacency_offsets[vertex];
+            for (uint32_t a = adjacency_begin; a < adjacency_begin + remaining_valence[vertex]; ++a)
+            {
+                uint32_t       t              = adjacency[a];
+                const uint32_t *tri           = &local_indices[size_t(t) * 3];
+                triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+                if (triangle_score[t] > best_score)
+                {
+                    best_score    = triangle_score[t];
+                    best_triangle = int(t);
+                }
+            }
+        }
+
+        if (new_cache.size() > kVertexCacheSize)
+        {
+            new_cache.resize(kVertexCacheSize);
+        }
+        std::swap(cache, new_cache);
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t *indices, size_t index_count, const RenderMesh &mesh)
+{
+    // Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+    // 把cache优化后的三角形序列切成若干簇，簇之间按朝外程度排序，外侧的簇先画以便遮挡内侧
+    size_t triangle_count = index_count / 3;
+    if (triangle_count < 2)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> local_indices;
+    std::vector<uint32_t> unique_vertices;
+    compactIndices(indices, index_count, local_indices, unique_vertices);
+    FifoCacheSimulator cache(unique_vertices.size(), kStatisticsCacheSize);
+
+    // 硬边界：三个顶点全部未命中的三角形，从这里切开不会损失cache命中
+    std::vector<uint32_t> hard_clusters;
+    for (size_t           t = 0; t < triangle_count; ++t)
+    {
+        if (cache.AccessTriangle(&local_indices[t * 3]) == 3)
+        {
+            hard_clusters.push_back(uint32_t(t));
+        }
+    }
+    if (hard_clusters.empty() || hard_clusters[0] != 0)
+    {
+        hard_clusters.insert(hard_clusters.begin(), 0);
+    }
+    hard_clusters.push_back(uint32_t(triangle_count));
+
+    // 软边界：子簇从冷cache开始的ACMR不超过整簇的kOverdrawThreshold倍时就切开
+    std::vector<uint32_t> clusters;
+    for (size_t           c = 0; c + 1 < hard_clusters.size(); ++c)
+    {
+        uint32_t cluster_begin = hard_clusters[c];
+        uint32_t cluster_end   = hard_clusters[c + 1];
+
+        cache.Reset();
+        uint32_t      cluster_misses = 0;
+        for (uint32_t t              = cluster_begin; t < cluster_end; ++t)
+        {
+            cluster_misses += cache.AccessTriangle(&local_indices[size_t(t) * 3]);
+        }
+        float threshold = kOverdrawThreshold * float(cluster_misses) / float(cluster_end - cluster_begin);
+
+        cache.Reset();
+        clusters.push_back(cluster_begin);
+        uint32_t      sub_begin  = cluster_begin;
+        uint32_t      sub_misses = 0;
+        for (uint32_t t          = cluster_begin; t < cluster_end; ++t)
+        {
+            sub_misses += cache.AccessTriangle(&local_indices[size_t(t) * 3]);
+            if (t + 1 < cluster_end && float(sub_misses) / float(t + 1 - sub_begin) <= threshold)
+            {
+                clusters.push_back(t + 1);
+                cache.Reset();
+                sub_begin  = t + 1;
+                sub_misses = 0;
+            }
+        }
+    }
+    clusters.push_back(uint32_t(triangle_count));
+
+    // 排序键：簇中心相对网格中心的偏移在簇平均法线上的投影，按面积加权
+    // 法线取顶点法线而不是由绕序计算，与坐标系和正面绕序约定无关
+    size_t               cluster_count = clusters.size() - 1;
+    std::vector<Vector3> cluster_centroids(cluster_count, Vector3::ZERO);
+    std::vector<Vector3> cluster_normals(cluster_count, Vector3::ZERO);
+    std::vector<float>   cluster_areas(cluster_count, 0.0f);
+    Vector3              mesh_centroid = Vector3::ZERO;
+    float                mesh_area     = 0.0f;
+
+    for (size_t c = 0; c < cluster_count; ++c)
+    {
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const uint32_t *triangle = indices + size_t(t) * 3;
+            const Vector3  &p0       = mesh.m_positions[triangle[0]].position;
+            const Vector3  &p1       = mesh.m_positions[triangle[1]].position;
+            const Vector3  &p2       = mesh.m_positions[triangle[2]].position;
+
+            float   area     = (p1 - p0).crossProduct(p2 - p0).length() * 0.5f;
+            Vector3 centroid = (p0 + p1 + p2) * (1.0f / 3.0f);
+
+            cluster_centroids[c] += centroid * area;
+            cluster_normals[c] += (mesh.m_normals[triangle[0]].DecodeNormal() +
+                                   mesh.m_normals[triangle[1]].DecodeNormal() +
+                                   mesh.m_normals[triangle[2]].DecodeNormal()) * area;
+            cluster_areas[c] += area;
+        }
+        mesh_centroid += cluster_centroids[c];
+        mesh_area += cluster_areas[c];
+    }
+    if (mesh_area <= 0.0f)
+    {
+        return;
+    }
+    mesh_centroid *= 1.0f / mesh_area;
+
+    std::vector<float> cluster_keys(cluster_count, 0.0f);
+    for (size_t        c = 0; c < cluster_count; ++c)
+    {
+        float normal_length = cluster_normals[c].length();
+        if (cluster_areas[c] <= 0.0f || normal_length <= 0.0f)
+        {
+            continue;
+        }
+        Vector3 centroid = cluster_centroids[c] * (1.0f / cluster_areas[c]);
+        cluster_keys[c] = (centroid - mesh_centroid).dotProduct(cluster_normals[c] * (1.0f / normal_length));
+    }
+
+    std::vector<uint32_t> cluster_order(cluster_count);
+    std::iota(cluster_order.begin(), cluster_order.end(), 0);
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&cluster_keys](uint32_t a, uint32_t b)
+    {
+        return cluster_keys[a] > cluster_keys[b];
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(index_count);
+    for (uint32_t         c: cluster_order)
+    {
+        result.insert(result.end(), indices + size_t(clusters[c]) * 3, indices + size_t(clusters[c + 1]) * 3);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(RenderMesh &mesh, std::vector<uint32_t> &indices)
+{
+    // 按索引中首次出现的顺序重排顶点，未被引用的顶点直接丢弃
+    size_t                vertex_count = mesh.m_positions.size();
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    uint32_t              next_vertex  = 0;
+    for (auto             &index: indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = next_vertex++;
+        }
+        index = remap[index];
+    }
+
+    std::vector<VulkanMeshVertexPostition> positions(next_vertex);
+    std::vector<VulkanMeshVertexNormal>    normals(next_vertex);
+    std::vector<VulkanMeshVertexTexcoord>  texcoords(next_vertex);
+    for (size_t                            v = 0; v < vertex_count; ++v)
+    {
+        if (remap[v] == UINT32_MAX)
+        {
+            continue;
+        }
+        positions[remap[v]] = mesh.m_positions[v];
+        normals[remap[v]]   = mesh.m_normals[v];
+        texcoords[remap[v]] = mesh.m_texcoords[v];
+    }
+    mesh.m_positions.swap(positions);
+    mesh.m_normals.swap(normals);
+    mesh.m_texcoords.swap(texcoords);
+}
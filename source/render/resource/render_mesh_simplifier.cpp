@@ -0,0 +1,417 @@
+//
+// Created by kyrosz7u on 2023/7/14.
+//
+
+#include "render/resource/render_mesh_simplifier.h"
+#include "core/logger/logger_macros.h"
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+using namespace RenderSystem;
+using namespace Math;
+
+namespace
+{
+    // 对称矩阵A、向量b、常数c表示的二次误差 Q(p) = p^T*A*p + 2*b^T*p + c，w为累计的面积权重
+    struct Quadric
+    {
+        double a00{0}, a01{0}, a02{0}, a11{0}, a12{0}, a22{0};
+        double b0{0}, b1{0}, b2{0};
+        double c{0};
+        double w{0};
+
+        void AddPlane(double nx, double ny, double nz, double d, double weight)
+        {
+            a00 += weight * nx * nx;
+            a01 += weight * nx * ny;
+            a02 += weight * nx * nz;
+            a11 += weight * ny * ny;
+            a12 += weight * ny * nz;
+            a22 += weight * nz * nz;
+            b0 += weight * nx * d;
+            b1 += weight * ny * d;
+            b2 += weight * nz * d;
+            c += weight * d * d;
+            w += weight;
+        }
+
+        Quadric &operator+=(const Quadric &rhs)
+        {
+            a00 += rhs.a00;
+            a01 += rhs.a01;
+            a02 += rhs.a02;
+            a11 += rhs.a11;
+            a12 += rhs.a12;
+            a22 += rhs.a22;
+            b0 += rhs.b0;
+            b1 += rhs.b1;
+            b2 += rhs.b2;
+            c += rhs.c;
+            w += rhs.w;
+            return *this;
+        }
+
+        [[nodiscard]] double Evaluate(const Vector3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a00 * x * x + a11 * y * y + a22 * z * z +
+                       2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                       2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return std::max(r, 0.0);
+        }
+    };
+
+    struct EdgeCollapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double   cost;
+    };
+
+    bool samePosition(const Vector3 &a, const Vector3 &b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+}
+
+void MeshSimplifier::GenerateLods(RenderMesh &mesh,
+                                  const std::vector<MeshIndexRange> &ranges,
+                                  std::vector<uint32_t> &lod_counts,
+                                  std::vector<RenderSubmeshLodChain> &lod_chains)
+{
+    auto generate_start = std::chrono::steady_clock::now();
+
+    lod_counts.assign(ranges.size(), 1);
+    lod_chains.assign(ranges.size(), RenderSubmeshLodChain{});
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        lod_chains[i][0] = {ranges[i].index_offset, ranges[i].index_count, 0.0f};
+    }
+    if (mesh.m_positions.empty())
+    {
+        return;
+    }
+
+    // 误差统一相对于整个网格的包围盒对角线
+    Vector3 bounding_min = mesh.m_positions[0].position;
+    Vector3 bounding_max = mesh.m_positions[0].position;
+    for (const auto &vertex: mesh.m_positions)
+    {
+        bounding_min.makeFloor(vertex.position);
+        bounding_max.makeCeil(vertex.position);
+    }
+    float extent = (bounding_max - bounding_min).length();
+    if (extent <= 0.0f)
+    {
+        return;
+    }
+
+    std::array<size_t, kMaxMeshLodCount> lod_index_counts{};
+    for (size_t                           i = 0; i < ranges.size(); ++i)
+    {
+        const auto &range = ranges[i];
+        auto       &chain = lod_chains[i];
+        lod_index_counts[0] += range.index_count;
+
+        std::vector<uint32_t> source(mesh.m_indices.begin() + range.index_offset,
+                                     mesh.m_indices.begin() + range.index_offset + range.index_count);
+        float                 error = 0.0f;
+        while (lod_counts[i] < kMaxMeshLodCount)
+        {
+            size_t target_index_count = size_t(float(source.size()) * kLodReduction) / 3 * 3;
+            if (target_index_count < 3)
+            {
+                break;
+            }
+
+            // 从上一级继续简化，误差按层累加
+            std::vector<uint32_t> lod_indices;
+            float                 lod_error = Simplify(mesh, source.data(), source.size(), target_index_count,
+                                                       kMaxLodError - error, extent, lod_indices);
+            if (lod_indices.empty() || float(lod_indices.size()) > float(source.size()) * kMinLodReduction)
+            {
+                break;
+            }
+            MeshOptimizer::OptimizeVertexCache(lod_indices.data(), lod_indices.size());
+
+            error += lod_error;
+            chain[lod_counts[i]] = {static_cast<uint32_t>(mesh.m_indices.size()),
+                                    static_cast<uint32_t>(lod_indices.size()),
+                                    error};
+            lod_index_counts[lod_counts[i]] += lod_indices.size();
+            mesh.m_indices.insert(mesh.m_indices.end(), lod_indices.begin(), lod_indices.end());
+            lod_counts[i]++;
+            source.swap(lod_indices);
+        }
+    }
+
+    std::string triangle_counts;
+    for (uint32_t lod = 0; lod < kMaxMeshLodCount; ++lod)
+    {
+        if (lod > 0)
+            triangle_counts += "/";
+        triangle_counts += std::to_string(lod_index_counts[lod] / 3);
+    }
+    auto generate_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generate_start);
+    LOG_INFO("mesh lods generated name:{}\ttriangles:{}\ttime:{:.2f}ms",
+             mesh.m_name, triangle_counts, generate_time.count())
+}
+
+float MeshSimplifier::Simplify(const RenderMesh &mesh,
+                               const uint32_t *indices, size_t index_count,
+                               size_t target_index_count, float target_error, float extent,
+                               std::vector<uint32_t> &result)
+{
+    result.clear();
+    index_count -= index_count % 3;
+    if (index_count == 0 || target_error <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    // 压缩到局部顶点编号
+    std::vector<uint32_t> unique_vertices(indices, indices + index_count);
+    std::sort(unique_vertices.begin(), unique_vertices.end());
+    unique_vertices.erase(std::unique(unique_vertices.begin(), unique_vertices.end()), unique_vertices.end());
+    size_t vertex_count = unique_vertices.size();
+
+    std::vector<uint32_t> triangles(index_count);
+    for (size_t           i = 0; i < index_count; ++i)
+    {
+        triangles[i] = uint32_t(std::lower_bound(unique_vertices.begin(), unique_vertices.end(), indices[i]) -
+                                unique_vertices.begin());
+    }
+
+    std::vector<Vector3> positions(vertex_count);
+    for (size_t          v = 0; v < vertex_count; ++v)
+    {
+        positions[v] = mesh.m_positions[unique_vertices[v]].position;
+    }
+
+    // 锁定不能移动的顶点：
+    // 1. 位置相同但属性不同的接缝顶点，移动后会撕开UV/法线接缝
+    // 2. 开放边界上的顶点，移动后会和相邻submesh之间产生裂缝
+    std::vector<bool> locked(vertex_count, false);
+
+    std::vector<uint32_t> position_order(vertex_count);
+    std::iota(position_order.begin(), position_order.end(), 0);
+    std::sort(position_order.begin(), position_order.end(), [&positions](uint32_t a, uint32_t b)
+    {
+        const auto &pa = positions[a];
+        const auto &pb = positions[b];
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        return pa.z < pb.z;
+    });
+    for (size_t i = 1; i < vertex_count; ++i)
+    {
+        if (samePosition(positions[position_order[i - 1]], positions[position_order[i]]))
+        {
+            locked[position_order[i - 1]] = true;
+            locked[position_order[i]]     = true;
+        }
+    }
+
+    std::vector<uint64_t> directed_edges;
+    directed_edges.reserve(index_count);
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            uint64_t a = triangles[i + k];
+            uint64_t b = triangles[i + (k + 1) % 3];
+            directed_edges.push_back(a << 32 | b);
+        }
+    }
+    std::sort(directed_edges.begin(), directed_edges.end());
+    for (uint64_t edge: directed_edges)
+    {
+        uint64_t reverse_edge = (edge << 32) | (edge >> 32);
+        if (!std::binary_search(directed_edges.begin(), directed_edges.end(), reverse_edge))
+        {
+            locked[edge >> 32]        = true;
+            locked[edge & 0xFFFFFFFF] = true;
+        }
+    }
+
+    // 每个顶点累加相邻三角形所在平面的二次误差，按面积加权
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t          i = 0; i < index_count; i += 3)
+    {
+        const Vector3 &p0     = positions[triangles[i]];
+        const Vector3 &p1     = positions[triangles[i + 1]];
+        const Vector3 &p2     = positions[triangles[i + 2]];
+        Vector3       normal  = (p1 - p0).crossProduct(p2 - p0);
+        float         length  = normal.length();
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+        normal *= 1.0f / length;
+        double distance = -double(normal.dotProduct(p0));
+        for (int k = 0; k < 3; ++k)
+        {
+            quadrics[triangles[i + k]].AddPlane(normal.x, normal.y, normal.z, distance, length * 0.5);
+        }
+    }
+
+    double max_error_squared = double(target_error) * extent * double(target_error) * extent;
+    double result_error      = 0.0;
+
+    std::vector<uint32_t>     collapse_target(vertex_count);
+    std::vector<bool>         touched(vertex_count);
+    std::vector<uint32_t>     adjacency_offsets(vertex_count + 1);
+    std::vector<uint32_t>     adjacency;
+    std::vector<EdgeCollapse> collapses;
+
+    // 每一轮按代价从小到大坍缩互不相邻的边，再重建三角形列表
+    while (triangles.size() > target_index_count)
+    {
+        std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+        for (uint32_t vertex: triangles)
+        {
+            adjacency_offsets[vertex + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+        }
+        adjacency.resize(triangles.size());
+        std::vector<uint32_t> adjacency_fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (size_t           i = 0; i < triangles.size(); ++i)
+        {
+            adjacency[adjacency_fill[triangles[i]]++] = uint32_t(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t a = triangles[i + k];
+                uint32_t b = triangles[i + (k + 1) % 3];
+                if (!locked[a])
+                {
+                    Quadric quadric = quadrics[a];
+                    quadric += quadrics[b];
+                    collapses.push_back({a, b, quadric.Evaluate(positions[b]) / std::max(quadric.w, 1e-12)});
+                }
+                if (!locked[b])
+                {
+                    Quadric quadric = quadrics[b];
+                    quadric += quadrics[a];
+                    collapses.push_back({b, a, quadric.Evaluate(positions[a]) / std::max(quadric.w, 1e-12)});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse &lhs, const EdgeCollapse &rhs)
+        {
+            return lhs.cost < rhs.cost;
+        });
+
+        std::iota(collapse_target.begin(), collapse_target.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t triangles_to_remove = (triangles.size() - target_index_count) / 3;
+        size_t triangles_removed   = 0;
+        size_t collapse_count      = 0;
+        for (const auto &collapse: collapses)
+        {
+            if (collapse.cost > max_error_squared)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+
+            // 检查移动后相邻三角形是否翻面
+            bool   flipped      = false;
+            size_t removed_here = 0;
+            for (uint32_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; ++a)
+            {
+                const uint32_t *triangle = &triangles[size_t(adjacency[a]) * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    removed_here++;
+                    continue;
+                }
+
+                Vector3 p[3];
+                Vector3 q[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    p[k] = positions[triangle[k]];
+                    q[k] = triangle[k] == collapse.from ? positions[collapse.to] : p[k];
+                }
+                Vector3 normal_before = (p[1] - p[0]).crossProduct(p[2] - p[0]);
+                Vector3 normal_after  = (q[1] - q[0]).crossProduct(q[2] - q[0]);
+                // 法线偏转超过约75度也视为翻面，避免产生竖直的细长三角形
+                if (normal_before.dotProduct(normal_after) <= 0.25f * normal_before.length() * normal_after.length())
+                {
+                    flipped = true;
+                    break;
+                }
+            }
+            if (flipped)
+            {
+                continue;
+            }
+
+            collapse_target[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            result_error = std::max(result_error, collapse.cost);
+
+            // 本轮内不再移动相关顶点，保证翻面检查使用的位置有效
+            touched[collapse.from] = true;
+            touched[collapse.to]   = true;
+            for (uint32_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; ++a)
+            {
+                const uint32_t *triangle = &triangles[size_t(adjacency[a]) * 3];
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+            }
+
+            collapse_count++;
+            triangles_removed += removed_here;
+            if (triangles_removed >= triangles_to_remove)
+            {
+                break;
+            }
+        }
+
+        if (collapse_count == 0)
+        {
+            break;
+        }
+
+        // 已坍缩的顶点不会再出现在新的三角形列表中，一层映射即可
+        size_t write = 0;
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            uint32_t v0 = collapse_target[triangles[i]];
+            uint32_t v1 = collapse_target[triangles[i + 1]];
+            uint32_t v2 = collapse_target[triangles[i + 2]];
+            if (v0 == v1 || v1 == v2 || v0 == v2)
+            {
+                continue;
+            }
+            triangles[write++] = v0;
+            triangles[write++] = v1;
+            triangles[write++] = v2;
+        }
+        triangles.resize(write);
+    }
+
+    result.resize(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        result[i] = unique_vertices[triangles[i]];
+    }
+    return float(std::sqrt(result_error)) / extent;
+}
@@ -0,0 +1,169 @@
+//
+// Created by kyrosz7u on 2023/7/16.
+//
+
+#include "render/resource/render_meshlet.h"
+#include "core/logger/logger_macros.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace RenderSystem;
+using namespace Math;
+
+void MeshletBuilder::Build(RenderMesh &mesh,
+                           const std::vector<MeshIndexRange> &ranges,
+                           std::vector<MeshletRange> &meshlet_ranges)
+{
+    auto build_start = std::chrono::steady_clock::now();
+
+    mesh.m_meshlets.clear();
+    meshlet_ranges.assign(ranges.size(), MeshletRange{0, 0});
+
+    // 记录顶点最后被哪个meshlet引用，用于统计meshlet内的不重复顶点数
+    std::vector<uint32_t> vertex_owner(mesh.m_positions.size(), UINT32_MAX);
+
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        const auto &range      = ranges[i];
+        size_t     index_count = range.index_count - range.index_count % 3;
+        if (size_t(range.index_offset) + index_count > mesh.m_indices.size())
+        {
+            continue;
+        }
+
+        meshlet_ranges[i].meshlet_offset = static_cast<uint32_t>(mesh.m_meshlets.size());
+
+        uint32_t meshlet_begin  = range.index_offset;
+        uint32_t vertex_count   = 0;
+        uint32_t triangle_count = 0;
+        auto     meshlet_id     = static_cast<uint32_t>(mesh.m_meshlets.size());
+        for (size_t t = 0; t < index_count; t += 3)
+        {
+            const uint32_t *triangle = &mesh.m_indices[range.index_offset + t];
+
+            uint32_t new_vertices = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                new_vertices += vertex_owner[triangle[k]] != meshlet_id;
+            }
+            if (vertex_count + new_vertices > kMaxMeshletVertices || triangle_count + 1 > kMaxMeshletTriangles)
+            {
+                uint32_t meshlet_end = range.index_offset + uint32_t(t);
+                mesh.m_meshlets.push_back(computeBounds(mesh, meshlet_begin, meshlet_end - meshlet_begin));
+                meshlet_begin  = meshlet_end;
+                vertex_count   = 0;
+                triangle_count = 0;
+                meshlet_id++;
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                if (vertex_owner[triangle[k]] != meshlet_id)
+                {
+                    vertex_owner[triangle[k]] = meshlet_id;
+                    vertex_count++;
+                }
+            }
+            triangle_count++;
+        }
+        if (triangle_count > 0)
+        {
+            uint32_t meshlet_end = range.index_offset + uint32_t(index_count);
+            mesh.m_meshlets.push_back(computeBounds(mesh, meshlet_begin, meshlet_end - meshlet_begin));
+        }
+
+        meshlet_ranges[i].meshlet_count = static_cast<uint32_t>(mesh.m_meshlets.size()) -
+                                          meshlet_ranges[i].meshlet_offset;
+    }
+
+    size_t cone_count = std::count_if(mesh.m_meshlets.begin(), mesh.m_meshlets.end(), [](const RenderMeshlet &meshlet)
+    {
+        return meshlet.cone_cutoff < 1.0f;
+    });
+    auto   build_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - build_start);
+    LOG_INFO("meshlets built name:{}\tmeshlets:{}\twith cone:{}\ttime:{:.2f}ms",
+             mesh.m_name, mesh.m_meshlets.size(), cone_count, build_time.count())
+}
+
+RenderMeshlet MeshletBuilder::computeBounds(const RenderMesh &mesh, uint32_t index_offset, uint32_t index_count)
+{
+    RenderMeshlet meshlet{};
+    meshlet.index_offset = index_offset;
+    meshlet.index_count  = index_count;
+
+    const uint32_t *indices = &mesh.m_indices[index_offset];
+
+    // 包围球取AABB中心
+    Vector3 bounding_min = mesh.m_positions[indices[0]].position;
+    Vector3 bounding_max = bounding_min;
+    for (uint32_t i = 1; i < index_count; ++i)
+    {
+        bounding_min.makeFloor(mesh.m_positions[indices[i]].position);
+        bounding_max.makeCeil(mesh.m_positions[indices[i]].position);
+    }
+    Vector3 center = (bounding_min + bounding_max) * 0.5f;
+    float   radius = 0.0f;
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        radius = std::max(radius, (mesh.m_positions[indices[i]].position - center).length());
+    }
+
+    // 几何法线按顶点法线定向为朝外，与光栅化的背面剔除保持一致
+    std::vector<Vector3> triangle_normals;
+    triangle_normals.reserve(index_count / 3);
+    Vector3 cone_axis = Vector3::ZERO;
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        const Vector3 &p0     = mesh.m_positions[indices[i]].position;
+        const Vector3 &p1     = mesh.m_positions[indices[i + 1]].position;
+        const Vector3 &p2     = mesh.m_positions[indices[i + 2]].position;
+        Vector3       normal  = (p1 - p0).crossProduct(p2 - p0);
+        float         length  = normal.length();
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+        normal *= 1.0f / length;
+
+        Vector3 vertex_normal = mesh.m_normals[indices[i]].DecodeNormal() +
+                                mesh.m_normals[indices[i + 1]].DecodeNormal() +
+                                mesh.m_normals[indices[i + 2]].DecodeNormal();
+        if (normal.dotProduct(vertex_normal) < 0.0f)
+        {
+            normal = -normal;
+        }
+        triangle_normals.push_back(normal);
+        cone_axis += normal;
+    }
+
+    float cone_cutoff = 1.0f;
+    float axis_length = cone_axis.length();
+    if (!triangle_normals.empty() && axis_length > 0.0f)
+    {
+        cone_axis *= 1.0f / axis_length;
+        float min_dot = 1.0f;
+        for (const auto &normal: triangle_normals)
+        {
+            min_dot = std::min(min_dot, normal.dotProduct(cone_axis));
+        }
+        // 视线与轴的夹角小于90°减去锥半角时，所有三角形都背向相机
+        if (min_dot > kMinConeDot)
+        {
+            cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+        }
+    } else
+    {
+        cone_axis = Vector3::ZERO;
+    }
+
+    meshlet.center[0]    = center.x;
+    meshlet.center[1]    = center.y;
+    meshlet.center[2]    = center.z;
+    meshlet.radius       = radius;
+    meshlet.cone_axis[0] = cone_axis.x;
+    meshlet.cone_axis[1] = cone_axis.y;
+    meshlet.cone_axis[2] = cone_axis.z;
+    meshlet.cone_cutoff  = cone_cutoff;
+    return meshlet;
+}
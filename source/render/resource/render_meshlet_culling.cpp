@@ -0,0 +1,474 @@
+//
+// Created by kyrosz7u on 2023/7/16.
+//
+
+#include "render/resource/render_meshlet_culling.h"
+#include "core/graphic/vulkan/vulkan_utils.h"
+#include "core/logger/logger_macros.h"
+#include "meshlet_cull_comp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace RenderSystem;
+using namespace VulkanAPI;
+using namespace Math;
+
+namespace RenderSystem
+{
+    extern std::shared_ptr<VulkanContext> g_p_vulkan_context;
+}
+
+void MeshletCulling::Initialize()
+{
+    setupDescriptorSet();
+    setupPipeline();
+}
+
+void MeshletCulling::Destroy()
+{
+    if (m_pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkDeviceWaitIdle(g_p_vulkan_context->_device);
+    releaseBuffers();
+    // 释放的buffer和descriptor set进入了延迟销毁队列，销毁descriptor pool之前全部执行
+    g_p_vulkan_context->_deletion_queue.Flush();
+    vkDestroyPipeline(g_p_vulkan_context->_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(g_p_vulkan_context->_device, m_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(g_p_vulkan_context->_device, m_descriptor_set_layout, nullptr);
+    vkDestroyDescriptorPool(g_p_vulkan_context->_device, m_descriptor_pool, nullptr);
+
+    m_pipeline              = VK_NULL_HANDLE;
+    m_pipeline_layout       = VK_NULL_HANDLE;
+    m_descriptor_set_layout = VK_NULL_HANDLE;
+    m_descriptor_pool       = VK_NULL_HANDLE;
+    m_descriptor_set        = VK_NULL_HANDLE;
+    m_meshlet_count         = 0;
+}
+
+void MeshletCulling::UpdateMeshlets(std::vector<RenderSubmesh> &submeshes,
+                                    const std::vector<VulkanModelDefine> &models)
+{
+    // 只有以LOD0绘制的submesh参与meshlet剔除，meshlet的索引区间是基于LOD0生成的
+    uint32_t meshlet_count = 0;
+    for (auto &submesh: submeshes)
+    {
+        submesh.meshlet_draw_offset = kInvalidMeshletDrawOffset;
+        if (submesh.meshlet_count > 0 && submesh.index_offset == submesh.lods[0].index_offset)
+        {
+            meshlet_count += submesh.meshlet_count;
+        }
+    }
+
+    m_meshlet_count = 0;
+    if (m_pipeline == VK_NULL_HANDLE || meshlet_count == 0)
+    {
+        return;
+    }
+    reserveBuffers(meshlet_count, static_cast<uint32_t>(models.size()));
+
+    // 只写当前帧槽位的region，beginFrame已经等到该槽位上一次提交完成，其余region可能仍在被GPU读取
+    m_frame_region = g_p_vulkan_context->m_current_frame_index;
+    auto *meshlet_data = reinterpret_cast<MeshletCullData *>(static_cast<uint8_t *>(m_mapped_meshlets) +
+                                                             m_meshlet_region_size * m_frame_region);
+    for (auto &submesh: submeshes)
+    {
+        if (submesh.meshlet_count == 0 || submesh.index_offset != submesh.lods[0].index_offset)
+        {
+            continue;
+        }
+        auto parent_mesh = submesh.parent_mesh.lock();
+        if (parent_mesh == nullptr)
+        {
+            continue;
+        }
+
+        submesh.meshlet_draw_offset = m_meshlet_count;
+        for (uint32_t i = 0; i < submesh.meshlet_count; ++i)
+        {
+            const auto      &meshlet = parent_mesh->m_meshlets[submesh.meshlet_offset + i];
+            MeshletCullData &data    = meshlet_data[m_meshlet_count++];
+            memcpy(data.bounding_sphere, meshlet.center, sizeof(meshlet.center));
+            data.bounding_sphere[3] = meshlet.radius;
+            memcpy(data.cone, meshlet.cone_axis, sizeof(meshlet.cone_axis));
+            data.cone[3]       = meshlet.cone_cutoff;
+            data.model_index   = parent_mesh->m_index_in_model_buffer;
+            data.index_count   = meshlet.index_count;
+            data.first_index   = meshlet.index_offset;
+            data.vertex_offset = static_cast<int32_t>(submesh.vertex_offset);
+        }
+    }
+
+    auto *model_data = reinterpret_cast<Matrix4x4 *>(static_cast<uint8_t *>(m_mapped_models) +
+                                                     m_model_region_size * m_frame_region);
+    for (size_t i = 0; i < models.size(); ++i)
+    {
+        model_data[i] = models[i].model;
+    }
+}
+
+void MeshletCulling::UpdateCamera(const Matrix4x4 &proj_view, const Vector3 &camera_pos)
+{
+    // 从proj_view的行提取视锥平面，深度范围为[0,1]
+    const float planes[6][4] = {
+            {proj_view[3][0] + proj_view[0][0], proj_view[3][1] + proj_view[0][1], proj_view[3][2] + proj_view[0][2], proj_view[3][3] + proj_view[0][3]},
+            {proj_view[3][0] - proj_view[0][0], proj_view[3][1] - proj_view[0][1], proj_view[3][2] - proj_view[0][2], proj_view[3][3] - proj_view[0][3]},
+            {proj_view[3][0] + proj_view[1][0], proj_view[3][1] + proj_view[1][1], proj_view[3][2] + proj_view[1][2], proj_view[3][3] + proj_view[1][3]},
+            {proj_view[3][0] - proj_view[1][0], proj_view[3][1] - proj_view[1][1], proj_view[3][2] - proj_view[1][2], proj_view[3][3] - proj_view[1][3]},
+            {proj_view[2][0], proj_view[2][1], proj_view[2][2], proj_view[2][3]},
+            {proj_view[3][0] - proj_view[2][0], proj_view[3][1] - proj_view[2][1], proj_view[3][2] - proj_view[2][2], proj_view[3][3] - proj_view[2][3]}
+    };
+
+    for (int i = 0; i < 6; ++i)
+    {
+        float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int k = 0; k < 4; ++k)
+        {
+            m_push_constants.frustum_planes[i][k] = planes[i][k] * scale;
+        }
+    }
+    m_push_constants.camera_pos[0] = camera_pos.x;
+    m_push_constants.camera_pos[1] = camera_pos.y;
+    m_push_constants.camera_pos[2] = camera_pos.z;
+}
+
+void MeshletCulling::Dispatch(VkCommandBuffer command_buffer, uint32_t dispatch_queue_family)
+{
+    const uint32_t graphics_queue_family = g_p_vulkan_context->_queue_indices.graphicsFamily.value();
+    m_dispatch_queue_family = dispatch_queue_family == graphics_queue_family ? VK_QUEUE_FAMILY_IGNORED
+                                                                             : dispatch_queue_family;
+    if (m_meshlet_count == 0)
+    {
+        m_dispatch_queue_family = VK_QUEUE_FAMILY_IGNORED;
+        return;
+    }
+
+    VkDebugUtilsLabelEXT label_info = {
+            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, "Meshlet Culling", {1.0f, 1.0f, 1.0f, 1.0f}};
+    g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(command_buffer, &label_info);
+
+    // 上一帧的间接绘制读取完成后才能覆盖命令；在独立的计算队列上由提交时等待图形队列的timeline保证
+    if (m_dispatch_queue_family == VK_QUEUE_FAMILY_IGNORED)
+    {
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 0, nullptr);
+    }
+
+    m_push_constants.meshlet_count = m_meshlet_count;
+    uint32_t dynamic_offsets[] = {uint32_t(m_meshlet_region_size * m_frame_region),
+                                  uint32_t(m_model_region_size * m_frame_region)};
+    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_COMPUTE,
+                                                 m_pipeline_layout,
+                                                 0, 1, &m_descriptor_set,
+                                                 2, dynamic_offsets);
+    vkCmdPushConstants(command_buffer,
+                       m_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(CullPushConstants),
+                       &m_push_constants);
+    vkCmdDispatch(command_buffer, (m_meshlet_count + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+    // 间接绘制命令每帧全部重写，图形队列用完后不需要把所有权还给计算队列
+    bool transfer_ownership = m_dispatch_queue_family != VK_QUEUE_FAMILY_IGNORED;
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask       = transfer_ownership ? 0 : VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.srcQueueFamilyIndex = transfer_ownership ? m_dispatch_queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = transfer_ownership ? graphics_queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = m_draw_command_buffer;
+    barrier.offset              = 0;
+    barrier.size                = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         transfer_ownership ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(command_buffer);
+}
+
+void MeshletCulling::AcquireOwnership(VkCommandBuffer command_buffer) const
+{
+    if (m_dispatch_queue_family == VK_QUEUE_FAMILY_IGNORED)
+    {
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask       = 0;
+    barrier.dstAccessMask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.srcQueueFamilyIndex = m_dispatch_queue_family;
+    barrier.dstQueueFamilyIndex = g_p_vulkan_context->_queue_indices.graphicsFamily.value();
+    barrier.buffer              = m_draw_command_buffer;
+    barrier.offset              = 0;
+    barrier.size                = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void MeshletCulling::DrawSubmesh(VkCommandBuffer command_buffer, const RenderSubmesh &submesh) const
+{
+    if (submesh.meshlet_draw_offset == kInvalidMeshletDrawOffset || submesh.meshlet_draw_offset >= m_meshlet_count)
+    {
+        g_p_vulkan_context->_vkCmdDrawIndexed(command_buffer,
+                                              submesh.index_count,
+                                              1,
+                                              submesh.index_offset,
+                                              submesh.vertex_offset,
+                                              0);
+        return;
+    }
+
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize   offset = VkDeviceSize(submesh.meshlet_draw_offset) * stride;
+    if (g_p_vulkan_context->_enabled_device_features.multiDrawIndirect)
+    {
+        uint32_t max_draw_count = std::max(1u, g_p_vulkan_context->_physical_device_properties.limits.maxDrawIndirectCount);
+        for (uint32_t drawn = 0; drawn < submesh.meshlet_count;)
+        {
+            uint32_t draw_count = std::min(max_draw_count, submesh.meshlet_count - drawn);
+            g_p_vulkan_context->_vkCmdDrawIndexedIndirect(command_buffer,
+                                                          m_draw_command_buffer,
+                                                          offset + VkDeviceSize(drawn) * stride,
+                                                          draw_count,
+                                                          stride);
+            drawn += draw_count;
+        }
+    } else
+    {
+        for (uint32_t i = 0; i < submesh.meshlet_count; ++i)
+        {
+            g_p_vulkan_context->_vkCmdDrawIndexedIndirect(command_buffer,
+                                                          m_draw_command_buffer,
+                                                          offset + VkDeviceSize(i) * stride,
+                                                          1,
+                                                          stride);
+        }
+    }
+}
+
+VkDescriptorType MeshletCulling::descriptorType(uint32_t binding)
+{
+    return binding < 2 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+
+void MeshletCulling::setupDescriptorSet()
+{
+    VkDescriptorPoolSize pool_sizes[2] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 * kMaxDescriptorSetCount},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1 * kMaxDescriptorSetCount}
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info{};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    descriptor_pool_create_info.poolSizeCount = 2;
+    descriptor_pool_create_info.pPoolSizes    = pool_sizes;
+    descriptor_pool_create_info.maxSets       = kMaxDescriptorSetCount;
+
+    VK_CHECK_RESULT(vkCreateDescriptorPool(g_p_vulkan_context->_device,
+                                           &descriptor_pool_create_info,
+                                           nullptr,
+                                           &m_descriptor_pool))
+
+    VkDescriptorSetLayoutBinding layout_bindings[3]{};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        layout_bindings[i].binding         = i;
+        layout_bindings[i].descriptorType  = descriptorType(i);
+        layout_bindings[i].descriptorCount = 1;
+        layout_bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info{};
+    layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 3;
+    layout_create_info.pBindings    = layout_bindings;
+
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(g_p_vulkan_context->_device,
+                                                &layout_create_info,
+                                                nullptr,
+                                                &m_descriptor_set_layout))
+}
+
+void MeshletCulling::allocateDescriptorSet()
+{
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool     = m_descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts        = &m_descriptor_set_layout;
+
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(g_p_vulkan_context->_device, &allocate_info, &m_descriptor_set))
+}
+
+void MeshletCulling::setupPipeline()
+{
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset     = 0;
+    push_constant_range.size       = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+    pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount         = 1;
+    pipeline_layout_create_info.pSetLayouts            = &m_descriptor_set_layout;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges    = &push_constant_range;
+
+    if (vkCreatePipelineLayout(g_p_vulkan_context->_device,
+                               &pipeline_layout_create_info,
+                               nullptr,
+                               &m_pipeline_layout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("create meshlet culling pipeline layout");
+    }
+
+    VkShaderModule shader_module = VulkanUtil::createShaderModule(g_p_vulkan_context->_device, MESHLET_CULL_COMP);
+
+    VkComputePipelineCreateInfo pipeline_create_info{};
+    pipeline_create_info.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = shader_module;
+    pipeline_create_info.stage.pName  = "main";
+    pipeline_create_info.layout       = m_pipeline_layout;
+
+    if (vkCreateComputePipelines(g_p_vulkan_context->_device,
+                                 VK_NULL_HANDLE,
+                                 1,
+                                 &pipeline_create_info,
+                                 nullptr,
+                                 &m_pipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("create meshlet culling pipeline");
+    }
+
+    vkDestroyShaderModule(g_p_vulkan_context->_device, shader_module, nullptr);
+}
+
+void MeshletCulling::reserveBuffers(uint32_t meshlet_count, uint32_t model_count)
+{
+    if (meshlet_count <= m_meshlet_capacity && model_count <= m_model_capacity)
+    {
+        return;
+    }
+
+    // 容量不足时重建，旧的buffer和descriptor set可能还在被之前的帧使用，交给延迟销毁队列
+    releaseBuffers();
+
+    m_meshlet_capacity = std::max({meshlet_count, m_meshlet_capacity * 2, 1024u});
+    m_model_capacity   = std::max({model_count, m_model_capacity * 2, 64u});
+    ++m_buffer_generation;
+
+    // region起点是dynamic offset，需要按minStorageBufferOffsetAlignment对齐
+    VkDeviceSize offset_alignment = std::max<VkDeviceSize>(
+            g_p_vulkan_context->_physical_device_properties.limits.minStorageBufferOffsetAlignment, 1);
+    m_meshlet_region_size = VkDeviceSize(m_meshlet_capacity) * sizeof(MeshletCullData);
+    m_meshlet_region_size = (m_meshlet_region_size + offset_alignment - 1) & ~(offset_alignment - 1);
+    m_model_region_size   = VkDeviceSize(m_model_capacity) * sizeof(Matrix4x4);
+    m_model_region_size   = (m_model_region_size + offset_alignment - 1) & ~(offset_alignment - 1);
+
+    VulkanUtil::createBuffer(g_p_vulkan_context,
+                             m_meshlet_region_size * VulkanContext::kMaxFramesInFlight,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             m_meshlet_buffer, m_meshlet_buffer_memory,
+                             g_p_vulkan_context->getGraphicsComputeQueueFamilies());
+    vkMapMemory(g_p_vulkan_context->_device, m_meshlet_buffer_memory, 0, VK_WHOLE_SIZE, 0, &m_mapped_meshlets);
+
+    VulkanUtil::createBuffer(g_p_vulkan_context,
+                             m_model_region_size * VulkanContext::kMaxFramesInFlight,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             m_model_buffer, m_model_buffer_memory,
+                             g_p_vulkan_context->getGraphicsComputeQueueFamilies());
+    vkMapMemory(g_p_vulkan_context->_device, m_model_buffer_memory, 0, VK_WHOLE_SIZE, 0, &m_mapped_models);
+
+    VulkanUtil::createBuffer(g_p_vulkan_context,
+                             VkDeviceSize(m_meshlet_capacity) * sizeof(VkDrawIndexedIndirectCommand),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             m_draw_command_buffer, m_draw_command_buffer_memory);
+
+    allocateDescriptorSet();
+    updateDescriptorSet();
+
+    LOG_INFO("meshlet culling buffers resized meshlets:{}\tmodels:{}", m_meshlet_capacity, m_model_capacity)
+}
+
+void MeshletCulling::releaseBuffers()
+{
+    if (m_meshlet_buffer == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    // 映射可以立即解除，GPU访问不依赖host映射
+    vkUnmapMemory(g_p_vulkan_context->_device, m_meshlet_buffer_memory);
+    vkUnmapMemory(g_p_vulkan_context->_device, m_model_buffer_memory);
+
+    auto &deletion_queue = g_p_vulkan_context->_deletion_queue;
+    deletion_queue.DestroyBuffer(m_meshlet_buffer, m_meshlet_buffer_memory);
+    deletion_queue.DestroyBuffer(m_model_buffer, m_model_buffer_memory);
+    deletion_queue.DestroyBuffer(m_draw_command_buffer, m_draw_command_buffer_memory);
+
+    VkDevice         device          = g_p_vulkan_context->_device;
+    VkDescriptorPool descriptor_pool = m_descriptor_pool;
+    VkDescriptorSet  descriptor_set  = m_descriptor_set;
+    deletion_queue.Push([device, descriptor_pool, descriptor_set]()
+                        {
+                            vkFreeDescriptorSets(device, descriptor_pool, 1, &descriptor_set);
+                        });
+    m_descriptor_set = VK_NULL_HANDLE;
+
+    m_meshlet_buffer             = VK_NULL_HANDLE;
+    m_meshlet_buffer_memory      = VK_NULL_HANDLE;
+    m_mapped_meshlets            = nullptr;
+    m_model_buffer               = VK_NULL_HANDLE;
+    m_model_buffer_memory        = VK_NULL_HANDLE;
+    m_mapped_models              = nullptr;
+    m_draw_command_buffer        = VK_NULL_HANDLE;
+    m_draw_command_buffer_memory = VK_NULL_HANDLE;
+    m_meshlet_capacity           = 0;
+    m_model_capacity             = 0;
+}
+
+void MeshletCulling::updateDescriptorSet()
+{
+    VkDescriptorBufferInfo buffer_infos[3] = {
+            {m_meshlet_buffer,      0, m_meshlet_region_size},
+            {m_model_buffer,        0, m_model_region_size},
+            {m_draw_command_buffer, 0, VK_WHOLE_SIZE}
+    };
+
+    VkWriteDescriptorSet descriptor_writes[3]{};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        descriptor_writes[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[i].pNext           = nullptr;
+        descriptor_writes[i].dstSet          = m_descriptor_set;
+        descriptor_writes[i].dstBinding      = i;
+        descriptor_writes[i].dstArrayElement = 0;
+        descriptor_writes[i].descriptorType  = descriptorType(i);
+        descriptor_writes[i].descriptorCount = 1;
+        descriptor_writes[i].pBufferInfo     = &buffer_infos[i];
+    }
+
+    vkUpdateDescriptorSets(g_p_vulkan_context->_device, 3, descriptor_writes, 0, nullptr);
+}
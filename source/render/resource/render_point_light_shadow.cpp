@@ -0,0 +1,68 @@
+//
+// Created by kyrosz7u on 2023/7/20.
+//
+
+#include "render/resource/render_point_light_shadow.h"
+
+using namespace RenderSystem;
+using namespace Math;
+
+Matrix4x4 PointLightShadow::GetFaceView(uint32_t face, const Vector3 &position)
+{
+    // cube map第face个面的朝向，纹理坐标s沿right增大，t沿-up增大
+    static const Vector3 kFaceForward[kFaceCount] = {Vector3(1, 0, 0), Vector3(-1, 0, 0),
+                                                     Vector3(0, 1, 0), Vector3(0, -1, 0),
+                                                     Vector3(0, 0, 1), Vector3(0, 0, -1)};
+    static const Vector3 kFaceRight[kFaceCount]   = {Vector3(0, 0, -1), Vector3(0, 0, 1),
+                                                     Vector3(1, 0, 0), Vector3(1, 0, 0),
+                                                     Vector3(1, 0, 0), Vector3(-1, 0, 0)};
+    static const Vector3 kFaceUp[kFaceCount]      = {Vector3(0, 1, 0), Vector3(0, 1, 0),
+                                                     Vector3(0, 0, -1), Vector3(0, 0, 1),
+                                                     Vector3(0, 1, 0), Vector3(0, 1, 0)};
+
+    const Vector3 &right   = kFaceRight[face];
+    const Vector3 &up      = kFaceUp[face];
+    const Vector3 &forward = kFaceForward[face];
+    return Matrix4x4(Vector4(right, -right.dotProduct(position)),
+                     Vector4(up, -up.dotProduct(position)),
+                     Vector4(forward, -forward.dotProduct(position)),
+                     Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+void PointLightShadow::UpdateShadowProjections(const std::vector<Scene::PointLight> &point_lights,
+                                               const std::vector<Scene::SpotLight> &spot_lights,
+                                               const PointLightShadowInfo &shadow_info,
+                                               std::vector<VulkanPointLightShadowDefine> &shadow_projections)
+{
+    shadow_projections.clear();
+
+    uint32_t light_count  = 0;
+    uint32_t shadow_count = 0;
+    auto     add_light    = [&](bool cast_shadow, const Vector3 &position, float radius)
+    {
+        // 超出MAX_LOCAL_LIGHT_COUNT的光源不参与着色
+        if (light_count++ >= MAX_LOCAL_LIGHT_COUNT || AssignShadowIndex(cast_shadow, shadow_count) < 0)
+        {
+            return;
+        }
+
+        VulkanPointLightShadowDefine shadow{};
+        Matrix4x4 light_project = Matrix4x4::makePerspectiveMatrix(90.0f, 1.0f, shadow_info.znear, radius);
+        for (uint32_t face = 0; face < kFaceCount; ++face)
+        {
+            shadow.face_proj_view[face] = light_project * GetFaceView(face, position);
+        }
+        shadow.position = position;
+        shadow.radius   = radius;
+        shadow_projections.push_back(shadow);
+    };
+
+    for (const auto &point_light: point_lights)
+    {
+        add_light(point_light.cast_shadow, point_light.transform.position, point_light.radius);
+    }
+    for (const auto &spot_light: spot_lights)
+    {
+        add_light(spot_light.cast_shadow, spot_light.transform.position, spot_light.radius);
+    }
+}
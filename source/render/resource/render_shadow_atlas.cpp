@@ -0,0 +1,121 @@
+//
+// Created by kyrosz7u on 2023/7/18.
+//
+
+#include "render/resource/render_shadow_atlas.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+using namespace RenderSystem;
+
+static uint32_t roundToPowerOfTwo(float size)
+{
+    return 1u << static_cast<uint32_t>(std::max(0.0f, std::round(std::log2(std::max(size, 1.0f)))));
+}
+
+void ShadowAtlas::Initialize(uint32_t atlas_size, uint32_t max_tile_size)
+{
+    m_atlas_size    = atlas_size;
+    m_max_tile_size = std::min(roundToPowerOfTwo(float(max_tile_size)), atlas_size);
+    m_tile_sizes.clear();
+    m_tiles.clear();
+}
+
+bool ShadowAtlas::Update(const std::vector<Scene::DirectionLight> &directional_light_list, uint32_t cascade_count)
+{
+    // 光源重要性：亮度 * 强度，最亮的光源使用最大tile
+    std::vector<float> importance(directional_light_list.size());
+    float              max_importance = 0.0f;
+    for (size_t i = 0; i < directional_light_list.size(); ++i)
+    {
+        const auto &light = directional_light_list[i];
+        float      luminance = 0.2126f * light.color.x + 0.7152f * light.color.y + 0.0722f * light.color.z;
+        importance[i]  = std::max(luminance * light.intensity, 0.0f);
+        max_importance = std::max(max_importance, importance[i]);
+    }
+
+    std::vector<uint32_t> tile_sizes(directional_light_list.size() * cascade_count);
+    for (size_t i = 0; i < directional_light_list.size(); ++i)
+    {
+        float    ratio = max_importance > 0.0f ? importance[i] / max_importance : 1.0f;
+        uint32_t size  = std::clamp(roundToPowerOfTwo(ratio * float(m_max_tile_size)),
+                                    std::min(kMinTileSize, m_max_tile_size),
+                                    m_max_tile_size);
+        std::fill_n(tile_sizes.begin() + i * cascade_count, cascade_count, size);
+    }
+
+    if (tile_sizes == m_tile_sizes)
+    {
+        return false;
+    }
+    m_tile_sizes = tile_sizes;
+
+    // 放不下时所有tile同时减半，保持光源之间的分辨率比例
+    while (!Pack(tile_sizes, m_atlas_size, m_tiles))
+    {
+        for (auto &size: tile_sizes)
+        {
+            size = std::max(size / 2, 1u);
+        }
+    }
+    return true;
+}
+
+Math::Vector4 ShadowAtlas::GetUVRect(uint32_t tile_index) const
+{
+    const auto &tile          = m_tiles[tile_index];
+    float      inv_atlas_size = 1.0f / float(m_atlas_size);
+    return {float(tile.x) * inv_atlas_size,
+            float(tile.y) * inv_atlas_size,
+            float(tile.size) * inv_atlas_size,
+            float(tile.size) * inv_atlas_size};
+}
+
+bool ShadowAtlas::Pack(const std::vector<uint32_t> &tile_sizes, uint32_t atlas_size,
+                       std::vector<ShadowAtlasTile> &tiles)
+{
+    tiles.assign(tile_sizes.size(), {});
+
+    std::vector<uint32_t> order(tile_sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&tile_sizes](uint32_t a, uint32_t b)
+    {
+        return tile_sizes[a] > tile_sizes[b];
+    });
+
+    std::vector<ShadowAtlasTile> free_nodes = {{0, 0, atlas_size}};
+    for (uint32_t index: order)
+    {
+        uint32_t size = tile_sizes[index];
+
+        // 取能容纳该tile的最小空闲节点
+        auto node_it = free_nodes.end();
+        for (auto it = free_nodes.begin(); it != free_nodes.end(); ++it)
+        {
+            if (it->size >= size && (node_it == free_nodes.end() || it->size < node_it->size))
+            {
+                node_it = it;
+            }
+        }
+        if (node_it == free_nodes.end())
+        {
+            return false;
+        }
+
+        ShadowAtlasTile node = *node_it;
+        free_nodes.erase(node_it);
+
+        // 四分节点直到与tile等大，其余三块放回空闲列表
+        while (node.size > size)
+        {
+            uint32_t half = node.size / 2;
+            free_nodes.push_back({node.x + half, node.y, half});
+            free_nodes.push_back({node.x, node.y + half, half});
+            free_nodes.push_back({node.x + half, node.y + half, half});
+            node.size = half;
+        }
+        tiles[index] = node;
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+//
+// Created by kyrosz7u on 2023/7/17.
+//
+
+#include "render/resource/render_shadow_cascade.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace RenderSystem;
+using namespace Math;
+
+void ShadowCascade::ComputeSplits(float znear, float zfar, uint32_t cascade_count, float split_lambda,
+                                  float *splits)
+{
+    for (uint32_t i = 1; i <= cascade_count; ++i)
+    {
+        float ratio         = float(i) / float(cascade_count);
+        float log_split     = znear * std::pow(zfar / znear, ratio);
+        float uniform_split = znear + (zfar - znear) * ratio;
+        splits[i - 1] = split_lambda * log_split + (1.0f - split_lambda) * uniform_split;
+    }
+}
+
+Matrix4x4 ShadowCascade::FitCascade(const RenderCameraInfo &camera_info,
+                                    float split_near,
+                                    float split_far,
+                                    const Matrix4x4 &light_rotation,
+                                    uint32_t shadowmap_size,
+                                    float caster_distance)
+{
+    // 相机空间下视锥分段的8个顶点，相机朝向+z
+    float     tan_half_fovy = tanf(camera_info.fov / 360.0f * Math_PI);
+    Matrix4x4 inverse_view  = camera_info.view.inverse();
+    Vector3   corners[8];
+    Vector3   center        = Vector3::ZERO;
+    for (int i = 0; i < 8; ++i)
+    {
+        float depth    = (i & 4) ? split_far : split_near;
+        float extent_y = depth * tan_half_fovy;
+        float extent_x = extent_y * camera_info.aspect;
+        corners[i] = inverse_view * Vector3((i & 1) ? extent_x : -extent_x,
+                                            (i & 2) ? extent_y : -extent_y,
+                                            depth);
+        center += corners[i];
+    }
+    center *= 1.0f / 8.0f;
+
+    float radius = 0.0f;
+    for (const auto &corner: corners)
+    {
+        radius = std::max(radius, (corner - center).length());
+    }
+    radius = std::ceil(radius * kRadiusQuantization) / kRadiusQuantization;
+
+    // 包围球中心在光源空间按grid_step对齐（含深度方向），中心最多偏移半个格子，
+    // 投影半宽取half_extent >= radius + grid_step / 2才能完整包含包围球；
+    // grid_step = 2 * half_extent / kCenterSnapDivisions，解得下面的half_extent
+    float half_extent = radius * float(kCenterSnapDivisions) / float(kCenterSnapDivisions - 1);
+    float grid_step   = 2.0f * half_extent / float(kCenterSnapDivisions);
+
+    Matrix4x4 light_rotation_inverse = light_rotation.transpose();
+    Vector3   light_space_center     = light_rotation_inverse * center;
+    light_space_center.x = std::round(light_space_center.x / grid_step) * grid_step;
+    light_space_center.y = std::round(light_space_center.y / grid_step) * grid_step;
+    light_space_center.z = std::round(light_space_center.z / grid_step) * grid_step;
+
+    // 光源放在包围球之外，沿光源方向额外包含caster_distance内的投射体，深度范围为中心的偏移预留一个格子
+    Vector3   light_position = light_rotation * (light_space_center -
+                                                 Vector3(0.0f, 0.0f, half_extent + caster_distance + 0.5f * grid_step));
+    Matrix4x4 light_view     = light_rotation_inverse * Matrix4x4::getTrans(-light_position);
+    Matrix4x4 light_project  = Matrix4x4::makeOrthogonalMatrix(2.0f * half_extent, 2.0f * half_extent,
+                                                               0.0f,
+                                                               2.0f * half_extent + caster_distance + grid_step);
+
+    // 世界原点投影后对齐到texel，整个投影只按整数texel平移
+    Vector4 origin      = (light_project * light_view) * Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+    float   texel_scale = float(shadowmap_size) * 0.5f;
+    float   texel_x     = origin.x * texel_scale;
+    float   texel_y     = origin.y * texel_scale;
+    light_project[0][3] += (std::round(texel_x) - texel_x) / texel_scale;
+    light_project[1][3] += (std::round(texel_y) - texel_y) / texel_scale;
+
+    return light_project * light_view;
+}
+
+void ShadowCascade::UpdateLightProjections(const RenderCameraInfo &camera_info,
+                                           const std::vector<Scene::DirectionLight> &directional_light_list,
+                                           const DirectionLightInfo &light_info,
+                                           const ShadowAtlas &shadow_atlas,
+                                           std::vector<VulkanLightProjectDefine> &light_projections)
+{
+    uint32_t cascade_count = GetCascadeCount(light_info);
+    float    shadow_far    = std::min(light_info.shadow_distance, camera_info.zfar);
+
+    float splits[MAX_SHADOW_CASCADE_COUNT];
+    ComputeSplits(camera_info.znear, shadow_far, cascade_count, light_info.cascade_split_lambda, splits);
+
+    const auto &tiles = shadow_atlas.GetTiles();
+    assert(tiles.size() == directional_light_list.size() * cascade_count);
+
+    light_projections.resize(directional_light_list.size() * cascade_count);
+    for (size_t i = 0; i < directional_light_list.size(); ++i)
+    {
+        Matrix4x4 light_rotation = getRotationMatrix(directional_light_list[i].transform.rotation);
+        float     split_near     = camera_info.znear;
+        for (uint32_t cascade = 0; cascade < cascade_count; ++cascade)
+        {
+            // 按tile的实际分辨率做texel对齐
+            uint32_t layer = i * cascade_count + cascade;
+            light_projections[layer].light_proj =
+                    FitCascade(camera_info, split_near, splits[cascade], light_rotation,
+                               tiles[layer].size, light_info.caster_distance);
+            light_projections[layer].atlas_rect = shadow_atlas.GetUVRect(layer);
+            split_near = splits[cascade];
+        }
+    }
+}
@@ -3,6 +3,7 @@
 //
 
 #include "render/resource/render_texture.h"
+#include "render/resource/render_texture_file.h"
 #include "core/graphic/vulkan/vulkan_utils.h"
 #include "core/logger/logger_macros.h"
 
@@ -11,22 +12,236 @@
 #include <stb_image.h>
 #include <cmath>
 #include <stdexcept>
+#include <filesystem>
+#include <cstring>
 
 using namespace RenderSystem;
 using namespace VulkanAPI;
 
+TextureImage::TextureImage(const std::string &image_path, bool prefer_cooked)
+{
+    path = image_path;
+
+    // 优先使用离线烘焙的KTX2，源图比烘焙结果新或设备不支持其格式时回退到stb解码
+    if (prefer_cooked)
+    {
+        auto            ktx2_path = std::filesystem::path(image_path).replace_extension(".ktx2");
+        std::error_code error_code;
+        if (std::filesystem::exists(ktx2_path, error_code) &&
+            (!std::filesystem::exists(image_path, error_code) ||
+             std::filesystem::last_write_time(ktx2_path, error_code) >=
+             std::filesystem::last_write_time(image_path, error_code)))
+        {
+            if (loadKtx2(ktx2_path.string()))
+            {
+                return;
+            }
+            LOG_WARN("fallback to source image:{}", image_path)
+        }
+    }
+
+    int image_width, image_height, texChannels;
+    pixels = stbi_load(path.c_str(),
+                       &image_width,
+                       &image_height,
+                       &texChannels,
+                       STBI_rgb_alpha);
+    if (!pixels)
+    {
+        throw std::runtime_error("failed to load texture image!");
+    }
+    width  = image_width;
+    height = image_height;
+    format = VK_FORMAT_R8G8B8A8_UNORM;
+    levels = {{0, VkDeviceSize(width) * height * 4, width, height}};
+}
+
+bool TextureImage::loadKtx2(const std::string &ktx2_path)
+{
+    if (!m_cooked_file.open(ktx2_path) || m_cooked_file.size() < sizeof(Ktx2Header))
+    {
+        m_cooked_file.close();
+        return false;
+    }
+
+    const auto *header = reinterpret_cast<const Ktx2Header *>(m_cooked_file.data());
+    if (memcmp(header->identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0 ||
+        header->supercompression_scheme != 0 ||
+        header->pixel_depth > 1 || header->layer_count > 1 || header->face_count != 1 ||
+        header->pixel_width == 0 || header->pixel_height == 0 || header->level_count == 0)
+    {
+        LOG_ERROR("unsupported ktx2 file:{}", ktx2_path)
+        m_cooked_file.close();
+        return false;
+    }
+
+    TextureFormatInfo format_info{};
+    auto              image_format = static_cast<VkFormat>(header->vk_format);
+    if (!GetTextureFormatInfo(image_format, format_info) ||
+        (g_p_vulkan_context != nullptr && !g_p_vulkan_context->isSampledImageFormatSupported(image_format)))
+    {
+        LOG_WARN("ktx2 format {} not supported by device:{}", header->vk_format, ktx2_path)
+        m_cooked_file.close();
+        return false;
+    }
+
+    // mip链最长到1x1，超过时按层级右移宽高没有意义
+    uint32_t max_level_count = 1;
+    while ((std::max(header->pixel_width, header->pixel_height) >> max_level_count) > 0)
+    {
+        ++max_level_count;
+    }
+    if (header->level_count > max_level_count)
+    {
+        LOG_ERROR("ktx2 level count {} exceeds full mip chain {}:{}", header->level_count, max_level_count, ktx2_path)
+        m_cooked_file.close();
+        return false;
+    }
+
+    if (sizeof(Ktx2Header) + header->level_count * sizeof(Ktx2LevelIndex) > m_cooked_file.size())
+    {
+        LOG_ERROR("ktx2 file truncated:{}", ktx2_path)
+        m_cooked_file.close();
+        return false;
+    }
+
+    const auto *level_indices = reinterpret_cast<const Ktx2LevelIndex *>(m_cooked_file.data() + sizeof(Ktx2Header));
+    levels.clear();
+    for (uint32_t level = 0; level < header->level_count; ++level)
+    {
+        const auto &level_index  = level_indices[level];
+        uint32_t   level_width  = std::max(header->pixel_width >> level, 1u);
+        uint32_t   level_height = std::max(header->pixel_height >> level, 1u);
+        if (level_index.byte_offset > m_cooked_file.size() ||
+            level_index.byte_length > m_cooked_file.size() - level_index.byte_offset)
+        {
+            LOG_ERROR("ktx2 file truncated:{}", ktx2_path)
+            m_cooked_file.close();
+            levels.clear();
+            return false;
+        }
+        // 上传时按层级尺寸拷贝整块数据，byte_length不足会读到别的层级或文件之外
+        VkDeviceSize expected_size = VkDeviceSize((level_width + format_info.block_width - 1) / format_info.block_width) *
+                                     ((level_height + format_info.block_height - 1) / format_info.block_height) *
+                                     format_info.block_byte_size;
+        if (level_index.byte_length < expected_size)
+        {
+            LOG_ERROR("ktx2 level {} has {} bytes, expected {}:{}", level, level_index.byte_length, expected_size, ktx2_path)
+            m_cooked_file.close();
+            levels.clear();
+            return false;
+        }
+        levels.push_back({level_index.byte_offset, level_index.byte_length, level_width, level_height});
+    }
+
+    width  = header->pixel_width;
+    height = header->pixel_height;
+    format = image_format;
+    return true;
+}
+
+TextureImage::~TextureImage()
+{
+    if (pixels != nullptr)
+    {
+        stbi_image_free(pixels);
+        pixels = nullptr;
+    }
+}
+
 Texture2D::Texture2D(const std::string &texture_path, const std::string &texture_name, bool gen_mipmap,
                      VkFormat image_format)
 {
     name = texture_name;
     path = texture_path;
 
-    int     image_width, image_height, texChannels;
-    stbi_uc *pixels = stbi_load(path.c_str(),
-                                &image_width,
-                                &image_height,
-                                &texChannels,
-                                STBI_rgb_alpha);
+    TextureImage texture_image(path);
+    setupFromImage(texture_image, gen_mipmap, image_format);
+}
+
+Texture2D::Texture2D(const TextureImage &texture_image, const std::string &texture_name, bool gen_mipmap,
+                     VkFormat image_format)
+{
+    name = texture_name;
+    path = texture_image.path;
+
+    setupFromImage(texture_image, gen_mipmap, image_format);
+}
+
+Texture2D::Texture2D(const TextureImagePtr &texture_image, const std::string &texture_name)
+{
+    name = texture_name;
+    path = texture_image->path;
+
+    if (!texture_image->IsCooked())
+    {
+        setupFromImage(*texture_image, false, VK_FORMAT_R8G8B8A8_UNORM);
+        return;
+    }
+
+    m_stream_source = texture_image;
+    width           = texture_image->width;
+    height          = texture_image->height;
+    mip_levels      = static_cast<uint32_t>(texture_image->levels.size());
+    setupFromCookedImage(*texture_image, GetTailLevel());
+}
+
+uint32_t Texture2D::GetTailLevel() const
+{
+    if (m_stream_source == nullptr)
+    {
+        return resident_level;
+    }
+
+    const auto &levels = m_stream_source->levels;
+    for (uint32_t level = 0; level < levels.size(); ++level)
+    {
+        if (levels[level].width <= kStreamingTailSize && levels[level].height <= kStreamingTailSize)
+        {
+            return level;
+        }
+    }
+    return static_cast<uint32_t>(levels.size()) - 1;
+}
+
+VkDeviceSize Texture2D::GetLevelChainSize(uint32_t base_level) const
+{
+    if (m_stream_source == nullptr)
+    {
+        return resident_size;
+    }
+
+    VkDeviceSize chain_size = 0;
+    for (uint32_t level = base_level; level < m_stream_source->levels.size(); ++level)
+    {
+        chain_size += m_stream_source->levels[level].size;
+    }
+    return chain_size;
+}
+
+void Texture2D::SetResidentLevel(uint32_t base_level)
+{
+    if (m_stream_source == nullptr || base_level == resident_level)
+    {
+        return;
+    }
+
+    base_level = std::min(base_level, GetTailLevel());
+    releaseImage();
+    setupFromCookedImage(*m_stream_source, base_level);
+}
+
+void Texture2D::setupFromImage(const TextureImage &texture_image, bool gen_mipmap, VkFormat image_format)
+{
+    if (texture_image.IsCooked())
+    {
+        setupFromCookedImage(texture_image);
+        return;
+    }
+
+    int image_width  = static_cast<int>(texture_image.width);
+    int image_height = static_cast<int>(texture_image.height);
+
     width      = image_width;
     height     = image_height;
     mip_levels = gen_mipmap ? static_cast<uint32_t>(std::floor(std::log2(std::max(image_width, image_height)))) + 1 : 1;
@@ -60,11 +275,6 @@ Texture2D::Texture2D(const std::string &texture_path, const std::string &texture
             throw std::runtime_error("invalid texture_layer_byte_size");
     }
 
-    if (!pixels)
-    {
-        throw std::runtime_error("failed to load texture image!");
-    }
-
     VkBuffer       stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     VulkanUtil::createBuffer(g_p_vulkan_context, texture_layer_byte_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -73,24 +283,21 @@ Texture2D::Texture2D(const std::string &texture_path, const std::string &texture
 
     void *data;
     vkMapMemory(g_p_vulkan_context->_device, stagingBufferMemory, 0, texture_layer_byte_size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(texture_layer_byte_size));
+    memcpy(data, texture_image.pixels, static_cast<size_t>(texture_layer_byte_size));
     vkUnmapMemory(g_p_vulkan_context->_device, stagingBufferMemory);
 
-    free(pixels);
-
     VulkanUtil::createImage(g_p_vulkan_context,
                             image_width, image_height,
                             VK_FORMAT_R8G8B8A8_UNORM,
                             VK_IMAGE_TILING_OPTIMAL,
-                            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory,
                             0, 1, mip_levels);
 
-    VulkanUtil::transitionImageLayout(g_p_vulkan_context,
-                                      image,
-                                      VK_IMAGE_LAYOUT_UNDEFINED,
-                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                      1, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT);
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(g_p_vulkan_context->_device, image, &memory_requirements);
+    resident_size = memory_requirements.size;
 
     VulkanUtil::copyBufferToImage(g_p_vulkan_context,
                                   stagingBuffer,
@@ -98,26 +305,25 @@ Texture2D::Texture2D(const std::string &texture_path, const std::string &texture
                                   static_cast<uint32_t>(image_width),
                                   static_cast<uint32_t>(image_height), 1);
 
-    VulkanUtil::transitionImageLayout(g_p_vulkan_context,
-                                      image,
-                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                      1, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT);
-
-    vkFreeMemory(g_p_vulkan_context->_device, stagingBufferMemory, nullptr);
-    vkDestroyBuffer(g_p_vulkan_context->_device, stagingBuffer, nullptr);
-
     if (gen_mipmap)
     {
-        VulkanUtil::genMipmappedImage(g_p_vulkan_context, image, image_width, image_height, mip_levels);
-    }
-    if (gen_mipmap)
-    {
-        sampler = VulkanUtil::getOrCreateLinearSampler(g_p_vulkan_context);
+        // genMipmappedImage负责把整个mip链转为SHADER_READ_ONLY
+        VulkanUtil::genMipmappedImage(g_p_vulkan_context, image, VK_FORMAT_R8G8B8A8_UNORM,
+                                      image_width, image_height, mip_levels);
     } else
     {
-        sampler = VulkanUtil::getOrCreateMipmapSampler(g_p_vulkan_context, mip_levels);
+        VulkanUtil::transitionImageLayout(g_p_vulkan_context,
+                                          image,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                          1, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT);
     }
+
+    vkFreeMemory(g_p_vulkan_context->_device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(g_p_vulkan_context->_device, stagingBuffer, nullptr);
+
+    // 按mip层数缓存的repeat采样器，maxLod与生成的层级一致
+    sampler = VulkanUtil::getOrCreateMipmapSampler(g_p_vulkan_context, mip_levels);
     view = VulkanUtil::createImageView(g_p_vulkan_context,
                                        image,
                                        VK_FORMAT_R8G8B8A8_UNORM,
@@ -130,21 +336,110 @@ Texture2D::Texture2D(const std::string &texture_path, const std::string &texture
     info.imageLayout = image_layout;
 }
 
+void Texture2D::setupFromCookedImage(const TextureImage &texture_image, uint32_t base_level)
+{
+    width          = texture_image.width;
+    height         = texture_image.height;
+    mip_levels     = static_cast<uint32_t>(texture_image.levels.size());
+    resident_level = base_level;
+
+    // 只上传[base_level, mip_levels)，图像的第0级对应源文件的base_level
+    uint32_t     resident_levels     = mip_levels - base_level;
+    VkDeviceSize staging_buffer_size = 0;
+    for (uint32_t level = base_level; level < mip_levels; ++level)
+    {
+        staging_buffer_size += texture_image.levels[level].size;
+    }
+
+    VkBuffer       stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    VulkanUtil::createBuffer(g_p_vulkan_context, staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             stagingBuffer, stagingBufferMemory);
+
+    // 每个mip直接从文件映射拷贝到staging buffer
+    std::vector<VkBufferImageCopy> regions;
+    void                           *data;
+    vkMapMemory(g_p_vulkan_context->_device, stagingBufferMemory, 0, staging_buffer_size, 0, &data);
+    VkDeviceSize buffer_offset = 0;
+    for (uint32_t level = base_level; level < mip_levels; ++level)
+    {
+        const auto &image_level = texture_image.levels[level];
+        memcpy(static_cast<uint8_t *>(data) + buffer_offset, texture_image.GetLevelData(level), image_level.size);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset                    = buffer_offset;
+        region.bufferRowLength                 = 0;
+        region.bufferImageHeight               = 0;
+        region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel       = level - base_level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+        region.imageOffset                     = {0, 0, 0};
+        region.imageExtent                     = {image_level.width, image_level.height, 1};
+        regions.push_back(region);
+
+        buffer_offset += image_level.size;
+    }
+    vkUnmapMemory(g_p_vulkan_context->_device, stagingBufferMemory);
+
+    VulkanUtil::createImage(g_p_vulkan_context,
+                            texture_image.levels[base_level].width, texture_image.levels[base_level].height,
+                            texture_image.format,
+                            VK_IMAGE_TILING_OPTIMAL,
+                            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory,
+                            0, 1, resident_levels);
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(g_p_vulkan_context->_device, image, &memory_requirements);
+    resident_size = memory_requirements.size;
+
+    VulkanUtil::copyBufferToImage(g_p_vulkan_context, stagingBuffer, image, regions);
+
+    VulkanUtil::transitionImageLayout(g_p_vulkan_context,
+                                      image,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      1, resident_levels, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    vkFreeMemory(g_p_vulkan_context->_device, stagingBufferMemory, nullptr);
+    vkDestroyBuffer(g_p_vulkan_context->_device, stagingBuffer, nullptr);
+
+    sampler = VulkanUtil::getOrCreateMipmapSampler(g_p_vulkan_context, resident_levels);
+    view    = VulkanUtil::createImageView(g_p_vulkan_context,
+                                          image,
+                                          texture_image.format,
+                                          VK_IMAGE_ASPECT_COLOR_BIT,
+                                          VK_IMAGE_VIEW_TYPE_2D, resident_levels);
+
+    image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    info.sampler     = sampler;
+    info.imageView   = view;
+    info.imageLayout = image_layout;
+}
+
 Texture2D::~Texture2D()
 {
-    vkDestroyImageView(g_p_vulkan_context->_device, view, nullptr);
-    vkDestroyImage(g_p_vulkan_context->_device, image, nullptr);
-    vkFreeMemory(g_p_vulkan_context->_device, memory, nullptr);
-    image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    releaseImage();
     LOG_INFO("texture2d destroyed {}", name);
 }
 
+void Texture2D::releaseImage()
+{
+    // 正在执行的帧可能还在采样旧图像
+    g_p_vulkan_context->_deletion_queue.DestroyImage(image, view, memory);
+    view          = VK_NULL_HANDLE;
+    image         = VK_NULL_HANDLE;
+    memory        = VK_NULL_HANDLE;
+    resident_size = 0;
+    image_layout  = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
 TextureCube::TextureCube(const std::vector<std::string> &path, const std::string &name, bool gen_mipmap,
                          VkFormat image_format)
 {
     assert(path.size() == 6);
-    // TextureCube暂时不支持mipmap
-    assert(gen_mipmap == false);
 
     this->name = name;
     this->path = path[0];
@@ -227,11 +522,6 @@ TextureCube::TextureCube(const std::vector<std::string> &path, const std::string
                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                    image, memory, mip_levels);
 
-    VulkanUtil::transitionImageLayout(g_p_vulkan_context,
-                                      image,
-                                      VK_IMAGE_LAYOUT_UNDEFINED,
-                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                      6, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT);
 //
 //    cubemap_offset = 0;
 //    std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -269,16 +559,24 @@ TextureCube::TextureCube(const std::vector<std::string> &path, const std::string
                                   texture_height,
                                   6);
 
-    VulkanUtil::transitionImageLayout(g_p_vulkan_context,
-                                      image,
-                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                      6, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT);
+    if (gen_mipmap)
+    {
+        // 6个面在同一次blit中逐级下采样
+        VulkanUtil::genMipmappedImage(g_p_vulkan_context, image, image_format,
+                                      texture_width, texture_height, mip_levels, 6);
+    } else
+    {
+        VulkanUtil::transitionImageLayout(g_p_vulkan_context,
+                                          image,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                          6, mip_levels, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
 
     vkDestroyBuffer(g_p_vulkan_context->_device, stagingBuffer, nullptr);
     vkFreeMemory(g_p_vulkan_context->_device, stagingBufferMemory, nullptr);
 
-    sampler = VulkanUtil::getOrCreateCubeMapSampler(g_p_vulkan_context, mip_levels);
+    sampler = VulkanUtil::getOrCreateCubeMapSampler(g_p_vulkan_context);
     view    = VulkanUtil::createImageView(g_p_vulkan_context,
                                           image,
                                           image_format,
@@ -294,9 +592,7 @@ TextureCube::TextureCube(const std::vector<std::string> &path, const std::string
 
 TextureCube::~TextureCube()
 {
-    vkDestroyImageView(g_p_vulkan_context->_device, view, nullptr);
-    vkDestroyImage(g_p_vulkan_context->_device, image, nullptr);
-    vkFreeMemory(g_p_vulkan_context->_device, memory, nullptr);
+    g_p_vulkan_context->_deletion_queue.DestroyImage(image, view, memory);
     image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
     LOG_INFO("texturecube destroyed {}", name);
 }
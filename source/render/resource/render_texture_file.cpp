@@ -0,0 +1,443 @@
+//
+// Created by kyrosz7u on 2023/7/6.
+//
+
+#include "render/resource/render_texture_file.h"
+#include "render/resource/render_texture.h"
+#include "core/logger/logger_macros.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace RenderSystem;
+
+static_assert(sizeof(Ktx2Header) == 80, "unexpected ktx2 header size");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "unexpected ktx2 level index size");
+
+namespace
+{
+    // BC7 4bit索引插值权重
+    const uint32_t kBC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct BC7Endpoint
+    {
+        uint32_t value[4]; // 7bit
+        uint32_t pbit;
+    };
+
+    struct BC7BitWriter
+    {
+        uint8_t  *block;
+        uint32_t bit_position{0};
+
+        void write(uint32_t value, uint32_t bit_count)
+        {
+            for (uint32_t i = 0; i < bit_count; ++i, ++bit_position)
+            {
+                if ((value >> i) & 1u)
+                {
+                    block[bit_position >> 3] |= uint8_t(1u << (bit_position & 7));
+                }
+            }
+        }
+    };
+
+    BC7Endpoint quantizeEndpoint(const float *color)
+    {
+        BC7Endpoint best{};
+        float       best_error = -1.0f;
+        for (uint32_t pbit = 0; pbit < 2; ++pbit)
+        {
+            BC7Endpoint endpoint{};
+            endpoint.pbit = pbit;
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                float q = std::round((color[c] - float(pbit)) * 0.5f);
+                endpoint.value[c] = uint32_t(std::clamp(q, 0.0f, 127.0f));
+                float reconstructed = float((endpoint.value[c] << 1) | pbit);
+                error += (reconstructed - color[c]) * (reconstructed - color[c]);
+            }
+            if (best_error < 0.0f || error < best_error)
+            {
+                best       = endpoint;
+                best_error = error;
+            }
+        }
+        return best;
+    }
+
+    // 根据量化后的端点为每个像素选择最近的插值颜色，返回总误差
+    float assignIndices(const float pixels[16][4], const BC7Endpoint &e0, const BC7Endpoint &e1, uint32_t *indices)
+    {
+        float palette[16][4];
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                uint32_t a = (e0.value[c] << 1) | e0.pbit;
+                uint32_t b = (e1.value[c] << 1) | e1.pbit;
+                palette[i][c] = float(((64 - kBC7Weights4[i]) * a + kBC7Weights4[i] * b + 32) >> 6);
+            }
+        }
+
+        float total_error = 0.0f;
+        for (int p = 0; p < 16; ++p)
+        {
+            float    best_error = -1.0f;
+            uint32_t best_index = 0;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                float error = 0.0f;
+                for (int c = 0; c < 4; ++c)
+                {
+                    float d = palette[i][c] - pixels[p][c];
+                    error += d * d;
+                }
+                if (best_error < 0.0f || error < best_error)
+                {
+                    best_error = error;
+                    best_index = i;
+                }
+            }
+            indices[p] = best_index;
+            total_error += best_error;
+        }
+        return total_error;
+    }
+}
+
+bool RenderSystem::GetTextureFormatInfo(VkFormat format, TextureFormatInfo &format_info)
+{
+    switch (format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            format_info = {1, 1, 4};
+            return true;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            format_info = {4, 4, 8};
+            return true;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+            format_info = {4, 4, 16};
+            return true;
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+            format_info = {6, 6, 16};
+            return true;
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+            format_info = {8, 8, 16};
+            return true;
+        default:
+            return false;
+    }
+}
+
+void TextureCooker::CompressBC7Block(const uint8_t *rgba, uint8_t *block)
+{
+    float pixels[16][4];
+    float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int p = 0; p < 16; ++p)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            pixels[p][c] = float(rgba[p * 4 + c]);
+            mean[c] += pixels[p][c] / 16.0f;
+        }
+    }
+
+    // 协方差矩阵 + 幂迭代求主轴
+    float covariance[4][4] = {};
+    for (int p = 0; p < 16; ++p)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                covariance[i][j] += (pixels[p][i] - mean[i]) * (pixels[p][j] - mean[j]);
+            }
+        }
+    }
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length  = 0.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                next[i] += covariance[i][j] * axis[j];
+            }
+            length += next[i] * next[i];
+        }
+        length = std::sqrt(length);
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            axis[i] = next[i] / length;
+        }
+    }
+
+    float t_min = 0.0f, t_max = 0.0f;
+    for (int p = 0; p < 16; ++p)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < 4; ++c)
+        {
+            t += (pixels[p][c] - mean[c]) * axis[c];
+        }
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+
+    float color0[4], color1[4];
+    for (int c = 0; c < 4; ++c)
+    {
+        color0[c] = std::clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+        color1[c] = std::clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+    }
+
+    BC7Endpoint e0 = quantizeEndpoint(color0);
+    BC7Endpoint e1 = quantizeEndpoint(color1);
+    uint32_t    indices[16];
+    float       error = assignIndices(pixels, e0, e1, indices);
+
+    // 用最小二乘根据索引重新拟合一次端点
+    float a = 0.0f, b = 0.0f, d = 0.0f;
+    float x0[4] = {}, x1[4] = {};
+    for (int p = 0; p < 16; ++p)
+    {
+        float w = float(kBC7Weights4[indices[p]]) / 64.0f;
+        a += (1.0f - w) * (1.0f - w);
+        b += (1.0f - w) * w;
+        d += w * w;
+        for (int c = 0; c < 4; ++c)
+        {
+            x0[c] += (1.0f - w) * pixels[p][c];
+            x1[c] += w * pixels[p][c];
+        }
+    }
+    float determinant = a * d - b * b;
+    if (std::abs(determinant) > 1e-6f)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            color0[c] = std::clamp((d * x0[c] - b * x1[c]) / determinant, 0.0f, 255.0f);
+            color1[c] = std::clamp((a * x1[c] - b * x0[c]) / determinant, 0.0f, 255.0f);
+        }
+        BC7Endpoint refit_e0 = quantizeEndpoint(color0);
+        BC7Endpoint refit_e1 = quantizeEndpoint(color1);
+        uint32_t    refit_indices[16];
+        float       refit_error = assignIndices(pixels, refit_e0, refit_e1, refit_indices);
+        if (refit_error < error)
+        {
+            e0 = refit_e0;
+            e1 = refit_e1;
+            memcpy(indices, refit_indices, sizeof(indices));
+        }
+    }
+
+    // 第一个像素的索引最高位隐含为0，必要时交换端点
+    if (indices[0] & 0x8u)
+    {
+        std::swap(e0, e1);
+        for (auto &index: indices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    memset(block, 0, 16);
+    BC7BitWriter writer{block};
+    writer.write(1u << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.write(e0.value[c], 7);
+        writer.write(e1.value[c], 7);
+    }
+    writer.write(e0.pbit, 1);
+    writer.write(e1.pbit, 1);
+    writer.write(indices[0], 3);
+    for (int p = 1; p < 16; ++p)
+    {
+        writer.write(indices[p], 4);
+    }
+}
+
+std::vector<uint8_t> TextureCooker::CompressBC7Image(const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+    uint32_t block_count_x = (width + 3) / 4;
+    uint32_t block_count_y = (height + 3) / 4;
+
+    std::vector<uint8_t> blocks(size_t(block_count_x) * block_count_y * 16);
+    uint8_t              block_pixels[16 * 4];
+    for (uint32_t by = 0; by < block_count_y; ++by)
+    {
+        for (uint32_t bx = 0; bx < block_count_x; ++bx)
+        {
+            // 边缘不足4x4的块用边界像素补齐
+            for (uint32_t y = 0; y < 4; ++y)
+            {
+                for (uint32_t x = 0; x < 4; ++x)
+                {
+                    uint32_t src_x = std::min(bx * 4 + x, width - 1);
+                    uint32_t src_y = std::min(by * 4 + y, height - 1);
+                    memcpy(&block_pixels[(y * 4 + x) * 4], &rgba[(size_t(src_y) * width + src_x) * 4], 4);
+                }
+            }
+            CompressBC7Block(block_pixels, &blocks[(size_t(by) * block_count_x + bx) * 16]);
+        }
+    }
+    return blocks;
+}
+
+std::vector<uint8_t> TextureCooker::DownsampleImage(const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+    uint32_t dst_width  = std::max(width / 2, 1u);
+    uint32_t dst_height = std::max(height / 2, 1u);
+
+    std::vector<uint8_t> dst(size_t(dst_width) * dst_height * 4);
+    for (uint32_t y = 0; y < dst_height; ++y)
+    {
+        for (uint32_t x = 0; x < dst_width; ++x)
+        {
+            uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                uint32_t sum = rgba[(size_t(y0) * width + x0) * 4 + c] + rgba[(size_t(y0) * width + x1) * 4 + c] +
+                               rgba[(size_t(y1) * width + x0) * 4 + c] + rgba[(size_t(y1) * width + x1) * 4 + c];
+                dst[(size_t(y) * dst_width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+bool TextureCooker::WriteKtx2File(const std::string &path,
+                                  VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  const std::vector<std::vector<uint8_t>> &levels)
+{
+    if (format != VK_FORMAT_BC7_UNORM_BLOCK && format != VK_FORMAT_BC7_SRGB_BLOCK)
+    {
+        LOG_ERROR("ktx2 writer only supports bc7, format:{}", format)
+        return false;
+    }
+
+    // Khronos Basic Data Format Descriptor: 一个BC7 sample
+    std::vector<uint32_t> dfd(1 + 6 + 4);
+    dfd[0]  = uint32_t(dfd.size() * sizeof(uint32_t));         // dfdTotalSize
+    dfd[1]  = 0;                                               // vendorId | descriptorType
+    dfd[2]  = 2u | (uint32_t(24 + 16) << 16);                  // versionNumber | descriptorBlockSize
+    dfd[3]  = 134u | (1u << 8) |                               // KHR_DF_MODEL_BC7 | BT709
+              ((format == VK_FORMAT_BC7_SRGB_BLOCK ? 2u : 1u) << 16);
+    dfd[4]  = 3u | (3u << 8);                                  // texelBlockDimension 4x4
+    dfd[5]  = 16;                                              // bytesPlane0
+    dfd[6]  = 0;
+    dfd[7]  = 0u | (127u << 16);                               // bitOffset | bitLength - 1
+    dfd[8]  = 0;                                               // samplePosition
+    dfd[9]  = 0;                                               // sampleLower
+    dfd[10] = 0xFFFFFFFFu;                                     // sampleUpper
+
+    uint32_t level_count = uint32_t(levels.size());
+
+    Ktx2Header header{};
+    memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+    header.vk_format               = format;
+    header.type_size               = 1;
+    header.pixel_width             = width;
+    header.pixel_height            = height;
+    header.pixel_depth             = 0;
+    header.layer_count             = 0;
+    header.face_count              = 1;
+    header.level_count             = level_count;
+    header.supercompression_scheme = 0;
+    header.dfd_byte_offset         = uint32_t(sizeof(Ktx2Header) + level_count * sizeof(Ktx2LevelIndex));
+    header.dfd_byte_length         = dfd[0];
+
+    // mip数据从最小的level开始存放，按16字节对齐
+    std::vector<Ktx2LevelIndex> level_indices(level_count);
+    uint64_t                    offset = header.dfd_byte_offset + header.dfd_byte_length;
+    for (int32_t level = int32_t(level_count) - 1; level >= 0; --level)
+    {
+        offset = (offset + 15) & ~uint64_t(15);
+        level_indices[level].byte_offset              = offset;
+        level_indices[level].byte_length              = levels[level].size();
+        level_indices[level].uncompressed_byte_length = levels[level].size();
+        offset += levels[level].size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        LOG_ERROR("failed to open ktx2 for writing:{}", path)
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(level_indices.data()), level_indices.size() * sizeof(Ktx2LevelIndex));
+    file.write(reinterpret_cast<const char *>(dfd.data()), dfd.size() * sizeof(uint32_t));
+    for (int32_t level = int32_t(level_count) - 1; level >= 0; --level)
+    {
+        static const char padding[16] = {};
+        uint64_t          current = file.tellp();
+        file.write(padding, level_indices[level].byte_offset - current);
+        file.write(reinterpret_cast<const char *>(levels[level].data()), levels[level].size());
+    }
+    return file.good();
+}
+
+bool TextureCooker::CookTextureFile(const std::string &source_path, const std::string &cooked_path)
+{
+    try
+    {
+        TextureImage source_image(source_path, false);
+
+        uint32_t width  = source_image.width;
+        uint32_t height = source_image.height;
+
+        std::vector<std::vector<uint8_t>> levels;
+        std::vector<uint8_t>              mip(source_image.pixels,
+                                              source_image.pixels + size_t(width) * height * 4);
+        while (true)
+        {
+            levels.push_back(CompressBC7Image(mip.data(), width, height));
+            if (width == 1 && height == 1)
+            {
+                break;
+            }
+            mip    = DownsampleImage(mip.data(), width, height);
+            width  = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+
+        if (!WriteKtx2File(cooked_path, VK_FORMAT_BC7_UNORM_BLOCK, source_image.width, source_image.height, levels))
+        {
+            return false;
+        }
+        LOG_INFO("texture cooked path:{}\tsize:{}x{}\tmips:{}", cooked_path, source_image.width,
+                 source_image.height, levels.size())
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("cook texture error:{}\tpath:{}", e.what(), source_path)
+        return false;
+    }
+}
@@ -0,0 +1,241 @@
+//
+// Created by kyrosz7u on 2023/7/9.
+//
+
+#include "render/resource/render_texture_residency.h"
+#include "core/logger/logger_macros.h"
+#include <imgui.h>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+using namespace RenderSystem;
+using namespace Math;
+
+void TextureResidencyManager::SetTextures(const std::vector<Texture2DPtr> &textures)
+{
+    m_textures = textures;
+    m_states.assign(m_textures.size(), TextureState{});
+    resetDesiredLevels();
+    updateResidentBytes();
+}
+
+void TextureResidencyManager::RequestTexture(int texture_index, float screen_extent)
+{
+    if (texture_index < 0 || texture_index >= int(m_textures.size()) || screen_extent <= 0.0f)
+    {
+        return;
+    }
+
+    const auto &texture = m_textures[texture_index];
+    auto       &state   = m_states[texture_index];
+    state.last_used_frame = m_frame_index;
+    if (!texture->IsStreamable())
+    {
+        return;
+    }
+
+    // 纹理按大致覆盖整个物体估算：每个屏幕像素对应一个纹素的层级
+    float    texel_ratio = float(std::max(texture->width, texture->height)) / screen_extent;
+    uint32_t level       = texel_ratio > 1.0f ? uint32_t(std::floor(std::log2(texel_ratio))) : 0;
+    state.desired_level = std::min(state.desired_level, std::min(level, texture->GetTailLevel()));
+}
+
+bool TextureResidencyManager::Update()
+{
+    uint64_t frame_index = m_frame_index++;
+    if (m_textures.empty() || frame_index - m_last_update_frame < m_config.update_interval)
+    {
+        return false;
+    }
+    m_last_update_frame = frame_index;
+    m_budget            = queryBudget();
+
+    // 目标层级：这段时间内没有被使用的流式纹理退回mip尾部
+    std::vector<uint32_t> target_levels(m_textures.size());
+    VkDeviceSize          target_bytes = 0;
+    for (size_t           i            = 0; i < m_textures.size(); ++i)
+    {
+        const auto &texture = m_textures[i];
+        target_levels[i] = texture->IsStreamable() ? m_states[i].desired_level : texture->resident_level;
+        target_bytes += texture->GetLevelChainSize(target_levels[i]);
+    }
+
+    // 超出预算时从最久未使用的纹理开始逐级降低精度
+    if (target_bytes > m_budget)
+    {
+        std::vector<size_t> lru_order(m_textures.size());
+        std::iota(lru_order.begin(), lru_order.end(), 0);
+        std::stable_sort(lru_order.begin(), lru_order.end(), [this](size_t a, size_t b)
+        {
+            return m_states[a].last_used_frame < m_states[b].last_used_frame;
+        });
+
+        for (size_t index: lru_order)
+        {
+            const auto &texture    = m_textures[index];
+            uint32_t   tail_level = texture->GetTailLevel();
+            while (target_bytes > m_budget && texture->IsStreamable() && target_levels[index] < tail_level)
+            {
+                target_bytes -= texture->GetLevelChainSize(target_levels[index]) -
+                                texture->GetLevelChainSize(target_levels[index] + 1);
+                target_levels[index]++;
+            }
+            if (target_bytes <= m_budget)
+            {
+                break;
+            }
+        }
+    }
+
+    // 降级总是执行以释放显存；升级按最近使用排序，并受单次上传量限制
+    std::vector<size_t> evictions;
+    std::vector<size_t> upgrades;
+    for (size_t         i = 0; i < m_textures.size(); ++i)
+    {
+        if (!m_textures[i]->IsStreamable())
+        {
+            continue;
+        }
+        if (target_levels[i] > m_textures[i]->resident_level)
+        {
+            evictions.push_back(i);
+        } else if (target_levels[i] < m_textures[i]->resident_level)
+        {
+            upgrades.push_back(i);
+        }
+    }
+    std::stable_sort(upgrades.begin(), upgrades.end(), [this](size_t a, size_t b)
+    {
+        return m_states[a].last_used_frame > m_states[b].last_used_frame;
+    });
+
+    std::vector<size_t> stream_ins;
+    VkDeviceSize        upload_bytes = 0;
+    for (size_t         index: upgrades)
+    {
+        VkDeviceSize chain_size = m_textures[index]->GetLevelChainSize(target_levels[index]);
+        if (upload_bytes > 0 && upload_bytes + chain_size > m_config.max_upload_bytes)
+        {
+            continue;
+        }
+        upload_bytes += chain_size;
+        stream_ins.push_back(index);
+    }
+
+    resetDesiredLevels();
+    if (evictions.empty() && stream_ins.empty())
+    {
+        return false;
+    }
+
+    // 旧图像可能仍被正在执行的command buffer引用，由SetResidentLevel交给延迟销毁队列
+    for (size_t index: evictions)
+    {
+        m_textures[index]->SetResidentLevel(target_levels[index]);
+    }
+    for (size_t index: stream_ins)
+    {
+        m_textures[index]->SetResidentLevel(target_levels[index]);
+    }
+    updateResidentBytes();
+
+    LOG_INFO("texture residency evicted:{}\tstreamed:{}\tupload:{:.2f}MB\tresident:{:.2f}MB\tbudget:{:.2f}MB",
+             evictions.size(), stream_ins.size(),
+             upload_bytes / (1024.0 * 1024.0),
+             m_resident_bytes / (1024.0 * 1024.0),
+             m_budget / (1024.0 * 1024.0))
+    return true;
+}
+
+float TextureResidencyManager::EstimateScreenExtent(const Matrix4x4 &proj_view_model,
+                                                    const Vector3 &bounding_min,
+                                                    const Vector3 &bounding_max,
+                                                    float viewport_height)
+{
+    float min_x = 1.0f, min_y = 1.0f;
+    float max_x = -1.0f, max_y = -1.0f;
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        Vector3 position((corner & 1) ? bounding_max.x : bounding_min.x,
+                         (corner & 2) ? bounding_max.y : bounding_min.y,
+                         (corner & 4) ? bounding_max.z : bounding_min.z);
+        Vector4 clip = proj_view_model * Vector4(position, 1.0f);
+        // 包围盒跨过相机平面时无法可靠投影，按占满屏幕处理
+        if (clip.w <= 1e-4f)
+        {
+            return viewport_height;
+        }
+        min_x = std::min(min_x, clip.x / clip.w);
+        min_y = std::min(min_y, clip.y / clip.w);
+        max_x = std::max(max_x, clip.x / clip.w);
+        max_y = std::max(max_y, clip.y / clip.w);
+    }
+
+    min_x = std::max(min_x, -1.0f);
+    min_y = std::max(min_y, -1.0f);
+    max_x = std::min(max_x, 1.0f);
+    max_y = std::min(max_y, 1.0f);
+    if (max_x <= min_x || max_y <= min_y)
+    {
+        return 0.0f;
+    }
+    return std::max(max_x - min_x, max_y - min_y) * 0.5f * viewport_height;
+}
+
+void TextureResidencyManager::ImGuiDebugPanel()
+{
+    ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+    if (ImGui::TreeNode("TextureResidency"))
+    {
+        size_t streamable_count = 0;
+        size_t full_count       = 0;
+        for (const auto &texture: m_textures)
+        {
+            if (texture->IsStreamable())
+            {
+                streamable_count++;
+                if (texture->resident_level == 0)
+                    full_count++;
+            }
+        }
+        ImGui::Text("budget: %.1fMB (%s)", m_budget / (1024.0 * 1024.0),
+                    m_budget_from_driver ? "VK_EXT_memory_budget" : "heap size");
+        ImGui::Text("resident: %.1fMB", m_resident_bytes / (1024.0 * 1024.0));
+        ImGui::Text("textures: %zu streamable: %zu full res: %zu",
+                    m_textures.size(), streamable_count, full_count);
+        ImGui::TreePop();
+    }
+}
+
+VkDeviceSize TextureResidencyManager::queryBudget()
+{
+    VkDeviceSize heap_budget, heap_usage;
+    m_budget_from_driver = g_p_vulkan_context->queryDeviceLocalMemoryBudget(heap_budget, heap_usage);
+
+    // heap_usage中包含纹理自身的占用，剩余预算加上已驻留的部分才是纹理可用的总量
+    VkDeviceSize available = heap_budget;
+    if (m_budget_from_driver)
+    {
+        available = (heap_budget > heap_usage ? heap_budget - heap_usage : 0) + m_resident_bytes;
+    }
+    return std::min(m_config.budget_bytes, VkDeviceSize(double(available) * m_config.budget_fraction));
+}
+
+void TextureResidencyManager::resetDesiredLevels()
+{
+    for (size_t i = 0; i < m_textures.size(); ++i)
+    {
+        m_states[i].desired_level = m_textures[i]->GetTailLevel();
+    }
+}
+
+void TextureResidencyManager::updateResidentBytes()
+{
+    m_resident_bytes = 0;
+    for (const auto &texture: m_textures)
+    {
+        m_resident_bytes += texture->resident_size;
+    }
+}
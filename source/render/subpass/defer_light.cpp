@@ -17,9 +17,9 @@ void DeferLightPass::initialize(SubPassInitInfo *subPassInitInfo)
     m_p_render_resource_info        = mesh_pass_init_info->p_render_resource_info;
     m_subpass_index                 = mesh_pass_init_info->subpass_index;
     m_renderpass                    = mesh_pass_init_info->renderpass;
-    m_p_gbuffer_color_attachment    = mesh_pass_init_info->gbuffer_color_attachment;
-    m_p_gbuffer_normal_attachment   = mesh_pass_init_info->gbuffer_normal_attachment;
-    m_p_gbuffer_position_attachment = mesh_pass_init_info->gbuffer_position_attachment;
+    m_p_gbuffer_color_attachment  = mesh_pass_init_info->gbuffer_color_attachment;
+    m_p_gbuffer_normal_attachment = mesh_pass_init_info->gbuffer_normal_attachment;
+    m_p_depth_attachment          = mesh_pass_init_info->depth_attachment;
 
     setupPipeLineLayout();
     setupDescriptorSet();
@@ -33,7 +33,7 @@ void DeferLightPass::setupPipeLineLayout()
     auto &ubo_data_layout = m_descriptor_set_layouts[_mesh_defer_lighting_pass_ubo_data_layout];
 
     std::vector<VkDescriptorSetLayoutBinding> ubo_layout_bindings;
-    ubo_layout_bindings.resize(3);
+    ubo_layout_bindings.resize(6);
 
     VkDescriptorSetLayoutBinding &perframe_buffer_binding = ubo_layout_bindings[0];
 
@@ -56,6 +56,17 @@ void DeferLightPass::setupPipeLineLayout()
     direction_light_projection_binding.binding         = 2;
     direction_light_projection_binding.descriptorCount = 1;
 
+    // 分簇光照：光源列表、每个cluster的光源数量和光源索引
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        VkDescriptorSetLayoutBinding &local_light_binding = ubo_layout_bindings[3 + i];
+
+        local_light_binding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        local_light_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+        local_light_binding.binding         = 3 + i;
+        local_light_binding.descriptorCount = 1;
+    }
+
     VkDescriptorSetLayoutCreateInfo descriptorset_layout_ci;
     descriptorset_layout_ci.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorset_layout_ci.flags        = 0;
@@ -85,11 +96,12 @@ void DeferLightPass::setupPipeLineLayout()
     gbuffer_normal_binding.binding         = 1;
     gbuffer_normal_binding.descriptorCount = 1;
 
-    VkDescriptorSetLayoutBinding &gbuffer_position_binding = texture_layout_bindings[2];
-    gbuffer_position_binding.descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-    gbuffer_position_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
-    gbuffer_position_binding.binding         = 2;
-    gbuffer_position_binding.descriptorCount = 1;
+    // 世界坐标由深度和inv_proj_view重建
+    VkDescriptorSetLayoutBinding &depth_binding = texture_layout_bindings[2];
+    depth_binding.descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    depth_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+    depth_binding.binding         = 2;
+    depth_binding.descriptorCount = 1;
 
     VkDescriptorSetLayoutCreateInfo texture_descriptorset_layout_ci;
     texture_descriptorset_layout_ci.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -106,7 +118,7 @@ void DeferLightPass::setupPipeLineLayout()
     auto &directional_light_data_layout = m_descriptor_set_layouts[_mesh_defer_lighting_pass_directional_light_shadow_layout];
 
     std::vector<VkDescriptorSetLayoutBinding> directional_light_layout_bindings;
-    directional_light_layout_bindings.resize(1);
+    directional_light_layout_bindings.resize(2);
 
     VkDescriptorSetLayoutBinding &directional_light_shadow_binding = directional_light_layout_bindings[0];
     directional_light_shadow_binding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -114,6 +126,12 @@ void DeferLightPass::setupPipeLineLayout()
     directional_light_shadow_binding.binding         = 0;
     directional_light_shadow_binding.descriptorCount = 1;
 
+    VkDescriptorSetLayoutBinding &point_light_shadow_binding = directional_light_layout_bindings[1];
+    point_light_shadow_binding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    point_light_shadow_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+    point_light_shadow_binding.binding         = 1;
+    point_light_shadow_binding.descriptorCount = 1;
+
     VkDescriptorSetLayoutCreateInfo directional_light_descriptorSetLayoutCreateInfo;
     directional_light_descriptorSetLayoutCreateInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     directional_light_descriptorSetLayoutCreateInfo.flags        = 0;
@@ -157,7 +175,7 @@ void DeferLightPass::setupDescriptorSet()
 void DeferLightPass::updateGlobalDescriptorSet()
 {
     std::vector<VkWriteDescriptorSet> write_descriptor_sets;
-    write_descriptor_sets.resize(3);
+    write_descriptor_sets.resize(6);
 
     VkWriteDescriptorSet &perframe_buffer_write = write_descriptor_sets[0];
     perframe_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -190,6 +208,23 @@ void DeferLightPass::updateGlobalDescriptorSet()
     directional_light_probes_buffer_write.pBufferInfo     = &m_p_render_resource_info->
             p_render_light_project_ubo_list->static_info;
 
+    auto                   *light_cluster_culling       = m_p_render_resource_info->p_light_cluster_culling;
+    VkDescriptorBufferInfo *local_light_buffer_infos[3] = {&light_cluster_culling->light_buffer_info,
+                                                           &light_cluster_culling->cluster_count_buffer_info,
+                                                           &light_cluster_culling->cluster_index_buffer_info};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        VkWriteDescriptorSet &local_light_buffer_write = write_descriptor_sets[3 + i];
+        local_light_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        local_light_buffer_write.pNext           = nullptr;
+        local_light_buffer_write.dstSet          = m_scence_ubo_descriptor_set;
+        local_light_buffer_write.dstBinding      = 3 + i;
+        local_light_buffer_write.dstArrayElement = 0;
+        local_light_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        local_light_buffer_write.descriptorCount = 1;
+        local_light_buffer_write.pBufferInfo     = local_light_buffer_infos[i];
+    }
+
     vkUpdateDescriptorSets(g_p_vulkan_context->_device,
                            write_descriptor_sets.size(),
                            write_descriptor_sets.data(),
@@ -207,7 +242,7 @@ void DeferLightPass::updateGBufferDescriptorSet()
 
     VkDescriptorImageInfo gbuffer_color_info;
     VkDescriptorImageInfo gbuffer_normal_info;
-    VkDescriptorImageInfo gbuffer_position_info;
+    VkDescriptorImageInfo depth_info;
 
     gbuffer_color_info.sampler     = VK_NULL_HANDLE;
     gbuffer_color_info.imageView   = m_p_gbuffer_color_attachment->view;
@@ -217,9 +252,9 @@ void DeferLightPass::updateGBufferDescriptorSet()
     gbuffer_normal_info.imageView   = m_p_gbuffer_normal_attachment->view;
     gbuffer_normal_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    gbuffer_position_info.sampler     = VK_NULL_HANDLE;
-    gbuffer_position_info.imageView   = m_p_gbuffer_position_attachment->view;
-    gbuffer_position_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    depth_info.sampler     = VK_NULL_HANDLE;
+    depth_info.imageView   = m_p_depth_attachment->view;
+    depth_info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
     VkWriteDescriptorSet &gbuffer_perframe_buffer_write = gbuffer_write_descriptor_sets[0];
     gbuffer_perframe_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -239,14 +274,14 @@ void DeferLightPass::updateGBufferDescriptorSet()
     gbuffer_normal_write.descriptorCount = 1;
     gbuffer_normal_write.pImageInfo      = &gbuffer_normal_info;
 
-    VkWriteDescriptorSet &gbuffer_position_write = gbuffer_write_descriptor_sets[2];
-    gbuffer_position_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    gbuffer_position_write.dstSet          = m_gbuffer_descriptor_set;
-    gbuffer_position_write.dstBinding      = 2;
-    gbuffer_position_write.dstArrayElement = 0;
-    gbuffer_position_write.descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-    gbuffer_position_write.descriptorCount = 1;
-    gbuffer_position_write.pImageInfo      = &gbuffer_position_info;
+    VkWriteDescriptorSet &depth_write = gbuffer_write_descriptor_sets[2];
+    depth_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    depth_write.dstSet          = m_gbuffer_descriptor_set;
+    depth_write.dstBinding      = 2;
+    depth_write.dstArrayElement = 0;
+    depth_write.descriptorType  = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    depth_write.descriptorCount = 1;
+    depth_write.pImageInfo      = &depth_info;
 
     vkUpdateDescriptorSets(g_p_vulkan_context->_device,
                            gbuffer_write_descriptor_sets.size(),
@@ -5,6 +5,9 @@
 #include "render/subpass/directional_light_shadow.h"
 #include "render/resource/render_mesh.h"
 #include "core/logger/logger_macros.h"
+#include <cfloat>
+#include <cstddef>
+#include <algorithm>
 
 using namespace VulkanAPI;
 using namespace RenderSystem;
@@ -29,23 +32,16 @@ void DirectionalLightShadowPass::setupPipeLineLayout()
     auto &ubo_data_layout = m_descriptor_set_layouts[_directional_shadow_layout];
 
     std::vector<VkDescriptorSetLayoutBinding> ubo_layout_bindings;
-    ubo_layout_bindings.resize(2);
+    ubo_layout_bindings.resize(1);
 
-    VkDescriptorSetLayoutBinding &perlight_buffer_binding = ubo_layout_bindings[0];
+    // light_proj通过push constant传入，只在切换tile时更新
+    VkDescriptorSetLayoutBinding &perobject_buffer_binding = ubo_layout_bindings[0];
 
-    perlight_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    perlight_buffer_binding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
-    perlight_buffer_binding.binding         = 0;
-    perlight_buffer_binding.descriptorCount = 1;
-
-    VkDescriptorSetLayoutBinding &perobject_buffer_binding = ubo_layout_bindings[1];
-
-    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     perobject_buffer_binding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
-    perobject_buffer_binding.binding         = 1;
+    perobject_buffer_binding.binding         = 0;
     perobject_buffer_binding.descriptorCount = 1;
 
-
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
     descriptorSetLayoutCreateInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorSetLayoutCreateInfo.flags        = 0;
@@ -81,25 +77,16 @@ void DirectionalLightShadowPass::setupDescriptorSet()
 void DirectionalLightShadowPass::updateGlobalRenderDescriptorSet()
 {
     std::vector<VkWriteDescriptorSet> write_descriptor_sets;
-    write_descriptor_sets.resize(2);
-
-    VkWriteDescriptorSet &perframe_buffer_write = write_descriptor_sets[0];
-    perframe_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    perframe_buffer_write.dstSet          = m_dir_shadow_ubo_descriptor_set;
-    perframe_buffer_write.dstBinding      = 0;
-    perframe_buffer_write.dstArrayElement = 0;
-    perframe_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    perframe_buffer_write.descriptorCount = 1;
-    perframe_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_light_project_ubo_list->dynamic_info;
-
-    VkWriteDescriptorSet &perobject_buffer_write = write_descriptor_sets[1];
+    write_descriptor_sets.resize(1);
+
+    VkWriteDescriptorSet &perobject_buffer_write = write_descriptor_sets[0];
     perobject_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     perobject_buffer_write.dstSet          = m_dir_shadow_ubo_descriptor_set;
-    perobject_buffer_write.dstBinding      = 1;
+    perobject_buffer_write.dstBinding      = 0;
     perobject_buffer_write.dstArrayElement = 0;
-    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     perobject_buffer_write.descriptorCount = 1;
-    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_ubo_list->dynamic_info;
+    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_buffer->buffer_info;
 
 
     vkUpdateDescriptorSets(g_p_vulkan_context->_device,
@@ -119,10 +106,15 @@ void DirectionalLightShadowPass::setupPipelines()
         descriptorset_layouts.push_back(layout);
     }
 
+    VkPushConstantRange draw_push_constant_range{};
+    draw_push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    draw_push_constant_range.offset     = 0;
+    draw_push_constant_range.size       = sizeof(VulkanShadowDrawPushConstant);
+
     VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
     pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.pushConstantRangeCount = 0;
-    pipeline_layout_create_info.pPushConstantRanges    = nullptr;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges    = &draw_push_constant_range;
     pipeline_layout_create_info.setLayoutCount         = descriptorset_layouts.size();
     pipeline_layout_create_info.pSetLayouts            = descriptorset_layouts.data();
 
@@ -270,83 +262,156 @@ void DirectionalLightShadowPass::setupPipelines()
     }
 }
 
-void DirectionalLightShadowPass::drawSingleThread(VkCommandBuffer &command_buffer,
-                                                  VkCommandBufferInheritanceInfo &inheritance_info,
-                                                  uint32_t submesh_start_index,
-                                                  uint32_t submesh_end_index)
+bool DirectionalLightShadowPass::isMeshInShadowTile(const RenderMesh &mesh, uint32_t tile_index) const
 {
-    VkCommandBufferBeginInfo command_buffer_begin_info{};
-    command_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    command_buffer_begin_info.flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-    command_buffer_begin_info.pInheritanceInfo = &inheritance_info;
-
-    VK_CHECK_RESULT(g_p_vulkan_context->_vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))
+    const auto &light_projections = m_p_render_resource_info->p_render_light_project_ubo_list->ubo_data_list;
+    const auto &models            = m_p_render_resource_info->p_render_model_buffer->data_list;
+    if (tile_index >= light_projections.size() || mesh.m_index_in_model_buffer >= models.size())
+    {
+        return true;
+    }
 
-    VkExtent2D extent = {static_cast<uint32_t>(m_p_render_resource_info->kDirectionalLightInfo.shadowmap_width),
-                         static_cast<uint32_t>(m_p_render_resource_info->kDirectionalLightInfo.shadowmap_height)};
-    VkViewport viewport{};
-    viewport.x        = 0.0f;
-    viewport.y        = 0.0f;
-    viewport.width    = static_cast<float>(extent.width);
-    viewport.height   = static_cast<float>(extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    // 包围盒变换到级联的光源裁剪空间，正交投影无需透视除法
+    Matrix4x4 light_model = light_projections[tile_index].light_proj *
+                            models[mesh.m_index_in_model_buffer].model;
+    Vector3   box_min(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vector3   box_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < 8; ++i)
+    {
+        Vector3 corner((i & 1) ? mesh.m_bounding_max.x : mesh.m_bounding_min.x,
+                       (i & 2) ? mesh.m_bounding_max.y : mesh.m_bounding_min.y,
+                       (i & 4) ? mesh.m_bounding_max.z : mesh.m_bounding_min.z);
+        corner = light_model * corner;
+        box_min.makeFloor(corner);
+        box_max.makeCeil(corner);
+    }
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = extent;
+    if (box_max.x < -1.0f || box_min.x > 1.0f || box_max.y < -1.0f || box_min.y > 1.0f ||
+        box_max.z < 0.0f || box_min.z > 1.0f)
+    {
+        return false;
+    }
 
-    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-    g_p_vulkan_context->_vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-    g_p_vulkan_context->_vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    // 远处级联覆盖范围大，细小物体投影后不足一个texel，阴影贡献可以忽略
+    float texel_scale = 0.5f * float(m_p_render_resource_info->p_shadow_atlas->GetTiles()[tile_index].size);
+    float extent      = std::max(box_max.x - box_min.x, box_max.y - box_min.y) * texel_scale;
+    return extent >= kMinCasterTexels;
+}
 
-    auto &render_submeshes = *m_p_render_resource_info->p_render_submeshes;
+void DirectionalLightShadowPass::drawSubmeshes(VkCommandBuffer command_buffer,
+                                               uint32_t submesh_start_index,
+                                               uint32_t submesh_end_index)
+{
+    const auto &tiles             = m_p_render_resource_info->p_shadow_atlas->GetTiles();
+    const auto &render_submeshes  = *m_p_render_resource_info->p_render_submeshes;
+    const auto &light_projections = m_p_render_resource_info->p_render_light_project_ubo_list->ubo_data_list;
 
+    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    uint32_t model_dynamic_offset = m_p_render_resource_info->p_render_model_buffer->GetDynamicOffset();
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                 pipeline_layout,
+                                                 0,
+                                                 1,
+                                                 &m_dir_shadow_ubo_descriptor_set,
+                                                 1,
+                                                 &model_dynamic_offset);
+
+    uint32_t current_tile_index = UINT32_MAX;
     for (uint32_t i = submesh_start_index; i < submesh_end_index; ++i)
     {
-        const auto submesh     = (*m_p_render_resource_info->p_render_submeshes)[i];
+        const auto &submesh = render_submeshes[i];
+        if (submesh.is_static != (m_caster_type == _shadow_caster_static))
+        {
+            continue;
+        }
         const auto parent_mesh = submesh.parent_mesh.lock();
         if (parent_mesh == nullptr)
         {
             continue;
         }
 
-        VkBuffer     vertex_buffers[] = {parent_mesh->mesh_vertex_position_buffer};
-        VkDeviceSize offsets[]        = {0};
-        g_p_vulkan_context->_vkCmdBindVertexBuffers(command_buffer,
-                                                    0,
-                                                    sizeof(vertex_buffers) / sizeof(vertex_buffers[0]),
-                                                    vertex_buffers,
-                                                    offsets);
-        g_p_vulkan_context->_vkCmdBindIndexBuffer(command_buffer,
-                                                  parent_mesh->mesh_index_buffer,
-                                                  0,
-                                                  VK_INDEX_TYPE_UINT16);
-
-        // bind model and light ubo
-        uint32_t dynamic_offset[2];
-
-        dynamic_offset[0] = m_directional_light_index *
-                            (*m_p_render_resource_info->p_render_light_project_ubo_list).dynamic_alignment;
-
-        dynamic_offset[1] = parent_mesh->m_index_in_dynamic_buffer *
-                            (*m_p_render_resource_info->p_render_model_ubo_list).dynamic_alignment;
-
-        g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
-                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                     pipeline_layout,
-                                                     0,
-                                                     1,
-                                                     &m_dir_shadow_ubo_descriptor_set,
-                                                     2,
-                                                     dynamic_offset);
-        g_p_vulkan_context->_vkCmdDrawIndexed(command_buffer,
-                                              submesh.index_count,
-                                              1,
-                                              submesh.index_offset,
-                                              submesh.vertex_offset,
-                                              0);
+        bool buffers_bound = false;
+        for (uint32_t tile_index: m_tile_indices)
+        {
+            if (tile_index >= light_projections.size() || !isMeshInShadowTile(*parent_mesh, tile_index))
+            {
+                continue;
+            }
+
+            if (!buffers_bound)
+            {
+                VkBuffer     vertex_buffers[] = {parent_mesh->mesh_vertex_position_buffer};
+                VkDeviceSize offsets[]        = {0};
+                g_p_vulkan_context->_vkCmdBindVertexBuffers(command_buffer,
+                                                            0,
+                                                            sizeof(vertex_buffers) / sizeof(vertex_buffers[0]),
+                                                            vertex_buffers,
+                                                            offsets);
+                g_p_vulkan_context->_vkCmdBindIndexBuffer(command_buffer,
+                                                          parent_mesh->mesh_index_buffer,
+                                                          0,
+                                                          parent_mesh->m_index_type);
+                buffers_bound = true;
+            }
+
+            // 切换tile时才更新viewport和light_proj
+            if (tile_index != current_tile_index)
+            {
+                const auto &tile = tiles[tile_index];
+                VkViewport viewport{};
+                viewport.x        = static_cast<float>(tile.x);
+                viewport.y        = static_cast<float>(tile.y);
+                viewport.width    = static_cast<float>(tile.size);
+                viewport.height   = static_cast<float>(tile.size);
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor{};
+                scissor.offset = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)};
+                scissor.extent = {tile.size, tile.size};
+
+                g_p_vulkan_context->_vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+                g_p_vulkan_context->_vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+                g_p_vulkan_context->_vkCmdPushConstants(command_buffer,
+                                                        pipeline_layout,
+                                                        VK_SHADER_STAGE_VERTEX_BIT,
+                                                        offsetof(VulkanShadowDrawPushConstant, light_proj),
+                                                        sizeof(Math::Matrix4x4),
+                                                        &light_projections[tile_index].light_proj);
+                current_tile_index = tile_index;
+            }
+
+            uint32_t model_index = parent_mesh->m_index_in_model_buffer;
+            g_p_vulkan_context->_vkCmdPushConstants(command_buffer,
+                                                    pipeline_layout,
+                                                    VK_SHADER_STAGE_VERTEX_BIT,
+                                                    offsetof(VulkanShadowDrawPushConstant, model_index),
+                                                    sizeof(uint32_t),
+                                                    &model_index);
+            g_p_vulkan_context->_vkCmdDrawIndexed(command_buffer,
+                                                  submesh.shadow_index_count,
+                                                  1,
+                                                  submesh.shadow_index_offset,
+                                                  submesh.vertex_offset,
+                                                  0);
+        }
     }
+}
+
+void DirectionalLightShadowPass::drawSingleThread(VkCommandBuffer &command_buffer,
+                                                  VkCommandBufferInheritanceInfo &inheritance_info,
+                                                  uint32_t submesh_start_index,
+                                                  uint32_t submesh_end_index)
+{
+    VkCommandBufferBeginInfo command_buffer_begin_info{};
+    command_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags            = secondaryCommandBufferUsage();
+    command_buffer_begin_info.pInheritanceInfo = &inheritance_info;
+
+    VK_CHECK_RESULT(g_p_vulkan_context->_vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))
+
+    drawSubmeshes(command_buffer, submesh_start_index, submesh_end_index);
 
     VK_CHECK_RESULT(g_p_vulkan_context->_vkEndCommandBuffer(command_buffer))
 }
@@ -388,74 +453,10 @@ void DirectionalLightShadowPass::draw()
             VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, NULL, "Directional light shadow", {1.0f, 1.0f, 1.0f, 1.0f}};
     g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
 
-    g_p_vulkan_context->_vkCmdBindPipeline(*m_p_render_command_info->p_current_command_buffer,
-                                           VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    drawSubmeshes(*m_p_render_command_info->p_current_command_buffer,
+                  0,
+                  m_p_render_resource_info->p_render_submeshes->size());
 
-    VkExtent2D extent = {static_cast<uint32_t>(m_p_render_resource_info->kDirectionalLightInfo.shadowmap_width),
-                         static_cast<uint32_t>(m_p_render_resource_info->kDirectionalLightInfo.shadowmap_height)};
-    VkViewport viewport{};
-    viewport.x        = 0.0f;
-    viewport.y        = 0.0f;
-    viewport.width    = static_cast<float>(extent.width);
-    viewport.height   = static_cast<float>(extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = extent;
-
-    g_p_vulkan_context->_vkCmdSetViewport(*m_p_render_command_info->p_current_command_buffer, 0, 1, &viewport);
-    g_p_vulkan_context->_vkCmdSetScissor(*m_p_render_command_info->p_current_command_buffer, 0, 1, &scissor);
-
-
-    auto &render_submeshes = *m_p_render_resource_info->p_render_submeshes;
-
-    for (uint32_t i = 0; i < render_submeshes.size(); i++)
-    {
-        const auto submesh     = (*m_p_render_resource_info->p_render_submeshes)[i];
-        const auto parent_mesh = submesh.parent_mesh.lock();
-        if (parent_mesh == nullptr)
-        {
-            continue;
-        }
-
-        VkBuffer     vertex_buffers[] = {parent_mesh->mesh_vertex_position_buffer};
-        VkDeviceSize offsets[]        = {0};
-        g_p_vulkan_context->_vkCmdBindVertexBuffers(*m_p_render_command_info->p_current_command_buffer,
-                                                    0,
-                                                    sizeof(vertex_buffers) / sizeof(vertex_buffers[0]),
-                                                    vertex_buffers,
-                                                    offsets);
-        g_p_vulkan_context->_vkCmdBindIndexBuffer(*m_p_render_command_info->p_current_command_buffer,
-                                                  parent_mesh->mesh_index_buffer,
-                                                  0,
-                                                  VK_INDEX_TYPE_UINT16);
-
-        // bind model and light ubo
-        uint32_t dynamic_offset[2];
-
-        dynamic_offset[0] = m_directional_light_index *
-                            (*m_p_render_resource_info->p_render_light_project_ubo_list).dynamic_alignment;
-
-        dynamic_offset[1] = parent_mesh->m_index_in_dynamic_buffer *
-                            (*m_p_render_resource_info->p_render_model_ubo_list).dynamic_alignment;
-
-        g_p_vulkan_context->_vkCmdBindDescriptorSets(*m_p_render_command_info->p_current_command_buffer,
-                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                     pipeline_layout,
-                                                     0,
-                                                     1,
-                                                     &m_dir_shadow_ubo_descriptor_set,
-                                                     2,
-                                                     dynamic_offset);
-        g_p_vulkan_context->_vkCmdDrawIndexed(*m_p_render_command_info->p_current_command_buffer,
-                                              submesh.index_count,
-                                              1,
-                                              submesh.index_offset,
-                                              submesh.vertex_offset,
-                                              0);
-    }
     g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer);
 }
 
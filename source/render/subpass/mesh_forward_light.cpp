@@ -17,6 +17,7 @@ void MeshForwardLightingPass::initialize(SubPassInitInfo *subPassInitInfo)
     m_p_render_resource_info = mesh_pass_init_info->p_render_resource_info;
     m_subpass_index          = mesh_pass_init_info->subpass_index;
     m_renderpass             = mesh_pass_init_info->renderpass;
+    m_rendering_formats      = mesh_pass_init_info->rendering_formats;
 
     setupPipeLineLayout();
     setupDescriptorSet();
@@ -29,7 +30,7 @@ void MeshForwardLightingPass::setupPipeLineLayout()
     auto &ubo_data_layout = m_descriptor_set_layouts[_mesh_pass_ubo_data_layout];
 
     std::vector<VkDescriptorSetLayoutBinding> ubo_layout_bindings;
-    ubo_layout_bindings.resize(4);
+    ubo_layout_bindings.resize(7);
 
     VkDescriptorSetLayoutBinding &perframe_buffer_binding = ubo_layout_bindings[0];
 
@@ -40,7 +41,7 @@ void MeshForwardLightingPass::setupPipeLineLayout()
 
     VkDescriptorSetLayoutBinding &perobject_buffer_binding = ubo_layout_bindings[1];
 
-    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     perobject_buffer_binding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
     perobject_buffer_binding.binding         = 1;
     perobject_buffer_binding.descriptorCount = 1;
@@ -59,6 +60,17 @@ void MeshForwardLightingPass::setupPipeLineLayout()
     direction_light_projection_binding.binding         = 3;
     direction_light_projection_binding.descriptorCount = 1;
 
+    // 分簇光照：光源列表、每个cluster的光源数量和光源索引
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        VkDescriptorSetLayoutBinding &local_light_binding = ubo_layout_bindings[4 + i];
+
+        local_light_binding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        local_light_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+        local_light_binding.binding         = 4 + i;
+        local_light_binding.descriptorCount = 1;
+    }
+
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
     descriptorSetLayoutCreateInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorSetLayoutCreateInfo.flags        = 0;
@@ -97,7 +109,7 @@ void MeshForwardLightingPass::setupPipeLineLayout()
     auto &directional_light_data_layout = m_descriptor_set_layouts[_mesh_pass_directional_light_shadow_layout];
 
     std::vector<VkDescriptorSetLayoutBinding> directional_light_layout_bindings;
-    directional_light_layout_bindings.resize(1);
+    directional_light_layout_bindings.resize(2);
 
     VkDescriptorSetLayoutBinding &directional_light_binding = directional_light_layout_bindings[0];
     directional_light_binding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -105,6 +117,12 @@ void MeshForwardLightingPass::setupPipeLineLayout()
     directional_light_binding.binding         = 0;
     directional_light_binding.descriptorCount = 1;
 
+    VkDescriptorSetLayoutBinding &point_light_shadow_binding = directional_light_layout_bindings[1];
+    point_light_shadow_binding.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    point_light_shadow_binding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+    point_light_shadow_binding.binding         = 1;
+    point_light_shadow_binding.descriptorCount = 1;
+
     VkDescriptorSetLayoutCreateInfo directional_light_descriptorSetLayoutCreateInfo;
     directional_light_descriptorSetLayoutCreateInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     directional_light_descriptorSetLayoutCreateInfo.flags        = 0;
@@ -141,7 +159,7 @@ void MeshForwardLightingPass::setupDescriptorSet()
 void MeshForwardLightingPass::updateGlobalRenderDescriptorSet()
 {
     std::vector<VkWriteDescriptorSet> write_descriptor_sets;
-    write_descriptor_sets.resize(4);
+    write_descriptor_sets.resize(7);
 
     VkWriteDescriptorSet &perframe_buffer_write = write_descriptor_sets[0];
     perframe_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -158,9 +176,9 @@ void MeshForwardLightingPass::updateGlobalRenderDescriptorSet()
     perobject_buffer_write.dstSet          = m_mesh_ubo_descriptor_set;
     perobject_buffer_write.dstBinding      = 1;
     perobject_buffer_write.dstArrayElement = 0;
-    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     perobject_buffer_write.descriptorCount = 1;
-    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_ubo_list->dynamic_info;
+    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_buffer->buffer_info;
 
     VkWriteDescriptorSet &direction_buffer_write = write_descriptor_sets[2];
     direction_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -182,6 +200,23 @@ void MeshForwardLightingPass::updateGlobalRenderDescriptorSet()
     directional_light_probes_buffer_write.pBufferInfo     = &m_p_render_resource_info->
             p_render_light_project_ubo_list->static_info;
 
+    auto                   *light_cluster_culling       = m_p_render_resource_info->p_light_cluster_culling;
+    VkDescriptorBufferInfo *local_light_buffer_infos[3] = {&light_cluster_culling->light_buffer_info,
+                                                           &light_cluster_culling->cluster_count_buffer_info,
+                                                           &light_cluster_culling->cluster_index_buffer_info};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        VkWriteDescriptorSet &local_light_buffer_write = write_descriptor_sets[4 + i];
+        local_light_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        local_light_buffer_write.pNext           = nullptr;
+        local_light_buffer_write.dstSet          = m_mesh_ubo_descriptor_set;
+        local_light_buffer_write.dstBinding      = 4 + i;
+        local_light_buffer_write.dstArrayElement = 0;
+        local_light_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        local_light_buffer_write.descriptorCount = 1;
+        local_light_buffer_write.pBufferInfo     = local_light_buffer_infos[i];
+    }
+
     vkUpdateDescriptorSets(g_p_vulkan_context->_device,
                            write_descriptor_sets.size(),
                            write_descriptor_sets.data(),
@@ -199,10 +234,15 @@ void MeshForwardLightingPass::setupPipelines()
         descriptorset_layouts.push_back(layout);
     }
 
+    VkPushConstantRange draw_push_constant_range{};
+    draw_push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    draw_push_constant_range.offset     = 0;
+    draw_push_constant_range.size       = sizeof(VulkanDrawPushConstant);
+
     VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
     pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.pushConstantRangeCount = 0;
-    pipeline_layout_create_info.pPushConstantRanges    = nullptr;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges    = &draw_push_constant_range;
     pipeline_layout_create_info.setLayoutCount         = descriptorset_layouts.size();
     pipeline_layout_create_info.pSetLayouts            = descriptorset_layouts.data();
 
@@ -328,10 +368,9 @@ void MeshForwardLightingPass::setupPipelines()
     pipelineInfo.pColorBlendState    = &color_blend_state_create_info;
     pipelineInfo.pDepthStencilState  = &depth_stencil_create_info;
     pipelineInfo.layout              = pipeline_layout;
-    pipelineInfo.renderPass          = m_renderpass;
-    pipelineInfo.subpass             = m_subpass_index;
     pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE;
     pipelineInfo.pDynamicState       = &dynamic_state_create_info;
+    setupPipelineRenderingTarget(pipelineInfo);
 
     if (vkCreateGraphicsPipelines(g_p_vulkan_context->_device,
                                   VK_NULL_HANDLE,
@@ -344,12 +383,52 @@ void MeshForwardLightingPass::setupPipelines()
         throw std::runtime_error("create " + name + " graphics m_pipeline");
     }
 
+    // 深度预渲染之后只有最近的表面能通过测试
+    depth_stencil_create_info.depthWriteEnable = VK_FALSE;
+    depth_stencil_create_info.depthCompareOp   = VK_COMPARE_OP_EQUAL;
+
+    if (vkCreateGraphicsPipelines(g_p_vulkan_context->_device,
+                                  VK_NULL_HANDLE,
+                                  1,
+                                  &pipelineInfo,
+                                  nullptr,
+                                  &m_depth_equal_pipeline) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("create " + name + " depth equal graphics m_pipeline");
+    }
+
     for (auto &shader_module: shader_modules)
     {
         vkDestroyShaderModule(g_p_vulkan_context->_device, shader_module.second, nullptr);
     }
 }
 
+void MeshForwardLightingPass::bindGlobalDescriptorSets(VkCommandBuffer command_buffer)
+{
+    uint32_t model_dynamic_offset = m_p_render_resource_info->p_render_model_buffer->GetDynamicOffset();
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                 pipeline_layout,
+                                                 0,
+                                                 1,
+                                                 &m_mesh_ubo_descriptor_set,
+                                                 1,
+                                                 &model_dynamic_offset);
+    //bind directional light shadow map
+    if (m_p_render_resource_info->p_directional_light_shadow_map_descriptor_set != nullptr)
+    {
+        g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                     pipeline_layout,
+                                                     2,
+                                                     1,
+                                                     m_p_render_resource_info->p_directional_light_shadow_map_descriptor_set,
+                                                     0,
+                                                     nullptr);
+    }
+}
+
 void MeshForwardLightingPass::drawSingleThread(VkCommandBuffer &command_buffer,
                                        VkCommandBufferInheritanceInfo &inheritance_info,
                                        uint32_t submesh_start_index,
@@ -357,14 +436,15 @@ void MeshForwardLightingPass::drawSingleThread(VkCommandBuffer &command_buffer,
 {
     VkCommandBufferBeginInfo command_buffer_begin_info{};
     command_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    command_buffer_begin_info.flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    command_buffer_begin_info.flags            = secondaryCommandBufferUsage();
     command_buffer_begin_info.pInheritanceInfo = &inheritance_info;
 
     VK_CHECK_RESULT(g_p_vulkan_context->_vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))
 
-    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, currentPipeline());
     g_p_vulkan_context->_vkCmdSetViewport(command_buffer, 0, 1, m_p_render_command_info->p_viewport);
     g_p_vulkan_context->_vkCmdSetScissor(command_buffer, 0, 1, m_p_render_command_info->p_scissor);
+    bindGlobalDescriptorSets(command_buffer);
 
     auto &render_texture_desc_sets = *m_p_render_resource_info->p_texture_descriptor_sets;
 
@@ -401,38 +481,19 @@ void MeshForwardLightingPass::drawSingleThread(VkCommandBuffer &command_buffer,
         g_p_vulkan_context->_vkCmdBindIndexBuffer(command_buffer,
                                                   parent_mesh->mesh_index_buffer,
                                                   0,
-                                                  VK_INDEX_TYPE_UINT16);
-
-        // bind model ubo
-        uint32_t dynamicOffset = parent_mesh->m_index_in_dynamic_buffer *
-                                 (*m_p_render_resource_info->p_render_model_ubo_list).dynamic_alignment;
-        g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
-                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                     pipeline_layout,
-                                                     0,
-                                                     1,
-                                                     &m_mesh_ubo_descriptor_set,
-                                                     1,
-                                                     &dynamicOffset);
-        //bind directional light shadow map
-        if (m_p_render_resource_info->p_directional_light_shadow_map_descriptor_set != nullptr)
-        {
-            g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
-                                                         VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                         pipeline_layout,
-                                                         2,
-                                                         1,
-                                                         m_p_render_resource_info->p_directional_light_shadow_map_descriptor_set,
-                                                         0,
-                                                         NULL);
-        }
-
-        g_p_vulkan_context->_vkCmdDrawIndexed(command_buffer,
-                                              submesh.index_count,
-                                              1,
-                                              submesh.index_offset,
-                                              submesh.vertex_offset,
-                                              0);
+                                                  parent_mesh->m_index_type);
+
+        // 物体数据在storage buffer中，每次draw只更新序号
+        VulkanDrawPushConstant push_constant{parent_mesh->m_index_in_model_buffer};
+        g_p_vulkan_context->_vkCmdPushConstants(command_buffer,
+                                                pipeline_layout,
+                                                VK_SHADER_STAGE_VERTEX_BIT,
+                                                0,
+                                                sizeof(VulkanDrawPushConstant),
+                                                &push_constant);
+
+        // 有meshlet的submesh按剔除结果间接绘制
+        m_p_render_resource_info->p_meshlet_culling->DrawSubmesh(command_buffer, submesh);
     }
     VK_CHECK_RESULT(g_p_vulkan_context->_vkEndCommandBuffer(command_buffer))
 }
@@ -475,11 +536,12 @@ void MeshForwardLightingPass::draw()
     g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer, &label_info);
 
     g_p_vulkan_context->_vkCmdBindPipeline(*m_p_render_command_info->p_current_command_buffer,
-                                           VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+                                           VK_PIPELINE_BIND_POINT_GRAPHICS, currentPipeline());
     g_p_vulkan_context->_vkCmdSetViewport(*m_p_render_command_info->p_current_command_buffer, 0, 1,
                                           m_p_render_command_info->p_viewport);
     g_p_vulkan_context->_vkCmdSetScissor(*m_p_render_command_info->p_current_command_buffer, 0, 1,
                                          m_p_render_command_info->p_scissor);
+    bindGlobalDescriptorSets(*m_p_render_command_info->p_current_command_buffer);
 
     auto &render_submeshes         = *m_p_render_resource_info->p_render_submeshes;
     auto &render_texture_desc_sets = *m_p_render_resource_info->p_texture_descriptor_sets;
@@ -517,38 +579,19 @@ void MeshForwardLightingPass::draw()
         g_p_vulkan_context->_vkCmdBindIndexBuffer(*m_p_render_command_info->p_current_command_buffer,
                                                   parent_mesh->mesh_index_buffer,
                                                   0,
-                                                  VK_INDEX_TYPE_UINT16);
-
-        // bind model ubo
-        uint32_t dynamicOffset = parent_mesh->m_index_in_dynamic_buffer *
-                                 (*m_p_render_resource_info->p_render_model_ubo_list).dynamic_alignment;
-        g_p_vulkan_context->_vkCmdBindDescriptorSets(*m_p_render_command_info->p_current_command_buffer,
-                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                     pipeline_layout,
-                                                     0,
-                                                     1,
-                                                     &m_mesh_ubo_descriptor_set,
-                                                     1,
-                                                     &dynamicOffset);
-        //bind directional light shadow map
-        if (m_p_render_resource_info->p_directional_light_shadow_map_descriptor_set != nullptr)
-        {
-            g_p_vulkan_context->_vkCmdBindDescriptorSets(*m_p_render_command_info->p_current_command_buffer,
-                                                         VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                         pipeline_layout,
-                                                         2,
-                                                         1,
-                                                         m_p_render_resource_info->p_directional_light_shadow_map_descriptor_set,
-                                                         0,
-                                                         NULL);
-        }
-
-        g_p_vulkan_context->_vkCmdDrawIndexed(*m_p_render_command_info->p_current_command_buffer,
-                                              submesh.index_count,
-                                              1,
-                                              submesh.index_offset,
-                                              submesh.vertex_offset,
-                                              0);
+                                                  parent_mesh->m_index_type);
+
+        // 物体数据在storage buffer中，每次draw只更新序号
+        VulkanDrawPushConstant push_constant{parent_mesh->m_index_in_model_buffer};
+        g_p_vulkan_context->_vkCmdPushConstants(*m_p_render_command_info->p_current_command_buffer,
+                                                pipeline_layout,
+                                                VK_SHADER_STAGE_VERTEX_BIT,
+                                                0,
+                                                sizeof(VulkanDrawPushConstant),
+                                                &push_constant);
+
+        // 有meshlet的submesh按剔除结果间接绘制
+        m_p_render_resource_info->p_meshlet_culling->DrawSubmesh(*m_p_render_command_info->p_current_command_buffer, submesh);
     }
     g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(*m_p_render_command_info->p_current_command_buffer);
 }
@@ -40,7 +40,7 @@ void MeshGBufferPass::setupPipeLineLayout()
 
     VkDescriptorSetLayoutBinding &perobject_buffer_binding = ubo_layout_bindings[1];
 
-    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     perobject_buffer_binding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
     perobject_buffer_binding.binding         = 1;
     perobject_buffer_binding.descriptorCount = 1;
@@ -121,9 +121,9 @@ void MeshGBufferPass::updateGlobalRenderDescriptorSet()
     perobject_buffer_write.dstSet          = m_mesh_ubo_descriptor_set;
     perobject_buffer_write.dstBinding      = 1;
     perobject_buffer_write.dstArrayElement = 0;
-    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     perobject_buffer_write.descriptorCount = 1;
-    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_ubo_list->dynamic_info;
+    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_buffer->buffer_info;
 
     vkUpdateDescriptorSets(g_p_vulkan_context->_device,
                            write_descriptor_sets.size(),
@@ -141,10 +141,15 @@ void MeshGBufferPass::setupPipelines()
         descriptorset_layouts.push_back(layout);
     }
 
+    VkPushConstantRange draw_push_constant_range{};
+    draw_push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    draw_push_constant_range.offset     = 0;
+    draw_push_constant_range.size       = sizeof(VulkanDrawPushConstant);
+
     VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
     pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.pushConstantRangeCount = 0;
-    pipeline_layout_create_info.pPushConstantRanges    = nullptr;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges    = &draw_push_constant_range;
     pipeline_layout_create_info.setLayoutCount         = descriptorset_layouts.size();
     pipeline_layout_create_info.pSetLayouts            = descriptorset_layouts.data();
 
@@ -220,7 +225,7 @@ void MeshGBufferPass::setupPipelines()
     multisample_state_create_info.sampleShadingEnable  = VK_FALSE;
     multisample_state_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-    VkPipelineColorBlendAttachmentState color_blend_attachments[3] = {};
+    VkPipelineColorBlendAttachmentState color_blend_attachments[2] = {};
     color_blend_attachments[0].colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
     color_blend_attachments[0].blendEnable         = VK_FALSE;
@@ -232,7 +237,6 @@ void MeshGBufferPass::setupPipelines()
     color_blend_attachments[0].alphaBlendOp        = VK_BLEND_OP_ADD;
 
     color_blend_attachments[1] = color_blend_attachments[0];
-    color_blend_attachments[2] = color_blend_attachments[0];
 
     VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {};
     color_blend_state_create_info.sType         = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -302,7 +306,7 @@ void MeshGBufferPass::drawSingleThread(VkCommandBuffer &command_buffer,
 {
     VkCommandBufferBeginInfo command_buffer_begin_info{};
     command_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    command_buffer_begin_info.flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    command_buffer_begin_info.flags            = secondaryCommandBufferUsage();
     command_buffer_begin_info.pInheritanceInfo = &inheritance_info;
 
     VK_CHECK_RESULT(g_p_vulkan_context->_vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))
@@ -310,6 +314,15 @@ void MeshGBufferPass::drawSingleThread(VkCommandBuffer &command_buffer,
     g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
     g_p_vulkan_context->_vkCmdSetViewport(command_buffer, 0, 1, m_p_render_command_info->p_viewport);
     g_p_vulkan_context->_vkCmdSetScissor(command_buffer, 0, 1, m_p_render_command_info->p_scissor);
+    uint32_t model_dynamic_offset = m_p_render_resource_info->p_render_model_buffer->GetDynamicOffset();
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                 pipeline_layout,
+                                                 0,
+                                                 1,
+                                                 &m_mesh_ubo_descriptor_set,
+                                                 1,
+                                                 &model_dynamic_offset);
 
     auto &render_texture_desc_sets = *m_p_render_resource_info->p_texture_descriptor_sets;
 
@@ -346,26 +359,19 @@ void MeshGBufferPass::drawSingleThread(VkCommandBuffer &command_buffer,
         g_p_vulkan_context->_vkCmdBindIndexBuffer(command_buffer,
                                                   parent_mesh->mesh_index_buffer,
                                                   0,
-                                                  VK_INDEX_TYPE_UINT16);
-
-        // bind model ubo
-        uint32_t dynamicOffset = parent_mesh->m_index_in_dynamic_buffer *
-                                 (*m_p_render_resource_info->p_render_model_ubo_list).dynamic_alignment;
-        g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
-                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                     pipeline_layout,
-                                                     0,
-                                                     1,
-                                                     &m_mesh_ubo_descriptor_set,
-                                                     1,
-                                                     &dynamicOffset);
-
-        g_p_vulkan_context->_vkCmdDrawIndexed(command_buffer,
-                                              submesh.index_count,
-                                              1,
-                                              submesh.index_offset,
-                                              submesh.vertex_offset,
-                                              0);
+                                                  parent_mesh->m_index_type);
+
+        // 物体数据在storage buffer中，每次draw只更新序号
+        VulkanDrawPushConstant push_constant{parent_mesh->m_index_in_model_buffer};
+        g_p_vulkan_context->_vkCmdPushConstants(command_buffer,
+                                                pipeline_layout,
+                                                VK_SHADER_STAGE_VERTEX_BIT,
+                                                0,
+                                                sizeof(VulkanDrawPushConstant),
+                                                &push_constant);
+
+        // 有meshlet的submesh按剔除结果间接绘制
+        m_p_render_resource_info->p_meshlet_culling->DrawSubmesh(command_buffer, submesh);
     }
 
     VK_CHECK_RESULT(g_p_vulkan_context->_vkEndCommandBuffer(command_buffer))
@@ -416,6 +422,15 @@ void MeshGBufferPass::draw()
                                           m_p_render_command_info->p_viewport);
     g_p_vulkan_context->_vkCmdSetScissor(*m_p_render_command_info->p_current_command_buffer, 0, 1,
                                          m_p_render_command_info->p_scissor);
+    uint32_t model_dynamic_offset = m_p_render_resource_info->p_render_model_buffer->GetDynamicOffset();
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(*m_p_render_command_info->p_current_command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                 pipeline_layout,
+                                                 0,
+                                                 1,
+                                                 &m_mesh_ubo_descriptor_set,
+                                                 1,
+                                                 &model_dynamic_offset);
 
     auto &render_submeshes         = *m_p_render_resource_info->p_render_submeshes;
     auto &render_texture_desc_sets = *m_p_render_resource_info->p_texture_descriptor_sets;
@@ -453,26 +468,19 @@ void MeshGBufferPass::draw()
         g_p_vulkan_context->_vkCmdBindIndexBuffer(*m_p_render_command_info->p_current_command_buffer,
                                                   parent_mesh->mesh_index_buffer,
                                                   0,
-                                                  VK_INDEX_TYPE_UINT16);
-
-        // bind model ubo
-        uint32_t dynamicOffset = parent_mesh->m_index_in_dynamic_buffer *
-                                 (*m_p_render_resource_info->p_render_model_ubo_list).dynamic_alignment;
-        g_p_vulkan_context->_vkCmdBindDescriptorSets(*m_p_render_command_info->p_current_command_buffer,
-                                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                                     pipeline_layout,
-                                                     0,
-                                                     1,
-                                                     &m_mesh_ubo_descriptor_set,
-                                                     1,
-                                                     &dynamicOffset);
-
-        g_p_vulkan_context->_vkCmdDrawIndexed(*m_p_render_command_info->p_current_command_buffer,
-                                              submesh.index_count,
-                                              1,
-                                              submesh.index_offset,
-                                              submesh.vertex_offset,
-                                              0);
+                                                  parent_mesh->m_index_type);
+
+        // 物体数据在storage buffer中，每次draw只更新序号
+        VulkanDrawPushConstant push_constant{parent_mesh->m_index_in_model_buffer};
+        g_p_vulkan_context->_vkCmdPushConstants(*m_p_render_command_info->p_current_command_buffer,
+                                                pipeline_layout,
+                                                VK_SHADER_STAGE_VERTEX_BIT,
+                                                0,
+                                                sizeof(VulkanDrawPushConstant),
+                                                &push_constant);
+
+        // 有meshlet的submesh按剔除结果间接绘制
+        m_p_render_resource_info->p_meshlet_culling->DrawSubmesh(*m_p_render_command_info->p_current_command_buffer, submesh);
     }
 }
 
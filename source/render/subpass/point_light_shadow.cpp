@@ -0,0 +1,376 @@
+//
+// Created by kyrosz7u on 2023/7/20.
+//
+
+#include "render/subpass/point_light_shadow.h"
+#include "render/resource/render_mesh.h"
+#include "core/logger/logger_macros.h"
+#include <cfloat>
+#include <algorithm>
+
+using namespace VulkanAPI;
+using namespace RenderSystem;
+using namespace RenderSystem::SubPass;
+
+void PointLightShadowPass::initialize(SubPassInitInfo *subPassInitInfo)
+{
+    auto point_shadow_pass_init_info = static_cast<PointLightShadowPassInitInfo *>(subPassInitInfo);
+    m_p_render_command_info  = point_shadow_pass_init_info->p_render_command_info;
+    m_p_render_resource_info = point_shadow_pass_init_info->p_render_resource_info;
+    m_subpass_index          = point_shadow_pass_init_info->subpass_index;
+    m_renderpass             = point_shadow_pass_init_info->renderpass;
+
+    setupPipeLineLayout();
+    setupDescriptorSet();
+    updateGlobalRenderDescriptorSet();
+    setupPipelines();
+}
+
+void PointLightShadowPass::setupPipeLineLayout()
+{
+    auto &ubo_data_layout = m_descriptor_set_layouts[_point_shadow_layout];
+
+    std::vector<VkDescriptorSetLayoutBinding> ubo_layout_bindings;
+    ubo_layout_bindings.resize(2);
+
+    VkDescriptorSetLayoutBinding &perlight_buffer_binding = ubo_layout_bindings[0];
+
+    perlight_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perlight_buffer_binding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    perlight_buffer_binding.binding         = 0;
+    perlight_buffer_binding.descriptorCount = 1;
+
+    VkDescriptorSetLayoutBinding &perobject_buffer_binding = ubo_layout_bindings[1];
+
+    perobject_buffer_binding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    perobject_buffer_binding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+    perobject_buffer_binding.binding         = 1;
+    perobject_buffer_binding.descriptorCount = 1;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.flags        = 0;
+    descriptorSetLayoutCreateInfo.pNext        = nullptr;
+    descriptorSetLayoutCreateInfo.bindingCount = ubo_layout_bindings.size();
+    descriptorSetLayoutCreateInfo.pBindings    = ubo_layout_bindings.data();
+
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(g_p_vulkan_context->_device,
+                                                &descriptorSetLayoutCreateInfo,
+                                                nullptr,
+                                                &ubo_data_layout))
+}
+
+void PointLightShadowPass::setupDescriptorSet()
+{
+    VkDescriptorSetAllocateInfo allocInfo{};
+
+    allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool     = *m_p_render_command_info->p_descriptor_pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts        = &m_descriptor_set_layouts[_point_shadow_layout];
+
+    if (vkAllocateDescriptorSets(g_p_vulkan_context->_device,
+                                 &allocInfo,
+                                 &m_point_shadow_ubo_descriptor_set) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate info sets!");
+    }
+}
+
+void PointLightShadowPass::updateGlobalRenderDescriptorSet()
+{
+    std::vector<VkWriteDescriptorSet> write_descriptor_sets;
+    write_descriptor_sets.resize(2);
+
+    VkWriteDescriptorSet &perlight_buffer_write = write_descriptor_sets[0];
+    perlight_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    perlight_buffer_write.dstSet          = m_point_shadow_ubo_descriptor_set;
+    perlight_buffer_write.dstBinding      = 0;
+    perlight_buffer_write.dstArrayElement = 0;
+    perlight_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    perlight_buffer_write.descriptorCount = 1;
+    perlight_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_point_light_shadow_ubo_list->dynamic_info;
+
+    VkWriteDescriptorSet &perobject_buffer_write = write_descriptor_sets[1];
+    perobject_buffer_write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    perobject_buffer_write.dstSet          = m_point_shadow_ubo_descriptor_set;
+    perobject_buffer_write.dstBinding      = 1;
+    perobject_buffer_write.dstArrayElement = 0;
+    perobject_buffer_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    perobject_buffer_write.descriptorCount = 1;
+    perobject_buffer_write.pBufferInfo     = &m_p_render_resource_info->p_render_model_buffer->buffer_info;
+
+    vkUpdateDescriptorSets(g_p_vulkan_context->_device,
+                           write_descriptor_sets.size(),
+                           write_descriptor_sets.data(),
+                           0,
+                           nullptr);
+}
+
+void PointLightShadowPass::setupPipelines()
+{
+    std::vector<VkDescriptorSetLayout> descriptorset_layouts;
+
+    for (auto &layout: m_descriptor_set_layouts)
+    {
+        descriptorset_layouts.push_back(layout);
+    }
+
+    VkPushConstantRange draw_push_constant_range{};
+    draw_push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    draw_push_constant_range.offset     = 0;
+    draw_push_constant_range.size       = sizeof(VulkanDrawPushConstant);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+    pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges    = &draw_push_constant_range;
+    pipeline_layout_create_info.setLayoutCount         = descriptorset_layouts.size();
+    pipeline_layout_create_info.pSetLayouts            = descriptorset_layouts.data();
+
+    if (vkCreatePipelineLayout(g_p_vulkan_context->_device,
+                               &pipeline_layout_create_info,
+                               nullptr,
+                               &pipeline_layout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("create " + name + " m_pipeline layout");
+    }
+
+    std::map<int, VkShaderModule> shader_modules;
+
+    for (int i = 0; i < m_shader_list.size(); i++)
+    {
+        auto &shader = m_shader_list[i];
+        if (shader.size() == 0)
+        { continue; }
+
+        shader_modules[i] = VulkanUtil::createShaderModule(g_p_vulkan_context->_device, shader);
+    }
+
+    std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos;
+
+    for (auto &shader_module: shader_modules)
+    {
+        VkPipelineShaderStageCreateInfo shader_stage_create_info{};
+        shader_stage_create_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shader_stage_create_info.stage  = static_cast<VkShaderStageFlagBits>(VK_SHADER_STAGE_VERTEX_BIT
+                << shader_module.first);
+        shader_stage_create_info.module = shader_module.second;
+        shader_stage_create_info.pName  = "main";
+        shader_stage_create_infos.push_back(shader_stage_create_info);
+    }
+
+    auto vertex_input_binding_description   = VulkanMeshVertex::getLightVertexInputBindingDescription();
+    auto vertex_input_attribute_description = VulkanMeshVertex::getLightVertexInputAttributeDescription();
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info{};
+    vertex_input_state_create_info.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_state_create_info.vertexBindingDescriptionCount   = vertex_input_binding_description.size();
+    vertex_input_state_create_info.pVertexBindingDescriptions      = vertex_input_binding_description.data();
+    vertex_input_state_create_info.vertexAttributeDescriptionCount = vertex_input_attribute_description.size();
+    vertex_input_state_create_info.pVertexAttributeDescriptions    = vertex_input_attribute_description.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info{};
+    input_assembly_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly_create_info.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_create_info.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewport_state_create_info{};
+    viewport_state_create_info.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state_create_info.viewportCount = 1;
+    viewport_state_create_info.pViewports    = m_p_render_command_info->p_viewport;
+    viewport_state_create_info.scissorCount  = 1;
+    viewport_state_create_info.pScissors     = m_p_render_command_info->p_scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterization_state_create_info{};
+    rasterization_state_create_info.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization_state_create_info.depthClampEnable        = VK_FALSE;
+    rasterization_state_create_info.rasterizerDiscardEnable = VK_FALSE;
+    rasterization_state_create_info.polygonMode             = VK_POLYGON_MODE_FILL;
+    rasterization_state_create_info.lineWidth               = 1.0f;
+    rasterization_state_create_info.cullMode                = VK_CULL_MODE_NONE;
+    rasterization_state_create_info.frontFace               = VK_FRONT_FACE_CLOCKWISE;
+    rasterization_state_create_info.depthBiasEnable         = VK_FALSE;
+    rasterization_state_create_info.depthBiasConstantFactor = 0.0f;
+    rasterization_state_create_info.depthBiasClamp          = 0.0f;
+    rasterization_state_create_info.depthBiasSlopeFactor    = 0.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample_state_create_info{};
+    multisample_state_create_info.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample_state_create_info.sampleShadingEnable  = VK_FALSE;
+    multisample_state_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // 只写深度，没有颜色附件
+    VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {};
+    color_blend_state_create_info.sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend_state_create_info.logicOpEnable   = VK_FALSE;
+    color_blend_state_create_info.logicOp         = VK_LOGIC_OP_COPY;
+    color_blend_state_create_info.attachmentCount = 0;
+    color_blend_state_create_info.pAttachments    = nullptr;
+    color_blend_state_create_info.blendConstants[0] = 0.0f;
+    color_blend_state_create_info.blendConstants[1] = 0.0f;
+    color_blend_state_create_info.blendConstants[2] = 0.0f;
+    color_blend_state_create_info.blendConstants[3] = 0.0f;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info{};
+    depth_stencil_create_info.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_create_info.depthTestEnable       = VK_TRUE;
+    depth_stencil_create_info.depthWriteEnable      = VK_TRUE;
+    depth_stencil_create_info.depthCompareOp        = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depth_stencil_create_info.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil_create_info.stencilTestEnable     = VK_FALSE;
+
+    VkDynamicState                   dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state_create_info{};
+    dynamic_state_create_info.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state_create_info.dynamicStateCount = 2;
+    dynamic_state_create_info.pDynamicStates    = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType      = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = shader_stage_create_infos.size();
+    pipelineInfo.pStages    = shader_stage_create_infos.data();
+
+    pipelineInfo.pVertexInputState   = &vertex_input_state_create_info;
+    pipelineInfo.pInputAssemblyState = &input_assembly_create_info;
+    pipelineInfo.pViewportState      = &viewport_state_create_info;
+    pipelineInfo.pRasterizationState = &rasterization_state_create_info;
+    pipelineInfo.pMultisampleState   = &multisample_state_create_info;
+    pipelineInfo.pColorBlendState    = &color_blend_state_create_info;
+    pipelineInfo.pDepthStencilState  = &depth_stencil_create_info;
+    pipelineInfo.layout              = pipeline_layout;
+    pipelineInfo.renderPass          = m_renderpass;
+    pipelineInfo.subpass             = m_subpass_index;
+    pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE;
+    pipelineInfo.pDynamicState       = &dynamic_state_create_info;
+
+    if (vkCreateGraphicsPipelines(g_p_vulkan_context->_device,
+                                  VK_NULL_HANDLE,
+                                  1,
+                                  &pipelineInfo,
+                                  nullptr,
+                                  &m_pipeline) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("create " + name + " graphics m_pipeline");
+    }
+
+    for (auto &shader_module: shader_modules)
+    {
+        vkDestroyShaderModule(g_p_vulkan_context->_device, shader_module.second, nullptr);
+    }
+}
+
+bool PointLightShadowPass::isMeshInLightRange(const RenderMesh &mesh) const
+{
+    const auto &shadow_projections = m_p_render_resource_info->p_render_point_light_shadow_ubo_list->ubo_data_list;
+    const auto &models             = m_p_render_resource_info->p_render_model_buffer->data_list;
+    if (m_shadow_index >= shadow_projections.size() || mesh.m_index_in_model_buffer >= models.size())
+    {
+        return true;
+    }
+
+    const Matrix4x4 &model = models[mesh.m_index_in_model_buffer].model;
+    Vector3         box_min(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vector3         box_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < 8; ++i)
+    {
+        Vector3 corner((i & 1) ? mesh.m_bounding_max.x : mesh.m_bounding_min.x,
+                       (i & 2) ? mesh.m_bounding_max.y : mesh.m_bounding_min.y,
+                       (i & 4) ? mesh.m_bounding_max.z : mesh.m_bounding_min.z);
+        corner = model * corner;
+        box_min.makeFloor(corner);
+        box_max.makeCeil(corner);
+    }
+
+    // 世界空间包围盒上离光源最近的点
+    const auto &shadow = shadow_projections[m_shadow_index];
+    Vector3    closest(std::clamp(shadow.position.x, box_min.x, box_max.x),
+                       std::clamp(shadow.position.y, box_min.y, box_max.y),
+                       std::clamp(shadow.position.z, box_min.z, box_max.z));
+    return closest.squaredDistance(shadow.position) <= shadow.radius * shadow.radius;
+}
+
+void PointLightShadowPass::draw()
+{
+    VkCommandBuffer command_buffer    = *m_p_render_command_info->p_current_command_buffer;
+    const auto      &render_submeshes = *m_p_render_resource_info->p_render_submeshes;
+
+    VkDebugUtilsLabelEXT label_info = {
+            VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, NULL, "Point light shadow", {1.0f, 1.0f, 1.0f, 1.0f}};
+    g_p_vulkan_context->_vkCmdBeginDebugUtilsLabelEXT(command_buffer, &label_info);
+
+    g_p_vulkan_context->_vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+
+    // 六个面尺寸相同，viewport对所有视图生效
+    uint32_t   shadowmap_size = m_p_render_resource_info->kPointLightShadowInfo.shadowmap_size;
+    VkViewport viewport{};
+    viewport.x        = 0.0f;
+    viewport.y        = 0.0f;
+    viewport.width    = static_cast<float>(shadowmap_size);
+    viewport.height   = static_cast<float>(shadowmap_size);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = {shadowmap_size, shadowmap_size};
+
+    g_p_vulkan_context->_vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    g_p_vulkan_context->_vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    // 整个pass只画一个光源，光源ubo的偏移不变；dynamic offset按binding顺序排列
+    uint32_t dynamic_offsets[] = {
+            uint32_t(m_shadow_index * (*m_p_render_resource_info->p_render_point_light_shadow_ubo_list).dynamic_alignment),
+            m_p_render_resource_info->p_render_model_buffer->GetDynamicOffset()};
+    g_p_vulkan_context->_vkCmdBindDescriptorSets(command_buffer,
+                                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                                 pipeline_layout,
+                                                 0,
+                                                 1,
+                                                 &m_point_shadow_ubo_descriptor_set,
+                                                 2,
+                                                 dynamic_offsets);
+
+    for (const auto &submesh: render_submeshes)
+    {
+        const auto parent_mesh = submesh.parent_mesh.lock();
+        if (parent_mesh == nullptr || !isMeshInLightRange(*parent_mesh))
+        {
+            continue;
+        }
+
+        VkBuffer     vertex_buffers[] = {parent_mesh->mesh_vertex_position_buffer};
+        VkDeviceSize offsets[]        = {0};
+        g_p_vulkan_context->_vkCmdBindVertexBuffers(command_buffer,
+                                                    0,
+                                                    sizeof(vertex_buffers) / sizeof(vertex_buffers[0]),
+                                                    vertex_buffers,
+                                                    offsets);
+        g_p_vulkan_context->_vkCmdBindIndexBuffer(command_buffer,
+                                                  parent_mesh->mesh_index_buffer,
+                                                  0,
+                                                  parent_mesh->m_index_type);
+
+        VulkanDrawPushConstant push_constant{parent_mesh->m_index_in_model_buffer};
+        g_p_vulkan_context->_vkCmdPushConstants(command_buffer,
+                                                pipeline_layout,
+                                                VK_SHADER_STAGE_VERTEX_BIT,
+                                                0,
+                                                sizeof(VulkanDrawPushConstant),
+                                                &push_constant);
+        g_p_vulkan_context->_vkCmdDrawIndexed(command_buffer,
+                                              submesh.shadow_index_count,
+                                              1,
+                                              submesh.shadow_index_offset,
+                                              submesh.vertex_offset,
+                                              0);
+    }
+
+    g_p_vulkan_context->_vkCmdEndDebugUtilsLabelEXT(command_buffer);
+}
+
+void PointLightShadowPass::updateAfterSwapchainRecreate()
+{
+
+}
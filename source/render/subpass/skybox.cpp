@@ -14,6 +14,7 @@ void SkyBoxPass::initialize(SubPassInitInfo *subpass_init_info)
     m_p_render_resource_info = skybox_pass_init_info->p_render_resource_info;
     m_subpass_index          = skybox_pass_init_info->subpass_index;
     m_renderpass             = skybox_pass_init_info->renderpass;
+    m_rendering_formats      = skybox_pass_init_info->rendering_formats;
 
     setupDescriptorSetLayout();
     setupDescriptorSet();
@@ -196,10 +197,9 @@ void SkyBoxPass::setupPipelines()
     pipelineInfo.pColorBlendState    = &color_blend_state_create_info;
     pipelineInfo.pDepthStencilState  = &depth_stencil_create_info;
     pipelineInfo.layout              = pipeline_layout;
-    pipelineInfo.renderPass          = m_renderpass;
-    pipelineInfo.subpass             = m_subpass_index;
     pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE;
     pipelineInfo.pDynamicState       = &dynamic_state_create_info;
+    setupPipelineRenderingTarget(pipelineInfo);
 
     if (vkCreateGraphicsPipelines(g_p_vulkan_context->_device,
                                   VK_NULL_HANDLE,
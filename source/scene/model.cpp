@@ -5,7 +5,14 @@
 #include "scene/model.h"
 #include "core/logger/logger_macros.h"
 #include "render/resource/render_texture.h"
+#include "render/resource/render_mesh_file.h"
+#include "render/resource/render_mesh_optimizer.h"
+#include "render/resource/render_mesh_simplifier.h"
+#include "render/resource/render_meshlet.h"
 #include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 
 using namespace Scene;
 
@@ -36,21 +43,31 @@ void Model::Tick()
 
 void Model::clearInternalState()
 {
-    m_index_count = 0;
+    m_index_count  = 0;
+    m_vertex_count = 0;
+    m_mesh_ranges.clear();
     m_submeshes.clear();
     textures_loaded.clear();
 }
 
+const aiScene *Model::importScene(Assimp::Importer &importer, const std::string &model_path)
+{
+    return importer.ReadFile(model_path,
+                             aiProcess_Triangulate |
+                             aiProcess_CalcTangentSpace | // 计算uv镜像
+                             aiProcess_JoinIdenticalVertices | // 焊接重复顶点，OBJ每个面角都是独立顶点
+                             aiProcess_ConvertToLeftHanded);
+}
+
 bool Model::LoadModelFile(const std::string &model_path, const std::string &model_name)
 {
+    auto load_start = std::chrono::steady_clock::now();
+
     path = model_path;
     name = model_name;
     Assimp::Importer importer;
 
-    const aiScene *pScene = importer.ReadFile(model_path,
-                                              aiProcess_Triangulate |
-                                              aiProcess_CalcTangentSpace | // 计算uv镜像
-                                              aiProcess_ConvertToLeftHanded);
+    const aiScene *pScene = importScene(importer, model_path);
     if (pScene == nullptr)
         return false;
 
@@ -58,8 +75,161 @@ bool Model::LoadModelFile(const std::string &model_path, const std::string &mode
     mesh_loaded = std::make_shared<RenderSystem::RenderMesh>();
     mesh_loaded->m_name = model_name;
     processModelNode(pScene->mRootNode, pScene);
-    mesh_loaded->m_submeshes = m_submeshes;
+    prepareMeshStorage();
+
+    for (const auto &range: m_mesh_ranges)
+    {
+        convertMeshVertices(range, *mesh_loaded, 0, range.mesh->mNumVertices);
+        convertMeshIndices(range, *mesh_loaded);
+    }
+    optimizeMesh();
+    mesh_loaded->CalculateBounds();
+    setupSubmeshes(nullptr);
+    m_mesh_ranges.clear();
+
+    auto load_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start);
+    LOG_INFO("model loaded name:{}\tvertices:{}\tindices:{}\ttime:{:.2f}ms",
+             name, m_vertex_count, m_index_count, load_time.count())
+    return true;
+}
+
+bool Model::importCookedFile(const std::string &cooked_path, const std::string &model_name)
+{
+    auto cooked_file = std::make_shared<RenderSystem::CookedMeshFile>();
+    if (!cooked_file->Open(cooked_path))
+        return false;
+
+    path = cooked_path;
+    name = model_name;
+
+    clearInternalState();
+    mesh_loaded = std::make_shared<RenderSystem::RenderMesh>();
+    mesh_loaded->m_name          = model_name;
+    mesh_loaded->m_cooked_source = cooked_file;
+
+    const auto &header = cooked_file->GetHeader();
+    m_vertex_count = header.vertex_count;
+    m_index_count  = header.index_count;
+    mesh_loaded->m_bounding_min = Vector3(header.bounding_min[0], header.bounding_min[1], header.bounding_min[2]);
+    mesh_loaded->m_bounding_max = Vector3(header.bounding_max[0], header.bounding_max[1], header.bounding_max[2]);
+
+    const auto *file_meshlets = cooked_file->GetMeshlets();
+    mesh_loaded->m_meshlets.assign(file_meshlets, file_meshlets + header.meshlet_count);
+
+    const auto *file_submeshes = cooked_file->GetSubmeshes();
+    const auto *file_materials = cooked_file->GetMaterials();
+    for (uint32_t i = 0; i < header.submesh_count; ++i)
+    {
+        const auto &file_submesh = file_submeshes[i];
+
+        MeshRange range{};
+        range.mesh          = nullptr;
+        range.vertex_offset = file_submesh.vertex_offset;
+        range.index_offset  = file_submesh.index_offset;
+        range.index_count   = file_submesh.index_count;
+        range.lod_count     = file_submesh.lod_count;
+        for (uint32_t lod = 0; lod < file_submesh.lod_count; ++lod)
+        {
+            range.lods[lod] = {file_submesh.lods[lod].index_offset,
+                               file_submesh.lods[lod].index_count,
+                               file_submesh.lods[lod].error};
+        }
+        range.meshlet_offset = file_submesh.meshlet_offset;
+        range.meshlet_count  = file_submesh.meshlet_count;
+        if (file_submesh.material_index >= 0 && file_submesh.material_index < int32_t(header.material_count))
+        {
+            const char *material_name = file_materials[file_submesh.material_index].name;
+            range.material_name = std::string(material_name,
+                                              strnlen(material_name, RenderSystem::kMeshFileMaterialNameLength));
+        }
+        m_mesh_ranges.push_back(range);
+    }
+    return true;
+}
+
+bool Model::LoadCookedFile(const std::string &cooked_path, const std::string &model_name)
+{
+    auto load_start = std::chrono::steady_clock::now();
+
+    if (!importCookedFile(cooked_path, model_name))
+        return false;
 
+    setupSubmeshes(nullptr);
+    m_mesh_ranges.clear();
+
+    auto load_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start);
+    LOG_INFO("cooked model loaded name:{}\tvertices:{}\tindices:{}\ttime:{:.2f}ms",
+             name, m_vertex_count, m_index_count, load_time.count())
+    return true;
+}
+
+bool Model::CookModelFile(const std::string &model_path, const std::string &model_name,
+                          const std::string &cooked_path)
+{
+    path = model_path;
+    name = model_name;
+    Assimp::Importer importer;
+
+    const aiScene *pScene = importScene(importer, model_path);
+    if (pScene == nullptr)
+    {
+        LOG_ERROR("load model error:{}\tpath:{}", importer.GetErrorString(), model_path)
+        return false;
+    }
+
+    clearInternalState();
+    mesh_loaded = std::make_shared<RenderSystem::RenderMesh>();
+    mesh_loaded->m_name = model_name;
+    processModelNode(pScene->mRootNode, pScene);
+    prepareMeshStorage();
+
+    for (const auto &range: m_mesh_ranges)
+    {
+        convertMeshVertices(range, *mesh_loaded, 0, range.mesh->mNumVertices);
+        convertMeshIndices(range, *mesh_loaded);
+    }
+    optimizeMesh();
+    mesh_loaded->CalculateBounds();
+
+    std::vector<RenderSystem::MeshFileSubmesh> file_submeshes;
+    std::vector<std::string>                   material_names;
+    for (const auto &range: m_mesh_ranges)
+    {
+        RenderSystem::MeshFileSubmesh file_submesh{};
+        file_submesh.index_count    = range.index_count;
+        file_submesh.index_offset   = range.index_offset;
+        file_submesh.vertex_offset  = 0;
+        file_submesh.material_index = -1;
+        file_submesh.lod_count      = range.lod_count;
+        for (uint32_t lod = 0; lod < range.lod_count; ++lod)
+        {
+            file_submesh.lods[lod] = {range.lods[lod].index_offset,
+                                      range.lods[lod].index_count,
+                                      range.lods[lod].error};
+        }
+        file_submesh.meshlet_offset = range.meshlet_offset;
+        file_submesh.meshlet_count  = range.meshlet_count;
+        if (!range.material_name.empty())
+        {
+            auto iter = std::find(material_names.begin(), material_names.end(), range.material_name);
+            if (iter == material_names.end())
+            {
+                material_names.push_back(range.material_name);
+                iter = material_names.end() - 1;
+            }
+            file_submesh.material_index = int32_t(iter - material_names.begin());
+        }
+        file_submeshes.push_back(file_submesh);
+    }
+    m_mesh_ranges.clear();
+
+    if (!RenderSystem::CookedMeshFile::Write(cooked_path, *mesh_loaded, file_submeshes, material_names))
+    {
+        LOG_ERROR("cook model error\tpath:{}", cooked_path)
+        return false;
+    }
+    LOG_INFO("model cooked name:{}\tvertices:{}\tindices:{}\tpath:{}",
+             name, m_vertex_count, m_index_count, cooked_path)
     return true;
 }
 
@@ -69,7 +239,22 @@ void Model::processModelNode(aiNode *node, const aiScene *scene)
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        processMesh(mesh, scene);
+
+        MeshRange range{};
+        range.mesh          = mesh;
+        range.vertex_offset = m_vertex_count;
+        range.index_offset  = m_index_count;
+        for (unsigned int j = 0; j < mesh->mNumFaces; j++)
+        {
+            range.index_count += mesh->mFaces[j].mNumIndices;
+        }
+        if (mesh->mMaterialIndex < scene->mNumMaterials)
+        {
+            range.material_name = scene->mMaterials[mesh->mMaterialIndex]->GetName().C_Str();
+        }
+        m_vertex_count += mesh->mNumVertices;
+        m_index_count += range.index_count;
+        m_mesh_ranges.push_back(range);
     }
     // 接下来对它的子节点重复这一过程
     for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -78,119 +263,165 @@ void Model::processModelNode(aiNode *node, const aiScene *scene)
     }
 }
 
-void Model::processMesh(aiMesh *mesh, const aiScene *scene)
+void Model::optimizeMesh()
 {
-//    mesh_loaded->m_name = mesh->mName.C_Str();
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    std::vector<RenderSystem::MeshIndexRange> index_ranges;
+    for (const auto &range: m_mesh_ranges)
+    {
+        index_ranges.push_back({range.index_offset, range.index_count});
+    }
+    RenderSystem::MeshOptimizer::Optimize(*mesh_loaded, index_ranges);
+    m_vertex_count = static_cast<uint32_t>(mesh_loaded->m_positions.size());
+
+    // LOD索引追加在原索引之后，必须在顶点重排之后生成
+    std::vector<uint32_t>                            lod_counts;
+    std::vector<RenderSystem::RenderSubmeshLodChain> lod_chains;
+    RenderSystem::MeshSimplifier::GenerateLods(*mesh_loaded, index_ranges, lod_counts, lod_chains);
+    for (size_t i = 0; i < m_mesh_ranges.size(); ++i)
     {
-        RenderSystem::VulkanMeshVertexPostition vertex_position;
-        RenderSystem::VulkanMeshVertexNormal    vertex_normal;
-        RenderSystem::VulkanMeshVertexTexcoord  vertex_texcoord;
+        m_mesh_ranges[i].lod_count = lod_counts[i];
+        m_mesh_ranges[i].lods      = lod_chains[i];
+    }
+    m_index_count = static_cast<uint32_t>(mesh_loaded->m_indices.size());
+
+    // meshlet只覆盖LOD0，较粗的层级整体绘制
+    std::vector<RenderSystem::MeshletRange> meshlet_ranges;
+    RenderSystem::MeshletBuilder::Build(*mesh_loaded, index_ranges, meshlet_ranges);
+    for (size_t i = 0; i < m_mesh_ranges.size(); ++i)
+    {
+        m_mesh_ranges[i].meshlet_offset = meshlet_ranges[i].meshlet_offset;
+        m_mesh_ranges[i].meshlet_count  = meshlet_ranges[i].meshlet_count;
+    }
+}
+
+void Model::prepareMeshStorage()
+{
+    // 一次性分配好所有顶点流，之后各个aiMesh可以独立写入自己的区间
+    mesh_loaded->m_positions.resize(m_vertex_count);
+    mesh_loaded->m_normals.resize(m_vertex_count);
+    mesh_loaded->m_texcoords.resize(m_vertex_count);
+    mesh_loaded->m_indices.resize(m_index_count);
+}
+
+void Model::convertMeshVertices(const MeshRange &range, RenderSystem::RenderMesh &mesh,
+                                uint32_t vertex_begin, uint32_t vertex_end)
+{
+    const aiMesh *ai_mesh = range.mesh;
+    for (uint32_t i = vertex_begin; i < vertex_end; i++)
+    {
+        auto &vertex_position = mesh.m_positions[range.vertex_offset + i];
+        auto &vertex_normal   = mesh.m_normals[range.vertex_offset + i];
+        auto &vertex_texcoord = mesh.m_texcoords[range.vertex_offset + i];
 
         // 处理顶点位置、法线和纹理坐标
-        vertex_position.position = Vector3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-        vertex_normal.normal     = Vector3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+        vertex_position.position = Vector3(ai_mesh->mVertices[i].x, ai_mesh->mVertices[i].y, ai_mesh->mVertices[i].z);
 
+        Vector3 normal;
         Vector3 tangent;
         Vector3 bitangent;
 
-        tangent   = Vector3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
-        bitangent = Vector3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
-
-        vertex_normal.tangent = Vector4(tangent.x, tangent.y, tangent.z, 1.0f);
+        normal    = Vector3(ai_mesh->mNormals[i].x, ai_mesh->mNormals[i].y, ai_mesh->mNormals[i].z);
+        tangent   = Vector3(ai_mesh->mTangents[i].x, ai_mesh->mTangents[i].y, ai_mesh->mTangents[i].z);
+        bitangent = Vector3(ai_mesh->mBitangents[i].x, ai_mesh->mBitangents[i].y, ai_mesh->mBitangents[i].z);
 
         // 计算切线空间手性
-        if (vertex_normal.normal.crossProduct(tangent).dotProduct(bitangent) < 0.0f)
-        {
-            vertex_normal.tangent.w = -1.0f;
-        } else
-        {
-            vertex_normal.tangent.w = 1.0f;
-        }
+        float handedness = normal.crossProduct(tangent).dotProduct(bitangent) < 0.0f ? -1.0f : 1.0f;
+        vertex_normal.Encode(normal, Vector4(tangent.x, tangent.y, tangent.z, handedness));
 
-        if (mesh->mTextureCoords[0]) // 网格是否有纹理坐标？
+        if (ai_mesh->mTextureCoords[0]) // 网格是否有纹理坐标？
         {
-            vertex_texcoord.texCoord.x = mesh->mTextureCoords[0][i].x;
-            vertex_texcoord.texCoord.y = mesh->mTextureCoords[0][i].y;
+            vertex_texcoord.Encode(Vector2(ai_mesh->mTextureCoords[0][i].x, ai_mesh->mTextureCoords[0][i].y));
         } else
-            vertex_texcoord.texCoord = Vector2::ZERO;
-
-        mesh_loaded->m_positions.push_back(vertex_position);
-        mesh_loaded->m_normals.push_back(vertex_normal);
-        mesh_loaded->m_texcoords.push_back(vertex_texcoord);
+            vertex_texcoord.Encode(Vector2::ZERO);
     }
+}
+
+void Model::convertMeshIndices(const MeshRange &range, RenderSystem::RenderMesh &mesh)
+{
     // 处理索引
-    uint32_t index_count = 0;
+    uint32_t index = range.index_offset;
 
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    for (unsigned int i = 0; i < range.mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace &face = range.mesh->mFaces[i];
 
         for (unsigned int j = 0; j < face.mNumIndices; j++)
         {
-            mesh_loaded->m_indices.push_back(face.mIndices[j] + m_index_count);
-            index_count++;
+            mesh.m_indices[index++] = face.mIndices[j] + range.vertex_offset;
         }
     }
+}
+
+std::string Model::getMaterialTexturePath(const std::string &material_name) const
+{
+    auto absolute_path = std::filesystem::absolute(path);
+    auto texture_path  = absolute_path.parent_path().parent_path() / "textures" / name / material_name;
+    return texture_path.string() + ".png";
+}
 
-    RenderSystem::RenderSubmesh render_submesh;
-    render_submesh.index_count   = index_count;
-    render_submesh.index_offset  = m_index_count;
-    render_submesh.vertex_offset = 0;
-    render_submesh.parent_mesh   = mesh_loaded;
-    m_index_count += index_count;
+void Model::setupSubmeshes(const std::map<std::string, TextureImagePtr> *decoded_images)
+{
+    // 同一模型中共用材质的submesh只创建一份纹理
+    std::map<std::string, int> material_index_map;
 
-    // 处理材质
-    if (mesh->mMaterialIndex >= 0)
+    for (const auto &range: m_mesh_ranges)
     {
-//        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-
-        // 1. diffuse maps
-//        loadMaterialTextures(material,
-//        aiTextureType_DIFFUSE,
-//                           "texture_diffuse");
-//        mesh_loaded->m_textures.insert(mesh_loaded->m_textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-//        // 2. specular maps
-//        std::vector<RenderSystem::RenderTexture> specular_maps = loadMaterialTextures(material,
-//                                                                                     aiTextureType_SPECULAR,
-//                                                                                     "texture_specular");
-//        mesh_loaded->m_textures.insert(mesh_loaded->m_textures.end(), specular_maps.begin(), specular_maps.end());
-//        // 3. normal maps
-//        std::vector<RenderSystem::RenderTexture> normal_maps = loadMaterialTextures(material,
-//                                                                                   aiTextureType_HEIGHT,
-//                                                                                   "texture_normal");
-//        mesh_loaded->m_textures.insert(mesh_loaded->m_textures.end(), normal_maps.begin(), normal_maps.end());
-//        // 4. height maps
-//        std::vector<RenderSystem::RenderTexture> height_maps = loadMaterialTextures(material,
-//                                                                                   aiTextureType_AMBIENT,
-//                                                                                   "texture_height");
-//        mesh_loaded->m_textures.insert(mesh_loaded->m_textures.end(), height_maps.begin(), height_maps.end());
-
-        aiMaterial *mat = scene->mMaterials[mesh->mMaterialIndex];
-
-        auto absolute_path    = std::filesystem::absolute(path);
-        auto texture_path     = absolute_path.parent_path().parent_path() / "textures" / name / mat->GetName().C_Str();
-        auto texture_path_str = texture_path.string() + ".png";
-
-        // loadMaterialTextures(mat,aiTextureType_DIFFUSE,"texture_diffuse");
-        try
+        RenderSystem::RenderSubmesh render_submesh;
+        render_submesh.index_count         = range.index_count;
+        render_submesh.index_offset        = range.index_offset;
+        render_submesh.vertex_offset       = 0;
+        render_submesh.parent_mesh         = mesh_loaded;
+        render_submesh.lod_count           = range.lod_count;
+        render_submesh.lods                = range.lods;
+        render_submesh.shadow_index_count  = range.index_count;
+        render_submesh.shadow_index_offset = range.index_offset;
+        render_submesh.meshlet_offset      = range.meshlet_offset;
+        render_submesh.meshlet_count       = range.meshlet_count;
+
+        // 处理材质
+        if (!range.material_name.empty())
         {
-            Texture2DPtr texture = std::make_shared<RenderSystem::Texture2D>(
-                    texture_path_str,
-                    mat->GetName().C_Str(),
-                    false);
-            textures_loaded.push_back(texture);
-            render_submesh.material_index = textures_loaded.size() - 1;
-            LOG_INFO("texture loaded name:{}\tpath:{}", mat->GetName().C_Str(), texture_path_str)
-        }
-        catch (const std::exception &e)
-        {
-            render_submesh.material_index = -1;
-            LOG_ERROR("load texture error:{}\tpath:{}", e.what(), texture_path_str);
+            auto texture_path_str = getMaterialTexturePath(range.material_name);
+
+            auto material_iter = material_index_map.find(texture_path_str);
+            if (material_iter != material_index_map.end())
+            {
+                render_submesh.material_index = material_iter->second;
+                m_submeshes.push_back(render_submesh);
+                continue;
+            }
+
+            try
+            {
+                TextureImagePtr texture_image;
+                if (decoded_images == nullptr)
+                {
+                    texture_image = std::make_shared<RenderSystem::TextureImage>(texture_path_str);
+                } else
+                {
+                    // 图像已经在工作线程中解码，这里只做GPU上传
+                    auto image_iter = decoded_images->find(texture_path_str);
+                    if (image_iter == decoded_images->end() || image_iter->second == nullptr)
+                    {
+                        throw std::runtime_error("texture image not decoded");
+                    }
+                    texture_image = image_iter->second;
+                }
+                // 烘焙过的纹理先只上传mip尾部，其余层级由TextureResidencyManager按需流入
+                Texture2DPtr texture = std::make_shared<RenderSystem::Texture2D>(texture_image,
+                                                                                 range.material_name);
+                textures_loaded.push_back(texture);
+                render_submesh.material_index = textures_loaded.size() - 1;
+                LOG_INFO("texture loaded name:{}\tpath:{}", range.material_name, texture_path_str)
+            }
+            catch (const std::exception &e)
+            {
+                render_submesh.material_index = -1;
+                LOG_ERROR("load texture error:{}\tpath:{}", e.what(), texture_path_str);
+            }
+            material_index_map[texture_path_str] = render_submesh.material_index;
         }
+        m_submeshes.push_back(render_submesh);
     }
-    m_submeshes.push_back(render_submesh);
+    mesh_loaded->m_submeshes = m_submeshes;
 }
-
-
-
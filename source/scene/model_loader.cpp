@@ -0,0 +1,215 @@
+//
+// Created by kyrosz7u on 2023/7/2.
+//
+
+#include "scene/model_loader.h"
+#include "core/logger/logger_macros.h"
+#include "render/resource/render_mesh_file.h"
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+
+using namespace Scene;
+
+namespace
+{
+    struct ModelImportState
+    {
+        std::unique_ptr<Assimp::Importer> importer;
+        const aiScene                     *scene{nullptr};
+        bool                              imported{false};
+        std::vector<std::string>          texture_paths;
+        std::vector<TextureImagePtr>      texture_images;
+    };
+}
+
+ModelLoader::ModelLoader(uint32_t thread_count)
+{
+    m_thread_pool.setThreadCount(std::max(thread_count, 1u));
+}
+
+void ModelLoader::addJob(std::function<void()> job)
+{
+    m_thread_pool.threads[m_next_thread]->addJob(std::move(job));
+    m_next_thread = (m_next_thread + 1) % m_thread_pool.threads.size();
+}
+
+bool ModelLoader::LoadModelFiles(const std::vector<ModelLoadInfo> &load_infos, std::vector<Model> &models)
+{
+    auto load_start = std::chrono::steady_clock::now();
+
+    models.clear();
+    models.resize(load_infos.size());
+    std::vector<ModelImportState> import_states(load_infos.size());
+
+    // 1. 每个文件一个任务：映射烘焙文件，或assimp导入并统计顶点/索引区间、预分配顶点流
+    for (size_t i = 0; i < load_infos.size(); ++i)
+    {
+        addJob([&load_infos, &models, &import_states, i]()
+               {
+                   auto &model     = models[i];
+                   auto &state     = import_states[i];
+                   auto &load_info = load_infos[i];
+
+                   // 源文件比烘焙文件新时说明烘焙结果已过期，回退到assimp
+                   std::error_code error_code;
+                   if (!load_info.cooked_path.empty() &&
+                       std::filesystem::exists(load_info.cooked_path, error_code) &&
+                       std::filesystem::last_write_time(load_info.cooked_path, error_code) >=
+                       std::filesystem::last_write_time(load_info.path, error_code))
+                   {
+                       state.imported = model.importCookedFile(load_info.cooked_path, load_info.name);
+                   }
+
+                   if (!state.imported)
+                   {
+                       model.path = load_info.path;
+                       model.name = load_info.name;
+
+                       state.importer = std::make_unique<Assimp::Importer>();
+                       state.scene    = Model::importScene(*state.importer, model.path);
+                       if (state.scene == nullptr)
+                       {
+                           LOG_ERROR("load model error:{}\tpath:{}", state.importer->GetErrorString(), model.path)
+                           return;
+                       }
+
+                       model.clearInternalState();
+                       model.mesh_loaded = std::make_shared<RenderSystem::RenderMesh>();
+                       model.mesh_loaded->m_name = model.name;
+                       model.processModelNode(state.scene->mRootNode, state.scene);
+                       model.prepareMeshStorage();
+                       state.imported = true;
+                   }
+
+                   for (const auto &range: model.m_mesh_ranges)
+                   {
+                       if (range.material_name.empty())
+                       {
+                           continue;
+                       }
+                       auto texture_path = model.getMaterialTexturePath(range.material_name);
+                       if (std::find(state.texture_paths.begin(), state.texture_paths.end(), texture_path) ==
+                           state.texture_paths.end())
+                       {
+                           state.texture_paths.push_back(texture_path);
+                       }
+                   }
+                   state.texture_images.resize(state.texture_paths.size());
+               });
+    }
+    m_thread_pool.wait();
+
+    auto import_time = std::chrono::steady_clock::now();
+
+    // 2. 顶点转换与纹理解码混合提交，各任务只写自己的区间/槽位
+    for (size_t i = 0; i < load_infos.size(); ++i)
+    {
+        auto &model = models[i];
+        auto &state = import_states[i];
+        if (!state.imported)
+        {
+            continue;
+        }
+
+        for (size_t j = 0; j < state.texture_paths.size(); ++j)
+        {
+            addJob([&state, j]()
+                   {
+                       try
+                       {
+                           state.texture_images[j] = std::make_shared<RenderSystem::TextureImage>(
+                                   state.texture_paths[j]);
+                       }
+                       catch (const std::exception &e)
+                       {
+                           LOG_ERROR("load texture error:{}\tpath:{}", e.what(), state.texture_paths[j]);
+                       }
+                   });
+        }
+
+        auto &mesh = *model.mesh_loaded;
+        for (const auto &range: model.m_mesh_ranges)
+        {
+            // 烘焙文件的顶点流直接来自文件映射，无需转换
+            if (range.mesh == nullptr)
+            {
+                continue;
+            }
+
+            uint32_t vertex_count = range.mesh->mNumVertices;
+            for (uint32_t vertex_begin = 0; vertex_begin < vertex_count; vertex_begin += kVertexBatchSize)
+            {
+                uint32_t vertex_end = std::min(vertex_begin + kVertexBatchSize, vertex_count);
+                addJob([&range, &mesh, vertex_begin, vertex_end]()
+                       {
+                           Model::convertMeshVertices(range, mesh, vertex_begin, vertex_end);
+                       });
+            }
+            addJob([&range, &mesh]()
+                   {
+                       Model::convertMeshIndices(range, mesh);
+                   });
+        }
+    }
+    m_thread_pool.wait();
+
+    // 顶点和索引全部转换完成后，每个模型一个任务做网格优化
+    for (size_t i = 0; i < load_infos.size(); ++i)
+    {
+        auto &model = models[i];
+        if (!import_states[i].imported || model.mesh_loaded->m_cooked_source != nullptr)
+        {
+            continue;
+        }
+        addJob([&model]()
+               {
+                   model.optimizeMesh();
+               });
+    }
+    m_thread_pool.wait();
+
+    auto convert_time = std::chrono::steady_clock::now();
+
+    // 3. 调用线程中创建纹理（GPU上传），释放assimp场景
+    bool all_loaded = true;
+    for (size_t i = 0; i < load_infos.size(); ++i)
+    {
+        auto &model = models[i];
+        auto &state = import_states[i];
+        if (!state.imported)
+        {
+            all_loaded = false;
+            continue;
+        }
+
+        std::map<std::string, TextureImagePtr> decoded_images;
+        for (size_t j = 0; j < state.texture_paths.size(); ++j)
+        {
+            decoded_images[state.texture_paths[j]] = state.texture_images[j];
+        }
+        if (model.mesh_loaded->m_cooked_source == nullptr)
+        {
+            model.mesh_loaded->CalculateBounds();
+        }
+        model.setupSubmeshes(&decoded_images);
+        model.m_mesh_ranges.clear();
+
+        state.texture_images.clear();
+        state.importer.reset();
+        state.scene = nullptr;
+    }
+
+    auto load_end = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    LOG_INFO("models loaded count:{}\tthreads:{}\timport:{:.2f}ms\tconvert:{:.2f}ms\tupload:{:.2f}ms\ttotal:{:.2f}ms",
+             load_infos.size(),
+             m_thread_pool.threads.size(),
+             ms(import_time - load_start).count(),
+             ms(convert_time - import_time).count(),
+             ms(load_end - convert_time).count(),
+             ms(load_end - load_start).count())
+
+    return all_loaded;
+}
@@ -1,5 +1,6 @@
 #include "scene/scene_manager.h"
 #include "core/logger/logger_macros.h"
+#include <algorithm>
 
 using namespace Scene;
 
@@ -43,6 +44,9 @@ void SceneManager::PostInitialize()
 
     m_ui_overlay->addDebugDrawCommand(std::bind(&_InputSystem::ImGuiDebugPanel, &_InputSystem::Instance()));
     m_ui_overlay->addDebugDrawCommand(std::bind(&Scene::Camera::ImGuiDebugPanel, m_main_camera));
+    m_ui_overlay->addDebugDrawCommand(std::bind(&TextureResidencyManager::ImGuiDebugPanel, &m_texture_residency));
+    m_ui_overlay->addDebugDrawCommand(std::bind(&RenderSystem::RenderBase::ImGuiDebugPanel, m_render));
+    m_ui_overlay->addDebugDrawCommand(std::bind(&RenderSystem::RenderBase::FramePacingDebugPanel, m_render));
 
     for (int i = 0; i < m_models.size(); ++i)
     {
@@ -54,6 +58,7 @@ void SceneManager::PostInitialize()
         }
     }
 
+    m_texture_residency.SetTextures(m_visible_textures);
     m_render->SetupModelRenderTextures(m_visible_textures);
     m_render->SetupSkyboxTexture(m_skybox);
     m_render->SetupShadowMapTexture(m_directional_lights);
@@ -67,7 +72,9 @@ void SceneManager::updateScene()
 
     m_visible_submeshes.clear();
 
-    int texture_offset = 0;
+    int   texture_offset  = 0;
+    auto  proj_view       = m_main_camera->getProjViewMatrix();
+    float viewport_height = m_render->m_viewport.height;
 
     for (int i = 0; i < m_models.size(); ++i)
     {
@@ -78,16 +85,49 @@ void SceneManager::updateScene()
         model.Tick();
         model.SetMeshIndex(i);
 
+        // 模型在屏幕上的尺寸决定其纹理需要驻留的mip层级和网格LOD
+        float screen_extent = TextureResidencyManager::EstimateScreenExtent(proj_view * model.GetModelMatrix(),
+                                                                            model.GetBoundingMin(),
+                                                                            model.GetBoundingMax(),
+                                                                            viewport_height);
+
         for (auto submesh: model_submeshes)
         {
             if (submesh.material_index >= 0)
+            {
                 submesh.material_index += texture_offset;
+                m_texture_residency.RequestTexture(submesh.material_index, screen_extent);
+            }
+
+            uint32_t lod        = selectLod(submesh, screen_extent);
+            uint32_t shadow_lod = std::min(lod + kShadowLodBias, submesh.lod_count - 1);
+            submesh.index_offset        = submesh.lods[lod].index_offset;
+            submesh.index_count         = submesh.lods[lod].index_count;
+            submesh.shadow_index_offset = submesh.lods[shadow_lod].index_offset;
+            submesh.shadow_index_count  = submesh.lods[shadow_lod].index_count;
+            submesh.is_static           = model.is_static;
             m_visible_submeshes.push_back(submesh);
         }
         texture_offset += model_textures.size();
     }
 }
 
+uint32_t SceneManager::selectLod(const RenderSubmesh &submesh, float screen_extent)
+{
+    // 误差相对模型尺寸，乘以模型的屏幕尺寸即为屏幕空间误差，选择误差仍在阈值内的最粗层级
+    uint32_t lod = 0;
+    while (lod + 1 < submesh.lod_count && submesh.lods[lod + 1].error * screen_extent <= kLodPixelError)
+    {
+        lod++;
+    }
+    return lod;
+}
+
+void SceneManager::BeginFrame()
+{
+    m_render->BeginFrame();
+}
+
 void SceneManager::Tick()
 {
     for (auto &model: m_models)
@@ -96,11 +136,24 @@ void SceneManager::Tick()
     }
 
     updateScene();
+    if (m_texture_residency.Update())
+    {
+        // 驻留层级变化后纹理的image view已重建
+        m_render->SetupModelRenderTextures(m_visible_textures);
+    }
     m_render->UpdateRenderModelList(m_models, m_visible_submeshes);
     m_render->UpdateRenderPerFrameScenceUBO(m_main_camera->getProjViewMatrix(),
                                             m_main_camera->position,
                                             m_directional_lights);
-    m_render->UpdateLightProjectionList(m_directional_lights);
+
+    RenderSystem::RenderCameraInfo camera_info{};
+    camera_info.view   = m_main_camera->calculateViewMatrix();
+    camera_info.fov    = m_main_camera->fov;
+    camera_info.aspect = m_main_camera->aspect;
+    camera_info.znear  = m_main_camera->znear;
+    camera_info.zfar   = m_main_camera->zfar;
+    m_render->UpdateLightProjectionList(camera_info, m_directional_lights);
+    m_render->UpdateLocalLightList(camera_info, m_point_lights, m_spot_lights);
     m_render->FlushRenderbuffer();
     m_render->Tick();
 }
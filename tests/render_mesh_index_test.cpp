@@ -0,0 +1,166 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#include "render/resource/render_mesh.h"
+#include "render/resource/render_mesh_file.h"
+#include <filesystem>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace RenderSystem;
+
+namespace
+{
+    int g_failed_count = 0;
+
+    void check(bool condition, const std::string &message)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << message << std::endl;
+            g_failed_count++;
+        }
+    }
+
+    // 三角形条带式的索引，最后一个三角形引用最大的顶点序号，保证超出16位范围的索引也被覆盖
+    void buildMesh(RenderMesh &mesh, uint32_t vertex_count)
+    {
+        mesh.m_positions.resize(vertex_count);
+        mesh.m_normals.resize(vertex_count);
+        mesh.m_texcoords.resize(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            mesh.m_positions[i].position = Vector3(float(i), float(i % 7), 0.0f);
+        }
+        for (uint32_t i = 0; i + 2 < vertex_count; ++i)
+        {
+            mesh.m_indices.push_back(i);
+            mesh.m_indices.push_back(i + 1);
+            mesh.m_indices.push_back(i + 2);
+        }
+        mesh.m_indices.push_back(0);
+        mesh.m_indices.push_back(vertex_count / 2);
+        mesh.m_indices.push_back(vertex_count - 1);
+    }
+
+    std::vector<uint32_t> unpackIndices(const uint8_t *data, uint32_t index_count, uint32_t index_stride)
+    {
+        std::vector<uint32_t> indices(index_count);
+        for (uint32_t i = 0; i < index_count; ++i)
+        {
+            if (index_stride == sizeof(uint16_t))
+            {
+                uint16_t index;
+                memcpy(&index, data + i * sizeof(uint16_t), sizeof(uint16_t));
+                indices[i] = index;
+            }
+            else
+            {
+                memcpy(&indices[i], data + i * sizeof(uint32_t), sizeof(uint32_t));
+            }
+        }
+        return indices;
+    }
+
+    void testIndexWidth(uint32_t vertex_count, VkIndexType expected_index_type)
+    {
+        const std::string name = std::to_string(vertex_count) + " vertices";
+
+        RenderMesh mesh;
+        buildMesh(mesh, vertex_count);
+
+        VkIndexType index_type = RenderMesh::SelectIndexType(mesh.m_positions.size());
+        check(index_type == expected_index_type, name + ": unexpected index type");
+
+        uint32_t index_stride   = RenderMesh::GetIndexStride(index_type);
+        auto     packed_indices = RenderMesh::PackIndices(mesh.m_indices, index_type);
+        check(packed_indices.size() == mesh.m_indices.size() * index_stride, name + ": packed size mismatch");
+        check(unpackIndices(packed_indices.data(), mesh.m_indices.size(), index_stride) == mesh.m_indices,
+              name + ": packed indices differ");
+
+        MeshFileSubmesh submesh{};
+        submesh.index_count          = mesh.m_indices.size();
+        submesh.index_offset         = 0;
+        submesh.vertex_offset        = 0;
+        submesh.material_index       = -1;
+        submesh.lod_count            = 1;
+        submesh.lods[0].index_offset = 0;
+        submesh.lods[0].index_count  = mesh.m_indices.size();
+
+        auto path = std::filesystem::temp_directory_path() /
+                    ("render_mesh_index_test_" + std::to_string(vertex_count) + ".xmesh");
+        check(CookedMeshFile::Write(path.string(), mesh, {submesh}, {}), name + ": write failed");
+
+        {
+            CookedMeshFile cooked_file;
+            if (cooked_file.Open(path.string()))
+            {
+                const auto &header = cooked_file.GetHeader();
+                check(header.vertex_count == vertex_count, name + ": vertex count mismatch");
+                check(header.index_stride == index_stride, name + ": cooked index stride mismatch");
+                check(header.index_count == mesh.m_indices.size(), name + ": cooked index count mismatch");
+                check(unpackIndices(cooked_file.GetSection(header.index_offset), header.index_count,
+                                    header.index_stride) == mesh.m_indices,
+                      name + ": cooked indices differ");
+            }
+            else
+            {
+                check(false, name + ": open failed");
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
+    // 越界的submesh范围必须被Open拒绝，由模型加载回退到assimp导入
+    void testRejectSubmesh(const std::string &name, const MeshFileSubmesh &submesh)
+    {
+        RenderMesh mesh;
+        buildMesh(mesh, 300);
+
+        auto path = std::filesystem::temp_directory_path() / "render_mesh_index_test_corrupt.xmesh";
+        check(CookedMeshFile::Write(path.string(), mesh, {submesh}, {}), name + ": write failed");
+        {
+            CookedMeshFile cooked_file;
+            check(!cooked_file.Open(path.string()), name + ": corrupt file was accepted");
+        }
+        std::filesystem::remove(path);
+    }
+
+    void testRejectCorruptSubmeshes()
+    {
+        RenderMesh mesh;
+        buildMesh(mesh, 300);
+
+        MeshFileSubmesh submesh{};
+        submesh.index_count         = mesh.m_indices.size();
+        submesh.material_index      = -1;
+        submesh.lod_count           = 1;
+        submesh.lods[0].index_count = mesh.m_indices.size();
+
+        MeshFileSubmesh index_overflow = submesh;
+        index_overflow.index_offset    = 3;
+        testRejectSubmesh("submesh index range", index_overflow);
+
+        MeshFileSubmesh vertex_overflow = submesh;
+        vertex_overflow.vertex_offset   = 1;
+        testRejectSubmesh("submesh vertex range", vertex_overflow);
+    }
+}
+
+int main()
+{
+    testIndexWidth(70000, VK_INDEX_TYPE_UINT32);
+    testIndexWidth(65536, VK_INDEX_TYPE_UINT16);
+    testIndexWidth(300, VK_INDEX_TYPE_UINT16);
+    testRejectCorruptSubmeshes();
+
+    if (g_failed_count > 0)
+    {
+        std::cerr << g_failed_count << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "render mesh index tests passed" << std::endl;
+    return 0;
+}
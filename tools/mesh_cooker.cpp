@@ -0,0 +1,48 @@
+//
+// Created by kyrosz7u on 2023/7/4.
+//
+
+#include "core/logger/logger_macros.h"
+#include "scene/model.h"
+#include <filesystem>
+#include <string>
+
+// 离线把assets/models下的模型烘焙为.xmesh，运行时通过文件映射加载
+// 用法: XMeshCooker [model_dir] [cooked_dir]
+int main(int argc, char **argv)
+{
+    std::filesystem::path model_dir  = argc > 1 ? argv[1] : "assets/models";
+    std::filesystem::path cooked_dir = argc > 2 ? argv[2] : "assets/cooked";
+
+    if (!std::filesystem::is_directory(model_dir))
+    {
+        LOG_ERROR("model directory not found:{}", model_dir.string())
+        return -1;
+    }
+    std::filesystem::create_directories(cooked_dir);
+
+    int failed_count = 0;
+    for (const auto &entry: std::filesystem::directory_iterator(model_dir))
+    {
+        if (!entry.is_regular_file())
+        {
+            continue;
+        }
+        auto extension = entry.path().extension().string();
+        if (extension != ".fbx" && extension != ".obj")
+        {
+            continue;
+        }
+
+        // 保留原扩展名，避免plane.fbx与plane.obj烘焙到同一个文件
+        auto model_name  = entry.path().stem().string();
+        auto cooked_path = cooked_dir / (entry.path().filename().string() + ".xmesh");
+
+        Scene::Model model;
+        if (!model.CookModelFile(entry.path().string(), model_name, cooked_path.string()))
+        {
+            failed_count++;
+        }
+    }
+    return failed_count == 0 ? 0 : -1;
+}
@@ -0,0 +1,113 @@
+//
+// Created by kyrosz7u on 2023/7/22.
+//
+
+#include "core/logger/logger_macros.h"
+#include "core/window/glfw_window.h"
+#include "render/render_base.h"
+#include "scene/model.h"
+#include "scene/model_loader.h"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// 比较model_dir下所有模型逐个串行加载(Model::LoadModelFile)与ModelLoader并行加载的耗时，
+// 两条路径都从assimp导入开始，包含顶点转换、网格优化、纹理解码和GPU上传，不使用烘焙文件
+// 用法: XModelLoadBench [model_dir] [repeat_count] [thread_count]
+namespace
+{
+    double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+    // 上传是同步完成的，设备已经空闲，析构时登记的资源可以立即销毁
+    void releaseModels(std::vector<Scene::Model> &models)
+    {
+        models.clear();
+        RenderSystem::g_p_vulkan_context->_deletion_queue.Flush();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::filesystem::path model_dir    = argc > 1 ? argv[1] : "assets/models";
+    int                   repeat_count = argc > 2 ? std::max(std::stoi(argv[2]), 1) : 5;
+    uint32_t              thread_count = argc > 3 ? uint32_t(std::max(std::stoi(argv[3]), 1))
+                                                  : std::max(std::thread::hardware_concurrency(), 1u);
+
+    if (!std::filesystem::is_directory(model_dir))
+    {
+        LOG_ERROR("model directory not found:{}", model_dir.string())
+        return -1;
+    }
+
+    std::vector<Scene::ModelLoadInfo> load_infos;
+    for (const auto &entry: std::filesystem::directory_iterator(model_dir))
+    {
+        auto extension = entry.path().extension().string();
+        if (entry.is_regular_file() && (extension == ".fbx" || extension == ".obj"))
+        {
+            load_infos.push_back({entry.path().string(), entry.path().stem().string(), ""});
+        }
+    }
+    if (load_infos.empty())
+    {
+        LOG_ERROR("no model found in:{}", model_dir.string())
+        return -1;
+    }
+
+    // 纹理上传需要vulkan设备
+    GLFWWindowCreateInfo window_create_info;
+    window_create_info.title = "XModelLoadBench";
+    auto window = std::make_shared<GLFWWindow>();
+    window->initialize(window_create_info);
+    RenderBase::setupGlobally(window->getWindowHandler());
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::vector<double> serial_times;
+    std::vector<double> parallel_times;
+    std::vector<Scene::Model> models;
+    Scene::ModelLoader        model_loader(thread_count);
+
+    // 第0轮只用来预热文件缓存，不计入结果
+    for (int round = 0; round <= repeat_count; ++round)
+    {
+        auto serial_start = std::chrono::steady_clock::now();
+        models.resize(load_infos.size());
+        for (size_t i = 0; i < load_infos.size(); ++i)
+        {
+            if (!models[i].LoadModelFile(load_infos[i].path, load_infos[i].name))
+            {
+                LOG_ERROR("failed to load model:{}", load_infos[i].path)
+            }
+        }
+        double serial_time = ms(std::chrono::steady_clock::now() - serial_start).count();
+        releaseModels(models);
+
+        auto parallel_start = std::chrono::steady_clock::now();
+        if (!model_loader.LoadModelFiles(load_infos, models))
+        {
+            LOG_ERROR("failed to load models in parallel")
+        }
+        double parallel_time = ms(std::chrono::steady_clock::now() - parallel_start).count();
+        releaseModels(models);
+
+        if (round > 0)
+        {
+            serial_times.push_back(serial_time);
+            parallel_times.push_back(parallel_time);
+            LOG_INFO("round:{}\tserial:{:.2f}ms\tparallel:{:.2f}ms", round, serial_time, parallel_time)
+        }
+    }
+
+    LOG_INFO("models:{}\tthreads:{}\trounds:{}\tserial median:{:.2f}ms\tparallel median:{:.2f}ms\tspeedup:{:.2f}x",
+             load_infos.size(), thread_count, repeat_count,
+             median(serial_times), median(parallel_times), median(serial_times) / median(parallel_times))
+
+    RenderBase::clearGlobally();
+    return 0;
+}
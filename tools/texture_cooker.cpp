@@ -0,0 +1,51 @@
+//
+// Created by kyrosz7u on 2023/7/6.
+//
+
+#include "core/logger/logger_macros.h"
+#include "core/threadpool.h"
+#include "render/resource/render_texture_file.h"
+#include <filesystem>
+#include <atomic>
+#include <string>
+
+// 离线把texture_dir下的png生成mip链并压缩为BC7，写到同目录的.ktx2
+// 用法: XTextureCooker [texture_dir]
+int main(int argc, char **argv)
+{
+    std::filesystem::path texture_dir = argc > 1 ? argv[1] : "assets/textures";
+
+    if (!std::filesystem::is_directory(texture_dir))
+    {
+        LOG_ERROR("texture directory not found:{}", texture_dir.string())
+        return -1;
+    }
+
+    ThreadPool thread_pool;
+    thread_pool.setThreadCount(std::max(std::thread::hardware_concurrency(), 1u));
+
+    std::atomic<int> failed_count{0};
+    uint32_t         next_thread = 0;
+    for (const auto &entry: std::filesystem::recursive_directory_iterator(texture_dir))
+    {
+        if (!entry.is_regular_file() || entry.path().extension() != ".png")
+        {
+            continue;
+        }
+
+        auto source_path = entry.path().string();
+        auto cooked_path = std::filesystem::path(entry.path()).replace_extension(".ktx2").string();
+        thread_pool.threads[next_thread]->addJob([source_path, cooked_path, &failed_count]()
+                                                 {
+                                                     if (!RenderSystem::TextureCooker::CookTextureFile(source_path,
+                                                                                                       cooked_path))
+                                                     {
+                                                         failed_count++;
+                                                     }
+                                                 });
+        next_thread = (next_thread + 1) % thread_pool.threads.size();
+    }
+    thread_pool.wait();
+
+    return failed_count == 0 ? 0 : -1;
+}